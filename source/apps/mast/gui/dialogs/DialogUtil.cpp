@@ -1,6 +1,7 @@
 /***
  * millipede: DialogUtil.cpp
  * Copyright Stuart Golodetz, 2009. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #include "DialogUtil.h"
@@ -68,8 +69,9 @@ bool execute_with_progress_dialog(const Job_Ptr& job, wxWindow *parent, const st
 			break;
 		}
 
-		// If any sub-jobs have been queued to run in the main thread, run the next one in the queue.
-		if(mtjq->has_jobs())
+		// If any sub-jobs have been queued to run in the main thread, run the next one in the queue. Otherwise, sleep
+		// until one is queued or the job stops (waking up periodically to keep the progress dialog up-to-date).
+		if(mtjq->wait_for_jobs(*job, 50))
 		{
 			mtjq->run_next_job();
 		}
@@ -6,6 +6,8 @@
 
 #include "SegmentDICOMVolumeDialog.h"
 
+#include <algorithm>
+
 #include <boost/lexical_cast.hpp>
 using boost::bad_lexical_cast;
 using boost::lexical_cast;
@@ -38,7 +40,7 @@ bool SegmentDICOMVolumeDialog::construct_segmentation_options()
 
 	DICOMSegmentationOptions::InputType inputType = DICOMSegmentationOptions::InputType(m_inputType->GetSelection());
 	DICOMSegmentationOptions::WaterfallAlgorithm waterfallAlgorithm = DICOMSegmentationOptions::WaterfallAlgorithm(m_waterfallAlgorithm->GetSelection());
-	m_segmentationOptions = DICOMSegmentationOptions(adfConductance, m_adfIterations->GetValue(), inputType, subvolumeSize, waterfallAlgorithm, m_waterfallLayerLimit->GetValue(), m_windowSettings);
+	m_segmentationOptions = DICOMSegmentationOptions(adfConductance, m_adfIterations->GetValue(), inputType, subvolumeSize, m_threadCount->GetValue(), waterfallAlgorithm, m_waterfallLayerLimit->GetValue(), m_windowSettings);
 	return true;
 }
 
@@ -93,6 +95,18 @@ wxPanel *SegmentDICOMVolumeDialog::create_advanced_page(wxWindow *parent)
 	m_waterfallLayerLimit = new wxSpinCtrl(panel, wxID_ANY, wxT("5"), wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 0, 10, 5);
 	waterfallSizer->Add(m_waterfallLayerLimit, 0, wxALIGN_CENTRE_VERTICAL);
 
+	sizer->AddSpacer(10);
+
+	// Set up the control that allows the user to set the number of threads used to build the lowest forest layers.
+	wxGridSizer *threadingSizer = new wxGridSizer(0, 2, 0, 5);
+	sizer->Add(threadingSizer);
+
+	int defaultThreadCount = DICOMSegmentationOptions::default_thread_count();
+	wxString defaultThreadCountString = string_to_wxString(lexical_cast<std::string>(defaultThreadCount));
+	threadingSizer->Add(new wxStaticText(panel, wxID_ANY, wxT("Worker Threads:")), 0, wxALIGN_CENTRE_VERTICAL);
+	m_threadCount = new wxSpinCtrl(panel, wxID_ANY, defaultThreadCountString, wxDefaultPosition, wxDefaultSize, wxSP_ARROW_KEYS, 1, std::max(defaultThreadCount, 64), defaultThreadCount);
+	threadingSizer->Add(m_threadCount, 0, wxALIGN_CENTRE_VERTICAL);
+
 	sizer->Fit(panel);
 	return panel;
 }
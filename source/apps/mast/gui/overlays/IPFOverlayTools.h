@@ -1,6 +1,7 @@
 /***
  * millipede: IPFOverlayTools.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_IPFOVERLAYTOOLS
@@ -67,59 +68,47 @@ void draw_node(const VolumeIPF_CPtr& volumeIPF, const PFNodeID& node, RGBA32Imag
 			   const itk::Index<3>& sliceBegin, const itk::Index<3>& sliceEnd, SliceOrientation sliceOrientation,
 			   const boost::optional<RGBA32>& fillColour, const boost::optional<RGBA32>& boundaryColour, const boost::optional<RGBA32>& hatchingColour)
 {
-	std::vector<itk::Offset<3> > offsets = ITKImageUtil::make_4_connected_offsets(sliceOrientation);
-
-	std::deque<int> receptiveRegion = volumeIPF->receptive_region_of(node);
-	for(std::deque<int>::const_iterator it=receptiveRegion.begin(), iend=receptiveRegion.end(); it!=iend; ++it)
+	typedef typename VolumeIPF_CPtr::element_type VolumeIPFT;
+	typedef typename VolumeIPFT::LeafRunConstIterator LeafRunConstIterator;
+	typedef typename VolumeIPFT::SliceRuns_CPtr SliceRuns_CPtr;
+
+	// Look up the runs of leaves of the node that lie within the slice (the bounds of the slice are the same in
+	// every orientation-specific slice dimension, so only the slice coordinate itself needs to be checked).
+	int slice = sliceBegin[sliceOrientation];
+	SliceRuns_CPtr sliceRuns = volumeIPF->slice_runs_of(node, sliceOrientation);
+	std::pair<LeafRunConstIterator,LeafRunConstIterator> runs = sliceRuns->runs_in_slice(slice);
+	for(LeafRunConstIterator it=runs.first, iend=runs.second; it!=iend; ++it)
 	{
-		// Calculate the position of the leaf.
-		itk::Index<3> volumePos = volumeIPF->position_of_leaf(*it);
-
-		// Ignore the leaf if it's not within [sliceBegin,sliceEnd).
-		if(volumePos[0] < sliceBegin[0] || volumePos[1] < sliceBegin[1] || volumePos[2] < sliceBegin[2] ||
-		   volumePos[0] >= sliceEnd[0] || volumePos[1] >= sliceEnd[1] || volumePos[2] >= sliceEnd[2])
+		for(int col=it->begin; col<it->end; ++col)
 		{
-			continue;
-		}
+			// Calculate the position of the leaf in image coordinates.
+			itk::Index<2> imagePos = {{col, it->row}};
 
-		// If there's a boundary colour, determine whether this pixel is a boundary.
-		bool boundary = false;
-		if(boundaryColour)
-		{
-			for(size_t i=0, size=offsets.size(); i<size; ++i)
+			// If there's a boundary colour, determine whether this pixel is a boundary. Since the runs are maximal, the ends
+			// of each run are always on the boundary: other pixels are boundaries iff the pixel above or below isn't in the node.
+			bool boundary = false;
+			if(boundaryColour)
 			{
-				if(volumeIPF->node_of(node.layer(), volumePos + offsets[i]) != node)
-				{
-					boundary = true;
-					break;
-				}
+				boundary =	col == it->begin || col == it->end - 1 ||
+							!sliceRuns->contains(slice, it->row - 1, col) || !sliceRuns->contains(slice, it->row + 1, col);
 			}
-		}
 
-		// Project the position into image coordinates.
-		itk::Index<2> imagePos = {{-1, -1}};
-		switch(sliceOrientation)
-		{
-			case ORIENT_XY:	imagePos[0] = volumePos[0]; imagePos[1] = volumePos[1]; break;
-			case ORIENT_XZ:	imagePos[0] = volumePos[0]; imagePos[1] = volumePos[2]; break;
-			case ORIENT_YZ:	imagePos[0] = volumePos[1]; imagePos[1] = volumePos[2]; break;
-		}
+			// If there's a hatching colour, determine whether this pixel is on a hatching line.
+			bool hatching = false;
+			if(hatchingColour)
+			{
+				// We want to draw diagonal hatching of the form y = -x + c (bear in mind that +y is down the screen).
+				const int LINE_SPACING = 20;
+				const int LINE_HALF_THICKNESS = 1;
+				int c = imagePos[0] + imagePos[1];
+				hatching = abs(c % LINE_SPACING) <= LINE_HALF_THICKNESS;
+			}
 
-		// If there's a hatching colour, determine whether this pixel is on a hatching line.
-		bool hatching = false;
-		if(hatchingColour)
-		{
-			// We want to draw diagonal hatching of the form y = -x + c (bear in mind that +y is down the screen).
-			const int LINE_SPACING = 20;
-			const int LINE_HALF_THICKNESS = 1;
-			int c = imagePos[0] + imagePos[1];
-			hatching = abs(c % LINE_SPACING) <= LINE_HALF_THICKNESS;
+			// Draw the pixel.
+			if(boundary)			image->SetPixel(imagePos, *boundaryColour);
+			else if(hatching)		image->SetPixel(imagePos, *hatchingColour);
+			else if(fillColour)		image->SetPixel(imagePos, *fillColour);
 		}
-
-		// Draw the pixel.
-		if(boundary)			image->SetPixel(imagePos, *boundaryColour);
-		else if(hatching)		image->SetPixel(imagePos, *hatchingColour);
-		else if(fillColour)		image->SetPixel(imagePos, *fillColour);
 	}
 }
 
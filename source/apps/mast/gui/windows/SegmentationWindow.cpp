@@ -9,6 +9,7 @@
 #include <iterator>
 
 #include <wx/menu.h>
+#include <wx/numdlg.h>
 #include <wx/sizer.h>
 
 #include <common/commands/UndoableCommandManager.h>
@@ -33,6 +34,7 @@ enum
 	MENUID_BASE = wxID_HIGHEST,		// a dummy value which is never used: subsequent values are guaranteed to be higher than this
 	MENUID_ACTIONS_CLEARHISTORY,
 	MENUID_ACTIONS_REDO,
+	MENUID_ACTIONS_SETUNDOMEMORYBUDGET,
 	MENUID_ACTIONS_UNDO,
 	MENUID_FEATURES_AUTOIDENTIFY_MULTIFEATURE3D,
 	MENUID_FEATURES_AUTOIDENTIFY_SPINE3D,
@@ -84,13 +86,26 @@ enum
 	MENUID_TOOLS_VISUALIZEIN3D,
 };
 
+/// The indices of the filters in the "Save Segmentation" dialog, each of which selects a volume IPF file format
+enum
+{
+	SAVEFILTER_BINARY,
+	SAVEFILTER_TEXT,
+};
+
+/// The amount of memory (in megabytes) that the undo history may initially occupy before the oldest commands are discarded
+const long DEFAULT_UNDO_MEMORY_BUDGET_MB = 256;
+
+/// The largest undo memory budget (in megabytes) that can be chosen from the "Set Undo Memory Budget" dialog (kept below 4GB so that it fits in a 32-bit size_t)
+const long MAX_UNDO_MEMORY_BUDGET_MB = 4095;
+
 }
 
 namespace mp {
 
 //#################### CONSTRUCTORS ####################
 SegmentationWindow::SegmentationWindow(wxWindow *parent, const std::string& title, const PartitionModel_Ptr& model, wxGLContext *context)
-:	wxFrame(parent, wxID_ANY, string_to_wxString(title)), m_commandManager(new UndoableCommandManager), m_model(model)
+:	wxFrame(parent, wxID_ANY, string_to_wxString(title)), m_commandManager(new UndoableCommandManager(DEFAULT_UNDO_MEMORY_BUDGET_MB * 1024 * 1024)), m_model(model)
 {
 	setup_menus();
 	setup_gui(context);
@@ -189,6 +204,7 @@ void SegmentationWindow::setup_menus()
 	actionsMenu->Append(MENUID_ACTIONS_REDO, wxT("&Redo\tCtrl+Y"));
 	actionsMenu->AppendSeparator();
 	actionsMenu->Append(MENUID_ACTIONS_CLEARHISTORY, wxT("&Clear History"));
+	actionsMenu->Append(MENUID_ACTIONS_SETUNDOMEMORYBUDGET, wxT("Set Undo &Memory Budget..."));
 
 	wxMenu *navigationMenu = new wxMenu;
 	navigationMenu->Append(MENUID_NAVIGATION_PANDOWN, wxT("Pan &Down\tKP_2"));
@@ -323,6 +339,15 @@ void SegmentationWindow::OnMenuActionsRedo(wxCommandEvent&)
 	m_commandManager->redo();
 }
 
+void SegmentationWindow::OnMenuActionsSetUndoMemoryBudget(wxCommandEvent&)
+{
+	size_t budget = m_commandManager->memory_budget();
+	long curValue = budget == UndoableCommandManager::UNLIMITED_MEMORY_BUDGET ? 0 : static_cast<long>(budget / (1024 * 1024));
+	long newValue = wxGetNumberFromUser(wxT("The oldest commands are discarded when the undo history exceeds this (0 = unlimited)."), wxT("Budget (MB):"), wxT("Set Undo Memory Budget"), curValue, 0, MAX_UNDO_MEMORY_BUDGET_MB, this);
+	if(newValue == 0) m_commandManager->set_memory_budget(UndoableCommandManager::UNLIMITED_MEMORY_BUDGET);
+	else if(newValue != -1) m_commandManager->set_memory_budget(static_cast<size_t>(newValue) * 1024 * 1024);
+}
+
 void SegmentationWindow::OnMenuActionsUndo(wxCommandEvent&)
 {
 	m_commandManager->undo();
@@ -489,11 +514,12 @@ void SegmentationWindow::OnMenuSegmentationMergeSelectedNodes(wxCommandEvent&)
 
 void SegmentationWindow::OnMenuSegmentationSaveSegmentation(wxCommandEvent&)
 {
-	wxFileDialog_Ptr dialog = construct_save_dialog(this, "Save Segmentation", "Image Partition Forest Files (*.ipf)|*.ipf|All Files|*.*");
+	wxFileDialog_Ptr dialog = construct_save_dialog(this, "Save Segmentation", "Image Partition Forest Files (*.ipf)|*.ipf|Text Image Partition Forest Files (*.ipf)|*.ipf");
 	if(dialog->ShowModal() == wxID_OK)
 	{
 		std::string path = wxString_to_string(dialog->GetPath());
-		VolumeIPFFile::save(path, m_model->volume_ipf());
+		VolumeIPFFile::Format format = dialog->GetFilterIndex() == SAVEFILTER_TEXT ? VolumeIPFFile::FORMAT_TEXT : VolumeIPFFile::FORMAT_BINARY;
+		VolumeIPFFile::save(path, m_model->volume_ipf(), format);
 	}
 }
 
@@ -830,6 +856,7 @@ BEGIN_EVENT_TABLE(SegmentationWindow, wxFrame)
 	//~~~~~~~~~~~~~~~~~~~~ MENUS ~~~~~~~~~~~~~~~~~~~~
 	EVT_MENU(MENUID_ACTIONS_CLEARHISTORY, SegmentationWindow::OnMenuActionsClearHistory)
 	EVT_MENU(MENUID_ACTIONS_REDO, SegmentationWindow::OnMenuActionsRedo)
+	EVT_MENU(MENUID_ACTIONS_SETUNDOMEMORYBUDGET, SegmentationWindow::OnMenuActionsSetUndoMemoryBudget)
 	EVT_MENU(MENUID_ACTIONS_UNDO, SegmentationWindow::OnMenuActionsUndo)
 	EVT_MENU(MENUID_FEATURES_AUTOIDENTIFY_MULTIFEATURE3D, SegmentationWindow::OnMenuFeaturesAutoIdentifyMultiFeature)
 	EVT_MENU(MENUID_FEATURES_AUTOIDENTIFY_SPINE3D, SegmentationWindow::OnMenuFeaturesAutoIdentifySpine)
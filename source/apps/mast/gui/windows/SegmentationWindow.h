@@ -20,8 +20,8 @@
 namespace mp {
 
 //#################### FORWARD DECLARATIONS ####################
-typedef boost::shared_ptr<class ICommandManager> ICommandManager_Ptr;
 class PartitionView;
+typedef boost::shared_ptr<class UndoableCommandManager> UndoableCommandManager_Ptr;
 
 class SegmentationWindow : public wxFrame
 {
@@ -36,7 +36,7 @@ private:
 
 	//#################### PRIVATE VARIABLES ####################
 private:
-	ICommandManager_Ptr m_commandManager;
+	UndoableCommandManager_Ptr m_commandManager;
 	wxMenuBar *m_menuBar;
 	PartitionModel_Ptr m_model;
 	PartitionView *m_view;
@@ -61,6 +61,7 @@ public:
 	//~~~~~~~~~~~~~~~~~~~~ MENUS ~~~~~~~~~~~~~~~~~~~~
 	void OnMenuActionsClearHistory(wxCommandEvent&);
 	void OnMenuActionsRedo(wxCommandEvent&);
+	void OnMenuActionsSetUndoMemoryBudget(wxCommandEvent&);
 	void OnMenuActionsUndo(wxCommandEvent&);
 	void OnMenuFeaturesAutoIdentifyMultiFeature(wxCommandEvent&);
 	void OnMenuFeaturesAutoIdentifySpine(wxCommandEvent&);
@@ -1,6 +1,7 @@
 /***
  * millipede: AdjacencyGraph.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_ADJACENCYGRAPH
@@ -128,6 +129,12 @@ public:
 		return m_edges.end();
 	}
 
+	template <typename Func>
+	Func for_each_edge(Func f) const
+	{
+		return std::for_each(m_edges.begin(), m_edges.end(), f);
+	}
+
 	bool has_edge(int u, int v) const
 	{
 		return m_edges.find(make_edge_tuple(u, v)) != m_edges.end();
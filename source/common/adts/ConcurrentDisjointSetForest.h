@@ -0,0 +1,244 @@
+/***
+ * millipede: ConcurrentDisjointSetForest.h
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#ifndef H_MILLIPEDE_CONCURRENTDISJOINTSETFOREST
+#define H_MILLIPEDE_CONCURRENTDISJOINTSETFOREST
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <common/exceptions/Exception.h>
+#include <common/io/util/OSSWrapper.h>
+#include <common/util/AtomicUtil.h>
+#include <common/util/NullType.h>
+
+namespace mp {
+
+/**
+@brief	A ConcurrentDisjointSetForest is a variant of DenseDisjointSetForest whose find_set() and union_sets() operations
+		may safely be called from multiple threads at once (e.g. to label the parts of an image in parallel).
+
+The forest is lock-free: sets are linked by atomically swapping the parent of one root for the other (retrying if
+another thread got there first), and find_set() halves paths using compare-and-swap operations that may harmlessly
+fail. To rule out cycles between concurrent links, a root is always linked beneath the root with the smaller index,
+so the root of each set is always its smallest element.
+
+Elements must be added (via add_element() or add_elements()) before any concurrent operations begin, and the forest
+cannot grow beyond the index bound specified on construction.
+
+@tparam	T	The type of data to attach to each element (arbitrary)
+*/
+template <typename T = NullType>
+class ConcurrentDisjointSetForest
+{
+	//#################### PRIVATE VARIABLES ####################
+private:
+	int m_elementCount;
+	mutable std::vector<int> m_parents;		// the parent of each element (or -1 for indices that are not elements)
+	mutable int m_setCount;
+	std::vector<T> m_values;
+
+	//#################### CONSTRUCTORS ####################
+public:
+	/**
+	@brief	Constructs an empty disjoint set forest.
+
+	@param[in]	indexBound	An exclusive upper bound on the element indices that will be used
+	*/
+	explicit ConcurrentDisjointSetForest(int indexBound)
+	:	m_elementCount(0), m_parents(indexBound, -1), m_setCount(0), m_values(indexBound)
+	{}
+
+	/**
+	@brief	Constructs a disjoint set forest from an initial set of elements and their associated values.
+
+	@param[in]	initialElements		A map from the initial elements to their associated values
+	*/
+	explicit ConcurrentDisjointSetForest(const std::map<int,T>& initialElements)
+	:	m_elementCount(0), m_setCount(0)
+	{
+		int indexBound = initialElements.empty() ? 0 : initialElements.rbegin()->first + 1;
+		m_parents.resize(indexBound, -1);
+		m_values.resize(indexBound);
+		add_elements(initialElements);
+	}
+
+	//#################### PUBLIC METHODS ####################
+public:
+	/**
+	@brief	Adds a single element x (and its associated value) to the disjoint set forest.
+
+	This is not thread-safe: all elements must be added before any concurrent operations begin.
+
+	@param[in]	x		The index of the element
+	@param[in]	value	The value to initially associate with the element
+	@pre
+		-	0 <= x < the index bound of the forest
+		-	x must not already be in the disjoint set forest
+	@throw Exception
+		-	If x is outside the index bound of the forest
+	*/
+	void add_element(int x, const T& value = T())
+	{
+		if(x < 0 || x >= static_cast<int>(m_parents.size()))
+		{
+			throw Exception(OSSWrapper() << "Element out of range: " << x);
+		}
+
+		m_parents[x] = x;
+		m_values[x] = value;
+		++m_elementCount;
+		++m_setCount;
+	}
+
+	/**
+	@brief	Adds multiple elements (and their associated values) to the disjoint set forest.
+
+	This is not thread-safe: all elements must be added before any concurrent operations begin.
+
+	@param[in]	elements	A map from the elements to add to their associated values
+	@pre
+		-	None of the elements to be added must already be in the disjoint set forest
+	@throw Exception
+		-	If any element is outside the index bound of the forest
+	*/
+	void add_elements(const std::map<int,T>& elements)
+	{
+		for(typename std::map<int,T>::const_iterator it=elements.begin(), iend=elements.end(); it!=iend; ++it)
+		{
+			add_element(it->first, it->second);
+		}
+	}
+
+	/**
+	@brief	Returns the number of elements in the disjoint set forest.
+
+	@return	As described
+	*/
+	int element_count() const
+	{
+		return m_elementCount;
+	}
+
+	/**
+	@brief	Finds the index of the root element (i.e. the smallest element) of the tree containing x in the disjoint set forest.
+
+	This may be called concurrently with other calls to find_set() and union_sets(), in which case the result is the root
+	of the tree containing x at some point during the call.
+
+	@param[in]	x	The element whose set to determine
+	@pre
+		-	x must be an element in the disjoint set forest
+	@throw Exception
+		-	If the precondition is violated
+	@return	As described
+	*/
+	int find_set(int x) const
+	{
+		check_element(x);
+
+		volatile int *parents = &m_parents[0];
+		for(;;)
+		{
+			int parent = parents[x];
+			if(parent == x) return x;
+
+			// Path halving: try to make x point to its grandparent (it doesn't matter if another thread changes it first).
+			int grandparent = parents[parent];
+			if(grandparent != parent) AtomicUtil::compare_and_swap(&parents[x], parent, grandparent);
+			x = grandparent;
+		}
+	}
+
+	/**
+	@brief	Returns the current number of disjoint sets in the forest (i.e. the current number of trees).
+
+	@return	As described
+	*/
+	int set_count() const
+	{
+		return AtomicUtil::add(&m_setCount, 0);
+	}
+
+	/**
+	@brief	Merges the disjoint sets containing elements x and y.
+
+	If both elements are already in the same disjoint set, this is a no-op. This may be called concurrently with
+	other calls to find_set() and union_sets().
+
+	@param[in]	x	The first element
+	@param[in]	y	The second element
+	@pre
+		-	Both x and y must be elements in the disjoint set forest
+	@throw Exception
+		-	If the precondition is violated
+	*/
+	void union_sets(int x, int y)
+	{
+		volatile int *parents = &m_parents[0];
+		for(;;)
+		{
+			int setX = find_set(x);
+			int setY = find_set(y);
+			if(setX == setY) return;
+
+			// Link the root with the larger index beneath the other one. If the former has stopped being a root in the
+			// meantime (because another thread has linked it elsewhere), try again.
+			if(setX < setY) std::swap(setX, setY);
+			if(AtomicUtil::compare_and_swap(&parents[setX], setX, setY) == setX)
+			{
+				AtomicUtil::add(&m_setCount, -1);
+				return;
+			}
+		}
+	}
+
+	/**
+	@brief	Returns the value associated with element x.
+
+	@param[in]	x	The element whose value to return
+	@pre
+		-	x must be an element in the disjoint set forest
+	@throw Exception
+		-	If the precondition is violated
+	@return	As described
+	*/
+	T& value_of(int x)
+	{
+		check_element(x);
+		return m_values[x];
+	}
+
+	/**
+	@brief	Returns the value associated with element x.
+
+	@param[in]	x	The element whose value to return
+	@pre
+		-	x must be an element in the disjoint set forest
+	@throw Exception
+		-	If the precondition is violated
+	@return	As described
+	*/
+	const T& value_of(int x) const
+	{
+		check_element(x);
+		return m_values[x];
+	}
+
+	//#################### PRIVATE METHODS ####################
+private:
+	void check_element(int x) const
+	{
+		if(x < 0 || x >= static_cast<int>(m_parents.size()) || m_parents[x] == -1)
+		{
+			throw Exception(OSSWrapper() << "No such element: " << x);
+		}
+	}
+};
+
+}
+
+#endif
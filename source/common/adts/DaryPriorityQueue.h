@@ -0,0 +1,293 @@
+/***
+ * millipede: DaryPriorityQueue.h
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#ifndef H_MILLIPEDE_DARYPRIORITYQUEUE
+#define H_MILLIPEDE_DARYPRIORITYQUEUE
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include <common/exceptions/Exception.h>
+
+namespace mp {
+
+/**
+@brief	A DaryPriorityQueue is a variant of PriorityQueue for elements whose IDs are small non-negative integers
+		(e.g. node or voxel indices).
+
+Instead of a std::map dictionary, it keeps a dense vector mapping each ID to its current position in the heap, so looking
+up an element is a single array access and no allocations are made per operation. The heap itself is d-ary (4-ary by
+default), which makes it shallower and more cache-friendly than a binary heap. With an arity of 2, elements with equal
+keys are ordered exactly as they would be by PriorityQueue.
+
+The interface is the same as that of PriorityQueue, so algorithms can switch between the two by changing a typedef.
+
+@tparam	ID		The element ID type (must be an integral type; IDs must be non-negative)
+@tparam	Key		The key type (the type of the priority values used to determine the element order)
+@tparam	Data	The auxiliary data type (any information clients might wish to store with each element)
+@tparam	Comp	A predicate specifying how the keys should be compared (the default predicate is std::less<Key>,
+				which specifies that elements with smaller keys will be extracted first)
+@tparam	Arity	The number of children of each node in the heap
+*/
+template <typename ID, typename Key, typename Data, typename Comp = std::less<Key>, int Arity = 4>
+class DaryPriorityQueue
+{
+	//#################### NESTED CLASSES ####################
+public:
+	/**
+	@brief	Each element of the priority queue stores its ID, its key and potentially some auxiliary data
+			that may be useful to client code.
+
+	Its auxiliary data may be changed by the client, but its key may only be changed via the priority queue's
+	update_key() method.
+	*/
+	class Element
+	{
+	private:
+		ID m_id;
+		Key m_key;
+		Data m_data;
+
+	public:
+		Element() {}
+		Element(const ID& id, const Key& key, const Data& data) : m_id(id), m_key(key), m_data(data) {}
+
+		Data& data()				{ return m_data; }
+		const ID& id() const		{ return m_id; }
+		const Key& key() const		{ return m_key; }
+
+		friend class DaryPriorityQueue;
+	};
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	Comp m_comp;
+	std::vector<Element> m_heap;
+	std::vector<int> m_positions;		// maps IDs to their current position in the heap (or -1 if not present)
+
+	//#################### CONSTRUCTORS ####################
+public:
+	/**
+	@brief	Constructs an empty priority queue.
+
+	@param[in]	idBound	An (optional) exclusive upper bound on the IDs that will be used, to avoid growing the position table later
+	*/
+	explicit DaryPriorityQueue(size_t idBound = 0)
+	:	m_positions(idBound, -1)
+	{}
+
+	//#################### PUBLIC METHODS ####################
+public:
+	/**
+	@brief	Clears the priority queue.
+	*/
+	void clear()
+	{
+		for(typename std::vector<Element>::const_iterator it=m_heap.begin(), iend=m_heap.end(); it!=iend; ++it)
+		{
+			m_positions[static_cast<size_t>(it->id())] = -1;
+		}
+		m_heap.clear();
+	}
+
+	/**
+	@brief	Returns whether or not the priority queue contains an element with the specified ID.
+
+	@param[in]	id	The ID
+	@return	true, if it does contain such an element, or false otherwise
+	*/
+	bool contains(ID id) const
+	{
+		size_t i = static_cast<size_t>(id);
+		return i < m_positions.size() && m_positions[i] != -1;
+	}
+
+	/**
+	@brief	Returns a reference to the element with the specified ID.
+
+	@param[in]	id	The ID
+	@pre
+		-	contains(id)
+	@return	As described
+	*/
+	Element& element(ID id)
+	{
+		return m_heap[m_positions[static_cast<size_t>(id)]];
+	}
+
+	/**
+	@brief	Returns whether or not the priority queue is empty.
+
+	@return	true, if is empty, or false if it isn't
+	*/
+	bool empty() const
+	{
+		return m_heap.empty();
+	}
+
+	/**
+	@brief	Erases the element with the specified ID from the priority queue.
+
+	@param[in]	id	The ID
+	@pre
+		-	contains(id)
+	@post
+		-	!contains(id)
+	*/
+	void erase(ID id)
+	{
+		size_t i = m_positions[static_cast<size_t>(id)];
+		m_positions[static_cast<size_t>(id)] = -1;
+
+		size_t last = m_heap.size() - 1;
+		if(i != last)
+		{
+			// Move the last element into the vacated position and restore the heap property around it.
+			Element e = m_heap[last];
+			m_heap.pop_back();
+			if(i > 0 && m_comp(e.key(), m_heap[parent(i)].key()))	sift_up(i, e);
+			else													sift_down(i, e);
+		}
+		else m_heap.pop_back();
+	}
+
+	/**
+	@brief	Inserts a new element into the priority queue.
+
+	@param[in]	id		The new element's ID
+	@param[in]	key		The new element's key
+	@param[in]	data	The new element's auxiliary data
+	*/
+	void insert(ID id, const Key& key, const Data& data)
+	{
+		if(contains(id))
+		{
+			throw Exception("An element with the specified ID is already in the priority queue");
+		}
+
+		size_t index = static_cast<size_t>(id);
+		if(index >= m_positions.size()) m_positions.resize(std::max(index + 1, m_positions.size() * 2), -1);
+
+		m_heap.push_back(Element());
+		sift_up(m_heap.size() - 1, Element(id, key, data));
+	}
+
+	/**
+	@brief	Removes the element at the front of the priority queue.
+
+	@pre
+		-	!empty()
+	*/
+	void pop()
+	{
+		erase(m_heap[0].id());
+	}
+
+	/**
+	@brief	Reserves space for elements with IDs up to (but excluding) the specified bound.
+
+	@param[in]	idBound	The bound
+	*/
+	void reserve(size_t idBound)
+	{
+		if(idBound > m_positions.size()) m_positions.resize(idBound, -1);
+	}
+
+	/**
+	@brief	Returns the number of elements in the priority queue.
+	*/
+	size_t size() const
+	{
+		return m_heap.size();
+	}
+
+	/**
+	@brief	Returns the element at the front of the priority queue.
+
+	@pre
+		-	!empty()
+	@return	As described
+	*/
+	Element top()
+	{
+		return m_heap[0];
+	}
+
+	/**
+	@brief	Updates the key of the specified element with a new value.
+
+	This potentially involves an internal reordering of the priority queue's heap.
+
+	@param[in]	id		The ID of the element whose key is to be updated
+	@param[in]	key		The new key value
+	@pre
+		-	contains(id)
+	*/
+	void update_key(ID id, const Key& key)
+	{
+		size_t i = m_positions[static_cast<size_t>(id)];
+		Element e = m_heap[i];
+		if(m_comp(key, e.key()))
+		{
+			// The key has increased in priority.
+			e.m_key = key;
+			sift_up(i, e);
+		}
+		else if(m_comp(e.key(), key))
+		{
+			// The key has decreased in priority.
+			e.m_key = key;
+			sift_down(i, e);
+		}
+	}
+
+	//#################### PRIVATE METHODS ####################
+private:
+	inline static size_t first_child(size_t i)	{ return Arity*i + 1; }
+	inline static size_t parent(size_t i)		{ return (i-1) / Arity; }
+
+	void place(size_t i, const Element& e)
+	{
+		m_heap[i] = e;
+		m_positions[static_cast<size_t>(e.id())] = static_cast<int>(i);
+	}
+
+	void sift_down(size_t i, const Element& e)
+	{
+		size_t size = m_heap.size();
+		for(;;)
+		{
+			// Find the highest-priority child (preferring earlier children in the event of ties).
+			size_t c = first_child(i);
+			if(c >= size) break;
+			size_t best = c;
+			for(size_t cend=std::min(c + Arity, size); ++c<cend;)
+			{
+				if(m_comp(m_heap[c].key(), m_heap[best].key())) best = c;
+			}
+
+			if(!m_comp(m_heap[best].key(), e.key())) break;
+			place(i, m_heap[best]);
+			i = best;
+		}
+		place(i, e);
+	}
+
+	void sift_up(size_t i, const Element& e)
+	{
+		while(i > 0 && m_comp(e.key(), m_heap[parent(i)].key()))
+		{
+			size_t p = parent(i);
+			place(i, m_heap[p]);
+			i = p;
+		}
+		place(i, e);
+	}
+};
+
+}
+
+#endif
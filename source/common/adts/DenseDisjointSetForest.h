@@ -0,0 +1,247 @@
+/***
+ * millipede: DenseDisjointSetForest.h
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#ifndef H_MILLIPEDE_DENSEDISJOINTSETFOREST
+#define H_MILLIPEDE_DENSEDISJOINTSETFOREST
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <common/exceptions/Exception.h>
+#include <common/io/util/OSSWrapper.h>
+#include <common/util/NullType.h>
+
+namespace mp {
+
+/**
+@brief	A DenseDisjointSetForest is a variant of DisjointSetForest for elements whose indices are small non-negative
+		integers (e.g. voxel or label indices).
+
+The elements are stored in contiguous arrays indexed by element (rather than in a std::map), and find_set() uses
+iterative path halving (rather than recursive path compression), so it is suitable for forests with millions of
+elements. Sets are linked by rank in exactly the same way as in DisjointSetForest, so the two always choose the same
+root elements when given the same sequence of operations.
+
+@tparam	T	The type of data to attach to each element (arbitrary)
+*/
+template <typename T = NullType>
+class DenseDisjointSetForest
+{
+	//#################### PRIVATE VARIABLES ####################
+private:
+	int m_elementCount;
+	mutable std::vector<int> m_parents;		// the parent of each element (or -1 for indices that are not elements)
+	std::vector<unsigned char> m_ranks;
+	int m_setCount;
+	std::vector<T> m_values;
+
+	//#################### CONSTRUCTORS ####################
+public:
+	/**
+	@brief	Constructs an empty disjoint set forest.
+
+	@param[in]	indexBound	An (optional) exclusive upper bound on the element indices that will be used, to avoid reallocation later
+	*/
+	explicit DenseDisjointSetForest(int indexBound = 0)
+	:	m_elementCount(0), m_setCount(0)
+	{
+		reserve(indexBound);
+	}
+
+	/**
+	@brief	Constructs a disjoint set forest from an initial set of elements and their associated values.
+
+	@param[in]	initialElements		A map from the initial elements to their associated values
+	*/
+	explicit DenseDisjointSetForest(const std::map<int,T>& initialElements)
+	:	m_elementCount(0), m_setCount(0)
+	{
+		add_elements(initialElements);
+	}
+
+	//#################### PUBLIC METHODS ####################
+public:
+	/**
+	@brief	Adds a single element x (and its associated value) to the disjoint set forest.
+
+	@param[in]	x		The index of the element
+	@param[in]	value	The value to initially associate with the element
+	@pre
+		-	x >= 0
+		-	x must not already be in the disjoint set forest
+	*/
+	void add_element(int x, const T& value = T())
+	{
+		if(x >= static_cast<int>(m_parents.size()))
+		{
+			int size = std::max(x + 1, static_cast<int>(m_parents.size()) * 2);
+			m_parents.resize(size, -1);
+			m_ranks.resize(size, 0);
+			m_values.resize(size);
+		}
+
+		m_parents[x] = x;
+		m_values[x] = value;
+		++m_elementCount;
+		++m_setCount;
+	}
+
+	/**
+	@brief	Adds multiple elements (and their associated values) to the disjoint set forest.
+
+	@param[in]	elements	A map from the elements to add to their associated values
+	@pre
+		-	None of the elements to be added must already be in the disjoint set forest
+	*/
+	void add_elements(const std::map<int,T>& elements)
+	{
+		if(!elements.empty()) reserve(elements.rbegin()->first + 1);
+		for(typename std::map<int,T>::const_iterator it=elements.begin(), iend=elements.end(); it!=iend; ++it)
+		{
+			add_element(it->first, it->second);
+		}
+	}
+
+	/**
+	@brief	Returns the number of elements in the disjoint set forest.
+
+	@return	As described
+	*/
+	int element_count() const
+	{
+		return m_elementCount;
+	}
+
+	/**
+	@brief	Finds the index of the root element of the tree containing x in the disjoint set forest.
+
+	@param[in]	x	The element whose set to determine
+	@pre
+		-	x must be an element in the disjoint set forest
+	@throw Exception
+		-	If the precondition is violated
+	@return	As described
+	*/
+	int find_set(int x) const
+	{
+		check_element(x);
+
+		// Path halving: make every other element on the path point to its grandparent.
+		int *parents = &m_parents[0];
+		while(parents[x] != x)
+		{
+			parents[x] = parents[parents[x]];
+			x = parents[x];
+		}
+		return x;
+	}
+
+	/**
+	@brief	Reserves space for elements with indices up to (but excluding) the specified bound.
+
+	@param[in]	indexBound	The bound
+	*/
+	void reserve(int indexBound)
+	{
+		if(indexBound > static_cast<int>(m_parents.size()))
+		{
+			m_parents.resize(indexBound, -1);
+			m_ranks.resize(indexBound, 0);
+			m_values.resize(indexBound);
+		}
+	}
+
+	/**
+	@brief	Returns the current number of disjoint sets in the forest (i.e. the current number of trees).
+
+	@return	As described
+	*/
+	int set_count() const
+	{
+		return m_setCount;
+	}
+
+	/**
+	@brief	Merges the disjoint sets containing elements x and y.
+
+	If both elements are already in the same disjoint set, this is a no-op.
+
+	@param[in]	x	The first element
+	@param[in]	y	The second element
+	@pre
+		-	Both x and y must be elements in the disjoint set forest
+	@throw Exception
+		-	If the precondition is violated
+	*/
+	void union_sets(int x, int y)
+	{
+		int setX = find_set(x);
+		int setY = find_set(y);
+		if(setX != setY) link(setX, setY);
+	}
+
+	/**
+	@brief	Returns the value associated with element x.
+
+	@param[in]	x	The element whose value to return
+	@pre
+		-	x must be an element in the disjoint set forest
+	@throw Exception
+		-	If the precondition is violated
+	@return	As described
+	*/
+	T& value_of(int x)
+	{
+		check_element(x);
+		return m_values[x];
+	}
+
+	/**
+	@brief	Returns the value associated with element x.
+
+	@param[in]	x	The element whose value to return
+	@pre
+		-	x must be an element in the disjoint set forest
+	@throw Exception
+		-	If the precondition is violated
+	@return	As described
+	*/
+	const T& value_of(int x) const
+	{
+		check_element(x);
+		return m_values[x];
+	}
+
+	//#################### PRIVATE METHODS ####################
+private:
+	void check_element(int x) const
+	{
+		if(x < 0 || x >= static_cast<int>(m_parents.size()) || m_parents[x] == -1)
+		{
+			throw Exception(OSSWrapper() << "No such element: " << x);
+		}
+	}
+
+	void link(int x, int y)
+	{
+		unsigned char& rankX = m_ranks[x];
+		unsigned char& rankY = m_ranks[y];
+		if(rankX > rankY)
+		{
+			m_parents[y] = x;
+		}
+		else
+		{
+			m_parents[x] = y;
+			if(rankX == rankY) ++rankY;
+		}
+		--m_setCount;
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,359 @@
+/***
+ * millipede: RadixPriorityQueue.h
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#ifndef H_MILLIPEDE_RADIXPRIORITYQUEUE
+#define H_MILLIPEDE_RADIXPRIORITYQUEUE
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/mpl/assert.hpp>
+#include <boost/mpl/bool.hpp>
+#include <boost/type_traits/is_integral.hpp>
+#include <boost/type_traits/is_signed.hpp>
+
+#include <common/exceptions/Exception.h>
+#include <common/io/util/OSSWrapper.h>
+
+namespace mp {
+
+/**
+@brief	A RadixPriorityQueue is a variant of PriorityQueue for monotone problems with integer keys and small
+		non-negative integer IDs.
+
+It is a radix heap: elements are kept in unsorted buckets according to the position of the highest bit in which their
+key differs from the key most recently extracted from the queue. Finding the smallest element only ever requires scanning
+the lowest non-empty bucket and redistributing its elements into lower buckets, so each element is touched at most once
+per bit of its key, and all other operations are O(1).
+
+The price of this is that the queue is monotone: the key of any element inserted (or updated) must be no smaller than that
+of the element most recently extracted from the front of the queue (as is the case for e.g. Dijkstra-style propagation or
+flooding with integral priorities). Elements with smaller keys are always extracted first.
+
+The interface is otherwise the same as that of PriorityQueue.
+
+@tparam	ID		The element ID type (must be an integral type; IDs must be non-negative)
+@tparam	Key		The key type (must be an integral type of at most 64 bits)
+@tparam	Data	The auxiliary data type (any information clients might wish to store with each element)
+*/
+template <typename ID, typename Key, typename Data>
+class RadixPriorityQueue
+{
+	//#################### COMPILE-TIME CHECKS ####################
+	BOOST_MPL_ASSERT_MSG(boost::is_integral<Key>::value, Key_Must_Be_An_Integral_Type, (Key));
+
+	//#################### NESTED CLASSES ####################
+public:
+	/**
+	@brief	Each element of the priority queue stores its ID, its key and potentially some auxiliary data
+			that may be useful to client code.
+
+	Its auxiliary data may be changed by the client, but its key may only be changed via the priority queue's
+	update_key() method.
+	*/
+	class Element
+	{
+	private:
+		ID m_id;
+		Key m_key;
+		Data m_data;
+
+	public:
+		Element() {}
+		Element(const ID& id, const Key& key, const Data& data) : m_id(id), m_key(key), m_data(data) {}
+
+		Data& data()				{ return m_data; }
+		const ID& id() const		{ return m_id; }
+		const Key& key() const		{ return m_key; }
+
+		friend class RadixPriorityQueue;
+	};
+
+	//#################### NESTED CLASSES (EXCLUDING ELEMENT) ####################
+private:
+	struct Position
+	{
+		int bucket;
+		int offset;
+
+		Position()
+		:	bucket(-1), offset(-1)
+		{}
+	};
+
+	//#################### ENUMERATIONS ####################
+private:
+	enum { BUCKET_COUNT = 65 };
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	std::vector<Element> m_buckets[BUCKET_COUNT];
+	Key m_lastKey;
+	std::vector<Position> m_positions;		// maps IDs to their current positions in the buckets
+	size_t m_size;
+
+	//#################### CONSTRUCTORS ####################
+public:
+	/**
+	@brief	Constructs an empty priority queue.
+
+	@param[in]	idBound	An (optional) exclusive upper bound on the IDs that will be used, to avoid growing the position table later
+	@param[in]	minKey	A lower bound on the keys that will be inserted
+	*/
+	explicit RadixPriorityQueue(size_t idBound = 0, Key minKey = Key())
+	:	m_lastKey(minKey), m_positions(idBound), m_size(0)
+	{}
+
+	//#################### PUBLIC METHODS ####################
+public:
+	/**
+	@brief	Clears the priority queue.
+
+	The queue's monotonicity bound is left unchanged.
+	*/
+	void clear()
+	{
+		for(int b=0; b<BUCKET_COUNT; ++b)
+		{
+			for(typename std::vector<Element>::const_iterator it=m_buckets[b].begin(), iend=m_buckets[b].end(); it!=iend; ++it)
+			{
+				m_positions[static_cast<size_t>(it->id())] = Position();
+			}
+			m_buckets[b].clear();
+		}
+		m_size = 0;
+	}
+
+	/**
+	@brief	Returns whether or not the priority queue contains an element with the specified ID.
+
+	@param[in]	id	The ID
+	@return	true, if it does contain such an element, or false otherwise
+	*/
+	bool contains(ID id) const
+	{
+		size_t i = static_cast<size_t>(id);
+		return i < m_positions.size() && m_positions[i].bucket != -1;
+	}
+
+	/**
+	@brief	Returns a reference to the element with the specified ID.
+
+	@param[in]	id	The ID
+	@pre
+		-	contains(id)
+	@return	As described
+	*/
+	Element& element(ID id)
+	{
+		const Position& pos = m_positions[static_cast<size_t>(id)];
+		return m_buckets[pos.bucket][pos.offset];
+	}
+
+	/**
+	@brief	Returns whether or not the priority queue is empty.
+
+	@return	true, if is empty, or false if it isn't
+	*/
+	bool empty() const
+	{
+		return m_size == 0;
+	}
+
+	/**
+	@brief	Erases the element with the specified ID from the priority queue.
+
+	@param[in]	id	The ID
+	@pre
+		-	contains(id)
+	@post
+		-	!contains(id)
+	*/
+	void erase(ID id)
+	{
+		remove(id);
+		--m_size;
+	}
+
+	/**
+	@brief	Inserts a new element into the priority queue.
+
+	@param[in]	id		The new element's ID
+	@param[in]	key		The new element's key
+	@param[in]	data	The new element's auxiliary data
+	@throw Exception
+		-	If an element with the specified ID is already in the priority queue
+		-	If key is smaller than the key of the element most recently extracted from the queue
+	*/
+	void insert(ID id, const Key& key, const Data& data)
+	{
+		if(contains(id))
+		{
+			throw Exception("An element with the specified ID is already in the priority queue");
+		}
+		check_monotone(key);
+
+		size_t index = static_cast<size_t>(id);
+		if(index >= m_positions.size()) m_positions.resize(std::max(index + 1, m_positions.size() * 2));
+
+		add(Element(id, key, data));
+		++m_size;
+	}
+
+	/**
+	@brief	Removes the element at the front of the priority queue.
+
+	@pre
+		-	!empty()
+	*/
+	void pop()
+	{
+		erase(top().id());
+	}
+
+	/**
+	@brief	Reserves space for elements with IDs up to (but excluding) the specified bound.
+
+	@param[in]	idBound	The bound
+	*/
+	void reserve(size_t idBound)
+	{
+		if(idBound > m_positions.size()) m_positions.resize(idBound);
+	}
+
+	/**
+	@brief	Returns the number of elements in the priority queue.
+	*/
+	size_t size() const
+	{
+		return m_size;
+	}
+
+	/**
+	@brief	Returns the element at the front of the priority queue (i.e. the one with the smallest key).
+
+	This advances the queue's monotonicity bound to the key of the returned element.
+
+	@pre
+		-	!empty()
+	@return	As described
+	*/
+	Element top()
+	{
+		if(m_buckets[0].empty())
+		{
+			// Find the lowest non-empty bucket and the smallest key within it.
+			int b = 1;
+			while(m_buckets[b].empty()) ++b;
+
+			std::vector<Element>& bucket = m_buckets[b];
+			Key minKey = bucket[0].key();
+			for(size_t i=1, size=bucket.size(); i<size; ++i)
+			{
+				if(bucket[i].key() < minKey) minKey = bucket[i].key();
+			}
+
+			// Redistribute the elements of the bucket relative to the new monotonicity bound:
+			// they all end up in lower buckets, and those with the smallest key end up in bucket 0.
+			m_lastKey = minKey;
+			std::vector<Element> elements;
+			elements.swap(bucket);
+			for(typename std::vector<Element>::const_iterator it=elements.begin(), iend=elements.end(); it!=iend; ++it)
+			{
+				add(*it);
+			}
+		}
+		return m_buckets[0].back();
+	}
+
+	/**
+	@brief	Updates the key of the specified element with a new value.
+
+	@param[in]	id		The ID of the element whose key is to be updated
+	@param[in]	key		The new key value
+	@pre
+		-	contains(id)
+	@throw Exception
+		-	If key is smaller than the key of the element most recently extracted from the queue
+	*/
+	void update_key(ID id, const Key& key)
+	{
+		check_monotone(key);
+		Element e = remove(id);
+		e.m_key = key;
+		add(e);
+	}
+
+	//#################### PRIVATE METHODS ####################
+private:
+	void add(const Element& e)
+	{
+		int b = bucket_for(e.key());
+		Position& pos = m_positions[static_cast<size_t>(e.id())];
+		pos.bucket = b;
+		pos.offset = static_cast<int>(m_buckets[b].size());
+		m_buckets[b].push_back(e);
+	}
+
+	int bucket_for(const Key& key) const
+	{
+		// The bucket index is one more than the position of the highest bit in which the key differs from the last
+		// extracted key (or 0 if the two are equal).
+		unsigned long long diff = ordered_bits(key) ^ ordered_bits(m_lastKey);
+		int b = 0;
+		if(diff >> 32)	{ b += 32; diff >>= 32; }
+		if(diff >> 16)	{ b += 16; diff >>= 16; }
+		if(diff >> 8)	{ b += 8; diff >>= 8; }
+		if(diff >> 4)	{ b += 4; diff >>= 4; }
+		if(diff >> 2)	{ b += 2; diff >>= 2; }
+		if(diff >> 1)	{ b += 1; diff >>= 1; }
+		return b + static_cast<int>(diff);
+	}
+
+	void check_monotone(const Key& key) const
+	{
+		if(key < m_lastKey)
+		{
+			throw Exception(OSSWrapper() << "Key " << key << " is smaller than the last extracted key (" << m_lastKey << ")");
+		}
+	}
+
+	static unsigned long long ordered_bits(const Key& key)
+	{
+		return ordered_bits(key, boost::mpl::bool_<boost::is_signed<Key>::value>());
+	}
+
+	static unsigned long long ordered_bits(const Key& key, boost::mpl::true_)
+	{
+		// Flip the sign bit so that the unsigned order of the results matches the signed order of the keys.
+		return static_cast<unsigned long long>(static_cast<long long>(key)) ^ (1ULL << 63);
+	}
+
+	static unsigned long long ordered_bits(const Key& key, boost::mpl::false_)
+	{
+		return static_cast<unsigned long long>(key);
+	}
+
+	Element remove(ID id)
+	{
+		Position& pos = m_positions[static_cast<size_t>(id)];
+		std::vector<Element>& bucket = m_buckets[pos.bucket];
+		Element e = bucket[pos.offset];
+
+		// Fill the hole with the last element in the bucket.
+		if(pos.offset != static_cast<int>(bucket.size()) - 1)
+		{
+			bucket[pos.offset] = bucket.back();
+			m_positions[static_cast<size_t>(bucket[pos.offset].id())].offset = pos.offset;
+		}
+		bucket.pop_back();
+		pos = Position();
+		return e;
+	}
+};
+
+}
+
+#endif
@@ -1,114 +1,225 @@
 /***
  * millipede: RootedMST.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_ROOTEDMST
 #define H_MILLIPEDE_ROOTEDMST
 
+#include <algorithm>
 #include <cassert>
 #include <climits>
+#include <iterator>
 #include <set>
+#include <vector>
 
-#include <boost/any.hpp>
-#include <boost/shared_ptr.hpp>
+#include <boost/mpl/bool.hpp>
+#include <boost/type_traits/is_integral.hpp>
 
+#include <common/exceptions/Exception.h>
+#include <common/io/util/OSSWrapper.h>
 #include <common/util/NullType.h>
-#include "AdjacencyGraph.h"
-#include "PriorityQueue.h"
+#include "DaryPriorityQueue.h"
+#include "WeightedEdge.h"
 
 namespace mp {
 
+/**
+@brief	A RootedMST is a minimum spanning tree of a graph, with one of its nodes designated as the root.
+
+The tree is stored compactly in arrays indexed by node index: each node records its parent, the weight of its parent edge
+and its place in its parent's (doubly-linked) list of children. Algorithms that need to associate data with each node of
+the tree should store it in their own arrays of size node_index_bound().
+
+The tree can be constructed either using Prim's algorithm (the default, which grows the tree outwards from the root), or
+using Kruskal's algorithm, which extracts the graph's edges into a contiguous array once, sorts them (using a radix sort
+for integral weights) and then joins components using a disjoint set forest. The latter avoids the per-relaxation adjacency
+and edge weight lookups of Prim's algorithm, and is much faster on large image layers. Note that when several edges have
+the same weight, the two algorithms may (validly) pick different trees, and the waterfall (and thus the forest built
+from the tree) depends on which one is picked: Prim's algorithm is used to build forests for this reason.
+
+@tparam	EdgeWeight	The type of the edge weights
+*/
 template <typename EdgeWeight>
 class RootedMST
 {
+	//#################### ENUMERATIONS ####################
+public:
+	enum Algorithm
+	{
+		ALGORITHM_KRUSKAL,
+		ALGORITHM_PRIM,
+	};
+
+	//#################### TYPEDEFS ####################
+public:
+	typedef WeightedEdge<EdgeWeight> Edge;
+
 	//#################### NESTED CLASSES ####################
-private:
-	struct NodeProperties
+public:
+	/**
+	@brief	An iterator over the edges of the tree. Each edge {u,v} is yielded once, with u < v.
+	*/
+	class EdgeConstIterator : public std::iterator<std::forward_iterator_tag, Edge>
 	{
-		int m_parent;
-		boost::any m_data;
+	private:
+		const RootedMST *m_mst;
+		int m_child;		// the edge is the parent edge of this node
+		Edge m_edge;
+
+	public:
+		EdgeConstIterator(const RootedMST *mst, int child)
+		:	m_mst(mst), m_child(child), m_edge(-1, -1, EdgeWeight())
+		{
+			skip_to_edge();
+		}
 
-		NodeProperties()
-		:	m_parent(-1)
-		{}
+		const Edge& operator*() const	{ return m_edge; }
+		const Edge *operator->() const	{ return &m_edge; }
 
-		explicit NodeProperties(int parent)
-		:	m_parent(parent)
-		{}
+		EdgeConstIterator& operator++()
+		{
+			++m_child;
+			skip_to_edge();
+			return *this;
+		}
+
+		bool operator==(const EdgeConstIterator& rhs) const	{ return m_child == rhs.m_child; }
+		bool operator!=(const EdgeConstIterator& rhs) const	{ return m_child != rhs.m_child; }
+
+	private:
+		void skip_to_edge()
+		{
+			int bound = m_mst->node_index_bound();
+			while(m_child < bound && (!m_mst->has_node(m_child) || m_mst->tree_parent(m_child) == -1)) ++m_child;
+			if(m_child < bound)
+			{
+				int parent = m_mst->tree_parent(m_child);
+				m_edge = Edge(std::min(m_child, parent), std::max(m_child, parent), m_mst->parent_edge_weight(m_child));
+			}
+		}
 	};
 
-	//#################### TYPEDEFS ####################
 private:
-	typedef AdjacencyGraph<NodeProperties, EdgeWeight> BaseGraph;	// each node stores the index of its parent and (possibly) some auxiliary data
-public:
-	typedef typename BaseGraph::Edge Edge;
-	typedef typename BaseGraph::EdgeCIter EdgeConstIterator;
+	/**
+	@brief	An EdgeAppender appends each graph edge it is passed to an array of edges.
+	*/
+	struct EdgeAppender
+	{
+		std::vector<Edge> *edges;
+
+		explicit EdgeAppender(std::vector<Edge> *edges_)
+		:	edges(edges_)
+		{}
+
+		template <typename GraphEdge>
+		void operator()(const GraphEdge& e) const
+		{
+			edges->push_back(Edge(e.u, e.v, e.weight));
+		}
+	};
 
 	//#################### PRIVATE VARIABLES ####################
 private:
+	std::vector<int> m_firstChildren;			// the first child of each node (or -1 if it has none)
+	std::vector<int> m_nextSiblings;			// the next sibling of each node (or -1 if it is its parent's last child)
+	int m_nodeCount;
+	std::vector<int> m_parents;					// the parent of each node (or -1 if it is a root)
+	std::vector<EdgeWeight> m_parentWeights;	// the weight of the edge between each node and its parent (if any)
+	std::vector<unsigned char> m_present;		// whether or not each node index refers to a node in the tree
+	std::vector<int> m_previousSiblings;		// the previous sibling of each node (or -1 if it is its parent's first child)
 	int m_root;
-	BaseGraph m_base;
 
 	//#################### CONSTRUCTORS ####################
 public:
+	/**
+	@brief	Constructs a rooted MST for the specified graph.
+
+	The root of the tree is the node with the smallest index.
+
+	@param[in]	graph		The graph (e.g. an AdjacencyGraph or a partition forest layer)
+	@param[in]	algorithm	The algorithm with which to construct the MST
+	@throw Exception
+		-	If the graph has no nodes
+	*/
 	template <typename Graph>
-	explicit RootedMST(const Graph& graph)
+	explicit RootedMST(const Graph& graph, Algorithm algorithm = ALGORITHM_PRIM)
 	{
-		// Build an MST for the graph using Prim's algorithm.
-		typedef PriorityQueue<int, EdgeWeight, NullType> PQ;
-		PQ pq;
 		std::vector<int> nodeIndices = graph.node_indices();
 		if(nodeIndices.empty()) throw Exception("Cannot build a *rooted* MST for a graph with no nodes (there's no potential root)");
-		m_root = nodeIndices.front();
-		pq.insert(m_root, 0, NullType());
-		set_tree_parent(m_root, -1);
-		for(size_t i=1, size=nodeIndices.size(); i<size; ++i)
+
+		// Set up the node arrays.
+		int bound = *std::max_element(nodeIndices.begin(), nodeIndices.end()) + 1;
+		m_firstChildren.assign(bound, -1);
+		m_nextSiblings.assign(bound, -1);
+		m_nodeCount = static_cast<int>(nodeIndices.size());
+		m_parents.assign(bound, -1);
+		m_parentWeights.assign(bound, EdgeWeight());
+		m_present.assign(bound, 0);
+		m_previousSiblings.assign(bound, -1);
+		for(std::vector<int>::const_iterator it=nodeIndices.begin(), iend=nodeIndices.end(); it!=iend; ++it)
 		{
-			pq.insert(nodeIndices[i], INT_MAX, NullType());
-			set_tree_parent(nodeIndices[i], -1);
+			m_present[*it] = 1;
 		}
+		m_root = *std::min_element(nodeIndices.begin(), nodeIndices.end());
 
-		while(!pq.empty())
+		switch(algorithm)
 		{
-			int u = pq.top().id();
-			pq.pop();
-
-			std::vector<int> adjNodes = graph.adjacent_nodes(u);
-			for(size_t i=0, size=adjNodes.size(); i<size; ++i)
-			{
-				int v = adjNodes[i];
-				EdgeWeight weight = graph.edge_weight(u, v);
-				if(pq.contains(v) && weight < pq.element(v).key())
-				{
-					pq.update_key(v, weight);
-					set_tree_parent(v, u);
-				}
-			}
+			case ALGORITHM_KRUSKAL:	build_kruskal(graph, nodeIndices); break;
+			case ALGORITHM_PRIM:	build_prim(graph, nodeIndices); break;
 		}
 
-		// Add the adjacent edges.
-		for(typename BaseGraph::NodePropertiesCIter it=m_base.node_properties_cbegin(), iend=m_base.node_properties_cend(); it!=iend; ++it)
+		// Link each node into its parent's list of children. Adding the nodes in descending order leaves each list in ascending order.
+		for(int n=bound-1; n>=0; --n)
 		{
-			int u = it->first;
-			int v = it->second.m_parent;
-			if(v != -1)
-			{
-				EdgeWeight weight = graph.edge_weight(u, v);
-				m_base.set_edge_weight(u, v, weight);
-			}
+			if(m_present[n] && m_parents[n] != -1) link_child(m_parents[n], n);
 		}
 	}
 
 	//#################### PUBLIC METHODS ####################
 public:
-	std::vector<Edge> adjacent_edges(int n) const		{ return m_base.adjacent_edges(n); }
-	std::vector<int> adjacent_nodes(int n) const		{ return m_base.adjacent_nodes(n); }
-	EdgeWeight edge_weight(int u, int v) const			{ return m_base.edge_weight(u, v); }
-	EdgeConstIterator edges_cbegin() const				{ return m_base.edges_cbegin(); }
-	EdgeConstIterator edges_cend() const				{ return m_base.edges_cend(); }
-	bool has_edge(int u, int v) const					{ return m_base.has_edge(u, v); }
-	bool has_node(int n) const							{ return m_base.has_node(n); }
+	std::vector<Edge> adjacent_edges(int n) const
+	{
+		std::vector<int> adjNodes = adjacent_nodes(n);
+		std::vector<Edge> ret;
+		ret.reserve(adjNodes.size());
+		for(std::vector<int>::const_iterator it=adjNodes.begin(), iend=adjNodes.end(); it!=iend; ++it)
+		{
+			ret.push_back(Edge(std::min(n, *it), std::max(n, *it), edge_weight(n, *it)));
+		}
+		return ret;
+	}
+
+	std::vector<int> adjacent_nodes(int n) const
+	{
+		check_node(n);
+		std::vector<int> ret;
+		if(m_parents[n] != -1) ret.push_back(m_parents[n]);
+		for(int c=m_firstChildren[n]; c!=-1; c=m_nextSiblings[c]) ret.push_back(c);
+		std::sort(ret.begin(), ret.end());
+		return ret;
+	}
+
+	EdgeWeight edge_weight(int u, int v) const
+	{
+		if(has_node(u) && m_parents[u] == v && v != -1) return m_parentWeights[u];
+		else if(has_node(v) && m_parents[v] == u && u != -1) return m_parentWeights[v];
+		else throw Exception(OSSWrapper() << "No such edge: {" << u << ',' << v << '}');
+	}
+
+	EdgeConstIterator edges_cbegin() const				{ return EdgeConstIterator(this, 0); }
+	EdgeConstIterator edges_cend() const				{ return EdgeConstIterator(this, node_index_bound()); }
+
+	bool has_edge(int u, int v) const
+	{
+		return (has_node(u) && m_parents[u] == v && v != -1) || (has_node(v) && m_parents[v] == u && u != -1);
+	}
+
+	bool has_node(int n) const
+	{
+		return 0 <= n && n < node_index_bound() && m_present[n];
+	}
 
 	int merge_nodes(int parent, int child)
 	{
@@ -118,63 +229,110 @@ public:
 		int survivingIndex = std::min(parent, child), otherIndex = std::max(parent, child);
 
 		// Move all the edges descending from the node to be removed to the surviving node.
-		std::set<int> otherChildren = tree_children(otherIndex);
-		if(survivingIndex == child) otherChildren.erase(child);
-		for(std::set<int>::const_iterator it=otherChildren.begin(), iend=otherChildren.end(); it!=iend; ++it)
-		{
-			set_tree_parent(*it, survivingIndex);
-			m_base.set_edge_weight(*it, survivingIndex, edge_weight(*it, otherIndex));
-		}
+		unlink_child(child);
+		move_children(otherIndex, survivingIndex);
 
-		// If the surviving node is the child, it needs to be connected to the parent of the initial parent.
+		// If the surviving node is the child, it needs to take the place of the initial parent in the tree.
 		if(survivingIndex == child)
 		{
-			set_tree_parent(survivingIndex, tree_parent(parent));
-			m_base.set_edge_weight(survivingIndex, tree_parent(parent), edge_weight(otherIndex, tree_parent(parent)));
+			int grandparent = m_parents[parent];
+			if(grandparent != -1)
+			{
+				unlink_child(parent);
+				link_child(grandparent, child);
+			}
+			m_parents[child] = grandparent;
+			m_parentWeights[child] = m_parentWeights[parent];
 		}
 
 		// If the root gets removed during a merge with another node, update its index.
 		if(m_root == otherIndex) m_root = survivingIndex;
 
 		// Remove the node.
-		m_base.remove_node(otherIndex);
+		m_present[otherIndex] = 0;
+		m_parents[otherIndex] = m_firstChildren[otherIndex] = m_nextSiblings[otherIndex] = m_previousSiblings[otherIndex] = -1;
+		--m_nodeCount;
 
 		return survivingIndex;
 	}
 
 	int node_count() const
 	{
-		return m_base.node_count();
+		return m_nodeCount;
 	}
 
-	template <typename T>
-	const T& node_data(int n) const
+	/**
+	@brief	Returns an upper bound (exclusive) on the indices of the nodes in the tree.
+
+	This is intended to allow algorithms to store per-node data in arrays indexed by node index.
+
+	@return	As described
+	*/
+	int node_index_bound() const
 	{
-		return boost::any_cast<const T&>(m_base.node_properties(n).m_data);
+		return static_cast<int>(m_present.size());
 	}
 
 	std::vector<int> node_indices() const
 	{
-		return m_base.node_indices();
+		std::vector<int> ret;
+		ret.reserve(m_nodeCount);
+		for(int n=0, bound=node_index_bound(); n<bound; ++n)
+		{
+			if(m_present[n]) ret.push_back(n);
+		}
+		return ret;
 	}
 
-	template <typename T>
-	void set_node_data(int n, const T& data)
+	/**
+	@brief	Returns the weight of the edge between the specified node and its parent.
+
+	@param[in]	n	The index of a node in the tree
+	@pre
+		-	tree_parent(n) != -1
+	@return	As described
+	*/
+	EdgeWeight parent_edge_weight(int n) const
 	{
-		m_base.node_properties(n).m_data = data;
+		return m_parentWeights[n];
 	}
 
 	std::set<int> tree_children(int n) const
 	{
-		std::vector<int> adjNodes = adjacent_nodes(n);
-		std::set<int> children(adjNodes.begin(), adjNodes.end());
-		children.erase(tree_parent(n));
+		check_node(n);
+		std::set<int> children;
+		for(int c=m_firstChildren[n]; c!=-1; c=m_nextSiblings[c]) children.insert(c);
 		return children;
 	}
 
+	/**
+	@brief	Returns the first child of the specified node in the tree (the children can be traversed using tree_next_sibling()).
+
+	Note that the order of the children is unspecified.
+
+	@param[in]	n	The index of a node in the tree
+	@return	The first child of the node, or -1 if it has no children
+	*/
+	int tree_first_child(int n) const
+	{
+		return m_firstChildren[n];
+	}
+
+	/**
+	@brief	Returns the next sibling of the specified node in the tree.
+
+	@param[in]	n	The index of a node in the tree
+	@return	The next sibling of the node, or -1 if there are no more
+	*/
+	int tree_next_sibling(int n) const
+	{
+		return m_nextSiblings[n];
+	}
+
 	int tree_parent(int n) const
 	{
-		return m_base.node_properties(n).m_parent;
+		check_node(n);
+		return m_parents[n];
 	}
 
 	int tree_root() const
@@ -184,11 +342,192 @@ public:
 
 	//#################### PRIVATE METHODS ####################
 private:
-	void set_tree_parent(int n, int parent)
+	template <typename Graph>
+	void build_kruskal(const Graph& graph, const std::vector<int>& nodeIndices)
+	{
+		// Extract the edges of the graph into a contiguous array, and sort them in non-decreasing order of weight.
+		std::vector<Edge> edges;
+		graph.for_each_edge(EdgeAppender(&edges));
+		sort_edges(edges, boost::mpl::bool_<boost::is_integral<EdgeWeight>::value && sizeof(EdgeWeight) <= sizeof(int)>());
+
+		// Run Kruskal's algorithm, using a flat disjoint set forest (with union-by-rank and path halving) to track the components.
+		int bound = node_index_bound();
+		std::vector<int> setParents(bound), setRanks(bound, 0);
+		for(int n=0; n<bound; ++n) setParents[n] = n;
+
+		std::vector<int> treeEdgeCounts(bound + 1, 0);
+		std::vector<Edge> treeEdges;
+		treeEdges.reserve(nodeIndices.size() - 1);
+		for(typename std::vector<Edge>::const_iterator it=edges.begin(), iend=edges.end(); it!=iend; ++it)
+		{
+			int ru = find_set(setParents, it->u), rv = find_set(setParents, it->v);
+			if(ru == rv) continue;
+
+			if(setRanks[ru] < setRanks[rv]) std::swap(ru, rv);
+			setParents[rv] = ru;
+			if(setRanks[ru] == setRanks[rv]) ++setRanks[ru];
+
+			treeEdges.push_back(*it);
+			++treeEdgeCounts[it->u + 1];
+			++treeEdgeCounts[it->v + 1];
+			if(static_cast<int>(treeEdges.size()) + 1 == m_nodeCount) break;
+		}
+		std::vector<Edge>().swap(edges);
+
+		// Store the tree's adjacency lists in compressed sparse row form.
+		for(int n=0; n<bound; ++n) treeEdgeCounts[n+1] += treeEdgeCounts[n];
+		std::vector<int> adjOffsets(treeEdgeCounts.begin(), treeEdgeCounts.end() - 1);
+		std::vector<std::pair<int,EdgeWeight> > adj(treeEdges.size() * 2);
+		for(typename std::vector<Edge>::const_iterator it=treeEdges.begin(), iend=treeEdges.end(); it!=iend; ++it)
+		{
+			adj[adjOffsets[it->u]++] = std::make_pair(it->v, it->weight);
+			adj[adjOffsets[it->v]++] = std::make_pair(it->u, it->weight);
+		}
+
+		// Orient the tree (or forest, if the graph is disconnected) by walking it from the smallest node in each component.
+		std::vector<unsigned char> visited(bound, 0);
+		std::vector<int> stack;
+		for(int r=0; r<bound; ++r)
+		{
+			if(!m_present[r] || visited[r]) continue;
+			visited[r] = 1;
+			stack.push_back(r);
+			while(!stack.empty())
+			{
+				int u = stack.back();
+				stack.pop_back();
+				for(int k=treeEdgeCounts[u], kend=treeEdgeCounts[u+1]; k!=kend; ++k)
+				{
+					int v = adj[k].first;
+					if(visited[v]) continue;
+					visited[v] = 1;
+					m_parents[v] = u;
+					m_parentWeights[v] = adj[k].second;
+					stack.push_back(v);
+				}
+			}
+		}
+	}
+
+	template <typename Graph>
+	void build_prim(const Graph& graph, const std::vector<int>& nodeIndices)
+	{
+		// Note: A binary heap is used so that ties between equal-weight edges are broken as they always have been.
+		typedef DaryPriorityQueue<int, EdgeWeight, NullType, std::less<EdgeWeight>, 2> PQ;
+		PQ pq(m_parents.size());
+		pq.insert(m_root, 0, NullType());
+		for(std::vector<int>::const_iterator it=nodeIndices.begin(), iend=nodeIndices.end(); it!=iend; ++it)
+		{
+			if(*it != m_root) pq.insert(*it, INT_MAX, NullType());
+		}
+
+		while(!pq.empty())
+		{
+			int u = pq.top().id();
+			pq.pop();
+
+			std::vector<int> adjNodes = graph.adjacent_nodes(u);
+			for(size_t i=0, size=adjNodes.size(); i<size; ++i)
+			{
+				int v = adjNodes[i];
+				EdgeWeight weight = graph.edge_weight(u, v);
+				if(pq.contains(v) && weight < pq.element(v).key())
+				{
+					pq.update_key(v, weight);
+					m_parents[v] = u;
+					m_parentWeights[v] = weight;
+				}
+			}
+		}
+	}
+
+	void check_node(int n) const
+	{
+		if(!has_node(n)) throw Exception(OSSWrapper() << "No such node: " << n);
+	}
+
+	static int find_set(std::vector<int>& setParents, int n)
+	{
+		while(setParents[n] != n)
+		{
+			setParents[n] = setParents[setParents[n]];
+			n = setParents[n];
+		}
+		return n;
+	}
+
+	void link_child(int parent, int child)
+	{
+		int first = m_firstChildren[parent];
+		m_nextSiblings[child] = first;
+		m_previousSiblings[child] = -1;
+		if(first != -1) m_previousSiblings[first] = child;
+		m_firstChildren[parent] = child;
+		m_parents[child] = parent;
+	}
+
+	void move_children(int from, int to)
+	{
+		int first = m_firstChildren[from];
+		if(first == -1) return;
+
+		// Reparent the children, and splice the list onto the front of the destination's list of children.
+		int last = first;
+		for(int c=first; c!=-1; c=m_nextSiblings[c])
+		{
+			m_parents[c] = to;
+			last = c;
+		}
+		m_nextSiblings[last] = m_firstChildren[to];
+		if(m_firstChildren[to] != -1) m_previousSiblings[m_firstChildren[to]] = last;
+		m_firstChildren[to] = first;
+		m_firstChildren[from] = -1;
+	}
+
+	static void sort_edges(std::vector<Edge>& edges, boost::mpl::false_)
+	{
+		std::stable_sort(edges.begin(), edges.end(), &RootedMST::less_weight);
+	}
+
+	static void sort_edges(std::vector<Edge>& edges, boost::mpl::true_)
+	{
+		if(edges.empty()) return;
+
+		// Radix sort the edges on their weights (offset by the minimum weight, so that they are non-negative), one byte at a time.
+		// Each pass is stable, so edges with the same weight retain their original order.
+		EdgeWeight minWeight = std::min_element(edges.begin(), edges.end(), &RootedMST::less_weight)->weight;
+		EdgeWeight maxWeight = std::max_element(edges.begin(), edges.end(), &RootedMST::less_weight)->weight;
+		unsigned int maxKey = static_cast<unsigned int>(maxWeight) - static_cast<unsigned int>(minWeight);
+
+		std::vector<Edge> buffer(edges.size(), edges.front());
+		for(int shift=0; shift<32 && (maxKey >> shift) != 0; shift+=8)
+		{
+			size_t counts[257] = {0};
+			for(typename std::vector<Edge>::const_iterator it=edges.begin(), iend=edges.end(); it!=iend; ++it)
+			{
+				++counts[(((static_cast<unsigned int>(it->weight) - static_cast<unsigned int>(minWeight)) >> shift) & 0xFF) + 1];
+			}
+			for(int i=0; i<256; ++i) counts[i+1] += counts[i];
+			for(typename std::vector<Edge>::const_iterator it=edges.begin(), iend=edges.end(); it!=iend; ++it)
+			{
+				buffer[counts[((static_cast<unsigned int>(it->weight) - static_cast<unsigned int>(minWeight)) >> shift) & 0xFF]++] = *it;
+			}
+			edges.swap(buffer);
+		}
+	}
+
+	static bool less_weight(const Edge& lhs, const Edge& rhs)
+	{
+		return lhs.weight < rhs.weight;
+	}
+
+	void unlink_child(int child)
 	{
-		// Note: set_tree_parent() intentionally creates node n if it doesn't already exist.
-		if(m_base.has_node(n))	m_base.node_properties(n).m_parent = parent;
-		else					m_base.set_node_properties(n, NodeProperties(parent));
+		int parent = m_parents[child], previous = m_previousSiblings[child], next = m_nextSiblings[child];
+		if(previous != -1) m_nextSiblings[previous] = next;
+		else m_firstChildren[parent] = next;
+		if(next != -1) m_previousSiblings[next] = previous;
+		m_nextSiblings[child] = m_previousSiblings[child] = -1;
 	}
 };
 
@@ -1,6 +1,7 @@
 /***
  * millipede: Command.cpp
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #include "Command.h"
@@ -27,6 +28,11 @@ const std::string& Command::description() const
 	return m_description;
 }
 
+size_t Command::memory_usage() const
+{
+	return sizeof(Command) + m_description.capacity();
+}
+
 void Command::redo()
 {
 	execute();
@@ -1,11 +1,13 @@
 /***
  * millipede: Command.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_COMMAND
 #define H_MILLIPEDE_COMMAND
 
+#include <cstddef>
 #include <string>
 
 namespace mp {
@@ -38,6 +40,11 @@ public:
 	int depth() const;
 	const std::string& description() const;
 
+	// Note:	This returns the approximate amount of memory (in bytes) occupied by the command, including any state it retains
+	//			so that it can be undone or redone. It is used to keep the undo history within a memory budget, so commands
+	//			that retain large amounts of state should override it.
+	virtual size_t memory_usage() const;
+
 	// Note:	Sometimes there may be ways of redoing a command that are more efficient than simply re-executing it.
 	//			This hook method is provided to let individual commands override their redo() when this is the case.
 	virtual void redo();
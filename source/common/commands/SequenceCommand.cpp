@@ -1,6 +1,7 @@
 /***
  * millipede: SequenceCommand.cpp
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #include "SequenceCommand.h"
@@ -21,6 +22,16 @@ void SequenceCommand::execute()
 	}
 }
 
+size_t SequenceCommand::memory_usage() const
+{
+	size_t ret = Command::memory_usage() + sizeof(SequenceCommand) - sizeof(Command);
+	for(std::deque<Command_Ptr>::const_iterator it=m_commands.begin(), iend=m_commands.end(); it!=iend; ++it)
+	{
+		ret += (*it)->memory_usage();
+	}
+	return ret;
+}
+
 void SequenceCommand::redo()
 {
 	for(std::deque<Command_Ptr>::const_iterator it=m_commands.begin(), iend=m_commands.end(); it!=iend; ++it)
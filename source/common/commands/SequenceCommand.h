@@ -1,6 +1,7 @@
 /***
  * millipede: SequenceCommand.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_SEQUENCECOMMAND
@@ -30,6 +31,7 @@ public:
 	//#################### PUBLIC METHODS ####################
 public:
 	void execute();
+	size_t memory_usage() const;
 	void redo();
 	void undo();
 };
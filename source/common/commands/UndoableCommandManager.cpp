@@ -1,11 +1,12 @@
 /***
  * millipede: UndoableCommandManager.cpp
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #include "UndoableCommandManager.h"
 
-#include <deque>
+#include <limits>
 
 #include <common/exceptions/Exception.h>
 #include "SequenceCommand.h"
@@ -21,9 +22,16 @@ public:
 	void undo() {}
 };
 
+UndoableCommandManager::HistoryEntry::HistoryEntry(const Command_Ptr& command_)
+:	command(command_), memoryUsage(command_->memory_usage())
+{}
+
+//#################### CONSTANTS ####################
+const size_t UndoableCommandManager::UNLIMITED_MEMORY_BUDGET = std::numeric_limits<size_t>::max();
+
 //#################### CONSTRUCTORS ####################
-UndoableCommandManager::UndoableCommandManager()
-:	m_markerCommand(new MarkerCommand)
+UndoableCommandManager::UndoableCommandManager(size_t memoryBudget)
+:	m_markerCommand(new MarkerCommand), m_memoryBudget(memoryBudget), m_memoryUsage(0)
 {}
 
 //#################### PUBLIC METHODS ####################
@@ -41,39 +49,54 @@ void UndoableCommandManager::clear_history()
 {
 	m_done.clear();
 	m_undone.clear();
+	m_memoryUsage = 0;
+}
+
+size_t UndoableCommandManager::memory_budget() const
+{
+	return m_memoryBudget;
+}
+
+size_t UndoableCommandManager::memory_usage() const
+{
+	return m_memoryUsage;
 }
 
 void UndoableCommandManager::redo()
 {
 	if(can_redo())
 	{
-		Command_Ptr command = m_undone.back();
-		m_undone.pop_back();
+		Command_Ptr command = pop_history(m_undone);
 		command->redo();
-		m_done.push_back(command);
+		push_history(m_done, command);
 	}
 }
 
 std::string UndoableCommandManager::redo_description() const
 {
-	if(can_redo()) return m_undone.back()->description();
+	if(can_redo()) return m_undone.back().command->description();
 	else return "";
 }
 
+void UndoableCommandManager::set_memory_budget(size_t memoryBudget)
+{
+	m_memoryBudget = memoryBudget;
+	if(command_depth() == 0) enforce_memory_budget();
+}
+
 void UndoableCommandManager::undo()
 {
 	if(can_undo())
 	{
-		Command_Ptr command = m_done.back();
-		m_done.pop_back();
+		Command_Ptr command = pop_history(m_done);
 		command->undo();
-		m_undone.push_back(command);
+		push_history(m_undone, command);
 	}
 }
 
 std::string UndoableCommandManager::undo_description() const
 {
-	if(can_undo()) return m_done.back()->description();
+	if(can_undo()) return m_done.back().command->description();
 	else return "";
 }
 
@@ -91,21 +114,57 @@ void UndoableCommandManager::end_command_sequence_hook(const std::string& descri
 	{
 		if(m_done.empty()) throw Exception("No command sequence had been started");
 
-		Command_Ptr latest = m_done.back();
-		m_done.pop_back();
+		Command_Ptr latest = pop_history(m_done);
 
 		if(latest != m_markerCommand) sequence.push_front(latest);
 		else break;
 	}
 	Command_Ptr command(new SequenceCommand(description, sequence));
 	set_depth_of_command(command);
-	m_done.push_back(command);
+	push_history(m_done, command);
+
+	if(command_depth() == 0) enforce_memory_budget();
+}
+
+// Precondition: No command sequence is in progress (otherwise its marker might be discarded)
+void UndoableCommandManager::enforce_memory_budget()
+{
+	if(m_memoryBudget == UNLIMITED_MEMORY_BUDGET) return;
+
+	// Discard the oldest commands until the history fits within the budget. The most recent command is always kept,
+	// so that it is possible to undo the last thing the user did, however large it may be.
+	while(m_memoryUsage > m_memoryBudget && !m_undone.empty()) pop_history_front(m_undone);
+	while(m_memoryUsage > m_memoryBudget && m_done.size() > 1) pop_history_front(m_done);
 }
 
 void UndoableCommandManager::execute_hook(const Command_Ptr& command)
 {
-	m_done.push_back(command);
-	m_undone.clear();
+	push_history(m_done, command);
+	while(!m_undone.empty()) pop_history_front(m_undone);
+
+	if(command_depth() == 0) enforce_memory_budget();
+}
+
+Command_Ptr UndoableCommandManager::pop_history(std::deque<HistoryEntry>& history)
+{
+	// Note:	The memory usage recorded when the command was pushed is subtracted (rather than its current usage), so that
+	//			the running total stays consistent even if the command's usage has changed since then.
+	HistoryEntry entry = history.back();
+	history.pop_back();
+	m_memoryUsage -= entry.memoryUsage;
+	return entry.command;
+}
+
+void UndoableCommandManager::pop_history_front(std::deque<HistoryEntry>& history)
+{
+	m_memoryUsage -= history.front().memoryUsage;
+	history.pop_front();
+}
+
+void UndoableCommandManager::push_history(std::deque<HistoryEntry>& history, const Command_Ptr& command)
+{
+	history.push_back(HistoryEntry(command));
+	m_memoryUsage += history.back().memoryUsage;
 }
 
 }
@@ -1,12 +1,14 @@
 /***
  * millipede: UndoableCommandManager.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_UNDOABLECOMMANDMANAGER
 #define H_MILLIPEDE_UNDOABLECOMMANDMANAGER
 
-#include <vector>
+#include <cstddef>
+#include <deque>
 
 #include "ICommandManager.h"
 
@@ -18,24 +20,43 @@ class UndoableCommandManager : public ICommandManager
 private:
 	class MarkerCommand;
 
+	/// An entry in the history, which remembers how much memory its command was using when it was last executed, undone or redone
+	struct HistoryEntry
+	{
+		Command_Ptr command;
+		size_t memoryUsage;
+
+		explicit HistoryEntry(const Command_Ptr& command_);
+	};
+
+	//#################### CONSTANTS ####################
+public:
+	/// The memory budget which indicates that the history should never be trimmed
+	static const size_t UNLIMITED_MEMORY_BUDGET;
+
 	//#################### PRIVATE VARIABLES ####################
 private:
-	std::vector<Command_Ptr> m_done;
-	std::vector<Command_Ptr> m_undone;
+	std::deque<HistoryEntry> m_done;
+	std::deque<HistoryEntry> m_undone;
 
 	Command_Ptr m_markerCommand;
+	size_t m_memoryBudget;
+	size_t m_memoryUsage;		///< the total memory usage of the commands in the history (kept up to date as the history changes)
 
 	//#################### CONSTRUCTORS ####################
 public:
-	UndoableCommandManager();
+	explicit UndoableCommandManager(size_t memoryBudget = UNLIMITED_MEMORY_BUDGET);
 
 	//#################### PUBLIC METHODS ####################
 public:
 	bool can_redo() const;
 	bool can_undo() const;
 	void clear_history();
+	size_t memory_budget() const;
+	size_t memory_usage() const;
 	void redo();
 	std::string redo_description() const;
+	void set_memory_budget(size_t memoryBudget);
 	void undo();
 	std::string undo_description() const;
 
@@ -43,7 +64,11 @@ public:
 private:
 	void begin_command_sequence_hook();
 	void end_command_sequence_hook(const std::string& description);
+	void enforce_memory_budget();
 	void execute_hook(const Command_Ptr& command);
+	Command_Ptr pop_history(std::deque<HistoryEntry>& history);
+	void pop_history_front(std::deque<HistoryEntry>& history);
+	void push_history(std::deque<HistoryEntry>& history, const Command_Ptr& command);
 };
 
 }
@@ -1,30 +1,34 @@
 /***
  * millipede: DICOMVolumeLoader.cpp
  * Copyright Stuart Golodetz, 2009. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #include "DICOMVolumeLoader.h"
 
+#include <cmath>
+
 #include <boost/algorithm/string/trim.hpp>
+#include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
 using boost::bad_lexical_cast;
 using boost::lexical_cast;
 
 #include <itkGDCMImageIO.h>
 #include <itkImageFileReader.h>
-#include <itkJoinSeriesImageFilter.h>
+#include <itkImageRegionConstIterator.h>
 #include <itkMetaDataObject.h>
-#include <itkRegionOfInterestImageFilter.h>
 
 #include <common/dicom/directories/DICOMDirectory.h>
 #include <common/dicom/volumes/DICOMVolume.h>
 #include <common/exceptions/Exception.h>
+#include <common/util/ITKImageUtil.h>
 
 namespace mp {
 
 //#################### CONSTRUCTORS ####################
-DICOMVolumeLoader::DICOMVolumeLoader(const DICOMDirectory_CPtr& dicomdir, const DICOMVolumeChoice& volumeChoice)
-:	m_dicomdir(dicomdir), m_volumeChoice(volumeChoice)
+DICOMVolumeLoader::DICOMVolumeLoader(const DICOMDirectory_CPtr& dicomdir, const DICOMVolumeChoice& volumeChoice, int threadCount)
+:	m_dicomdir(dicomdir), m_threadCount(threadCount), m_volumeChoice(volumeChoice)
 {}
 
 //#################### PUBLIC METHODS ####################
@@ -44,16 +48,26 @@ const DICOMVolumeChoice& DICOMVolumeLoader::volume_choice() const
 }
 
 //#################### PRIVATE METHODS ####################
+void DICOMVolumeLoader::copy_region(const Image2D::Pointer& image, const Image2D::RegionType& region, const Image3D::Pointer& volumeImage, int z)
+{
+	if(!image->GetLargestPossibleRegion().IsInside(region))
+	{
+		throw Exception("The chosen region does not lie entirely within the image");
+	}
+
+	// The volume's buffer stores x fastest, then y, then z, which is the order in which a region iterator visits the pixels
+	// of each slice, so the region can be copied straight into the slice of the buffer at the right z offset.
+	const itk::Size<2>& size = region.GetSize();
+	int *dest = volumeImage->GetBufferPointer() + static_cast<size_t>(z) * size[0] * size[1];
+	for(itk::ImageRegionConstIterator<Image2D> it(image, region); !it.IsAtEnd(); ++it)
+	{
+		*dest++ = it.Get();
+	}
+}
+
 void DICOMVolumeLoader::execute_impl()
 try
 {
-	typedef itk::GDCMImageIO ImageIO;
-	typedef itk::Image<int,2> Image2D;
-	typedef itk::Image<int,3> Image3D;
-	typedef itk::JoinSeriesImageFilter<Image2D,Image3D> Joiner;
-	typedef itk::ImageFileReader<Image2D> Reader;
-	typedef itk::RegionOfInterestImageFilter<Image2D,Image2D> RegionExtractor;
-
 	// Set up the desired region for each of the slices.
 	Image2D::RegionType region;
 	itk::Index<2> index = {{m_volumeChoice.minX, m_volumeChoice.minY}};
@@ -62,41 +76,31 @@ try
 	region.SetSize(size);
 
 	std::vector<std::string> imageFilenames = m_dicomdir->image_filenames(m_volumeChoice.patientKey, m_volumeChoice.studyKey, m_volumeChoice.seriesKey);
-	std::vector<Image2D::Pointer> images(imageFilenames.size());
-	for(int i=m_volumeChoice.minZ; i<=m_volumeChoice.maxZ; ++i)
-	{
-		std::string imageFilename = m_volumeChoice.filePrefix + imageFilenames[i];
+	int sliceCount = length();
 
-		if(!is_aborted())
-		{
-			set_progress(i - m_volumeChoice.minZ);
-			set_status("Loading image " + imageFilename + "...");
-		}
-		else return;
-
-		// Load the image.
-		Reader::Pointer reader = Reader::New();
-		reader->SetFileName(imageFilename);
-		ImageIO::Pointer gdcmImageIO = ImageIO::New();
-		reader->SetImageIO(gdcmImageIO);
-		reader->Update();
-
-		// Extract the relevant sub-region.
-		RegionExtractor::Pointer extractor = RegionExtractor::New();
-		extractor->SetInput(reader->GetOutput());
-		extractor->SetRegionOfInterest(region);
-		extractor->Update();
-
-		// Store the image.
-		images[i] = extractor->GetOutput();
-		images[i]->SetMetaDataDictionary(reader->GetMetaDataDictionary());
+	// Load the first slice on this thread. Its header supplies the metadata for the volume, and loading it before any
+	// worker threads are started makes sure that any state which GDCM initialises on first use is set up beforehand.
+	std::string firstImageFilename = m_volumeChoice.filePrefix + imageFilenames[m_volumeChoice.minZ];
+	set_status("Loading image " + firstImageFilename + "...");
+	itk::MetaDataDictionary dict;
+	Image2D::Pointer firstImage = read_slice(firstImageFilename, &dict);
+
+	// Determine the modality of the images (before loading the rest of them, in case it isn't supported).
+	DICOMVolume::Modality modality = DICOMVolume::UNSUPPORTED_MODALITY;
+	std::string modalityString = read_header_field(dict, "0008|0060");
+	if(modalityString == "CT")		modality = DICOMVolume::CT;
+	else if(modalityString == "MR")	modality = DICOMVolume::MR;
+
+	if(modality == DICOMVolume::UNSUPPORTED_MODALITY)
+	{
+		throw Exception("Cannot currently handle modalities other than CT and MR - sorry!");
 	}
 
 	// Get the window centre and width if they haven't been explicitly specified by the user.
 	if(m_volumeChoice.windowSettings.unspecified())
 	{
-		std::string windowCentreStr = read_header_field(images[m_volumeChoice.minZ], "0028|1050");
-		std::string windowWidthStr = read_header_field(images[m_volumeChoice.minZ], "0028|1051");
+		std::string windowCentreStr = read_header_field(dict, "0028|1050");
+		std::string windowWidthStr = read_header_field(dict, "0028|1051");
 		std::string validChars = "-0123456789";
 		windowCentreStr = windowCentreStr.substr(0, windowCentreStr.find_first_not_of(validChars));
 		windowWidthStr = windowWidthStr.substr(0, windowWidthStr.find_first_not_of(validChars));
@@ -105,45 +109,51 @@ try
 		m_volumeChoice.windowSettings = WindowSettings(windowCentre, windowWidth);
 	}
 
-	// Make the images into a volume.
-	Joiner::Pointer joiner = Joiner::New();
-
 	double minSliceLocation = 0;
-	try							{ minSliceLocation = lexical_cast<double>(read_header_field(images[m_volumeChoice.minZ], "0020|1041")); }
+	try							{ minSliceLocation = lexical_cast<double>(read_header_field(dict, "0020|1041")); }
 	catch(bad_lexical_cast&)	{ throw Exception("The SliceLocation value for the slice was not of the appropriate type"); }
-	joiner->SetOrigin(minSliceLocation);
+
+	// Allocate the volume and copy the desired region of the first slice into it. The volume has the in-plane origin and
+	// spacing of the region, and its z origin is the location of the first slice (its z spacing is set once the slice
+	// thickness is known, below).
+	Image3D::Pointer volumeImage = ITKImageUtil::make_image<int>(size[0], size[1], sliceCount);
+
+	itk::Point<double,2> regionOrigin;
+	firstImage->TransformIndexToPhysicalPoint(index, regionOrigin);
+	Image3D::PointType origin;
+	origin[0] = regionOrigin[0];
+	origin[1] = regionOrigin[1];
+	origin[2] = minSliceLocation;
+	volumeImage->SetOrigin(origin);
+
+	Image3D::SpacingType spacing;
+	spacing[0] = firstImage->GetSpacing()[0];
+	spacing[1] = firstImage->GetSpacing()[1];
+
+	copy_region(firstImage, region, volumeImage, 0);
+	firstImage = NULL;
+	increment_progress();
+
+	// Load the remaining slices concurrently.
+	std::string secondSliceLocation;
+	ParallelJob::run_slabs(sliceCount - 1,
+						   boost::bind(&DICOMVolumeLoader::load_slices, this, boost::cref(imageFilenames), region, volumeImage, &secondSliceLocation, _1, _2),
+						   m_threadCount);
+	if(is_aborted()) return;
 
 	double sliceThickness = 0;
-	if(m_volumeChoice.minZ + 1 <= m_volumeChoice.maxZ)
+	if(!secondSliceLocation.empty())
 	{
-		try
-		{
-			double nextSliceLocation = lexical_cast<double>(read_header_field(images[m_volumeChoice.minZ+1], "0020|1041"));
-			sliceThickness = fabs(nextSliceLocation - minSliceLocation);
-		}
+		try							{ sliceThickness = fabs(lexical_cast<double>(secondSliceLocation) - minSliceLocation); }
 		catch(bad_lexical_cast&)	{}
 	}
 	if(sliceThickness == 0)
 	{
-		try							{ sliceThickness = lexical_cast<double>(read_header_field(images[m_volumeChoice.minZ], "0018|0050")); }
+		try							{ sliceThickness = lexical_cast<double>(read_header_field(dict, "0018|0050")); }
 		catch(bad_lexical_cast&)	{ throw Exception("The SliceThickness value for the slice was not of the appropriate type"); }
 	}
-	joiner->SetSpacing(sliceThickness);
-
-	for(int i=m_volumeChoice.minZ; i<=m_volumeChoice.maxZ; ++i) joiner->PushBackInput(images[i]);
-	joiner->Update();
-	Image3D::Pointer volumeImage = joiner->GetOutput();
-
-	// Determine the modality of the images.
-	DICOMVolume::Modality modality = DICOMVolume::UNSUPPORTED_MODALITY;
-	std::string modalityString = read_header_field(images[m_volumeChoice.minZ], "0008|0060");
-	if(modalityString == "CT")		modality = DICOMVolume::CT;
-	else if(modalityString == "MR")	modality = DICOMVolume::MR;
-
-	if(modality == DICOMVolume::UNSUPPORTED_MODALITY)
-	{
-		throw Exception("Cannot currently handle modalities other than CT and MR - sorry!");
-	}
+	spacing[2] = sliceThickness;
+	volumeImage->SetSpacing(spacing);
 
 	m_volume.reset(new DICOMVolume(volumeImage, modality));
 }
@@ -153,10 +163,33 @@ catch(std::exception& e)
 	set_status(e.what());
 }
 
-std::string DICOMVolumeLoader::read_header_field(const itk::Image<int,2>::Pointer& image, const std::string& key)
+// Note: The slices in [sliceBegin,sliceEnd) are numbered relative to the second slice in the volume (the first one is loaded by execute_impl()).
+void DICOMVolumeLoader::load_slices(const std::vector<std::string>& imageFilenames, const Image2D::RegionType& region, const Image3D::Pointer& volumeImage,
+									std::string *secondSliceLocation, int sliceBegin, int sliceEnd)
 {
-	const itk::MetaDataDictionary& dict = image->GetMetaDataDictionary();
+	for(int i=sliceBegin; i<sliceEnd; ++i)
+	{
+		if(is_aborted()) return;
 
+		int z = i + 1;
+		std::string imageFilename = m_volumeChoice.filePrefix + imageFilenames[m_volumeChoice.minZ + z];
+		set_status("Loading image " + imageFilename + "...");
+
+		if(z == 1)
+		{
+			// The location of the second slice is used to determine the slice thickness, so its header is needed.
+			itk::MetaDataDictionary dict;
+			copy_region(read_slice(imageFilename, &dict), region, volumeImage, z);
+			*secondSliceLocation = read_header_field(dict, "0020|1041");
+		}
+		else copy_region(read_slice(imageFilename), region, volumeImage, z);
+
+		increment_progress();
+	}
+}
+
+std::string DICOMVolumeLoader::read_header_field(const itk::MetaDataDictionary& dict, const std::string& key)
+{
 	const itk::MetaDataObjectBase *baseVal = dict[key];
 	if(!baseVal) throw Exception("No such key in image header: " + key);
 
@@ -168,4 +201,20 @@ std::string DICOMVolumeLoader::read_header_field(const itk::Image<int,2>::Pointe
 	return ret;
 }
 
+DICOMVolumeLoader::Image2D::Pointer DICOMVolumeLoader::read_slice(const std::string& imageFilename, itk::MetaDataDictionary *dict)
+{
+	typedef itk::ImageFileReader<Image2D> Reader;
+	Reader::Pointer reader = Reader::New();
+	reader->SetFileName(imageFilename);
+	reader->SetImageIO(itk::GDCMImageIO::New());
+	reader->Update();
+
+	// Copy the header only if the caller needs it, and detach the image from the reader so that the reader (along with
+	// its own copy of the header) is destroyed on return.
+	if(dict) *dict = reader->GetMetaDataDictionary();
+	Image2D::Pointer image = reader->GetOutput();
+	image->DisconnectPipeline();
+	return image;
+}
+
 }
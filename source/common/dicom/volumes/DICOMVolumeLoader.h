@@ -1,18 +1,21 @@
 /***
  * millipede: DICOMVolumeLoader.h
  * Copyright Stuart Golodetz, 2009. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_DICOMVOLUMELOADER
 #define H_MILLIPEDE_DICOMVOLUMELOADER
 
 #include <string>
+#include <vector>
 
 #include <boost/shared_ptr.hpp>
 
 #include <itkImage.h>
 
 #include <common/dicom/volumes/DICOMVolumeChoice.h>
+#include <common/jobs/ParallelJob.h>
 #include <common/jobs/SimpleJob.h>
 
 namespace mp {
@@ -21,17 +24,31 @@ namespace mp {
 typedef boost::shared_ptr<const class DICOMDirectory> DICOMDirectory_CPtr;
 typedef boost::shared_ptr<class DICOMVolume> DICOMVolume_Ptr;
 
+/**
+@brief	A DICOMVolumeLoader loads the chosen region of a DICOM series as a volume.
+
+The slices are decoded concurrently by a pool of worker threads, each of which copies the chosen region of the slices
+it decodes straight into the appropriate z offset of a preallocated volume buffer (so only the volume and the slices
+currently being decoded are in memory at any one time). The header fields needed for the volume are read from the first
+slice (and the slice location of the second), and the headers of the other slices are discarded as soon as they are decoded.
+*/
 class DICOMVolumeLoader : public SimpleJob
 {
+	//#################### TYPEDEFS ####################
+private:
+	typedef itk::Image<int,2> Image2D;
+	typedef itk::Image<int,3> Image3D;
+
 	//#################### PRIVATE VARIABLES ####################
 private:
 	DICOMDirectory_CPtr m_dicomdir;
+	int m_threadCount;
 	DICOMVolume_Ptr m_volume;
 	DICOMVolumeChoice m_volumeChoice;
 
 	//#################### CONSTRUCTORS ####################
 public:
-	DICOMVolumeLoader(const DICOMDirectory_CPtr& dicomdir, const DICOMVolumeChoice& volumeChoice);
+	DICOMVolumeLoader(const DICOMDirectory_CPtr& dicomdir, const DICOMVolumeChoice& volumeChoice, int threadCount = ParallelJob::default_thread_count());
 
 	//#################### PUBLIC METHODS ####################
 public:
@@ -41,8 +58,12 @@ public:
 
 	//#################### PRIVATE METHODS ####################
 private:
+	static void copy_region(const Image2D::Pointer& image, const Image2D::RegionType& region, const Image3D::Pointer& volumeImage, int z);
 	void execute_impl();
-	static std::string read_header_field(const itk::Image<int,2>::Pointer& image, const std::string& key);
+	void load_slices(const std::vector<std::string>& imageFilenames, const Image2D::RegionType& region, const Image3D::Pointer& volumeImage,
+					 std::string *secondSliceLocation, int sliceBegin, int sliceEnd);
+	static std::string read_header_field(const itk::MetaDataDictionary& dict, const std::string& key);
+	static Image2D::Pointer read_slice(const std::string& imageFilename, itk::MetaDataDictionary *dict = NULL);
 };
 
 //#################### TYPEDEFS ####################
@@ -97,7 +97,7 @@ void AortaIdentifier3D::execute_impl()
 	increment_progress();
 
 	// Step 6: Use the Fast Marching Method.
-	FastMarching<3> fm(volume_ipf()->leaf_layer()->gradient_magnitude_image(), positions);
+	FastMarching<3> fm(volume_ipf()->leaf_layer()->gradient_magnitude_image(), positions, 8.0);
 	positions = fm.get_shape_at_time(8.0);
 
 	increment_progress();
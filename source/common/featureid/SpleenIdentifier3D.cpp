@@ -70,7 +70,7 @@ void SpleenIdentifier3D::execute_impl()
 	increment_progress();
 
 	// Step 5: Use the Fast Marching Method.
-	FastMarching<3> fm(volume_ipf()->leaf_layer()->gradient_magnitude_image(), positions);
+	FastMarching<3> fm(volume_ipf()->leaf_layer()->gradient_magnitude_image(), positions, 5.0);
 	positions = fm.get_shape_at_time(5.0);
 
 	increment_progress();
@@ -6,29 +6,39 @@
 #ifndef H_MILLIPEDE_FASTMARCHING
 #define H_MILLIPEDE_FASTMARCHING
 
+#include <algorithm>
 #include <cfloat>
 #include <cmath>
 #include <list>
+#include <vector>
 
 #include <boost/mpl/assert.hpp>
 #include <boost/type_traits/is_integral.hpp>
 
 #include <itkCastImageFilter.h>
-#include <itkConstantBoundaryCondition.h>
-#include <itkConstShapedNeighborhoodIterator.h>
 #include <itkGradientAnisotropicDiffusionImageFilter.h>
 #include <itkGradientMagnitudeImageFilter.h>
 #include <itkImage.h>
-#include <itkImageRegionConstIterator.h>
-#include <itkImageRegionIterator.h>
 
-#include <common/adts/PriorityQueue.h>
-#include <common/util/ITKImageUtil.h>
+#include <common/adts/DaryPriorityQueue.h>
 #include <common/util/NullType.h>
 #include <common/util/QuadEqn.h>
 
 namespace mp {
 
+/**
+@brief	A FastMarching object propagates a front outwards from a set of seed voxels (at a speed that decreases with the
+		gradient magnitude of the image) and records the time at which the front passes each voxel.
+
+The propagation works directly on the linear offsets of the voxels, using precomputed strides, and stops once the front
+passes a time bound supplied by the caller. Only the narrow band of voxels touched by the front is ever stored: their times
+are kept in a sparse map made up of tiles that are allocated on demand, and the voxels the front has passed are kept in a
+list from which shapes are extracted. Memory use and running time therefore scale with the grown region, rather than with
+the volume.
+
+The voxels the front passes are also counted in a histogram of their times as the front goes along, so that the time at
+which the growth of the region first stalls (see get_shape_at_first_stop) can be found without sorting the times.
+*/
 template <unsigned int Dimension, typename InputPixelType = unsigned int>
 class FastMarching
 {
@@ -39,59 +49,87 @@ class FastMarching
 
 	//#################### TYPEDEFS ####################
 private:
-	typedef double TimePixelType;	
+	typedef double TimePixelType;
 
 	typedef itk::Image<short, Dimension> GradientMagnitudeImage;
 	typedef itk::Image<InputPixelType, Dimension> InputImage;
-	typedef itk::Image<TimePixelType, Dimension> TimeImage;
 
 	typedef typename InputImage::IndexType Index;
 	typedef std::list<Index> Indices;
 
 	typedef typename GradientMagnitudeImage::Pointer GradientMagnitudeImagePointer;
 	typedef typename InputImage::Pointer InputImagePointer;
-	typedef typename TimeImage::Pointer TimeImagePointer;
 
-	typedef PriorityQueue<Index, TimePixelType, NullType, std::less<TimePixelType>, itk::Functor::IndexLexicographicCompare<Dimension> > PQ;
+	// Note: The priority queue is keyed by the narrow band IDs of the voxels (see VoxelState).
+	typedef DaryPriorityQueue<int, TimePixelType, NullType> PQ;
+
+	//#################### NESTED CLASSES ####################
+private:
+	struct VoxelState
+	{
+		TimePixelType time;		// the time at which the front passed the voxel (or DBL_MAX if it has not done so yet)
+		int narrowBandID;		// the ID of the voxel in the narrow band (or -1 if the front has not touched it yet)
+
+		VoxelState()
+		:	time(DBL_MAX), narrowBandID(-1)
+		{}
+	};
 
-	typedef itk::Offset<Dimension> NeighbourOffset;
-	typedef std::vector<NeighbourOffset> NeighbourOffsets;
+	//#################### ENUMERATIONS ####################
+private:
+	enum { STOP_INTERVAL = 2 };	// the interval between the times at which get_shape_at_first_stop checks the growth of the region
+	enum { TILE_BITS = 12 };	// the voxel states are allocated in tiles of 2^TILE_BITS consecutive voxels
 
-	typedef itk::ConstShapedNeighborhoodIterator<TimeImage> ConstShapedNeighbourhoodIterator;
-	typedef typename ConstShapedNeighbourhoodIterator::ConstIterator ConstNeighbourIterator;
-	typedef itk::ConstNeighborhoodIterator<TimeImage> ConstNeighbourhoodIterator;
-		
 	//#################### PRIVATE VARIABLES ####################
 private:
+	std::vector<int> m_accepted;						// the offsets of the voxels the front has passed
 	GradientMagnitudeImagePointer m_gradients;
-	TimeImagePointer m_times;
-	NeighbourOffsets m_offsets;
+	std::vector<int> m_narrowBand;						// maps narrow band IDs to voxel offsets
+	int m_sizes[Dimension];
+	int m_strides[Dimension];
+	std::vector<std::vector<VoxelState> > m_tiles;
+	TimePixelType m_timeBound;
+	std::vector<int> m_timeHistogram;					// the numbers of voxels the front passed in each stop interval (see stop_interval_of)
 
 	//#################### CONSTRUCTORS ####################
 public:
-	FastMarching(const InputImagePointer& input, const Indices& initial)
+	/**
+	@brief	Propagates a front outwards from the specified seeds over the specified input image.
+
+	@param[in]	input		The input image (its smoothed gradient magnitude determines the speed of the front)
+	@param[in]	initial		The seed voxels
+	@param[in]	timeBound	The time after which the propagation stops (shapes are only available up to this time)
+	*/
+	FastMarching(const InputImagePointer& input, const Indices& initial, TimePixelType timeBound = 100.0)
+	:	m_timeBound(timeBound)
 	{
 		construct_gradients(input);
 		run(initial);
 	}
 
-	FastMarching(const GradientMagnitudeImagePointer& gradients, const Indices& initial)
-	:	m_gradients(gradients)	
+	/**
+	@brief	Propagates a front outwards from the specified seeds over the specified gradient magnitude image.
+
+	@param[in]	gradients	The gradient magnitude image that determines the speed of the front
+	@param[in]	initial		The seed voxels
+	@param[in]	timeBound	The time after which the propagation stops (shapes are only available up to this time)
+	*/
+	FastMarching(const GradientMagnitudeImagePointer& gradients, const Indices& initial, TimePixelType timeBound = 100.0)
+	:	m_gradients(gradients), m_timeBound(timeBound)
 	{
 		run(initial);
-	}	
+	}
 
 	//#################### PUBLIC METHODS ####################
 public:
 	Indices get_shape_at_time(TimePixelType time)
 	{
 		Indices indices;
-		itk::ImageRegionConstIterator<TimeImage> it(m_times, m_times->GetLargestPossibleRegion());
-		for(it.GoToBegin(); !it.IsAtEnd(); ++it)
+		for(std::vector<int>::const_iterator it=m_accepted.begin(), iend=m_accepted.end(); it!=iend; ++it)
 		{
-			if(it.Get() <= time)
+			if(time_at(*it) <= time)
 			{
-				indices.push_back(it.GetIndex());
+				indices.push_back(m_gradients->ComputeIndex(*it));
 			}
 		}
 
@@ -100,91 +138,84 @@ public:
 
 	Indices get_shape_at_first_stop(int threshold)
 	{
-		typedef std::list<TimePixelType> Values;
-		// Sort time image values in increasing order by inserting all of them into a priority queue and then popping out. 
-		Indices allIndices;
-		Values allValues;
-
-		PQ pq;
-		itk::ImageRegionConstIteratorWithIndex<TimeImage> it(m_times, m_times->GetLargestPossibleRegion());
-		for(it.GoToBegin(); !it.IsAtEnd(); ++it)
-		{
-			pq.insert(it.GetIndex(), it.Get(), NullType());
-		}
-		allIndices.resize(pq.size());
-		allValues.resize(pq.size());
-		while(!pq.empty())
-		{
-			typename PQ::Element e = pq.top();
-			pq.pop();
-			allIndices.push_back(e.id());
-			allValues.push_back(e.key());
-		}
-
 		// Repeatedly increase the time value starting from 0 by a fixed delta until the expansion of the region is sufficiently small. For more information refer to my dissertation.
-		TimePixelType delta = 2.0;
-		typename Indices::iterator curIndexIt = allIndices.begin();
-		Values::iterator curValueIt = allValues.begin();
-		Values::iterator largestValueIt = allValues.end();
-		int difference = 0;
-		for(TimePixelType value=delta; ; value+=delta)
+		// Note:	The expansion of the region during each interval is read straight from the histogram. (Voxels the front has not passed
+		//			are never counted, since the expansion of the region stops at the time bound.)
+		// Note:	The expansion during the first interval is deemed to include one voxel for every voxel in the volume. This is because
+		//			the original implementation padded its sorted list of times with that many zeros, and the thresholds used by the
+		//			feature identifiers were chosen with that behaviour in place: in practice, it means that the search never stops in
+		//			the first interval.
+		int voxelCount = 1;
+		for(unsigned int i=0; i<Dimension; ++i) voxelCount *= m_sizes[i];
+
+		int remaining = static_cast<int>(m_accepted.size());
+		size_t interval = 0;
+		for(;; ++interval)
 		{
-			difference = 0;
-			while(curValueIt != largestValueIt && *curValueIt <= value)
-			{
-				++curIndexIt;
-				++curValueIt;
-				++difference;
-			}
-
-			if(difference < threshold || curValueIt == largestValueIt)	break;
+			int difference = interval < m_timeHistogram.size() ? m_timeHistogram[interval] : 0;
+			remaining -= difference;
+			if(interval == 0) difference += voxelCount;
+			if(difference < threshold || remaining == 0)	break;
 		}
 
-		// Take the indices with currentRegionSize-many smallest values (this is the region for time value) and return it.
-		Indices indices;
-		indices.splice(indices.begin(), allIndices, allIndices.begin(), curIndexIt);
-		return indices;
+		// Take the voxels the front passed by the end of the interval (this is the region for time value) and return them.
+		return get_shape_at_time(static_cast<TimePixelType>((interval + 1) * STOP_INTERVAL));
 	}
 
 	//#################### PRIVATE METHODS ####################
 private:
-	static PQ build_initial_propagation_queue(const Indices& initial)
+	void accept(int offset, TimePixelType time)
+	{
+		VoxelState& s = state(offset);
+		if(s.time == DBL_MAX) m_accepted.push_back(offset);
+		else --m_timeHistogram[stop_interval_of(s.time)];
+		s.time = time;
+
+		size_t interval = stop_interval_of(time);
+		if(interval >= m_timeHistogram.size()) m_timeHistogram.resize(interval + 1, 0);
+		++m_timeHistogram[interval];
+	}
+
+	PQ build_initial_propagation_queue(const Indices& initial)
 	{
 		PQ pq;
 		for(typename Indices::const_iterator jt=initial.begin(), jend=initial.end(); jt!=jend; ++jt)
 		{
-			pq.insert(*jt, 0.0, NullType());	
-		}	
+			int id = narrow_band_id(static_cast<int>(m_gradients->ComputeOffset(*jt)));
+			if(!pq.contains(id)) pq.insert(id, 0.0, NullType());
+		}
 
 		return pq;
 	}
 
-	TimePixelType compute_new_time_at(const Index& index, const ConstNeighbourhoodIterator& it)
-	{		
+	TimePixelType compute_new_time_at(int offset, const int *coords) const
+	{
 		double A, B, C;
 
 		double alpha = 1.0;
-		double coefficient = 10.0;	
+		double coefficient = 10.0;
 		A = 0;
 		B = 0;
 		// The following formulas are used: C = -1 / F^2 , where F(x) = coefficient * e^(-2*alpha*x). For more information refer to my dissertation.
-		C = -(exp(2*alpha*m_gradients->GetPixel(index))) / (coefficient*coefficient);
-		TimePixelType time = it.GetCenterPixel();
+		C = -(exp(2*alpha*m_gradients->GetBufferPointer()[offset])) / (coefficient*coefficient);
+		TimePixelType time = time_at(offset);
 		for(unsigned int i=0; i<Dimension; ++i)
 		{
-			// The offsets in the i-th direction have indices Dimension-1-i and Dimension+i in the vector of offsets.
-			TimePixelType adjTime = std::min(it.GetPixel(m_offsets[Dimension-1-i]), it.GetPixel(m_offsets[Dimension+i]));
+			// Voxels outside the image are treated as never having been passed by the front.
+			TimePixelType prevTime = coords[i] > 0 ? time_at(offset - m_strides[i]) : DBL_MAX;
+			TimePixelType nextTime = coords[i] < m_sizes[i] - 1 ? time_at(offset + m_strides[i]) : DBL_MAX;
+			TimePixelType adjTime = std::min(prevTime, nextTime);
 			if(time > adjTime)
 			{
-				// The spacing in the time image is considered to be 1. 
+				// The spacing in the time image is considered to be 1.
 				A += 1;
 				B += -2 * adjTime;
 				C += adjTime * adjTime;
-			}	
+			}
 		}
 
 		return QuadEqn::largest_root(A, B, C);
-	}	
+	}
 
 	void construct_gradients(const InputImagePointer& input)
 	{
@@ -215,88 +246,127 @@ private:
 		gmFilter->SetUseImageSpacingOff();
 		gmFilter->Update();
 		m_gradients = gmFilter->GetOutput();
-	}	
+	}
 
-	void initialise_times()
+	const VoxelState *find_state(int offset) const
 	{
-		m_times = TimeImage::New();
-		m_times->SetRegions(m_gradients->GetLargestPossibleRegion());
-		m_times->Allocate();
+		const std::vector<VoxelState>& tile = m_tiles[offset >> TILE_BITS];
+		return tile.empty() ? NULL : &tile[offset & ((1 << TILE_BITS) - 1)];
+	}
 
-		itk::ImageRegionIterator<TimeImage> it(m_times, m_times->GetLargestPossibleRegion());
-		for(it.GoToBegin(); !it.IsAtEnd(); ++it)
+	void initialise_narrow_band()
+	{
+		const typename GradientMagnitudeImage::SizeType& size = m_gradients->GetBufferedRegion().GetSize();
+		int stride = 1;
+		for(unsigned int i=0; i<Dimension; ++i)
 		{
-			it.Set(DBL_MAX);
+			m_sizes[i] = static_cast<int>(size[i]);
+			m_strides[i] = stride;
+			stride *= m_sizes[i];
 		}
+
+		// Note: stride is now the number of voxels in the image.
+		m_tiles.resize((stride >> TILE_BITS) + 1);
 	}
 
-	void propagate_surface(PQ& pq)
+	int narrow_band_id(int offset)
 	{
-		TimePixelType largeNumber = 100.0;
-
-		itk::Size<Dimension> radius;
-		radius.Fill(1);
-		ConstShapedNeighbourhoodIterator it(radius, m_times, m_times->GetLargestPossibleRegion());
-
-		for(typename NeighbourOffsets::const_iterator jt=m_offsets.begin(), jend=m_offsets.end(); jt!=jend; ++jt)
+		VoxelState& s = state(offset);
+		if(s.narrowBandID == -1)
 		{
-			it.ActivateOffset(*jt);	
+			s.narrowBandID = static_cast<int>(m_narrowBand.size());
+			m_narrowBand.push_back(offset);
 		}
+		return s.narrowBandID;
+	}
 
-		itk::ConstantBoundaryCondition<TimeImage> itCondition;
-		itCondition.SetConstant(0.0);
-		it.OverrideBoundaryCondition(&itCondition);	
-
-		ConstNeighbourhoodIterator kt(radius, m_times, m_times->GetLargestPossibleRegion());
-		itk::ConstantBoundaryCondition<TimeImage> ktCondition;
-		ktCondition.SetConstant(DBL_MAX);
-		kt.OverrideBoundaryCondition(&ktCondition);
+	void propagate_surface(PQ& pq)
+	{
+		int coords[Dimension], adjCoords[Dimension];
 
 		while(!pq.empty())
 		{
 			typename PQ::Element e = pq.top();
 			pq.pop();
-			Index cur = e.id();
+			int cur = m_narrowBand[e.id()];
 			TimePixelType curTime = e.key();
 
-			// To avoid real-valued type precision errors stop the process when it reaches some large time value.
-			if(curTime > largeNumber)	break;
+			// Stop the process when the front passes the time bound (this also avoids real-valued type precision errors at large time values).
+			if(curTime > m_timeBound)	break;
+
+			accept(cur, curTime);
+			for(unsigned int i=0; i<Dimension; ++i)
+			{
+				coords[i] = (cur / m_strides[i]) % m_sizes[i];
+			}
 
-			m_times->SetPixel(cur, curTime);
-			it.SetLocation(cur);
-			for(ConstNeighbourIterator jt=it.Begin(), jend=it.End(); jt!=jend; ++jt)
+			// Visit the 2*Dimension face-adjacent neighbours of the current voxel (in increasing order of offset).
+			for(unsigned int k=0; k<2*Dimension; ++k)
 			{
-				Index adj = cur + jt.GetNeighborhoodOffset();
-				TimePixelType adjTime = jt.Get();
+				unsigned int i = k < Dimension ? Dimension-1-k : k-Dimension;
+				int step = k < Dimension ? -1 : 1;
+				if(coords[i] + step < 0 || coords[i] + step >= m_sizes[i]) continue;
+
+				int adj = cur + step * m_strides[i];
+				TimePixelType adjTime = time_at(adj);
 
 				if(adjTime <= curTime)	continue;
 
-				kt.SetLocation(adj);
-				TimePixelType adjNewTime = compute_new_time_at(adj, kt);
-				if(pq.contains(adj))
+				std::copy(coords, coords + Dimension, adjCoords);
+				adjCoords[i] += step;
+				TimePixelType adjNewTime = compute_new_time_at(adj, adjCoords);
+
+				const VoxelState *s = find_state(adj);
+				if(s && s->narrowBandID != -1 && pq.contains(s->narrowBandID))
 				{
-					if (adjNewTime < pq.element(adj).key())
+					if (adjNewTime < pq.element(s->narrowBandID).key())
 					{
-						pq.update_key(adj, adjNewTime);
+						pq.update_key(s->narrowBandID, adjNewTime);
 					}
 				}
-				else
+				else if(adjNewTime <= m_timeBound)
 				{
-					pq.insert(adj, adjNewTime, NullType());
+					// Voxels whose times would exceed the time bound are never accepted, so they need not join the narrow band.
+					pq.insert(narrow_band_id(adj), adjNewTime, NullType());
 				}
 			}
-		}		
+		}
 	}
-	
+
 	void run(const Indices& initial)
 	{
-		m_offsets = ITKImageUtil::make_2d_connected_offsets<Dimension>();
-
-		initialise_times();
+		initialise_narrow_band();
 
 		PQ pq =  build_initial_propagation_queue(initial);
 		propagate_surface(pq);
-	}	
+	}
+
+	VoxelState& state(int offset)
+	{
+		std::vector<VoxelState>& tile = m_tiles[offset >> TILE_BITS];
+		if(tile.empty()) tile.resize(1 << TILE_BITS);
+		return tile[offset & ((1 << TILE_BITS) - 1)];
+	}
+
+	/**
+	@brief	Returns the index of the stop interval containing the specified time.
+
+	Interval 0 is [0,STOP_INTERVAL], and interval k > 0 is (k*STOP_INTERVAL,(k+1)*STOP_INTERVAL].
+
+	@param[in]	time	The time (which must be finite and non-negative)
+	@return	As described
+	*/
+	static size_t stop_interval_of(TimePixelType time)
+	{
+		if(time <= STOP_INTERVAL) return 0;
+		else return static_cast<size_t>(std::ceil(time / STOP_INTERVAL)) - 1;
+	}
+
+	TimePixelType time_at(int offset) const
+	{
+		const VoxelState *s = find_state(offset);
+		return s ? s->time : DBL_MAX;
+	}
 };
 
 }
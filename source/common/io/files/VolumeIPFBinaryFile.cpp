@@ -0,0 +1,429 @@
+/***
+ * millipede: VolumeIPFBinaryFile.cpp
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#include "VolumeIPFBinaryFile.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fstream>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <common/exceptions/Exception.h>
+#include <common/io/util/OSSWrapper.h>
+#include <common/util/ITKImageUtil.h>
+
+namespace mp {
+
+//#################### LOCAL CONSTANTS ####################
+namespace {
+
+const char MAGIC[8] = { 'M', 'P', 'V', 'I', 'P', 'F', 'B', '\0' };
+const boost::uint32_t BYTE_ORDER_MARKER = 0x01020304;
+const size_t HEADER_SIZE = 8 + 6 * sizeof(boost::uint32_t);
+const size_t BRANCH_LAYER_HEADER_SIZE = 2 * sizeof(boost::uint32_t) + sizeof(boost::uint64_t);
+
+}
+
+//#################### LOCAL FUNCTIONS ####################
+namespace {
+
+void check_consistent(bool condition)
+{
+	if(!condition) throw Exception("The binary volume IPF file is truncated or corrupt");
+}
+
+bool is_node(const std::vector<bool>& layerNodes, int n)
+{
+	return n >= 0 && n < static_cast<int>(layerNodes.size()) && layerNodes[n];
+}
+
+boost::uint64_t padded(boost::uint64_t length)
+{
+	return (length + 7) & ~static_cast<boost::uint64_t>(7);
+}
+
+template <typename T>
+T read_value(const char *data)
+{
+	T value;
+	std::memcpy(&value, data, sizeof(T));
+	return value;
+}
+
+template <typename T>
+void read_array(const char *data, T *arr, boost::uint64_t size)
+{
+	std::memcpy(arr, data, static_cast<size_t>(size * sizeof(T)));
+}
+
+template <typename T>
+void write_array(std::ostream& os, const T *arr, boost::uint64_t size)
+{
+	boost::uint64_t length = size * sizeof(T);
+	if(length != 0) os.write(reinterpret_cast<const char*>(arr), length);
+
+	static const char zeros[8] = {0};
+	os.write(zeros, padded(length) - length);
+}
+
+template <typename T>
+void write_array(std::ostream& os, const std::vector<T>& arr)
+{
+	write_array(os, arr.empty() ? NULL : &arr[0], arr.size());
+}
+
+template <typename T>
+void write_value(std::ostream& os, const T& value)
+{
+	os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void write_branch_layer(std::ostream& os, const VolumeIPFBinaryFile::BranchLayer& layer)
+{
+	typedef VolumeIPFBinaryFile::BranchLayer BranchLayer;
+
+	// Note: The node indices of a branch layer are returned in ascending order, so they can be binary searched below.
+	std::vector<int> nodeIndices = layer.node_indices();
+	std::vector<BranchLayer::Edge> edges = layer.edges();
+	size_t nodeCount = nodeIndices.size(), edgeCount = edges.size();
+
+	std::vector<int> parents(nodeCount);
+	std::vector<char> properties(nodeCount * DICOMRegionProperties::BINARY_SIZE);
+	std::vector<boost::uint64_t> childOffsets(nodeCount + 1);
+	std::vector<int> children;
+	for(size_t i=0; i<nodeCount; ++i)
+	{
+		int n = nodeIndices[i];
+		parents[i] = layer.node_parent(n);
+		layer.node_properties(n).write_binary(&properties[i * DICOMRegionProperties::BINARY_SIZE]);
+
+		const std::set<int>& nodeChildren = layer.node_children(n);
+		childOffsets[i] = children.size();
+		children.insert(children.end(), nodeChildren.begin(), nodeChildren.end());
+	}
+	childOffsets[nodeCount] = children.size();
+
+	// The edges come out sorted by (u,v) with u < v, so each node's row is a contiguous run.
+	std::vector<boost::uint64_t> edgeOffsets(nodeCount + 1, 0);
+	std::vector<int> edgeTargets(edgeCount), edgeWeights(edgeCount);
+	for(size_t j=0; j<edgeCount; ++j)
+	{
+		size_t row = std::lower_bound(nodeIndices.begin(), nodeIndices.end(), edges[j].u) - nodeIndices.begin();
+		++edgeOffsets[row + 1];
+		edgeTargets[j] = edges[j].v;
+		edgeWeights[j] = edges[j].weight;
+	}
+	for(size_t i=0; i<nodeCount; ++i) edgeOffsets[i + 1] += edgeOffsets[i];
+
+	write_value(os, static_cast<boost::uint32_t>(nodeCount));
+	write_value(os, static_cast<boost::uint32_t>(edgeCount));
+	write_value(os, static_cast<boost::uint64_t>(children.size()));
+	write_array(os, nodeIndices);
+	write_array(os, parents);
+	write_array(os, properties);
+	write_array(os, childOffsets);
+	write_array(os, children);
+	write_array(os, edgeOffsets);
+	write_array(os, edgeTargets);
+	write_array(os, edgeWeights);
+}
+
+void write_leaf_layer(std::ostream& os, const VolumeIPFBinaryFile::LeafLayer& layer)
+{
+	// Note:	The leaf layer already stores each of the node properties as a separate array, so they can be written out directly.
+	int nodeCount = layer.node_count();
+	std::vector<int> parents(nodeCount);
+	for(int i=0; i<nodeCount; ++i)
+	{
+		parents[i] = layer.node_parent(i);
+	}
+
+	write_array(os, layer.base_image()->GetBufferPointer(), nodeCount);
+	write_array(os, layer.gradient_magnitude_image()->GetBufferPointer(), nodeCount);
+	write_array(os, layer.grey_image()->GetBufferPointer(), nodeCount);
+	write_array(os, parents);
+}
+
+}
+
+//#################### CONSTRUCTORS ####################
+VolumeIPFBinaryFile::VolumeIPFBinaryFile(const std::string& filename)
+try
+:	m_mapping(new boost::interprocess::file_mapping(filename.c_str(), boost::interprocess::read_only)),
+	m_region(new boost::interprocess::mapped_region(*m_mapping, boost::interprocess::read_only))
+{
+	m_data = static_cast<const char*>(m_region->get_address());
+	m_size = m_region->get_size();
+
+	// Read and validate the fixed-size header.
+	check_range(0, HEADER_SIZE);
+	if(std::memcmp(m_data, MAGIC, sizeof(MAGIC)) != 0) throw Exception(filename + " is not a binary volume IPF file");
+
+	const char *p = m_data + sizeof(MAGIC);
+	boost::uint32_t version = read_value<boost::uint32_t>(p);			p += sizeof(boost::uint32_t);
+	boost::uint32_t byteOrderMarker = read_value<boost::uint32_t>(p);	p += sizeof(boost::uint32_t);
+	if(version != FORMAT_VERSION) throw Exception(OSSWrapper() << "Unsupported binary volume IPF version: " << version);
+	if(byteOrderMarker != BYTE_ORDER_MARKER) throw Exception("The binary volume IPF file was written on a machine with a different byte order");
+
+	for(int i=0; i<3; ++i)
+	{
+		m_volumeSize[i] = read_value<boost::uint32_t>(p);
+		p += sizeof(boost::uint32_t);
+	}
+	boost::uint32_t highestLayer = read_value<boost::uint32_t>(p);
+
+	// Note: The leaf layer's nodes (and hence all the node indices in the file) must be representable as ints.
+	boost::uint64_t sliceSize = static_cast<boost::uint64_t>(m_volumeSize[0]) * m_volumeSize[1];
+	check_consistent(sliceSize <= INT_MAX && sliceSize * m_volumeSize[2] <= INT_MAX);
+
+	// Read the layer directory.
+	check_range(HEADER_SIZE, (static_cast<boost::uint64_t>(highestLayer) + 1) * sizeof(boost::uint64_t));
+	m_layerOffsets.resize(highestLayer + 1);
+	for(boost::uint32_t i=0; i<=highestLayer; ++i)
+	{
+		m_layerOffsets[i] = read_value<boost::uint64_t>(m_data + HEADER_SIZE + i * sizeof(boost::uint64_t));
+	}
+
+	m_branchLayers.resize(highestLayer);
+}
+catch(boost::interprocess::interprocess_exception& e)
+{
+	throw Exception("Could not map " + filename + " for reading: " + e.what());
+}
+
+//#################### PUBLIC METHODS ####################
+VolumeIPFBinaryFile::BranchLayer_Ptr VolumeIPFBinaryFile::branch_layer(int index) const
+{
+	if(index < 1 || index > highest_layer()) throw Exception(OSSWrapper() << "Invalid layer: " << index);
+	BranchLayer_Ptr& layer = m_branchLayers[index-1];
+	if(!layer) layer = load_branch_layer(index);
+	return layer;
+}
+
+int VolumeIPFBinaryFile::highest_layer() const
+{
+	return static_cast<int>(m_branchLayers.size());
+}
+
+bool VolumeIPFBinaryFile::is_binary_file(const std::string& filename)
+{
+	std::ifstream is(filename.c_str(), std::ios_base::binary);
+	char magic[sizeof(MAGIC)];
+	is.read(magic, sizeof(MAGIC));
+	return !is.fail() && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+VolumeIPFBinaryFile::LeafLayer_Ptr VolumeIPFBinaryFile::leaf_layer() const
+{
+	if(!m_leafLayer) m_leafLayer = load_leaf_layer();
+	return m_leafLayer;
+}
+
+void VolumeIPFBinaryFile::save(const std::string& filename, const VolumeIPF_CPtr& volumeIPF)
+{
+	std::ofstream os(filename.c_str(), std::ios_base::binary);
+	if(os.fail()) throw Exception("Could not open " + filename + " for writing");
+
+	int highestLayer = volumeIPF->highest_layer();
+	const itk::Size<3>& volumeSize = volumeIPF->volume_size();
+
+	// Write the header.
+	os.write(MAGIC, sizeof(MAGIC));
+	write_value(os, static_cast<boost::uint32_t>(FORMAT_VERSION));
+	write_value(os, BYTE_ORDER_MARKER);
+	for(int i=0; i<3; ++i) write_value(os, static_cast<boost::uint32_t>(volumeSize[i]));
+	write_value(os, static_cast<boost::uint32_t>(highestLayer));
+
+	// Write a placeholder layer directory (it gets filled in once the layer offsets are known).
+	std::vector<boost::uint64_t> layerOffsets(highestLayer + 1);
+	write_array(os, layerOffsets);
+
+	// Write the layers themselves.
+	layerOffsets[0] = static_cast<boost::uint64_t>(os.tellp());
+	write_leaf_layer(os, *volumeIPF->leaf_layer());
+	for(int layer=1; layer<=highestLayer; ++layer)
+	{
+		layerOffsets[layer] = static_cast<boost::uint64_t>(os.tellp());
+		write_branch_layer(os, *volumeIPF->branch_layer(layer));
+	}
+
+	// Go back and fill in the layer directory.
+	os.seekp(HEADER_SIZE);
+	write_array(os, layerOffsets);
+
+	if(os.fail()) throw Exception("Could not write " + filename);
+}
+
+// Note: The returned forest shares the layers cached by the file, so the file should be discarded once the forest is modified.
+VolumeIPFBinaryFile::VolumeIPF_Ptr VolumeIPFBinaryFile::volume_ipf() const
+{
+	VolumeIPF_Ptr volumeIPF(new VolumeIPFT(m_volumeSize, leaf_layer()));
+	for(int layer=1, highestLayer=highest_layer(); layer<=highestLayer; ++layer)
+	{
+		volumeIPF->add_branch_layer(branch_layer(layer));
+	}
+	return volumeIPF;
+}
+
+const itk::Size<3>& VolumeIPFBinaryFile::volume_size() const
+{
+	return m_volumeSize;
+}
+
+//#################### PRIVATE METHODS ####################
+void VolumeIPFBinaryFile::check_range(boost::uint64_t offset, boost::uint64_t length) const
+{
+	check_consistent(offset <= m_size && length <= m_size - offset);
+}
+
+// Note: Only the layer's header and node index array are read, so this is cheap even for a layer that has not yet been loaded.
+std::vector<bool> VolumeIPFBinaryFile::layer_nodes(int index) const
+{
+	const int volumeNodeCount = static_cast<int>(m_volumeSize[0] * m_volumeSize[1] * m_volumeSize[2]);
+	if(index == 0) return std::vector<bool>(volumeNodeCount, true);
+
+	boost::uint64_t offset = m_layerOffsets[index];
+	check_range(offset, BRANCH_LAYER_HEADER_SIZE);
+	boost::uint64_t nodeCount = read_value<boost::uint32_t>(m_data + offset);
+	check_range(offset + BRANCH_LAYER_HEADER_SIZE, nodeCount * sizeof(int));
+
+	std::vector<bool> nodes(volumeNodeCount, false);
+	const char *nodeIndices = m_data + offset + BRANCH_LAYER_HEADER_SIZE;
+	int prev = -1;
+	for(boost::uint64_t i=0; i<nodeCount; ++i)
+	{
+		int n = read_value<int>(nodeIndices + i * sizeof(int));
+		check_consistent(n > prev && n < volumeNodeCount);
+		nodes[n] = true;
+		prev = n;
+	}
+	return nodes;
+}
+
+VolumeIPFBinaryFile::BranchLayer_Ptr VolumeIPFBinaryFile::load_branch_layer(int index) const
+{
+	// Note: The whole extent of the layer is checked before any pointers into it are formed.
+	boost::uint64_t offset = m_layerOffsets[index];
+	check_range(offset, BRANCH_LAYER_HEADER_SIZE);
+	const char *p = m_data + offset;
+	boost::uint64_t nodeCount = read_value<boost::uint32_t>(p);			p += sizeof(boost::uint32_t);
+	boost::uint64_t edgeCount = read_value<boost::uint32_t>(p);			p += sizeof(boost::uint32_t);
+	boost::uint64_t childCount = read_value<boost::uint64_t>(p);		p += sizeof(boost::uint64_t);
+	check_consistent(childCount <= m_size / sizeof(int));
+
+	boost::uint64_t arrayOffsets[9];
+	arrayOffsets[0] = BRANCH_LAYER_HEADER_SIZE;
+	arrayOffsets[1] = arrayOffsets[0] + padded(nodeCount * sizeof(int));
+	arrayOffsets[2] = arrayOffsets[1] + padded(nodeCount * sizeof(int));
+	arrayOffsets[3] = arrayOffsets[2] + padded(nodeCount * DICOMRegionProperties::BINARY_SIZE);
+	arrayOffsets[4] = arrayOffsets[3] + padded((nodeCount + 1) * sizeof(boost::uint64_t));
+	arrayOffsets[5] = arrayOffsets[4] + padded(childCount * sizeof(int));
+	arrayOffsets[6] = arrayOffsets[5] + padded((nodeCount + 1) * sizeof(boost::uint64_t));
+	arrayOffsets[7] = arrayOffsets[6] + padded(edgeCount * sizeof(int));
+	arrayOffsets[8] = arrayOffsets[7] + padded(edgeCount * sizeof(int));
+	check_range(offset, arrayOffsets[8]);
+
+	const char *nodeIndices = m_data + offset + arrayOffsets[0];
+	const char *parents = m_data + offset + arrayOffsets[1];
+	const char *properties = m_data + offset + arrayOffsets[2];
+	const char *childOffsets = m_data + offset + arrayOffsets[3];
+	const char *children = m_data + offset + arrayOffsets[4];
+	const char *edgeOffsets = m_data + offset + arrayOffsets[5];
+	const char *edgeTargets = m_data + offset + arrayOffsets[6];
+	const char *edgeWeights = m_data + offset + arrayOffsets[7];
+
+	// Every index in the layer must refer to a node of the appropriate layer, or the forest would be inconsistent.
+	// The nodes of the highest layer are the only ones without parents.
+	std::vector<bool> nodes = layer_nodes(index);
+	std::vector<bool> childNodes = layer_nodes(index - 1);
+	std::vector<bool> parentNodes = index < highest_layer() ? layer_nodes(index + 1) : std::vector<bool>();
+
+	BranchLayer_Ptr layer(new BranchLayer);
+
+	for(boost::uint64_t i=0; i<nodeCount; ++i)
+	{
+		int n = read_value<int>(nodeIndices + i * sizeof(int));
+		int parent = read_value<int>(parents + i * sizeof(int));
+		check_consistent(parentNodes.empty() ? parent == -1 : is_node(parentNodes, parent));
+		layer->set_node_properties(n, DICOMRegionProperties::read_binary(properties + i * DICOMRegionProperties::BINARY_SIZE));
+		layer->set_node_parent(n, parent);
+
+		boost::uint64_t childBegin = read_value<boost::uint64_t>(childOffsets + i * sizeof(boost::uint64_t));
+		boost::uint64_t childEnd = read_value<boost::uint64_t>(childOffsets + (i + 1) * sizeof(boost::uint64_t));
+		check_consistent(childBegin <= childEnd && childEnd <= childCount);
+
+		// Note: The children are stored in ascending order, so hinted insertion at the end is constant time.
+		std::set<int>& nodeChildren = layer->node_children(n);
+		for(boost::uint64_t j=childBegin; j<childEnd; ++j)
+		{
+			int child = read_value<int>(children + j * sizeof(int));
+			check_consistent(is_node(childNodes, child));
+			nodeChildren.insert(nodeChildren.end(), child);
+		}
+	}
+
+	for(boost::uint64_t i=0; i<nodeCount; ++i)
+	{
+		int u = read_value<int>(nodeIndices + i * sizeof(int));
+		boost::uint64_t edgeBegin = read_value<boost::uint64_t>(edgeOffsets + i * sizeof(boost::uint64_t));
+		boost::uint64_t edgeEnd = read_value<boost::uint64_t>(edgeOffsets + (i + 1) * sizeof(boost::uint64_t));
+		check_consistent(edgeBegin <= edgeEnd && edgeEnd <= edgeCount);
+
+		for(boost::uint64_t j=edgeBegin; j<edgeEnd; ++j)
+		{
+			int v = read_value<int>(edgeTargets + j * sizeof(int));
+			check_consistent(v > u && is_node(nodes, v));
+			layer->set_edge_weight(u, v, read_value<int>(edgeWeights + j * sizeof(int)));
+		}
+	}
+
+	return layer;
+}
+
+VolumeIPFBinaryFile::LeafLayer_Ptr VolumeIPFBinaryFile::load_leaf_layer() const
+{
+	const boost::uint64_t nodeCount = static_cast<boost::uint64_t>(m_volumeSize[0]) * m_volumeSize[1] * m_volumeSize[2];
+
+	// Note: The whole extent of the layer is checked before any pointers into it are formed.
+	boost::uint64_t offset = m_layerOffsets[0];
+	boost::uint64_t arrayOffsets[5];
+	arrayOffsets[0] = 0;
+	arrayOffsets[1] = arrayOffsets[0] + padded(nodeCount * sizeof(int));
+	arrayOffsets[2] = arrayOffsets[1] + padded(nodeCount * sizeof(short));
+	arrayOffsets[3] = arrayOffsets[2] + padded(nodeCount * sizeof(unsigned char));
+	arrayOffsets[4] = arrayOffsets[3] + padded(nodeCount * sizeof(int));
+	check_range(offset, arrayOffsets[4]);
+
+	const char *baseValues = m_data + offset + arrayOffsets[0];
+	const char *gradientMagnitudeValues = m_data + offset + arrayOffsets[1];
+	const char *greyValues = m_data + offset + arrayOffsets[2];
+	const char *parents = m_data + offset + arrayOffsets[3];
+
+	// Bulk copy the node properties into images, whose pixel buffers the leaf layer then uses as its own arrays.
+	itk::Image<int,3>::Pointer baseImage = ITKImageUtil::make_image<int,3>(m_volumeSize);
+	itk::Image<short,3>::Pointer gradientMagnitudeImage = ITKImageUtil::make_image<short,3>(m_volumeSize);
+	itk::Image<unsigned char,3>::Pointer greyImage = ITKImageUtil::make_image<unsigned char,3>(m_volumeSize);
+	read_array(baseValues, baseImage->GetBufferPointer(), nodeCount);
+	read_array(gradientMagnitudeValues, gradientMagnitudeImage->GetBufferPointer(), nodeCount);
+	read_array(greyValues, greyImage->GetBufferPointer(), nodeCount);
+
+	// Every leaf must have a parent in the lowest branch layer (if there is one).
+	std::vector<bool> parentNodes = highest_layer() > 0 ? layer_nodes(1) : std::vector<bool>();
+
+	LeafLayer_Ptr layer(new LeafLayer(baseImage, greyImage, gradientMagnitudeImage));
+	for(boost::uint64_t i=0; i<nodeCount; ++i)
+	{
+		int parent = read_value<int>(parents + i * sizeof(int));
+		check_consistent(parentNodes.empty() ? parent == -1 : is_node(parentNodes, parent));
+		layer->set_node_parent(static_cast<int>(i), parent);
+	}
+
+	return layer;
+}
+
+}
@@ -0,0 +1,103 @@
+/***
+ * millipede: VolumeIPFBinaryFile.h
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#ifndef H_MILLIPEDE_VOLUMEIPFBINARYFILE
+#define H_MILLIPEDE_VOLUMEIPFBINARYFILE
+
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <common/partitionforests/images/DICOMImageBranchLayer.h>
+#include <common/partitionforests/images/DICOMImageLeafLayer.h>
+#include <common/partitionforests/images/VolumeIPF.h>
+
+//#################### FORWARD DECLARATIONS ####################
+namespace boost { namespace interprocess {
+	class file_mapping;
+	class mapped_region;
+}}
+
+namespace mp {
+
+/**
+@brief	A VolumeIPFBinaryFile provides access to a volume IPF stored in the versioned binary (.ipf) format.
+
+The file is memory-mapped when it is opened, and only its fixed-size header and layer directory are read at that point.
+Individual layers are materialised into ImageLeafLayer / ImageBranchLayer objects on demand (and cached thereafter),
+so clients that only need (say) the leaf layer and the lowest few branch layers never pay for parsing the rest.
+
+The layout of the file is as follows (all values in native byte order, each array padded to an 8-byte boundary):
+
+	Header:				magic[8], version (u32), byte-order marker (u32), sizeX, sizeY, sizeZ (u32), layer count (u32)
+	Layer directory:	leaf layer offset (u64), followed by one offset (u64) per branch layer
+	Leaf layer:			base values (i32[N]), gradient magnitude values (i16[N]), grey values (u8[N]), parents (i32[N])
+	Branch layer:		node count (u32), edge count (u32), child count (u64),
+						node indices (i32[nodes], ascending), parents (i32[nodes]), properties (DICOMRegionProperties::BINARY_SIZE bytes each),
+						child offsets (u64[nodes+1]), children (i32[children]),
+						edge offsets (u64[nodes+1]), edge targets (i32[edges]), edge weights (i32[edges])
+
+The child and edge tables are in compressed sparse row form, indexed by the position of each node in the node index array.
+Each edge {u,v} (with u < v) is stored once, in the row for u.
+*/
+class VolumeIPFBinaryFile
+{
+	//#################### TYPEDEFS ####################
+public:
+	typedef DICOMImageBranchLayer BranchLayer;
+	typedef DICOMImageLeafLayer LeafLayer;
+	typedef boost::shared_ptr<BranchLayer> BranchLayer_Ptr;
+	typedef boost::shared_ptr<LeafLayer> LeafLayer_Ptr;
+	typedef VolumeIPF<LeafLayer,BranchLayer> VolumeIPFT;
+	typedef boost::shared_ptr<VolumeIPFT> VolumeIPF_Ptr;
+	typedef boost::shared_ptr<const VolumeIPFT> VolumeIPF_CPtr;
+
+	//#################### CONSTANTS ####################
+public:
+	enum { FORMAT_VERSION = 2 };
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	mutable std::vector<BranchLayer_Ptr> m_branchLayers;
+	const char *m_data;
+	std::vector<boost::uint64_t> m_layerOffsets;	// m_layerOffsets[0] is the offset of the leaf layer, m_layerOffsets[i] that of branch layer i
+	mutable LeafLayer_Ptr m_leafLayer;
+	boost::shared_ptr<boost::interprocess::file_mapping> m_mapping;
+	boost::shared_ptr<boost::interprocess::mapped_region> m_region;
+	size_t m_size;
+	itk::Size<3> m_volumeSize;
+
+	//#################### CONSTRUCTORS ####################
+public:
+	explicit VolumeIPFBinaryFile(const std::string& filename);
+
+	//#################### COPY CONSTRUCTOR & ASSIGNMENT OPERATOR ####################
+private:
+	VolumeIPFBinaryFile(const VolumeIPFBinaryFile&);
+	VolumeIPFBinaryFile& operator=(const VolumeIPFBinaryFile&);
+
+	//#################### PUBLIC METHODS ####################
+public:
+	BranchLayer_Ptr branch_layer(int index) const;
+	int highest_layer() const;
+	static bool is_binary_file(const std::string& filename);
+	LeafLayer_Ptr leaf_layer() const;
+	static void save(const std::string& filename, const VolumeIPF_CPtr& volumeIPF);
+	VolumeIPF_Ptr volume_ipf() const;
+	const itk::Size<3>& volume_size() const;
+
+	//#################### PRIVATE METHODS ####################
+private:
+	void check_range(boost::uint64_t offset, boost::uint64_t length) const;
+	std::vector<bool> layer_nodes(int index) const;
+	BranchLayer_Ptr load_branch_layer(int index) const;
+	LeafLayer_Ptr load_leaf_layer() const;
+};
+
+}
+
+#endif
@@ -9,23 +9,47 @@
 
 #include <common/exceptions/Exception.h>
 #include <common/io/sections/VolumeIPFSection.h>
+#include "VolumeIPFBinaryFile.h"
 
 namespace mp {
 
 //#################### LOADING METHODS ####################
 VolumeIPFFile::VolumeIPF_Ptr VolumeIPFFile::load(const std::string& filename)
 {
+	// Binary files are recognised by their magic number - anything else is assumed to be in the text format.
+	if(VolumeIPFBinaryFile::is_binary_file(filename))
+	{
+		VolumeIPFBinaryFile file(filename);
+		return file.volume_ipf();
+	}
+
 	std::ifstream is(filename.c_str(), std::ios_base::binary);
 	if(is.fail()) throw Exception("Could not open " + filename + " for reading");
 	return VolumeIPFSection::load(is);
 }
 
 //#################### SAVING METHODS ####################
-void VolumeIPFFile::save(const std::string& filename, const VolumeIPFFile::VolumeIPF_CPtr& volumeIPF)
+void VolumeIPFFile::save(const std::string& filename, const VolumeIPFFile::VolumeIPF_CPtr& volumeIPF, Format format)
 {
-	std::ofstream os(filename.c_str(), std::ios_base::binary);
-	if(os.fail()) throw Exception("Could not open " + filename + " for writing");
-	VolumeIPFSection::save(os, volumeIPF);
+	switch(format)
+	{
+		case FORMAT_BINARY:
+		{
+			VolumeIPFBinaryFile::save(filename, volumeIPF);
+			break;
+		}
+		case FORMAT_TEXT:
+		{
+			std::ofstream os(filename.c_str(), std::ios_base::binary);
+			if(os.fail()) throw Exception("Could not open " + filename + " for writing");
+			VolumeIPFSection::save(os, volumeIPF);
+			break;
+		}
+		default:
+		{
+			throw Exception("Unknown volume IPF file format");		// this should never happen
+		}
+	}
 }
 
 }
@@ -19,11 +19,24 @@ struct VolumeIPFFile
 	typedef boost::shared_ptr<VolumeIPFT> VolumeIPF_Ptr;
 	typedef boost::shared_ptr<const VolumeIPFT> VolumeIPF_CPtr;
 
+	//#################### ENUMERATIONS ####################
+	enum Format
+	{
+		FORMAT_BINARY,	// the memory-mappable binary format (see VolumeIPFBinaryFile)
+		FORMAT_TEXT		// the original line-based text format (see VolumeIPFSection)
+	};
+
 	//#################### LOADING METHODS ####################
+	/**
+	@brief	Loads a volume IPF from a file in either format.
+
+	Every layer is loaded before this returns, even from a binary file: clients that only need some of the layers
+	of a binary file should use VolumeIPFBinaryFile directly, which materialises its layers on demand.
+	*/
 	static VolumeIPF_Ptr load(const std::string& filename);
 
 	//#################### SAVING METHODS ####################
-	static void save(const std::string& filename, const VolumeIPF_CPtr& volumeIPF);
+	static void save(const std::string& filename, const VolumeIPF_CPtr& volumeIPF, Format format = FORMAT_BINARY);
 };
 
 }
@@ -1,6 +1,7 @@
 /***
  * millipede: CompositeJob.cpp
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #include "CompositeJob.h"
@@ -72,10 +73,20 @@ void CompositeJob::execute()
 			m_currentJob = m_jobs[i].first;
 		}
 
+		// If the composite job was aborted before the pointer was set, the abort will not have reached the sub-job,
+		// so stop here rather than waiting for a sub-job that may never be run.
+		if(is_aborted())
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+			m_currentJob.reset();
+			break;
+		}
+
 		if(m_jobs[i].second) main_thread_job_queue()->queue_job(m_currentJob);
-		else m_currentJob->execute();
+		else m_currentJob->execute_and_signal();
 
-		while(!m_currentJob->is_aborted() && !m_currentJob->is_finished());
+		// Sleep until the sub-job has either been run to completion or aborted.
+		m_currentJob->wait_until_stopped();
 
 		if(m_currentJob->is_finished())
 		{
@@ -1,6 +1,7 @@
 /***
  * millipede: Job.cpp
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #include "Job.h"
@@ -13,7 +14,7 @@ namespace mp {
 
 //#################### CONSTRUCTORS ####################
 Job::Job()
-:	m_aborted(false), m_mainThreadJobQueue(new MainThreadJobQueue)
+:	m_aborted(false), m_mainThreadJobQueue(new MainThreadJobQueue), m_stopped(false)
 {}
 
 //#################### DESTRUCTOR ####################
@@ -23,8 +24,40 @@ Job::~Job()
 //#################### PUBLIC METHODS ####################
 void Job::abort()
 {
-	boost::mutex::scoped_lock lock(m_mutex);
-	m_aborted = true;
+	{
+		boost::mutex::scoped_lock lock(m_stateMutex);
+		m_aborted = true;
+	}
+	notify_state_changed();
+}
+
+void Job::execute_and_signal()
+{
+	// Note:	Any exception thrown by execute() is propagated to the caller, after the job has been marked as stopped.
+	{
+		boost::mutex::scoped_lock lock(m_stateMutex);
+		m_stopped = false;
+	}
+
+	try
+	{
+		execute();
+	}
+	catch(...)
+	{
+		{
+			boost::mutex::scoped_lock lock(m_stateMutex);
+			m_stopped = true;
+		}
+		notify_state_changed();
+		throw;
+	}
+
+	{
+		boost::mutex::scoped_lock lock(m_stateMutex);
+		m_stopped = true;
+	}
+	notify_state_changed();
 }
 
 boost::shared_ptr<boost::thread> Job::execute_in_thread(const boost::shared_ptr<Job>& job)
@@ -36,17 +69,24 @@ void Job::execute_managed(const boost::shared_ptr<Job>& job)
 {
 	execute_in_thread(job);
 
+	// Sleep until either a main-thread job is queued (in which case, run it) or the job stops running.
 	MainThreadJobQueue_Ptr mtjq = job->main_thread_job_queue();
-	while(!job->is_finished())
+	while(mtjq->wait_for_jobs(*job))
 	{
-		if(job->is_aborted()) break;
-		if(mtjq->has_jobs()) mtjq->run_next_job();
+		mtjq->run_next_job();
 	}
 }
 
+bool Job::has_stopped() const
+{
+	// A job has stopped if it has been aborted or if a call to execute_and_signal() has returned.
+	boost::mutex::scoped_lock lock(m_stateMutex);
+	return m_stopped || m_aborted;
+}
+
 bool Job::is_aborted() const
 {
-	boost::mutex::scoped_lock lock(m_mutex);
+	boost::mutex::scoped_lock lock(m_stateMutex);
 	return m_aborted;
 }
 
@@ -65,6 +105,23 @@ void Job::set_main_thread_job_queue(const MainThreadJobQueue_Ptr& mainThreadJobQ
 	m_mainThreadJobQueue = mainThreadJobQueue;
 }
 
+void Job::wait_until_stopped() const
+{
+	boost::mutex::scoped_lock lock(m_stateMutex);
+	while(!m_stopped && !m_aborted) m_stateChanged.wait(lock);
+}
+
+bool Job::wait_until_stopped(int milliseconds) const
+{
+	boost::system_time timeout = boost::get_system_time() + boost::posix_time::milliseconds(milliseconds);
+	boost::mutex::scoped_lock lock(m_stateMutex);
+	while(!m_stopped && !m_aborted)
+	{
+		if(!m_stateChanged.timed_wait(lock, timeout)) return m_stopped || m_aborted;
+	}
+	return true;
+}
+
 //#################### PROTECTED METHODS ####################
 void Job::set_status(const std::string& status)
 {
@@ -73,11 +130,20 @@ void Job::set_status(const std::string& status)
 }
 
 //#################### PRIVATE METHODS ####################
+void Job::notify_state_changed()
+{
+	m_stateChanged.notify_all();
+
+	// Wake up anyone waiting on the main thread job queue for this job to stop (see MainThreadJobQueue::wait_for_jobs()).
+	MainThreadJobQueue_Ptr mtjq = m_mainThreadJobQueue;
+	if(mtjq) mtjq->wake_waiters();
+}
+
 void Job::safe_job_executor(const boost::shared_ptr<Job>& job)
 {
 	try
 	{
-		job->execute();
+		job->execute_and_signal();
 	}
 	catch(std::exception& e)
 	{
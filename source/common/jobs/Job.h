@@ -1,6 +1,7 @@
 /***
  * millipede: Job.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_JOB
@@ -10,6 +11,7 @@
 
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 
 namespace mp {
@@ -23,6 +25,9 @@ class Job
 private:
 	bool m_aborted;
 	MainThreadJobQueue_Ptr m_mainThreadJobQueue;
+	mutable boost::condition_variable m_stateChanged;	// signalled when the job is aborted or stops running
+	mutable boost::mutex m_stateMutex;					// protects m_aborted and m_stopped
+	bool m_stopped;
 
 	//#################### PROTECTED VARIABLES ####################
 protected:
@@ -47,12 +52,16 @@ public:
 	//#################### PUBLIC METHODS ####################
 public:
 	virtual void abort();
+	void execute_and_signal();
 	static boost::shared_ptr<boost::thread> execute_in_thread(const boost::shared_ptr<Job>& job);
 	static void execute_managed(const boost::shared_ptr<Job>& job);
+	bool has_stopped() const;
 	bool is_aborted() const;
 	bool is_finished() const;
 	MainThreadJobQueue_Ptr main_thread_job_queue();
 	virtual void set_main_thread_job_queue(const MainThreadJobQueue_Ptr& mainThreadJobQueue);
+	void wait_until_stopped() const;
+	bool wait_until_stopped(int milliseconds) const;
 
 	//#################### PROTECTED METHODS ####################
 protected:
@@ -60,6 +69,7 @@ protected:
 
 	//#################### PRIVATE METHODS ####################
 private:
+	void notify_state_changed();
 	static void safe_job_executor(const boost::shared_ptr<Job>& job);
 };
 
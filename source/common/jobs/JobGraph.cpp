@@ -0,0 +1,236 @@
+/***
+ * millipede: JobGraph.cpp
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#include "JobGraph.h"
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+#include <common/exceptions/Exception.h>
+#include <common/io/util/OSSWrapper.h>
+#include "MainThreadJobQueue.h"
+
+namespace mp {
+
+//#################### CONSTRUCTORS ####################
+JobGraph::JobGraph(int threadCount)
+:	m_completedCount(0), m_length(0), m_runningCount(0), m_threadCount(std::max(threadCount, 1))
+{}
+
+//#################### PUBLIC METHODS ####################
+void JobGraph::abort()
+{
+	Job::abort();
+
+	// Note:	The graph is fixed once execution starts, so it is safe to iterate over it without holding the mutex.
+	//			Aborting a sub-job that has not yet started (or that has already finished) is harmless.
+	for(size_t i=0, size=m_nodes.size(); i<size; ++i)
+	{
+		m_nodes[i].job->abort();
+	}
+
+	// Wake up any idle workers so that they notice the abort. (Acquiring the mutex first ensures that no worker
+	// can be between checking whether the graph has been aborted and starting to wait.)
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_conditionChanged.notify_all();
+}
+
+void JobGraph::add_dependency(int prerequisite, int dependant)
+{
+	int size = static_cast<int>(m_nodes.size());
+	if(prerequisite < 0 || dependant >= size || prerequisite >= dependant)
+	{
+		throw Exception(OSSWrapper() << "Bad dependency: " << prerequisite << " -> " << dependant);
+	}
+
+	m_nodes[prerequisite].successors.push_back(dependant);
+	++m_nodes[dependant].prerequisiteCount;
+}
+
+int JobGraph::add_main_thread_subjob(Job *job)
+{
+	return add_main_thread_subjob(Job_Ptr(job));
+}
+
+int JobGraph::add_main_thread_subjob(const Job_Ptr& job)
+{
+	return add_node(job, true);
+}
+
+int JobGraph::add_subjob(Job *job)
+{
+	return add_subjob(Job_Ptr(job));
+}
+
+int JobGraph::add_subjob(const Job_Ptr& job)
+{
+	return add_node(job, false);
+}
+
+bool JobGraph::empty() const
+{
+	return m_nodes.empty();
+}
+
+void JobGraph::execute()
+{
+	{
+		boost::mutex::scoped_lock lock(m_mutex);
+		m_completedCount = 0;
+		m_failure.reset();
+		m_readyNodes.clear();
+		m_runningCount = 0;
+		m_pendingPrerequisites.resize(m_nodes.size());
+		for(size_t i=0, size=m_nodes.size(); i<size; ++i)
+		{
+			m_pendingPrerequisites[i] = m_nodes[i].prerequisiteCount;
+			if(m_pendingPrerequisites[i] == 0) m_readyNodes.push_back(static_cast<int>(i));
+		}
+	}
+
+	// Run the sub-jobs on a pool of worker threads. The current thread acts as one of the workers,
+	// so that a thread count of 1 runs everything sequentially without spawning any extra threads.
+	int threadCount = std::min(m_threadCount, static_cast<int>(m_nodes.size()));
+	boost::thread_group workers;
+	for(int i=1; i<threadCount; ++i)
+	{
+		workers.create_thread(boost::bind(&JobGraph::run_worker, this));
+	}
+	run_worker();
+	workers.join_all();
+
+	if(m_failure) throw Exception(*m_failure);
+}
+
+int JobGraph::length() const
+{
+	return m_length;
+}
+
+int JobGraph::progress() const
+{
+	// Note:	Each sub-job's progress is individually thread-safe, so there is no need to lock the mutex here.
+	int progress = 0;
+	for(size_t i=0, size=m_nodes.size(); i<size; ++i)
+	{
+		progress += m_nodes[i].job->progress();
+	}
+	return progress;
+}
+
+void JobGraph::set_main_thread_job_queue(const MainThreadJobQueue_Ptr& mainThreadJobQueue)
+{
+	Job::set_main_thread_job_queue(mainThreadJobQueue);
+	for(size_t i=0, size=m_nodes.size(); i<size; ++i)
+	{
+		m_nodes[i].job->set_main_thread_job_queue(mainThreadJobQueue);
+	}
+}
+
+std::string JobGraph::status() const
+{
+	// Report the status of the earliest sub-job that is still running (if any).
+	boost::mutex::scoped_lock lock(m_mutex);
+	for(size_t i=0, size=m_nodes.size(); i<size; ++i)
+	{
+		if(m_nodes[i].running && !m_nodes[i].job->is_aborted()) return m_nodes[i].job->status();
+	}
+	return m_status;
+}
+
+//#################### PRIVATE METHODS ####################
+int JobGraph::add_node(const Job_Ptr& job, bool mainThread)
+{
+	Node node;
+	node.job = job;
+	node.mainThread = mainThread;
+	node.prerequisiteCount = 0;
+	node.running = false;
+	m_nodes.push_back(node);
+
+	m_length += job->length();
+	job->set_main_thread_job_queue(main_thread_job_queue());
+	return static_cast<int>(m_nodes.size()) - 1;
+}
+
+void JobGraph::run_node(int n)
+{
+	const Job_Ptr& job = m_nodes[n].job;
+	if(is_aborted())
+	{
+		job->abort();
+		return;
+	}
+
+	try
+	{
+		if(m_nodes[n].mainThread)
+		{
+			main_thread_job_queue()->queue_job(job);
+			job->wait_until_stopped();
+		}
+		else job->execute_and_signal();
+	}
+	catch(std::exception& e)
+	{
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+			if(!m_failure) m_failure = std::string(e.what());
+		}
+		for(size_t i=0, size=m_nodes.size(); i<size; ++i) m_nodes[i].job->abort();
+		return;
+	}
+
+	if(!job->is_finished() && !is_aborted())
+	{
+		// The sub-job aborted itself (e.g. because it failed), so the sub-jobs that depend on it cannot be run.
+		set_status(job->status());
+		abort();
+	}
+}
+
+void JobGraph::run_worker()
+{
+	int size = static_cast<int>(m_nodes.size());
+
+	boost::mutex::scoped_lock lock(m_mutex);
+	for(;;)
+	{
+		bool stopping = m_failure || is_aborted();
+		if(m_completedCount == size || (stopping && m_runningCount == 0)) break;
+
+		if(stopping || m_readyNodes.empty())
+		{
+			// Sleep until another worker finishes a sub-job (or the graph is aborted).
+			m_conditionChanged.wait(lock);
+			continue;
+		}
+
+		int n = m_readyNodes.front();
+		m_readyNodes.pop_front();
+		m_nodes[n].running = true;
+		++m_runningCount;
+
+		lock.unlock();
+		run_node(n);
+		lock.lock();
+
+		m_nodes[n].running = false;
+		--m_runningCount;
+		if(m_nodes[n].job->is_finished())
+		{
+			++m_completedCount;
+			const std::vector<int>& successors = m_nodes[n].successors;
+			for(std::vector<int>::const_iterator it=successors.begin(), iend=successors.end(); it!=iend; ++it)
+			{
+				if(--m_pendingPrerequisites[*it] == 0) m_readyNodes.push_back(*it);
+			}
+		}
+		m_conditionChanged.notify_all();
+	}
+}
+
+}
@@ -0,0 +1,91 @@
+/***
+ * millipede: JobGraph.h
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#ifndef H_MILLIPEDE_JOBGRAPH
+#define H_MILLIPEDE_JOBGRAPH
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "Job.h"
+
+namespace mp {
+
+/**
+@brief	A JobGraph runs a directed acyclic graph of sub-jobs on a fixed-size pool of worker threads.
+
+Each sub-job may only start once all of its prerequisites (specified using add_dependency()) have finished; sub-jobs
+that do not depend on each other may run concurrently. The dependencies are intended to mirror the data hooks that
+connect the sub-jobs: if sub-job B's input hook is connected to sub-job A's output hook, then A should be a prerequisite
+of B. Sub-jobs must be added in an order that respects their dependencies (i.e. prerequisites must be added before the
+sub-jobs that depend on them), which guarantees that the graph is acyclic.
+
+Main-thread sub-jobs are queued on the main thread job queue once they become ready; the worker that queued one sleeps
+until it has been run. As with CompositeJob, a graph containing main-thread sub-jobs must not itself be run in the thread
+that services the main thread job queue.
+
+If any sub-job throws, the remaining sub-jobs are aborted and the exception is re-thrown (as an Exception) from execute()
+once all of the workers have finished. If a sub-job aborts itself, the graph is aborted.
+*/
+class JobGraph : public virtual Job
+{
+	//#################### NESTED CLASSES ####################
+private:
+	struct Node
+	{
+		Job_Ptr job;
+		bool mainThread;
+		int prerequisiteCount;
+		bool running;
+		std::vector<int> successors;
+	};
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	int m_completedCount;
+	boost::condition_variable m_conditionChanged;	// signalled when a sub-job finishes or the graph is aborted
+	boost::optional<std::string> m_failure;
+	int m_length;
+	std::vector<Node> m_nodes;
+	std::vector<int> m_pendingPrerequisites;		// the number of unfinished prerequisites of each sub-job
+	std::deque<int> m_readyNodes;
+	int m_runningCount;
+	int m_threadCount;
+
+	//#################### CONSTRUCTORS ####################
+public:
+	explicit JobGraph(int threadCount);
+
+	//#################### PUBLIC METHODS ####################
+public:
+	void abort();
+	void add_dependency(int prerequisite, int dependant);
+	int add_main_thread_subjob(Job *job);
+	int add_main_thread_subjob(const Job_Ptr& job);
+	int add_subjob(Job *job);
+	int add_subjob(const Job_Ptr& job);
+	bool empty() const;
+	void execute();
+	int length() const;
+	int progress() const;
+	void set_main_thread_job_queue(const MainThreadJobQueue_Ptr& mainThreadJobQueue);
+	std::string status() const;
+
+	//#################### PRIVATE METHODS ####################
+private:
+	int add_node(const Job_Ptr& job, bool mainThread);
+	void run_node(int n);
+	void run_worker();
+};
+
+//#################### TYPEDEFS ####################
+typedef boost::shared_ptr<JobGraph> JobGraph_Ptr;
+
+}
+
+#endif
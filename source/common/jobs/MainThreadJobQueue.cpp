@@ -1,6 +1,7 @@
 /***
  * millipede: MainThreadJobQueue.cpp
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #include "MainThreadJobQueue.h"
@@ -26,8 +27,11 @@ void MainThreadJobQueue::queue_job(Job *job)
 
 void MainThreadJobQueue::queue_job(const Job_Ptr& job)
 {
-	boost::mutex::scoped_lock lock(m_mutex);
-	m_jobs.push(job);
+	{
+		boost::mutex::scoped_lock lock(m_mutex);
+		m_jobs.push(job);
+	}
+	m_jobsChanged.notify_all();
 }
 
 void MainThreadJobQueue::run_next_job()
@@ -45,7 +49,41 @@ void MainThreadJobQueue::run_next_job()
 		}
 	}
 
-	if(job) job->execute();
+	if(job) job->execute_and_signal();
+}
+
+bool MainThreadJobQueue::wait_for_jobs(const Job& job)
+{
+	// Block until either there is a job to run (in which case return true) or the specified job has stopped (in which case
+	// return false). Note that jobs call wake_waiters() when they stop, so the job's state cannot change unnoticed.
+	boost::mutex::scoped_lock lock(m_mutex);
+	for(;;)
+	{
+		if(job.has_stopped()) return false;
+		if(!m_jobs.empty()) return true;
+		m_jobsChanged.wait(lock);
+	}
+}
+
+bool MainThreadJobQueue::wait_for_jobs(const Job& job, int milliseconds)
+{
+	// As above, but give up (and return false) if there is still nothing to run once the specified time has elapsed.
+	boost::system_time timeout = boost::get_system_time() + boost::posix_time::milliseconds(milliseconds);
+	boost::mutex::scoped_lock lock(m_mutex);
+	for(;;)
+	{
+		if(job.has_stopped()) return false;
+		if(!m_jobs.empty()) return true;
+		if(!m_jobsChanged.timed_wait(lock, timeout)) return !m_jobs.empty() && !job.has_stopped();
+	}
+}
+
+void MainThreadJobQueue::wake_waiters()
+{
+	// Acquiring the mutex ensures that any thread in wait_for_jobs() is either actually waiting (and will be woken)
+	// or has not yet checked the state of the job it is waiting for.
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_jobsChanged.notify_all();
 }
 
 }
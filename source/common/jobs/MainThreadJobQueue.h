@@ -1,6 +1,7 @@
 /***
  * millipede: MainThreadJobQueue.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_MAINTHREADJOBQUEUE
@@ -8,6 +9,7 @@
 
 #include <queue>
 
+#include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 
 #include "Job.h"
@@ -18,6 +20,7 @@ class MainThreadJobQueue
 {
 	//#################### PRIVATE VARIABLES ####################
 private:
+	boost::condition_variable m_jobsChanged;	// signalled when a job is queued (or when a job someone may be waiting for stops)
 	std::queue<Job_Ptr> m_jobs;
 	mutable boost::mutex m_mutex;
 
@@ -28,6 +31,9 @@ public:
 	void queue_job(Job *job);
 	void queue_job(const Job_Ptr& job);
 	void run_next_job();
+	bool wait_for_jobs(const Job& job);
+	bool wait_for_jobs(const Job& job, int milliseconds);
+	void wake_waiters();
 };
 
 }
@@ -0,0 +1,74 @@
+/***
+ * millipede: ParallelJob.cpp
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#include "ParallelJob.h"
+
+#include <algorithm>
+
+#include "SimpleJob.h"
+
+namespace {
+
+using namespace mp;
+
+class SlabJob : public SimpleJob
+{
+private:
+	boost::function<void(int,int)> m_processSlab;
+	int m_sliceBegin, m_sliceEnd;
+public:
+	SlabJob(const boost::function<void(int,int)>& processSlab, int sliceBegin, int sliceEnd)
+	:	m_processSlab(processSlab), m_sliceBegin(sliceBegin), m_sliceEnd(sliceEnd)
+	{}
+
+	int length() const
+	{
+		return 1;
+	}
+
+private:
+	void execute_impl()
+	{
+		m_processSlab(m_sliceBegin, m_sliceEnd);
+	}
+};
+
+}
+
+namespace mp {
+
+//#################### CONSTRUCTORS ####################
+ParallelJob::ParallelJob(int threadCount)
+:	JobGraph(threadCount)
+{}
+
+//#################### PUBLIC METHODS ####################
+int ParallelJob::default_thread_count()
+{
+	// Note:	hardware_concurrency() returns 0 if the information is unavailable, in which case we fall back to a single thread.
+	int threadCount = static_cast<int>(boost::thread::hardware_concurrency());
+	return threadCount > 0 ? threadCount : 1;
+}
+
+void ParallelJob::run_slabs(int sliceCount, const boost::function<void(int,int)>& processSlab, int threadCount)
+{
+	if(sliceCount <= 0) return;
+	if(threadCount <= 1)
+	{
+		processSlab(0, sliceCount);
+		return;
+	}
+
+	const int SLABS_PER_THREAD = 4;
+	int slabCount = std::min(sliceCount, threadCount * SLABS_PER_THREAD);
+	ParallelJob job(threadCount);
+	for(int i=0; i<slabCount; ++i)
+	{
+		job.add_subjob(new SlabJob(processSlab, i * sliceCount / slabCount, (i+1) * sliceCount / slabCount));
+	}
+	job.execute();
+}
+
+}
@@ -0,0 +1,60 @@
+/***
+ * millipede: ParallelJob.h
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#ifndef H_MILLIPEDE_PARALLELJOB
+#define H_MILLIPEDE_PARALLELJOB
+
+#include <boost/function.hpp>
+
+#include "JobGraph.h"
+
+namespace mp {
+
+/**
+@brief	A ParallelJob runs a collection of independent sub-jobs concurrently on a fixed-size pool of worker threads.
+
+It is simply a JobGraph without any dependencies: unlike a CompositeJob, the sub-jobs of a ParallelJob may be executed
+in any order (and simultaneously), so they must not depend on each other's results. If any sub-job throws, the remaining
+sub-jobs are aborted and the exception is re-thrown (as an Exception) from execute() once all of the workers have finished.
+
+It also provides run_slabs(), a convenience for data-parallel loops over the slices of a volume (e.g. creating an image
+by writing directly into disjoint z-slabs of its buffer).
+*/
+class ParallelJob : public JobGraph
+{
+	//#################### CONSTRUCTORS ####################
+public:
+	explicit ParallelJob(int threadCount);
+
+	//#################### PUBLIC METHODS ####################
+public:
+	/**
+	@brief	Returns the number of threads to use for parallel jobs by default (the number of hardware threads, if known).
+
+	@return	As described
+	*/
+	static int default_thread_count();
+
+	/**
+	@brief	Splits the range [0,sliceCount) into contiguous slabs and processes them concurrently.
+
+	The slabs are processed by calling processSlab(sliceBegin, sliceEnd) for each one, using at most threadCount threads
+	(the calling thread is one of them). There are a few more slabs than threads, to even out the load.
+
+	@param[in]	sliceCount		The number of slices
+	@param[in]	processSlab		The function to call to process the slices in [sliceBegin,sliceEnd)
+	@param[in]	threadCount		The maximum number of threads to use
+	@throw Exception
+		-	If processSlab throws for any of the slabs
+	*/
+	static void run_slabs(int sliceCount, const boost::function<void(int,int)>& processSlab, int threadCount = default_thread_count());
+};
+
+//#################### TYPEDEFS ####################
+typedef boost::shared_ptr<ParallelJob> ParallelJob_Ptr;
+
+}
+
+#endif
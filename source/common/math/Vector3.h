@@ -10,6 +10,8 @@
 #include <cmath>
 #include <iostream>
 
+#include <boost/functional/hash.hpp>
+
 #include <common/exceptions/Exception.h>
 #include "MathConstants.h"
 #include "NumericUtil.h"
@@ -328,6 +330,20 @@ Vector3<T> operator/(const Vector3<T>& v, double factor)
 	return copy;
 }
 
+template <typename T>
+bool operator==(const Vector3<T>& lhs, const Vector3<T>& rhs)
+{
+	// Note: This operator should be used cautiously when T is not an integral type.
+	return lhs.x == rhs.x && lhs.y == rhs.y && lhs.z == rhs.z;
+}
+
+template <typename T>
+bool operator!=(const Vector3<T>& lhs, const Vector3<T>& rhs)
+{
+	// Note: This operator should be used cautiously when T is not an integral type.
+	return !(lhs == rhs);
+}
+
 template <typename T>
 bool operator<(const Vector3<T>& lhs, const Vector3<T>& rhs)
 {
@@ -351,6 +367,17 @@ std::ostream& operator<<(std::ostream& os, const Vector3<T>& rhs)
 	return os;
 }
 
+template <typename T>
+std::size_t hash_value(const Vector3<T>& v)
+{
+	// Note: This makes it possible to use vectors as keys in hashed containers such as boost::unordered_map.
+	std::size_t seed = 0;
+	boost::hash_combine(seed, v.x);
+	boost::hash_combine(seed, v.y);
+	boost::hash_combine(seed, v.z);
+	return seed;
+}
+
 //#################### TYPEDEFS ####################
 typedef Vector3<double> Vector3d;
 typedef Vector3<int> Vector3i;
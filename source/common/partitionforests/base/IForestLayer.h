@@ -1,6 +1,7 @@
 /***
  * millipede: IForestLayer.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_IFORESTLAYER
@@ -33,6 +34,63 @@ public:
 		virtual void set_parent(int parent) = 0;
 	};
 
+	/**
+	@brief	An EdgeBlockVisitor is passed the edges of a layer a block at a time by for_each_edge_block().
+	*/
+	class EdgeBlockVisitor
+	{
+	public:
+		virtual ~EdgeBlockVisitor() {}
+		virtual void visit_edges(const std::vector<Edge>& edges) = 0;
+	};
+
+	/**
+	@brief	A NodeBlockVisitor is passed the nodes of a layer (and their parents) a block at a time by for_each_node_block().
+	*/
+	class NodeBlockVisitor
+	{
+	public:
+		virtual ~NodeBlockVisitor() {}
+		virtual void visit_nodes(const std::vector<int>& nodes, const std::vector<int>& parents) = 0;
+	};
+
+private:
+	template <typename Func>
+	class EdgeBlockVisitorT : public EdgeBlockVisitor
+	{
+	private:
+		Func& m_f;
+	public:
+		explicit EdgeBlockVisitorT(Func& f)
+		:	m_f(f)
+		{}
+
+		void visit_edges(const std::vector<Edge>& edges)
+		{
+			for(typename std::vector<Edge>::const_iterator it=edges.begin(), iend=edges.end(); it!=iend; ++it) m_f(*it);
+		}
+	};
+
+	template <typename Func>
+	class NodeBlockVisitorT : public NodeBlockVisitor
+	{
+	private:
+		Func& m_f;
+	public:
+		explicit NodeBlockVisitorT(Func& f)
+		:	m_f(f)
+		{}
+
+		void visit_nodes(const std::vector<int>& nodes, const std::vector<int>& parents)
+		{
+			for(size_t i=0, size=nodes.size(); i<size; ++i) m_f(nodes[i], parents[i]);
+		}
+	};
+
+	//#################### CONSTANTS ####################
+public:
+	enum { BLOCK_SIZE = 1024 };		// the maximum number of edges or nodes passed to a block visitor at once
+
 	//#################### ITERATORS ####################
 protected:
 	class EdgeConstIteratorImplBase
@@ -129,6 +187,29 @@ public:
 	virtual EdgeWeight edge_weight(int u, int v) const = 0;
 	virtual EdgeConstIterator edges_cbegin() const = 0;
 	virtual EdgeConstIterator edges_cend() const = 0;
+
+	/**
+	@brief	Passes all the edges of the layer to the specified visitor, in the same order as edges_cbegin() and edges_cend()
+			would visit them, in blocks of at most BLOCK_SIZE edges.
+
+	This makes it possible to traverse the edges of a layer whose type is not known statically with only one virtual call per
+	block (rather than several per edge, as with an EdgeConstIterator).
+
+	@param[in]	block		A caller-provided array in which to store each block of edges (its contents are overwritten)
+	@param[in]	visitor		The visitor
+	*/
+	virtual void for_each_edge_block(std::vector<Edge>& block, EdgeBlockVisitor& visitor) const = 0;
+
+	/**
+	@brief	Passes all the nodes of the layer (and their parents) to the specified visitor, in ascending order of index,
+			in blocks of at most BLOCK_SIZE nodes.
+
+	@param[in]	nodes		A caller-provided array in which to store the indices of each block of nodes (its contents are overwritten)
+	@param[in]	parents		A caller-provided array in which to store the parents of each block of nodes (its contents are overwritten)
+	@param[in]	visitor		The visitor
+	*/
+	virtual void for_each_node_block(std::vector<int>& nodes, std::vector<int>& parents, NodeBlockVisitor& visitor) const = 0;
+
 	virtual bool has_edge(int u, int v) const = 0;
 	virtual bool has_node(int n) const = 0;
 	virtual int node_count() const = 0;
@@ -139,6 +220,43 @@ public:
 	virtual NodeConstIterator nodes_cend() const = 0;
 	virtual NodeIterator nodes_end() = 0;
 	virtual void set_node_parent(int n, int parent) = 0;
+
+	//#################### PUBLIC METHODS ####################
+public:
+	/**
+	@brief	Calls f(e) for each edge e in the layer (in the same order as edges_cbegin() and edges_cend() would visit them).
+
+	Layer implementations hide this with a native version that avoids making virtual calls for each edge; this version is
+	used when the type of the layer is not known statically, and visits the edges in blocks using for_each_edge_block().
+
+	@param[in]	f	The function object to call
+	@return	The function object, after it has been called for all of the edges
+	*/
+	template <typename Func>
+	Func for_each_edge(Func f) const
+	{
+		std::vector<Edge> block;
+		EdgeBlockVisitorT<Func> visitor(f);
+		for_each_edge_block(block, visitor);
+		return f;
+	}
+
+	/**
+	@brief	Calls f(n, parent) for each node n in the layer, in ascending order of index.
+
+	As with for_each_edge(), layer implementations hide this with a native version that avoids making virtual calls for each node.
+
+	@param[in]	f	The function object to call
+	@return	The function object, after it has been called for all of the nodes
+	*/
+	template <typename Func>
+	Func for_each_node(Func f) const
+	{
+		std::vector<int> nodes, parents;
+		NodeBlockVisitorT<Func> visitor(f);
+		for_each_node_block(nodes, parents, visitor);
+		return f;
+	}
 };
 
 }
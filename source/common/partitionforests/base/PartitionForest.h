@@ -7,10 +7,13 @@
 #ifndef H_MILLIPEDE_PARTITIONFOREST
 #define H_MILLIPEDE_PARTITIONFOREST
 
+#include <algorithm>
 #include <climits>
 #include <deque>
+#include <map>
 #include <queue>
 #include <set>
+#include <utility>
 
 #include <boost/bind.hpp>
 #include <boost/optional.hpp>
@@ -22,6 +25,7 @@
 #include <common/exceptions/Exception.h>
 #include <common/io/util/OSSWrapper.h>
 #include <common/listeners/CompositeListenerBase.h>
+#include <common/util/MemoryUtil.h>
 #include "IForestLayer.h"
 #include "PFNodeID.h"
 
@@ -161,14 +165,54 @@ private:
 	{
 		PartitionForest *m_base;
 		int m_indexD;
-		BranchLayer_Ptr m_layerD;
+		std::vector<std::pair<int,int> > m_forestLinks;
+		std::vector<BranchProperties> m_nodeProperties;
 
 		DeleteLayerCommand(PartitionForest *base, int indexD)
 		:	Command("Delete Layer"), m_base(base), m_indexD(indexD)
 		{}
 
-		void execute()	{ m_layerD = m_base->delete_layer_impl(m_indexD); }
-		void undo()		{ m_base->undelete_layer_impl(m_indexD, m_layerD); }
+		void execute()
+		{
+			// Rather than keeping the deleted layer itself (which could be very large), record only the links between it and
+			// the layer below, and the properties of its nodes: the rest of the layer can be rebuilt from these and the layer
+			// below when the command is undone. The properties are kept (rather than recombined from the layer below) because
+			// they may have been derived incrementally, in which case recombining them would not give exactly the same values.
+			m_forestLinks = m_base->forest_links_below(m_indexD);
+			m_nodeProperties = m_base->layer_node_properties(m_indexD);
+			m_base->delete_layer_impl(m_indexD);
+		}
+
+		size_t memory_usage() const
+		{
+			return sizeof(*this) + MemoryUtil::footprint(m_forestLinks) + MemoryUtil::footprint(m_nodeProperties);
+		}
+
+		void undo()
+		{
+			m_base->undelete_layer_impl(m_indexD, m_base->rebuild_layer(m_indexD, m_forestLinks, &m_nodeProperties));
+
+			// The links and properties will be recorded again if the command is redone.
+			std::vector<std::pair<int,int> >().swap(m_forestLinks);
+			std::vector<BranchProperties>().swap(m_nodeProperties);
+		}
+	};
+
+	struct InsertAboveLayerCommand : Command
+	{
+		PartitionForest *m_base;
+		int m_indexB;
+		std::vector<std::pair<int,int> > m_forestLinks;
+
+		InsertAboveLayerCommand(PartitionForest *base, int indexB, std::vector<std::pair<int,int> >& forestLinks)
+		:	Command("Insert Above Layer"), m_base(base), m_indexB(indexB)
+		{
+			m_forestLinks.swap(forestLinks);
+		}
+
+		void execute()				{ m_base->insert_layer_above_impl(m_indexB, m_forestLinks); }
+		size_t memory_usage() const	{ return sizeof(*this) + MemoryUtil::footprint(m_forestLinks); }
+		void undo()					{ m_base->delete_layer_impl(m_indexB + 1); }
 	};
 
 	struct MergeSiblingNodesCommand : Command
@@ -199,6 +243,7 @@ private:
 			m_result = m_base->merge_sibling_nodes_impl(m_nodes, depth());
 		}
 
+		size_t memory_usage() const		{ return sizeof(*this) + MemoryUtil::footprint(m_nodes) + MemoryUtil::footprint(m_splitGroups); }
 		const PFNodeID& result() const	{ return *m_result; }
 		void undo()						{ m_base->split_node_impl(*m_result, m_splitGroups, depth()); }
 	};
@@ -215,10 +260,103 @@ private:
 		{}
 
 		void execute()								{ m_result = m_base->split_node_impl(m_node, m_groups, depth()); }
+		size_t memory_usage() const					{ return sizeof(*this) + MemoryUtil::footprint(m_groups) + MemoryUtil::footprint(m_result); }
 		const std::set<PFNodeID>& result() const	{ return m_result; }
 		void undo()									{ m_base->merge_sibling_nodes_impl(m_result, depth()); }
 	};
 
+	//#################### EDGE AND NODE VISITORS ####################
+private:
+	/**
+	Adds an edge between the parents of the endpoints of each edge visited (if they are different) to the layer above,
+	keeping the smallest weight of any edge joining their children. The parents are looked up by index in a dense array.
+	*/
+	struct DenseParentEdgeAdder
+	{
+		BranchLayer *layerAbove;
+		const std::vector<int> *parents;
+
+		DenseParentEdgeAdder(BranchLayer *layerAbove_, const std::vector<int> *parents_)
+		:	layerAbove(layerAbove_), parents(parents_)
+		{}
+
+		void operator()(const Edge& e) const
+		{
+			int parentU = (*parents)[e.u], parentV = (*parents)[e.v];
+			if(parentU != parentV) layerAbove->update_edge_weight(parentU, parentV, e.weight);
+		}
+	};
+
+	/**
+	Adds a copy of each edge visited to a layer.
+	*/
+	struct EdgeCopier
+	{
+		BranchLayer *layer;
+
+		explicit EdgeCopier(BranchLayer *layer_)
+		:	layer(layer_)
+		{}
+
+		void operator()(const Edge& e) const
+		{
+			layer->set_edge_weight(e.u, e.v, e.weight);
+		}
+	};
+
+	/**
+	As DenseParentEdgeAdder, except that the parents are looked up in a sorted array of (child, parent) forest links.
+	*/
+	struct LinkedParentEdgeAdder
+	{
+		BranchLayer *layerAbove;
+		const std::vector<std::pair<int,int> > *forestLinks;
+
+		LinkedParentEdgeAdder(BranchLayer *layerAbove_, const std::vector<std::pair<int,int> > *forestLinks_)
+		:	layerAbove(layerAbove_), forestLinks(forestLinks_)
+		{}
+
+		void operator()(const Edge& e) const
+		{
+			int parentU = parent_in_links(*forestLinks, e.u), parentV = parent_in_links(*forestLinks, e.v);
+			if(parentU != parentV) layerAbove->update_edge_weight(parentU, parentV, e.weight);
+		}
+	};
+
+	/**
+	Records the (child, parent) forest link of each node visited.
+	*/
+	struct LinkRecorder
+	{
+		std::vector<std::pair<int,int> > *links;
+
+		explicit LinkRecorder(std::vector<std::pair<int,int> > *links_)
+		:	links(links_)
+		{}
+
+		void operator()(int n, int parent) const
+		{
+			links->push_back(std::make_pair(n, parent));
+		}
+	};
+
+	/**
+	Records the parent of each node visited in a dense array indexed by node.
+	*/
+	struct ParentRecorder
+	{
+		std::vector<int> *parents;
+
+		explicit ParentRecorder(std::vector<int> *parents_)
+		:	parents(parents_)
+		{}
+
+		void operator()(int n, int parent) const
+		{
+			(*parents)[n] = parent;
+		}
+	};
+
 	//#################### PRIVATE VARIABLES ####################
 private:
 	ICommandManager_Ptr m_commandManager;
@@ -409,17 +547,11 @@ public:
 			lowestBranchLayer->set_node_properties(parentIndex, leafLayer->combine_properties(group));
 		}
 
-		// Add the edges between adjacent lowest branch layer nodes.
-		for(typename LeafLayer::EdgeConstIterator it=leafLayer->edges_cbegin(), iend=leafLayer->edges_cend(); it!=iend; ++it)
-		{
-			Edge e = *it;
-			int parentU = leafLayer->node_parent(e.u);
-			int parentV = leafLayer->node_parent(e.v);
-			if(parentU != parentV)
-			{
-				lowestBranchLayer->update_edge_weight(parentU, parentV, e.weight);
-			}
-		}
+		// Add the edges between adjacent lowest branch layer nodes. To keep the pass over the leaf edges tight, the parents
+		// of the leaves are first gathered into a flat array.
+		std::vector<int> parents(leafLayer->node_count(), -1);
+		leafLayer->for_each_node(ParentRecorder(&parents));
+		leafLayer->for_each_edge(DenseParentEdgeAdder(lowestBranchLayer.get(), &parents));
 
 		return lowestBranchLayer;
 	}
@@ -740,7 +872,7 @@ public:
 		-	If the specified ID does not refer to a valid node
 	@return The properties of the leaf node, as described
 	*/
-	const LeafProperties& leaf_properties(int n) const
+	LeafProperties leaf_properties(int n) const
 	{
 		if(m_leafLayer->has_node(n)) return m_leafLayer->node_properties(n);
 		else throw Exception(OSSWrapper() << "Invalid leaf: " << n);
@@ -968,6 +1100,81 @@ public:
 		m_commandManager->execute(Command_Ptr(new DeleteLayerCommand(this, indexD)));
 	}
 
+	/**
+	@brief	Inserts a new layer into the partition forest (above the specified layer), whose nodes are formed by
+			grouping together the nodes of the specified layer.
+
+	This has the same effect as cloning the layer and then merging the nodes in each group, but the new layer is built
+	in one go: the properties of each new node are combined once, the edges of the new layer are found in a single pass
+	over those of the layer below, and listeners are alerted only once. From their point of view, the new layer is
+	indistinguishable from a deleted layer being restored, so they are alerted via layer_was_undeleted(). As with a merge,
+	each new node takes the index of the smallest node in its group.
+
+	@note	This method executes an InsertAboveLayerCommand (which can be undone, if an UndoableCommandManager
+			has been previously installed using set_command_manager()).
+
+	@param[in]	indexB				The index of the layer whose nodes are to be grouped
+	@param[in]	groups				The groups (any nodes of the layer that are not in a group are placed in groups of their own)
+	@param[in]	checkPreconditions	Whether or not the preconditions need to be explicitly checked (default: yes)
+	@pre
+		-	0 <= indexB <= highest_layer()
+		-	The groups are non-empty and pairwise disjoint
+		-	The nodes in each group are valid nodes of the layer, share a common parent and are connected
+	@post
+		-	The new layer will have been inserted into the partition forest as described
+		-	Listeners will have been alerted that this has happened
+	@throw Exception
+		-	If the preconditions are violated
+	*/
+	void insert_layer_above(int indexB, const std::vector<std::set<int> >& groups, CheckPreconditions checkPreconditions = CHECK_PRECONDITIONS)
+	{
+		if(checkPreconditions)
+		{
+			if(indexB < 0 || indexB > highest_layer())
+			{
+				throw Exception(OSSWrapper() << "Invalid layer: " << indexB);
+			}
+
+			std::set<int> seen;
+			for(size_t i=0, size=groups.size(); i<size; ++i)
+			{
+				const std::set<int>& group = groups[i];
+				if(group.empty()) throw Exception("Empty layer group");
+
+				// Note that checking the parents of the nodes also implicitly checks whether the nodes themselves are valid.
+				PFNodeID commonParent = parent_of(PFNodeID(indexB, *group.begin()));
+				for(std::set<int>::const_iterator jt=group.begin(), jend=group.end(); jt!=jend; ++jt)
+				{
+					if(parent_of(PFNodeID(indexB, *jt)) != commonParent) throw Exception("The nodes in a layer group are not siblings");
+					if(!seen.insert(*jt).second) throw Exception(OSSWrapper() << "Node " << *jt << " is in more than one layer group");
+				}
+
+				if(!are_connected(group, indexB)) throw Exception("A layer group would not be connected");
+			}
+		}
+
+		// Convert the groups into the (child, parent) forest links between the layer and the new layer.
+		std::vector<std::pair<int,int> > forestLinks;
+		IForestLayer_Ptr layerB = forest_layer(indexB);
+		forestLinks.reserve(layerB->node_count());
+		layerB->for_each_node(LinkRecorder(&forestLinks));
+		for(size_t i=0, size=forestLinks.size(); i<size; ++i)
+		{
+			forestLinks[i].second = forestLinks[i].first;
+		}
+		std::sort(forestLinks.begin(), forestLinks.end());
+		for(size_t i=0, size=groups.size(); i<size; ++i)
+		{
+			int parentIndex = *groups[i].begin();
+			for(std::set<int>::const_iterator jt=groups[i].begin(), jend=groups[i].end(); jt!=jend; ++jt)
+			{
+				std::lower_bound(forestLinks.begin(), forestLinks.end(), std::make_pair(*jt, INT_MIN))->second = parentIndex;
+			}
+		}
+
+		m_commandManager->execute(Command_Ptr(new InsertAboveLayerCommand(this, indexB, forestLinks)));
+	}
+
 	/**
 	@brief	Merges a set of sibling nodes in the partition forest.
 
@@ -1504,10 +1711,7 @@ private:
 			ret->set_node_properties(nodes[i], sourceLayer.combine_properties(children));
 		}
 
-		for(typename IForestLayer<BranchProperties,int>::EdgeConstIterator it=sourceLayer.edges_cbegin(), iend=sourceLayer.edges_cend(); it!=iend; ++it)
-		{
-			ret->set_edge_weight(it->u, it->v, it->weight);
-		}
+		sourceLayer.for_each_edge(EdgeCopier(ret.get()));
 
 		return ret;
 	}
@@ -1625,6 +1829,40 @@ private:
 		else return m_branchLayers[index-1];
 	}
 
+	std::vector<std::pair<int,int> > forest_links_below(int index) const
+	{
+		// Record the (child, parent) link of each node in the layer below, sorted by child so that they can be searched.
+		IForestLayer_Ptr layerB = forest_layer(index - 1);
+		std::vector<std::pair<int,int> > links;
+		links.reserve(layerB->node_count());
+		layerB->for_each_node(LinkRecorder(&links));
+		std::sort(links.begin(), links.end());
+		return links;
+	}
+
+	void insert_layer_above_impl(int indexB, const std::vector<std::pair<int,int> >& forestLinks)
+	{
+		// Note:	Before the new layer is inserted, the parent of each node in layer B is the node in the layer above that will
+		//			become its grandparent, which is exactly the state the forest is in just after a layer has been deleted.
+		//			The new layer can thus be built and inserted in the same way as a deleted layer is rebuilt and restored.
+		undelete_layer_impl(indexB + 1, rebuild_layer(indexB + 1, forestLinks));
+	}
+
+	std::vector<BranchProperties> layer_node_properties(int index) const
+	{
+		// Record the properties of each node in the layer, in ascending order of node index (as rebuild_layer() expects).
+		BranchLayer_Ptr layer = m_branchLayers[index-1];
+		std::vector<int> nodes = layer->node_indices();
+		std::sort(nodes.begin(), nodes.end());
+		std::vector<BranchProperties> properties;
+		properties.reserve(nodes.size());
+		for(std::vector<int>::const_iterator it=nodes.begin(), iend=nodes.end(); it!=iend; ++it)
+		{
+			properties.push_back(layer->node_properties(*it));
+		}
+		return properties;
+	}
+
 	PFNodeID merge_sibling_nodes_impl(const std::set<PFNodeID>& nodes, int commandDepth)
 	{
 		m_listeners->nodes_will_be_merged(nodes, commandDepth);
@@ -1689,8 +1927,14 @@ private:
 			}
 		}
 
-		// Recalculate the properties for the canonical node.
-		layerM->set_node_properties(canonical.index(), layerB->combine_properties(layerM->node_children(canonical.index())));
+		// Recalculate the properties for the canonical node by merging in those of the other nodes (this avoids recombining
+		// the properties of all of its children, which could be expensive if the merged nodes are large).
+		BranchProperties properties = layerM->node_properties(canonical.index());
+		for(std::set<PFNodeID>::const_iterator it=othersBegin, iend=othersEnd; it!=iend; ++it)
+		{
+			properties = BranchProperties::merge(properties, layerM->node_properties(it->index()));
+		}
+		layerM->set_node_properties(canonical.index(), properties);
 
 		//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 		// Step 3: Remove the other merged nodes (note that this also removes their adjacent edges)
@@ -1705,6 +1949,43 @@ private:
 		return canonical;
 	}
 
+	static int parent_in_links(const std::vector<std::pair<int,int> >& forestLinks, int child)
+	{
+		return std::lower_bound(forestLinks.begin(), forestLinks.end(), std::make_pair(child, INT_MIN))->second;
+	}
+
+	BranchLayer_Ptr rebuild_layer(int indexD, const std::vector<std::pair<int,int> >& forestLinks,
+								  const std::vector<BranchProperties> *nodeProperties = NULL) const
+	{
+		// Note: We denote the layer being rebuilt as D and the layer below as B. The forest must be in the state it was in
+		// just after D was deleted, in which each node in B has the parent that its parent in D used to have. If the
+		// properties of the nodes of D are supplied (in ascending order of node index), they are used as they are;
+		// otherwise, they are combined from those of their children.
+		IForestLayer_Ptr layerB = forest_layer(indexD - 1);
+		BranchLayer_Ptr layerD(new BranchLayer);
+
+		// Recreate the nodes of layer D and their forest links.
+		std::map<int,std::set<int> > groups;
+		for(std::vector<std::pair<int,int> >::const_iterator it=forestLinks.begin(), iend=forestLinks.end(); it!=iend; ++it)
+		{
+			groups[it->second].insert(it->first);
+		}
+
+		size_t i = 0;
+		for(std::map<int,std::set<int> >::const_iterator it=groups.begin(), iend=groups.end(); it!=iend; ++it, ++i)
+		{
+			layerD->set_node_properties(it->first, nodeProperties ? (*nodeProperties)[i] : layerB->combine_properties(it->second));
+			layerD->set_node_children(it->first, it->second);
+			layerD->set_node_parent(it->first, layerB->node_parent(*it->second.begin()));
+		}
+
+		// Recreate the edges of layer D from those of layer B (as when splitting nodes, the weight of each edge is the
+		// smallest weight of any edge joining the children of its endpoints).
+		layerB->for_each_edge(LinkedParentEdgeAdder(layerD.get(), &forestLinks));
+
+		return layerD;
+	}
+
 	std::set<PFNodeID> split_node_impl(const PFNodeID& node, const std::vector<std::set<int> >& groups, int commandDepth)
 	{
 		BranchLayer_Ptr layerA = checked_branch_layer(node.layer() + 1);
@@ -1725,6 +2006,9 @@ private:
 		int parentIndex = layerS->node_parent(node.index());
 		if(layerA) layerA->node_children(parentIndex).erase(node.index());
 
+		// Record the node's properties so that they can be used to derive those of the largest group (see below).
+		BranchProperties nodeProperties = layerS->node_properties(node.index());
+
 		// Remove the node from its partitioning graph.
 		layerS->remove_node(node.index());
 
@@ -1732,13 +2016,40 @@ private:
 		// Step 2: Add new nodes for each of the groups to the split layer, along with the appropriate forest links.
 		//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
+		// Calculate the properties of the new nodes. Only the children being moved out of the largest group need to have
+		// their properties combined: those of the largest group can usually be derived by subtracting the moved properties
+		// from those of the original node, and are only recombined from its children if that is impossible (e.g. because
+		// one of its extrema was attained by a moved child).
+		size_t largest = 0;
+		for(size_t i=1, size=groups.size(); i<size; ++i)
+		{
+			if(groups[i].size() > groups[largest].size()) largest = i;
+		}
+
+		std::vector<BranchProperties> groupProperties(groups.size());
+		BranchProperties movedProperties;
+		bool firstMoved = true;
+		for(size_t i=0, size=groups.size(); i<size; ++i)
+		{
+			if(i == largest) continue;
+			groupProperties[i] = layerB->combine_properties(groups[i]);
+			movedProperties = firstMoved ? groupProperties[i] : BranchProperties::merge(movedProperties, groupProperties[i]);
+			firstMoved = false;
+		}
+
+		if(groups.size() == 1) groupProperties[largest] = nodeProperties;
+		else if(!BranchProperties::subtract(nodeProperties, movedProperties, groupProperties[largest]))
+		{
+			groupProperties[largest] = layerB->combine_properties(groups[largest]);
+		}
+
 		std::set<PFNodeID> newNodes;
-		for(std::vector<std::set<int> >::const_iterator it=groups.begin(), iend=groups.end(); it!=iend; ++it)
+		for(size_t i=0, size=groups.size(); i<size; ++i)
 		{
-			const std::set<int>& group = *it;
-			int groupIndex = *it->begin();		// note that the groups are guaranteed to be non-empty by the method preconditions (checked as necessary)
+			const std::set<int>& group = groups[i];
+			int groupIndex = *group.begin();		// note that the groups are guaranteed to be non-empty by the method preconditions (checked as necessary)
 			newNodes.insert(PFNodeID(node.layer(), groupIndex));
-			layerS->set_node_properties(groupIndex, layerB->combine_properties(group));
+			layerS->set_node_properties(groupIndex, groupProperties[i]);
 			layerS->set_node_children(groupIndex, group);
 			layerS->set_node_parent(groupIndex, parentIndex);
 			for(std::set<int>::const_iterator jt=group.begin(), jend=group.end(); jt!=jend; ++jt) layerB->set_node_parent(*jt, groupIndex);
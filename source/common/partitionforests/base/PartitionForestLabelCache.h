@@ -0,0 +1,254 @@
+/***
+ * millipede: PartitionForestLabelCache.h
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#ifndef H_MILLIPEDE_PARTITIONFORESTLABELCACHE
+#define H_MILLIPEDE_PARTITIONFORESTLABELCACHE
+
+#include <map>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "PartitionForest.h"
+
+namespace mp {
+
+/**
+@brief	A PartitionForestLabelCache maintains, for selected layers of a partition forest, a flat array that maps
+		each leaf index to the index of its ancestor in that layer.
+
+Each array (or "label volume") is built in a single top-down pass the first time it is requested, and is thereafter
+kept up-to-date incrementally by listening to the forest: merging or splitting nodes only relabels the receptive regions
+of the resulting nodes, and cloning, deleting or undeleting layers only renumbers (or copies) the cached arrays. Once a
+layer has been cached, finding the ancestor of a leaf in it is a single array read, rather than a climb up the forest.
+
+The arrays handed out to clients are never modified: if a client still holds the array for a layer when the forest
+changes, the cache relabels a copy of it instead (so clients can safely read the array from other threads).
+
+To bound the memory used, at most a fixed number of layers are cached at any one time: requesting an additional layer
+evicts the least recently requested one.
+
+@tparam	LeafLayer	The type of leaf layer used by the forest
+@tparam	BranchLayer	The type of branch layer used by the forest
+*/
+template <typename LeafLayer, typename BranchLayer>
+class PartitionForestLabelCache : public PartitionForest<LeafLayer,BranchLayer>::Listener
+{
+	//#################### TYPEDEFS ####################
+public:
+	typedef std::vector<int> Labels;
+	typedef boost::shared_ptr<Labels> Labels_Ptr;
+	typedef boost::shared_ptr<const Labels> Labels_CPtr;
+private:
+	typedef PartitionForest<LeafLayer,BranchLayer> PartitionForestT;
+
+	//#################### NESTED CLASSES ####################
+private:
+	struct Entry
+	{
+		Labels_Ptr labels;
+		unsigned long lastUsed;
+
+		Entry()
+		:	lastUsed(0)
+		{}
+	};
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	mutable std::map<int,Entry> m_entries;
+	const PartitionForestT *m_forest;
+	int m_maxLayers;
+	mutable boost::mutex m_mutex;
+	mutable unsigned long m_useCounter;
+
+	//#################### CONSTRUCTORS ####################
+public:
+	/**
+	@brief	Constructs a label cache for the specified forest.
+
+	@param[in]	forest		The forest (the cache must be registered as a listener of this forest to stay up-to-date)
+	@param[in]	maxLayers	The maximum number of layers whose label volumes may be cached at any one time
+	*/
+	explicit PartitionForestLabelCache(const PartitionForestT *forest, int maxLayers = 2)
+	:	m_forest(forest), m_maxLayers(maxLayers), m_useCounter(0)
+	{}
+
+	//#################### COPY CONSTRUCTOR & ASSIGNMENT OPERATOR ####################
+private:
+	PartitionForestLabelCache(const PartitionForestLabelCache&);
+	PartitionForestLabelCache& operator=(const PartitionForestLabelCache&);
+
+	//#################### PUBLIC METHODS ####################
+public:
+	/**
+	@brief	Discards all of the cached label volumes.
+	*/
+	void clear()
+	{
+		boost::mutex::scoped_lock lock(m_mutex);
+		m_entries.clear();
+	}
+
+	/**
+	@brief	Returns the cached label volume for the specified layer, if any.
+
+	@param[in]	layerIndex	The index of the layer
+	@return	The label volume, if the layer is currently cached, or NULL otherwise
+	*/
+	Labels_CPtr cached_labels(int layerIndex) const
+	{
+		boost::mutex::scoped_lock lock(m_mutex);
+		typename std::map<int,Entry>::iterator it = m_entries.find(layerIndex);
+		if(it != m_entries.end()) return it->second.labels;
+		else return Labels_CPtr();
+	}
+
+	/**
+	@brief	Returns the label volume for the specified layer, building (and caching) it if necessary.
+
+	@param[in]	layerIndex	The index of the layer
+	@pre
+		-	0 <= layerIndex <= highest_layer() of the forest
+	@return	An array whose i'th element is the index of the ancestor of leaf i in the specified layer
+	*/
+	Labels_CPtr labels(int layerIndex) const
+	{
+		boost::mutex::scoped_lock lock(m_mutex);
+		Entry& entry = m_entries[layerIndex];
+		if(!entry.labels)
+		{
+			evict_least_recently_used(layerIndex);
+			entry.labels = build_labels(layerIndex);
+		}
+		entry.lastUsed = ++m_useCounter;
+		return entry.labels;
+	}
+
+	void layer_was_cloned(int index)
+	{
+		// The clone is inserted as layer index + 1, so the cached layers above layer index move up by one.
+		// The labels of the clone are identical to those of the layer from which it was cloned.
+		boost::mutex::scoped_lock lock(m_mutex);
+		std::map<int,Entry> entries;
+		for(typename std::map<int,Entry>::const_iterator it=m_entries.begin(), iend=m_entries.end(); it!=iend; ++it)
+		{
+			entries[it->first > index ? it->first + 1 : it->first] = it->second;
+		}
+		typename std::map<int,Entry>::const_iterator it = m_entries.find(index);
+		if(it != m_entries.end() && static_cast<int>(entries.size()) < m_maxLayers)
+		{
+			entries[index + 1].labels.reset(new Labels(*it->second.labels));
+			entries[index + 1].lastUsed = it->second.lastUsed;
+		}
+		m_entries.swap(entries);
+	}
+
+	void layer_was_deleted(int index)
+	{
+		// The cached labels for the deleted layer are discarded, and the cached layers above it move down by one.
+		boost::mutex::scoped_lock lock(m_mutex);
+		std::map<int,Entry> entries;
+		for(typename std::map<int,Entry>::const_iterator it=m_entries.begin(), iend=m_entries.end(); it!=iend; ++it)
+		{
+			if(it->first < index) entries[it->first] = it->second;
+			else if(it->first > index) entries[it->first - 1] = it->second;
+		}
+		m_entries.swap(entries);
+	}
+
+	void layer_was_undeleted(int index)
+	{
+		// The cached layers at or above the undeleted layer move up by one (the undeleted layer itself will be rebuilt on demand).
+		boost::mutex::scoped_lock lock(m_mutex);
+		std::map<int,Entry> entries;
+		for(typename std::map<int,Entry>::const_iterator it=m_entries.begin(), iend=m_entries.end(); it!=iend; ++it)
+		{
+			entries[it->first >= index ? it->first + 1 : it->first] = it->second;
+		}
+		m_entries.swap(entries);
+	}
+
+	void node_was_split(const PFNodeID& node, const std::set<PFNodeID>& results, int commandDepth)
+	{
+		// Splitting a node only changes the labels of its receptive region in its own layer.
+		boost::mutex::scoped_lock lock(m_mutex);
+		typename std::map<int,Entry>::iterator it = m_entries.find(node.layer());
+		if(it == m_entries.end() || !it->second.labels) return;
+
+		Labels& labels = writable_labels(it->second);
+		for(std::set<PFNodeID>::const_iterator jt=results.begin(), jend=results.end(); jt!=jend; ++jt)
+		{
+			relabel(labels, *jt);
+		}
+	}
+
+	void nodes_were_merged(const std::set<PFNodeID>& nodes, const PFNodeID& result, int commandDepth)
+	{
+		// Merging sibling nodes only changes the labels of the receptive region of the result in its own layer.
+		boost::mutex::scoped_lock lock(m_mutex);
+		typename std::map<int,Entry>::iterator it = m_entries.find(result.layer());
+		if(it == m_entries.end() || !it->second.labels) return;
+
+		relabel(writable_labels(it->second), result);
+	}
+
+	//#################### PRIVATE METHODS ####################
+private:
+	Labels_Ptr build_labels(int layerIndex) const
+	{
+		Labels_Ptr labels(new Labels(m_forest->leaf_layer()->node_count(), -1));
+		if(layerIndex == 0)
+		{
+			for(int i=0, size=static_cast<int>(labels->size()); i<size; ++i) (*labels)[i] = i;
+		}
+		else
+		{
+			// Label the receptive region of each node in the layer with the node's index.
+			boost::shared_ptr<const BranchLayer> layer = m_forest->branch_layer(layerIndex);
+			for(typename BranchLayer::BranchNodeConstIterator it=layer->branch_nodes_cbegin(), iend=layer->branch_nodes_cend(); it!=iend; ++it)
+			{
+				relabel(*labels, PFNodeID(layerIndex, it.index()));
+			}
+		}
+		return labels;
+	}
+
+	void evict_least_recently_used(int layerIndexToKeep) const
+	{
+		int cachedCount = 0;
+		typename std::map<int,Entry>::iterator victim = m_entries.end();
+		for(typename std::map<int,Entry>::iterator it=m_entries.begin(), iend=m_entries.end(); it!=iend; ++it)
+		{
+			if(it->first == layerIndexToKeep || !it->second.labels) continue;
+			++cachedCount;
+			if(victim == m_entries.end() || it->second.lastUsed < victim->second.lastUsed) victim = it;
+		}
+		if(cachedCount >= m_maxLayers && victim != m_entries.end()) m_entries.erase(victim);
+	}
+
+	void relabel(Labels& labels, const PFNodeID& node) const
+	{
+		std::deque<int> receptiveRegion = m_forest->receptive_region_of(node);
+		for(std::deque<int>::const_iterator it=receptiveRegion.begin(), iend=receptiveRegion.end(); it!=iend; ++it)
+		{
+			labels[*it] = node.index();
+		}
+	}
+
+	/**
+	@brief	Returns the labels of the specified entry for modification, first replacing them with a copy if any client still holds them.
+	*/
+	static Labels& writable_labels(Entry& entry)
+	{
+		if(!entry.labels.unique()) entry.labels.reset(new Labels(*entry.labels));
+		return *entry.labels;
+	}
+};
+
+}
+
+#endif
@@ -39,6 +39,11 @@ private:
 			m_base->m_listeners.multi_feature_selection_manager_changed();
 		}
 
+		size_t memory_usage() const
+		{
+			return sizeof(*this) + m_name.capacity() + m_mfs->memory_usage();
+		}
+
 		void undo()
 		{
 			m_base->m_multiFeatureSelections.erase(m_name);
@@ -66,6 +71,12 @@ private:
 			m_base->m_listeners.multi_feature_selection_manager_changed();
 		}
 
+		size_t memory_usage() const
+		{
+			// Note: Once the command has been executed, it holds the only reference to the removed multi-feature selection.
+			return sizeof(*this) + m_name.capacity() + (m_oldMFS ? m_oldMFS->memory_usage() : 0);
+		}
+
 		void undo()
 		{
 			std::pair<std::string,MFS_Ptr> p = std::make_pair(m_name, m_oldMFS);
@@ -84,8 +95,9 @@ private:
 		:	Command("Rename Multi-Feature Selection"), m_base(base), m_oldName(oldName), m_newName(newName)
 		{}
 
-		void execute()	{ rename(m_oldName, m_newName); }
-		void undo()		{ rename(m_newName, m_oldName); }
+		void execute()				{ rename(m_oldName, m_newName); }
+		size_t memory_usage() const	{ return sizeof(*this) + m_oldName.capacity() + m_newName.capacity(); }
+		void undo()					{ rename(m_newName, m_oldName); }
 
 		void rename(const std::string& from, const std::string& to)
 		{
@@ -120,6 +132,13 @@ private:
 			else throw Exception("Multi-feature selection " + m_name + " does not exist");
 		}
 
+		size_t memory_usage() const
+		{
+			size_t ret = sizeof(*this) + m_name.capacity();
+			if(m_oldActiveMultiFeatureSelection) ret += m_oldActiveMultiFeatureSelection->first.capacity();
+			return ret;
+		}
+
 		void undo()
 		{
 			m_base->m_activeMultiFeatureSelection = *m_oldActiveMultiFeatureSelection;
@@ -249,6 +249,16 @@ public:
 		return m_listeners;
 	}
 
+	size_t memory_usage() const
+	{
+		size_t ret = sizeof(*this);
+		for(typename std::map<Feature,PartitionForestSelection_Ptr>::const_iterator it=m_selections.begin(), iend=m_selections.end(); it!=iend; ++it)
+		{
+			ret += MemoryUtil::SET_NODE_OVERHEAD + sizeof(*it) + it->second->memory_usage();
+		}
+		return ret;
+	}
+
 	void read_text(std::istream& is)
 	{
 		// Note: This method should only be invoked on newly-created multi-feature selections.
@@ -15,6 +15,7 @@
 #include <boost/lexical_cast.hpp>
 
 #include <common/io/util/LineIO.h>
+#include <common/util/MemoryUtil.h>
 #include "PartitionForest.h"
 
 namespace mp {
@@ -83,7 +84,20 @@ private:
 		:	Command(description), m_base(base), m_function(function)
 		{}
 
-		void execute()	{ m_modification = m_function(m_base, depth()); }
+		void execute()
+		{
+			m_modification = m_function(m_base, depth());
+
+			// The function is never called again (redoing the command just reapplies the modification), so release it
+			// along with anything it has bound (e.g. the selection passed to replace_with_selection()).
+			m_function = ModifyingFunction();
+		}
+
+		size_t memory_usage() const
+		{
+			return sizeof(*this) + MemoryUtil::footprint(m_modification.erased_nodes()) + MemoryUtil::footprint(m_modification.inserted_nodes());
+		}
+
 		void redo()		{ m_base->redo_modification(m_modification, depth()); }
 		void undo()		{ m_base->undo_modification(m_modification, depth()); }
 	};
@@ -465,6 +479,16 @@ public:
 		return m_listeners;
 	}
 
+	/**
+	@brief	Returns the approximate amount of memory (in bytes) occupied by the selection.
+
+	@return	As described
+	*/
+	size_t memory_usage() const
+	{
+		return sizeof(*this) + MemoryUtil::footprint(m_nodes);
+	}
+
 	/**
 	@brief	Calculates the layer in which any merging of the selected nodes should happen.
 
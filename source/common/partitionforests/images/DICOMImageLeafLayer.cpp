@@ -6,113 +6,147 @@
 
 #include "DICOMImageLeafLayer.h"
 
+#include <algorithm>
+
+#include <common/exceptions/Exception.h>
+#include <common/util/ITKImageUtil.h>
+
+namespace {
+
+/**
+Makes a 3D image of the specified size that shares the pixel buffer of the specified image (rather than copying it).
+The specified image must be fully buffered and have the same number of pixels.
+*/
+template <typename TPixel, unsigned int Dimension>
+typename itk::Image<TPixel,3>::Pointer share_pixels(itk::Image<TPixel,Dimension> *image, const itk::Size<3>& size)
+{
+	if(image->GetBufferedRegion() != image->GetLargestPossibleRegion())
+	{
+		throw mp::Exception("The whole of each image used to construct a leaf layer must be buffered");
+	}
+
+	typedef itk::Image<TPixel,3> Image;
+	typename Image::IndexType index;
+	index.Fill(0);
+	typename Image::RegionType region;
+	region.SetIndex(index);
+	region.SetSize(size);
+	typename Image::Pointer result = Image::New();
+	result->SetRegions(region);
+	result->SetPixelContainer(image->GetPixelContainer());
+	return result;
+}
+
+}
+
 namespace mp {
 
 //#################### CONSTRUCTORS ####################
 DICOMImageLeafLayer::DICOMImageLeafLayer(const std::vector<DICOMPixelProperties>& nodeProperties, int sizeX, int sizeY, int sizeZ)
 {
-	initialise(nodeProperties, sizeX, sizeY, sizeZ);
+	if(static_cast<int>(nodeProperties.size()) != sizeX * sizeY * sizeZ)
+	{
+		throw Exception("The number of node properties does not match the size of the leaf layer");
+	}
+
+	initialise(sizeX, sizeY, sizeZ);
+	allocate_images();
+
+	int *baseValues = m_baseImage->GetBufferPointer();
+	short *gradientMagnitudeValues = m_gradientMagnitudeImage->GetBufferPointer();
+	unsigned char *greyValues = m_greyImage->GetBufferPointer();
+	for(int n=0; n<m_sizeXYZ; ++n)
+	{
+		const DICOMPixelProperties& properties = nodeProperties[n];
+		baseValues[n] = properties.base_value();
+		gradientMagnitudeValues[n] = properties.gradient_magnitude_value();
+		greyValues[n] = properties.grey_value();
+	}
 }
 
 DICOMImageLeafLayer::DICOMImageLeafLayer(const itk::Image<int,2>::Pointer& baseImage,
 										 const itk::Image<unsigned char,2>::Pointer& windowedImage,
 										 const itk::Image<short,2>::Pointer& gradientMagnitudeImage)
 {
-	assert(baseImage->GetLargestPossibleRegion().GetSize() == windowedImage->GetLargestPossibleRegion().GetSize());
-
-	typedef itk::Image<int,2> BaseImage;
-	typedef itk::Image<short,2> GradientMagnitudeImage;
-	typedef itk::Image<unsigned char,2> WindowedImage;
-
-	const BaseImage::SizeType& size = baseImage->GetLargestPossibleRegion().GetSize();
-
-	std::vector<DICOMPixelProperties> nodeProperties;
-	nodeProperties.reserve(size[0] * size[1]);
-
-	BaseImage::IndexType baseIndex;
-	GradientMagnitudeImage::IndexType gradientMagnitudeIndex;
-	WindowedImage::IndexType windowedIndex;
-	for(size_t y=0; y<size[1]; ++y)
-		for(size_t x=0; x<size[0]; ++x)
-		{
-			baseIndex[0] = gradientMagnitudeIndex[0] = windowedIndex[0] = x;
-			baseIndex[1] = gradientMagnitudeIndex[1] = windowedIndex[1] = y;
-			nodeProperties.push_back(DICOMPixelProperties(baseImage->GetPixel(baseIndex),
-														  gradientMagnitudeImage->GetPixel(gradientMagnitudeIndex),
-														  windowedImage->GetPixel(windowedIndex)));
-		}
-
-	initialise(nodeProperties, size[0], size[1]);
+	initialise_from_images<2>(baseImage, windowedImage, gradientMagnitudeImage);
 }
 
 DICOMImageLeafLayer::DICOMImageLeafLayer(const itk::Image<int,3>::Pointer& baseImage,
 										 const itk::Image<unsigned char,3>::Pointer& windowedImage,
 										 const itk::Image<short,3>::Pointer& gradientMagnitudeImage)
 {
-	assert(baseImage->GetLargestPossibleRegion().GetSize() == windowedImage->GetLargestPossibleRegion().GetSize());
-
-	typedef itk::Image<int,3> BaseImage;
-	typedef itk::Image<short,3> GradientMagnitudeImage;
-	typedef itk::Image<unsigned char,3> WindowedImage;
-
-	const BaseImage::SizeType& size = baseImage->GetLargestPossibleRegion().GetSize();
-
-	std::vector<DICOMPixelProperties> nodeProperties;
-	nodeProperties.reserve(size[0] * size[1] * size[2]);
-
-	BaseImage::IndexType baseIndex;
-	GradientMagnitudeImage::IndexType gradientMagnitudeIndex;
-	WindowedImage::IndexType windowedIndex;
-	for(size_t z=0; z<size[2]; ++z)
-		for(size_t y=0; y<size[1]; ++y)
-			for(size_t x=0; x<size[0]; ++x)
-			{
-				baseIndex[0] = gradientMagnitudeIndex[0] = windowedIndex[0] = x;
-				baseIndex[1] = gradientMagnitudeIndex[1] = windowedIndex[1] = y;
-				baseIndex[2] = gradientMagnitudeIndex[2] = windowedIndex[2] = z;
-				nodeProperties.push_back(DICOMPixelProperties(baseImage->GetPixel(baseIndex),
-															  gradientMagnitudeImage->GetPixel(gradientMagnitudeIndex),
-															  windowedImage->GetPixel(windowedIndex)));
-			}
-
-	initialise(nodeProperties, size[0], size[1], size[2]);
+	initialise_from_images<3>(baseImage, windowedImage, gradientMagnitudeImage);
 }
 
 //#################### PUBLIC METHODS ####################
+DICOMImageLeafLayer::BaseImage::Pointer DICOMImageLeafLayer::base_image() const
+{
+	return m_baseImage;
+}
+
 // Precondition: has_edge(u, v)
 DICOMImageLeafLayer::EdgeWeight DICOMImageLeafLayer::edge_weight(int u, int v) const
 {
-	return std::max(m_nodes[u].properties().gradient_magnitude_value(), m_nodes[v].properties().gradient_magnitude_value());
+	const short *gradientMagnitudeValues = m_gradientMagnitudeImage->GetBufferPointer();
+	return std::max(gradientMagnitudeValues[u], gradientMagnitudeValues[v]);
 }
 
-itk::Image<short,3>::Pointer DICOMImageLeafLayer::gradient_magnitude_image() const
+DICOMImageLeafLayer::GradientMagnitudeImage::Pointer DICOMImageLeafLayer::gradient_magnitude_image() const
 {
-	typedef itk::Image<short,3> Image;
-	
-	Image::Pointer image = Image::New();
-	Image::SizeType size;
-	size[0] = m_sizeX;
-	size[1] = m_sizeY;
-	size[2] = m_sizeZ;
-	
-	Image::RegionType region;
-	region.SetSize(size);
-	image->SetRegions(region);
-	image->Allocate();
-
-	Image::IndexType index;
-	for(size_t z=0; z<size[2]; ++z)
-		for(size_t y=0; y<size[1]; ++y)
-			for(size_t x=0; x<size[0]; ++x)
-			{
-				index[0] = x;
-				index[1] = y;
-				index[2] = z;
-				int n = x + y * m_sizeX + z * m_sizeXY;
-				image->SetPixel(index, m_nodes[n].properties().gradient_magnitude_value());
-			}
-
-	return image;
+	return m_gradientMagnitudeImage;
+}
+
+DICOMImageLeafLayer::GreyImage::Pointer DICOMImageLeafLayer::grey_image() const
+{
+	return m_greyImage;
+}
+
+// Precondition: has_node(n)
+DICOMImageLeafLayer::NodeProperties DICOMImageLeafLayer::node_properties(int n) const
+{
+	return DICOMPixelProperties(m_baseImage->GetBufferPointer()[n], m_gradientMagnitudeImage->GetBufferPointer()[n], m_greyImage->GetBufferPointer()[n]);
+}
+
+//#################### PROTECTED METHODS ####################
+void DICOMImageLeafLayer::set_edge_weights(std::vector<Edge>& edges) const
+{
+	// Note:	This is equivalent to calling edge_weight() for each edge, but avoids a virtual call per edge.
+	const short *gradientMagnitudeValues = m_gradientMagnitudeImage->GetBufferPointer();
+	for(std::vector<Edge>::iterator it=edges.begin(), iend=edges.end(); it!=iend; ++it)
+	{
+		it->weight = std::max(gradientMagnitudeValues[it->u], gradientMagnitudeValues[it->v]);
+	}
+}
+
+//#################### PRIVATE METHODS ####################
+void DICOMImageLeafLayer::allocate_images()
+{
+	itk::Size<3> size = {{m_sizeX, m_sizeY, m_sizeZ}};
+	m_baseImage = ITKImageUtil::make_image<int,3>(size);
+	m_gradientMagnitudeImage = ITKImageUtil::make_image<short,3>(size);
+	m_greyImage = ITKImageUtil::make_image<unsigned char,3>(size);
+}
+
+template <unsigned int Dimension>
+void DICOMImageLeafLayer::initialise_from_images(const typename itk::Image<int,Dimension>::Pointer& baseImage,
+												 const typename itk::Image<unsigned char,Dimension>::Pointer& windowedImage,
+												 const typename itk::Image<short,Dimension>::Pointer& gradientMagnitudeImage)
+{
+	const itk::Size<Dimension>& size = baseImage->GetLargestPossibleRegion().GetSize();
+	if(windowedImage->GetLargestPossibleRegion().GetSize() != size || gradientMagnitudeImage->GetLargestPossibleRegion().GetSize() != size)
+	{
+		throw Exception("The base, windowed and gradient magnitude images must all be the same size");
+	}
+
+	int sizeZ = 1;
+	for(unsigned int i=2; i<Dimension; ++i) sizeZ *= static_cast<int>(size[i]);
+	initialise(static_cast<int>(size[0]), static_cast<int>(size[1]), sizeZ);
+
+	// The images are all laid out in x-y-z order, just like the nodes, so the layer can use their pixel buffers as its arrays.
+	itk::Size<3> layerSize = {{m_sizeX, m_sizeY, m_sizeZ}};
+	m_baseImage = share_pixels(baseImage.GetPointer(), layerSize);
+	m_gradientMagnitudeImage = share_pixels(gradientMagnitudeImage.GetPointer(), layerSize);
+	m_greyImage = share_pixels(windowedImage.GetPointer(), layerSize);
 }
 
 }
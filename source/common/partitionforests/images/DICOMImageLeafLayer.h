@@ -15,8 +15,31 @@
 
 namespace mp {
 
+/**
+@brief	A DICOMImageLeafLayer is the leaf layer of a partition forest built over a DICOM volume.
+
+Rather than storing a DICOMPixelProperties object for each node, the layer stores each of the properties in a separate
+contiguous array, which is the pixel buffer of an ITK image. This keeps the layer small, makes scans over a single property
+(e.g. calculating edge weights from the gradient magnitudes) cache-friendly, and means that the property images can be
+handed out to the code that needs them (e.g. the fast marching used by the feature identifiers) without any copying.
+
+When the layer is constructed from images, it shares their pixel buffers rather than copying them, so the images must not
+be modified afterwards.
+*/
 class DICOMImageLeafLayer : public ImageLeafLayer<DICOMPixelProperties,DICOMRegionProperties>
 {
+	//#################### TYPEDEFS ####################
+public:
+	typedef itk::Image<int,3> BaseImage;
+	typedef itk::Image<short,3> GradientMagnitudeImage;
+	typedef itk::Image<unsigned char,3> GreyImage;
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	BaseImage::Pointer m_baseImage;
+	GradientMagnitudeImage::Pointer m_gradientMagnitudeImage;
+	GreyImage::Pointer m_greyImage;
+
 	//#################### CONSTRUCTORS ####################
 public:
 	DICOMImageLeafLayer(const std::vector<DICOMPixelProperties>& nodeProperties, int sizeX, int sizeY, int sizeZ = 1);
@@ -29,8 +52,49 @@ public:
 
 	//#################### PUBLIC METHODS ####################
 public:
+	/**
+	@brief	Returns an image containing the base values of the leaf nodes.
+
+	The image shares its pixel buffer with the layer, so it must not be modified.
+
+	@return	As described
+	*/
+	BaseImage::Pointer base_image() const;
+
 	EdgeWeight edge_weight(int u, int v) const;
-	itk::Image<short,3>::Pointer gradient_magnitude_image() const;
+
+	/**
+	@brief	Returns an image containing the gradient magnitude values of the leaf nodes.
+
+	The image shares its pixel buffer with the layer, so it must not be modified.
+
+	@return	As described
+	*/
+	GradientMagnitudeImage::Pointer gradient_magnitude_image() const;
+
+	/**
+	@brief	Returns an image containing the grey (windowed) values of the leaf nodes.
+
+	The image shares its pixel buffer with the layer, so it must not be modified.
+
+	@return	As described
+	*/
+	GreyImage::Pointer grey_image() const;
+
+	NodeProperties node_properties(int n) const;
+
+	//#################### PROTECTED METHODS ####################
+protected:
+	void set_edge_weights(std::vector<Edge>& edges) const;
+
+	//#################### PRIVATE METHODS ####################
+private:
+	void allocate_images();
+
+	template <unsigned int Dimension>
+	void initialise_from_images(const typename itk::Image<int,Dimension>::Pointer& baseImage,
+								const typename itk::Image<unsigned char,Dimension>::Pointer& windowedImage,
+								const typename itk::Image<short,Dimension>::Pointer& gradientMagnitudeImage);
 };
 
 }
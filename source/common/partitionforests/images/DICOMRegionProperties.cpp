@@ -6,14 +6,64 @@
 
 #include "DICOMRegionProperties.h"
 
+#include <algorithm>
 #include <climits>
+#include <cstring>
+#include <functional>
 #include <ostream>
 #include <sstream>
 
+#include <boost/cstdint.hpp>
 #include <boost/lexical_cast.hpp>
 
 namespace mp {
 
+//#################### LOCAL CONSTANTS ####################
+namespace {
+
+/// The count recorded for an extremum when the number of voxels attaining it is unknown (e.g. for properties read from a text file)
+const unsigned int UNKNOWN_COUNT = UINT_MAX;
+
+}
+
+//#################### LOCAL FUNCTIONS ####################
+namespace {
+
+unsigned int add_counts(unsigned int lhs, unsigned int rhs)
+{
+	return lhs == UNKNOWN_COUNT || rhs == UNKNOWN_COUNT ? UNKNOWN_COUNT : lhs + rhs;
+}
+
+/**
+Updates an extremum (and the number of voxels attaining it) to take account of another value attained by some voxels.
+*/
+template <typename T, typename Compare>
+void combine_extremum(T& value, unsigned int& count, T otherValue, unsigned int otherCount, Compare better)
+{
+	if(better(otherValue, value))	{ value = otherValue; count = otherCount; }
+	else if(otherValue == value)	count = add_counts(count, otherCount);
+}
+
+/**
+Determines an extremum of what remains of a region when part of it is removed. Returns false if it cannot be determined,
+i.e. if the part might contain every voxel of the region that attains the extremum.
+*/
+template <typename T>
+bool subtract_extremum(T wholeValue, unsigned int wholeCount, T partValue, unsigned int partCount, T& value, unsigned int& count)
+{
+	value = wholeValue;
+	if(partValue != wholeValue)
+	{
+		count = wholeCount;
+		return true;
+	}
+	if(wholeCount == UNKNOWN_COUNT || partCount == UNKNOWN_COUNT || partCount >= wholeCount) return false;
+	count = wholeCount - partCount;
+	return true;
+}
+
+}
+
 //#################### CONSTRUCTORS ####################
 DICOMRegionProperties::DICOMRegionProperties()
 :	m_centroid(0.0, 0.0, 0.0),
@@ -21,7 +71,9 @@ DICOMRegionProperties::DICOMRegionProperties()
 	m_meanGreyValue(0.0),
 	m_minGreyValue(UCHAR_MAX),
 	m_xMin(INT_MAX), m_yMin(INT_MAX), m_zMin(INT_MAX), m_xMax(INT_MIN), m_yMax(INT_MIN), m_zMax(INT_MIN),
-	m_voxelCount(0)
+	m_voxelCount(0),
+	m_maxGreyCount(0), m_minGreyCount(0),
+	m_xMinCount(0), m_yMinCount(0), m_zMinCount(0), m_xMaxCount(0), m_yMaxCount(0), m_zMaxCount(0)
 {}
 
 //#################### PUBLIC METHODS ####################
@@ -86,14 +138,9 @@ DICOMRegionProperties DICOMRegionProperties::combine_branch_properties(const std
 	for(size_t i=0, size=properties.size(); i<size; ++i)
 	{
 		ret.m_centroid += properties[i].m_centroid * properties[i].m_voxelCount;
-		ret.m_maxGreyValue = std::max(ret.m_maxGreyValue, properties[i].m_maxGreyValue);
 		ret.m_meanGreyValue += properties[i].m_meanGreyValue * properties[i].m_voxelCount;
-		ret.m_minGreyValue = std::min(ret.m_minGreyValue, properties[i].m_minGreyValue);
 		ret.m_voxelCount += properties[i].m_voxelCount;
-
-		ret.m_xMin = std::min(ret.m_xMin, properties[i].m_xMin);	ret.m_xMax = std::max(ret.m_xMax, properties[i].m_xMax);
-		ret.m_yMin = std::min(ret.m_yMin, properties[i].m_yMin);	ret.m_yMax = std::max(ret.m_yMax, properties[i].m_yMax);
-		ret.m_zMin = std::min(ret.m_zMin, properties[i].m_zMin);	ret.m_zMax = std::max(ret.m_zMax, properties[i].m_zMax);
+		ret.combine_extrema(properties[i]);
 	}
 	ret.m_centroid /= ret.m_voxelCount;
 	ret.m_meanGreyValue /= ret.m_voxelCount;
@@ -111,14 +158,8 @@ DICOMRegionProperties DICOMRegionProperties::combine_leaf_properties(const std::
 	for(size_t i=0, size=properties.size(); i<size; ++i)
 	{
 		ret.m_centroid += Vector3d(properties[i].first);
-		ret.m_maxGreyValue = std::max(ret.m_maxGreyValue, properties[i].second.grey_value());
 		ret.m_meanGreyValue += properties[i].second.grey_value();
-		ret.m_minGreyValue = std::min(ret.m_minGreyValue, properties[i].second.grey_value());
-
-		int x = properties[i].first.x, y = properties[i].first.y, z = properties[i].first.z;
-		ret.m_xMin = std::min(ret.m_xMin, x);	ret.m_xMax = std::max(ret.m_xMax, x);
-		ret.m_yMin = std::min(ret.m_yMin, y);	ret.m_yMax = std::max(ret.m_yMax, y);
-		ret.m_zMin = std::min(ret.m_zMin, z);	ret.m_zMax = std::max(ret.m_zMax, z);
+		ret.combine_extrema(convert_from_leaf_properties(properties[i]));
 	}
 	ret.m_centroid /= ret.m_voxelCount;
 	ret.m_meanGreyValue /= ret.m_voxelCount;
@@ -137,13 +178,114 @@ DICOMRegionProperties DICOMRegionProperties::convert_from_leaf_properties(const
 	ret.m_xMin = ret.m_xMax = properties.first.x;
 	ret.m_yMin = ret.m_yMax = properties.first.y;
 	ret.m_zMin = ret.m_zMax = properties.first.z;
+	ret.m_maxGreyCount = ret.m_minGreyCount = 1;
+	ret.m_xMinCount = ret.m_yMinCount = ret.m_zMinCount = ret.m_xMaxCount = ret.m_yMaxCount = ret.m_zMaxCount = 1;
 	return ret;
 }
 
 int DICOMRegionProperties::max_grey_value() const		{ return m_maxGreyValue; }
 double DICOMRegionProperties::mean_grey_value() const			{ return m_meanGreyValue; }
+
+// Note: This is equivalent to combining the two sets of properties using combine_branch_properties, but avoids building a vector.
+DICOMRegionProperties DICOMRegionProperties::merge(const DICOMRegionProperties& lhs, const DICOMRegionProperties& rhs)
+{
+	DICOMRegionProperties ret = lhs;
+
+	ret.m_voxelCount = lhs.m_voxelCount + rhs.m_voxelCount;
+	ret.m_centroid = (lhs.m_centroid * lhs.m_voxelCount + rhs.m_centroid * rhs.m_voxelCount) / ret.m_voxelCount;
+	ret.m_meanGreyValue = (lhs.m_meanGreyValue * lhs.m_voxelCount + rhs.m_meanGreyValue * rhs.m_voxelCount) / ret.m_voxelCount;
+	ret.combine_extrema(rhs);
+
+	return ret;
+}
+
 int DICOMRegionProperties::min_grey_value() const		{ return m_minGreyValue; }
+
+// Note: The record need not be aligned in memory (e.g. it may be read straight out of a memory-mapped file).
+DICOMRegionProperties DICOMRegionProperties::read_binary(const char *data)
+{
+	DICOMRegionProperties ret;
+	boost::uint64_t voxelCount;
+	std::memcpy(&ret.m_centroid.x, data + 0, sizeof(double));
+	std::memcpy(&ret.m_centroid.y, data + 8, sizeof(double));
+	std::memcpy(&ret.m_centroid.z, data + 16, sizeof(double));
+	std::memcpy(&ret.m_meanGreyValue, data + 24, sizeof(double));
+	std::memcpy(&voxelCount, data + 32, sizeof(boost::uint64_t));
+	std::memcpy(&ret.m_xMin, data + 40, sizeof(int));
+	std::memcpy(&ret.m_yMin, data + 44, sizeof(int));
+	std::memcpy(&ret.m_zMin, data + 48, sizeof(int));
+	std::memcpy(&ret.m_xMax, data + 52, sizeof(int));
+	std::memcpy(&ret.m_yMax, data + 56, sizeof(int));
+	std::memcpy(&ret.m_zMax, data + 60, sizeof(int));
+	ret.m_minGreyValue = static_cast<unsigned char>(data[64]);
+	ret.m_maxGreyValue = static_cast<unsigned char>(data[65]);
+	std::memcpy(&ret.m_minGreyCount, data + 72, sizeof(unsigned int));
+	std::memcpy(&ret.m_maxGreyCount, data + 76, sizeof(unsigned int));
+	std::memcpy(&ret.m_xMinCount, data + 80, sizeof(unsigned int));
+	std::memcpy(&ret.m_yMinCount, data + 84, sizeof(unsigned int));
+	std::memcpy(&ret.m_zMinCount, data + 88, sizeof(unsigned int));
+	std::memcpy(&ret.m_xMaxCount, data + 92, sizeof(unsigned int));
+	std::memcpy(&ret.m_yMaxCount, data + 96, sizeof(unsigned int));
+	std::memcpy(&ret.m_zMaxCount, data + 100, sizeof(unsigned int));
+	ret.m_voxelCount = static_cast<size_t>(voxelCount);
+	return ret;
+}
+
+// Precondition: part describes a proper subset of the region described by whole
+// Returns false (leaving result unchanged) if the extrema of the remainder cannot be determined, i.e. if part contains
+// every voxel of whole that attains one of its extreme grey values or bounding box coordinates (or the numbers of voxels
+// attaining them are unknown); in that case, the remainder's properties must be recombined from scratch. The other
+// properties are sums, and can always be subtracted.
+bool DICOMRegionProperties::subtract(const DICOMRegionProperties& whole, const DICOMRegionProperties& part, DICOMRegionProperties& result)
+{
+	DICOMRegionProperties ret;
+	bool extremaValid =	subtract_extremum(whole.m_maxGreyValue, whole.m_maxGreyCount, part.m_maxGreyValue, part.m_maxGreyCount, ret.m_maxGreyValue, ret.m_maxGreyCount) &&
+						subtract_extremum(whole.m_minGreyValue, whole.m_minGreyCount, part.m_minGreyValue, part.m_minGreyCount, ret.m_minGreyValue, ret.m_minGreyCount) &&
+						subtract_extremum(whole.m_xMin, whole.m_xMinCount, part.m_xMin, part.m_xMinCount, ret.m_xMin, ret.m_xMinCount) &&
+						subtract_extremum(whole.m_yMin, whole.m_yMinCount, part.m_yMin, part.m_yMinCount, ret.m_yMin, ret.m_yMinCount) &&
+						subtract_extremum(whole.m_zMin, whole.m_zMinCount, part.m_zMin, part.m_zMinCount, ret.m_zMin, ret.m_zMinCount) &&
+						subtract_extremum(whole.m_xMax, whole.m_xMaxCount, part.m_xMax, part.m_xMaxCount, ret.m_xMax, ret.m_xMaxCount) &&
+						subtract_extremum(whole.m_yMax, whole.m_yMaxCount, part.m_yMax, part.m_yMaxCount, ret.m_yMax, ret.m_yMaxCount) &&
+						subtract_extremum(whole.m_zMax, whole.m_zMaxCount, part.m_zMax, part.m_zMaxCount, ret.m_zMax, ret.m_zMaxCount);
+	if(!extremaValid) return false;
+
+	ret.m_voxelCount = whole.m_voxelCount - part.m_voxelCount;
+	ret.m_centroid = (whole.m_centroid * whole.m_voxelCount - part.m_centroid * part.m_voxelCount) / ret.m_voxelCount;
+	ret.m_meanGreyValue = (whole.m_meanGreyValue * whole.m_voxelCount - part.m_meanGreyValue * part.m_voxelCount) / ret.m_voxelCount;
+	result = ret;
+	return true;
+}
+
 int DICOMRegionProperties::voxel_count() const					{ return m_voxelCount; }
+
+// Precondition: data points to a buffer of at least BINARY_SIZE bytes
+void DICOMRegionProperties::write_binary(char *data) const
+{
+	boost::uint64_t voxelCount = m_voxelCount;
+	std::memset(data, 0, BINARY_SIZE);
+	std::memcpy(data + 0, &m_centroid.x, sizeof(double));
+	std::memcpy(data + 8, &m_centroid.y, sizeof(double));
+	std::memcpy(data + 16, &m_centroid.z, sizeof(double));
+	std::memcpy(data + 24, &m_meanGreyValue, sizeof(double));
+	std::memcpy(data + 32, &voxelCount, sizeof(boost::uint64_t));
+	std::memcpy(data + 40, &m_xMin, sizeof(int));
+	std::memcpy(data + 44, &m_yMin, sizeof(int));
+	std::memcpy(data + 48, &m_zMin, sizeof(int));
+	std::memcpy(data + 52, &m_xMax, sizeof(int));
+	std::memcpy(data + 56, &m_yMax, sizeof(int));
+	std::memcpy(data + 60, &m_zMax, sizeof(int));
+	data[64] = static_cast<char>(m_minGreyValue);
+	data[65] = static_cast<char>(m_maxGreyValue);
+	std::memcpy(data + 72, &m_minGreyCount, sizeof(unsigned int));
+	std::memcpy(data + 76, &m_maxGreyCount, sizeof(unsigned int));
+	std::memcpy(data + 80, &m_xMinCount, sizeof(unsigned int));
+	std::memcpy(data + 84, &m_yMinCount, sizeof(unsigned int));
+	std::memcpy(data + 88, &m_zMinCount, sizeof(unsigned int));
+	std::memcpy(data + 92, &m_xMaxCount, sizeof(unsigned int));
+	std::memcpy(data + 96, &m_yMaxCount, sizeof(unsigned int));
+	std::memcpy(data + 100, &m_zMaxCount, sizeof(unsigned int));
+}
+
 int DICOMRegionProperties::x_max() const						{ return m_xMax; }
 int DICOMRegionProperties::x_min() const						{ return m_xMin; }
 int DICOMRegionProperties::y_max() const						{ return m_yMax; }
@@ -151,6 +293,19 @@ int DICOMRegionProperties::y_min() const						{ return m_yMin; }
 int DICOMRegionProperties::z_max() const						{ return m_zMax; }
 int DICOMRegionProperties::z_min() const						{ return m_zMin; }
 
+//#################### PRIVATE METHODS ####################
+void DICOMRegionProperties::combine_extrema(const DICOMRegionProperties& rhs)
+{
+	combine_extremum(m_maxGreyValue, m_maxGreyCount, rhs.m_maxGreyValue, rhs.m_maxGreyCount, std::greater<unsigned char>());
+	combine_extremum(m_minGreyValue, m_minGreyCount, rhs.m_minGreyValue, rhs.m_minGreyCount, std::less<unsigned char>());
+	combine_extremum(m_xMin, m_xMinCount, rhs.m_xMin, rhs.m_xMinCount, std::less<int>());
+	combine_extremum(m_yMin, m_yMinCount, rhs.m_yMin, rhs.m_yMinCount, std::less<int>());
+	combine_extremum(m_zMin, m_zMinCount, rhs.m_zMin, rhs.m_zMinCount, std::less<int>());
+	combine_extremum(m_xMax, m_xMaxCount, rhs.m_xMax, rhs.m_xMaxCount, std::greater<int>());
+	combine_extremum(m_yMax, m_yMaxCount, rhs.m_yMax, rhs.m_yMaxCount, std::greater<int>());
+	combine_extremum(m_zMax, m_zMaxCount, rhs.m_zMax, rhs.m_zMaxCount, std::greater<int>());
+}
+
 //#################### GLOBAL OPERATORS ####################
 std::istream& operator>>(std::istream& is, DICOMRegionProperties& rhs)
 {
@@ -171,6 +326,10 @@ std::istream& operator>>(std::istream& is, DICOMRegionProperties& rhs)
 		>> dummy >> dummy;
 	rhs.m_maxGreyValue = static_cast<unsigned char>(maxGreyValue);
 	rhs.m_minGreyValue = static_cast<unsigned char>(minGreyValue);
+
+	// The text format does not record how many voxels attain each extremum.
+	rhs.m_maxGreyCount = rhs.m_minGreyCount = UNKNOWN_COUNT;
+	rhs.m_xMinCount = rhs.m_yMinCount = rhs.m_zMinCount = rhs.m_xMaxCount = rhs.m_yMaxCount = rhs.m_zMaxCount = UNKNOWN_COUNT;
 	return is;
 }
 
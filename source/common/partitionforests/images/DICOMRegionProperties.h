@@ -20,7 +20,12 @@ class DICOMRegionProperties
 {
 	//#################### FRIENDS ####################
 	friend std::istream& operator>>(std::istream& is, DICOMRegionProperties& rhs);
-	
+
+	//#################### CONSTANTS ####################
+public:
+	/// The number of bytes occupied by a set of region properties in a binary file (see read_binary() and write_binary())
+	enum { BINARY_SIZE = 104 };
+
 	//#################### PRIVATE VARIABLES ####################
 private:
 	Vector3d m_centroid;
@@ -30,6 +35,10 @@ private:
 	int m_xMin, m_yMin, m_zMin, m_xMax, m_yMax, m_zMax;
 	size_t m_voxelCount;
 
+	// The numbers of voxels attaining each of the extrema above (these make it possible to subtract one region from another).
+	unsigned int m_maxGreyCount, m_minGreyCount;
+	unsigned int m_xMinCount, m_yMinCount, m_zMinCount, m_xMaxCount, m_yMaxCount, m_zMaxCount;
+
 	//#################### CONSTRUCTORS ####################
 public:
 	DICOMRegionProperties();
@@ -45,14 +54,22 @@ public:
 	static DICOMRegionProperties convert_from_leaf_properties(const std::pair<Vector3i,DICOMPixelProperties>& properties);
 	int max_grey_value() const;
 	double mean_grey_value() const;
+	static DICOMRegionProperties merge(const DICOMRegionProperties& lhs, const DICOMRegionProperties& rhs);
 	int min_grey_value() const;
+	static DICOMRegionProperties read_binary(const char *data);
+	static bool subtract(const DICOMRegionProperties& whole, const DICOMRegionProperties& part, DICOMRegionProperties& result);
 	int voxel_count() const;
+	void write_binary(char *data) const;
 	int x_max() const;
 	int x_min() const;
 	int y_max() const;
 	int y_min() const;
 	int z_max() const;
 	int z_min() const;
+
+	//#################### PRIVATE METHODS ####################
+private:
+	void combine_extrema(const DICOMRegionProperties& rhs);
 };
 
 //#################### GLOBAL OPERATORS ####################
@@ -0,0 +1,572 @@
+/***
+ * millipede: DenseImageBranchLayer.h
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#ifndef H_MILLIPEDE_DENSEIMAGEBRANCHLAYER
+#define H_MILLIPEDE_DENSEIMAGEBRANCHLAYER
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <common/exceptions/Exception.h>
+#include <common/io/util/OSSWrapper.h>
+#include <common/partitionforests/base/IForestLayer.h>
+
+namespace mp {
+
+/**
+@brief	A DenseImageBranchLayer is a drop-in alternative to ImageBranchLayer that stores its nodes in index-addressed arrays
+		rather than in std::map / boost::multi_index containers.
+
+Since the indices of the nodes in an image branch layer are always leaf indices, the layer keeps a two-level presence
+bitmap over the leaf indices, together with a hash table that maps the index of each node that exists to its slot. The
+bitmap costs one bit per leaf, and makes it possible to iterate over the nodes in ascending index order without visiting
+every possible index, which means that nodes and edges are visited in exactly the same order as they would be for an
+ImageBranchLayer. The hash table is sized to the number of nodes in the layer rather than the number of leaves, which
+matters for the higher layers of a forest, which have far fewer nodes than leaves. Each slot holds the node's properties,
+its forest links and a sorted array of its adjacent edges (a mutable analogue of compressed sparse row adjacency), and
+remains at the same address until its node is removed.
+
+The children of each node are still stored as a std::set<int>, because the partition forest code modifies them in place
+via node_children().
+*/
+template <typename BranchProperties>
+class DenseImageBranchLayer : public IForestLayer<BranchProperties,int>
+{
+	//#################### TYPEDEFS ####################
+private:
+	typedef IForestLayer<BranchProperties,int> Base;
+public:
+	typedef int EdgeWeight;
+	typedef WeightedEdge<EdgeWeight> Edge;
+	typedef BranchProperties NodeProperties;
+
+	//#################### NESTED CLASSES (EXCLUDING ITERATORS) ####################
+private:
+	struct NodeSlot
+	{
+		std::set<int> m_children;
+		std::vector<Edge> m_edges;		// the edges adjacent to this node, sorted by the index of the node at their other end
+		int m_parent;
+		NodeProperties m_properties;
+
+		NodeSlot()
+		:	m_parent(-1)
+		{}
+	};
+
+	/**
+	Orders edges by the index of the node at their other end (relative to a fixed node n).
+	*/
+	struct OtherEndLess
+	{
+		int n;
+
+		explicit OtherEndLess(int n_)
+		:	n(n_)
+		{}
+
+		int other(const Edge& e) const	{ return e.u == n ? e.v : e.u; }
+
+		bool operator()(const Edge& lhs, const Edge& rhs) const	{ return other(lhs) < other(rhs); }
+		bool operator()(const Edge& lhs, int rhs) const			{ return other(lhs) < rhs; }
+		bool operator()(int lhs, const Edge& rhs) const			{ return lhs < other(rhs); }
+	};
+
+public:
+	class BranchNode : public Base::Node
+	{
+	private:
+		NodeSlot *m_slot;
+	public:
+		explicit BranchNode(NodeSlot *slot = NULL)
+		:	m_slot(slot)
+		{}
+
+		std::set<int>& children()					{ return m_slot->m_children; }
+		const std::set<int>& children() const		{ return m_slot->m_children; }
+		int parent() const							{ return m_slot->m_parent; }
+		const NodeProperties& properties() const	{ return m_slot->m_properties; }
+		void set_parent(int parent)					{ m_slot->m_parent = parent; }
+	};
+
+	//#################### ITERATORS ####################
+private:
+	class EdgeConstIteratorImpl : public Base::EdgeConstIteratorImplBase
+	{
+	private:
+		const DenseImageBranchLayer *m_layer;
+		int m_n;		// the smaller endpoint of the current edge (or -1 at the end)
+		size_t m_i;		// the position of the current edge in the adjacent edge array of node m_n
+	public:
+		EdgeConstIteratorImpl(const DenseImageBranchLayer *layer, int n)
+		:	m_layer(layer), m_n(n), m_i(0)
+		{
+			seek();
+		}
+
+		const Edge& operator*() const	{ return m_layer->slot(m_n).m_edges[m_i]; }
+		const Edge *operator->() const	{ return &m_layer->slot(m_n).m_edges[m_i]; }
+
+		EdgeConstIteratorImpl& operator++()
+		{
+			++m_i;
+			if(m_i == m_layer->slot(m_n).m_edges.size())
+			{
+				m_n = m_layer->next_node(m_n + 1);
+				seek();
+			}
+			return *this;
+		}
+
+		bool operator==(const typename Base::EdgeConstIteratorImplBase& baseRhs) const
+		{
+			const EdgeConstIteratorImpl& rhs = static_cast<const EdgeConstIteratorImpl&>(baseRhs);
+			return m_n == rhs.m_n && (m_n == -1 || m_i == rhs.m_i);
+		}
+
+	private:
+		void seek()
+		{
+			// Find the first edge {u,v} (with u < v) at or after node m_n for which m_n == u. Since the adjacent edges of
+			// each node are sorted by the index of their other end, these are exactly the edges after the last one whose
+			// other end is smaller than m_n.
+			while(m_n != -1)
+			{
+				const std::vector<Edge>& edges = m_layer->slot(m_n).m_edges;
+				m_i = std::upper_bound(edges.begin(), edges.end(), m_n, OtherEndLess(m_n)) - edges.begin();
+				if(m_i != edges.size()) return;
+				m_n = m_layer->next_node(m_n + 1);
+			}
+			m_i = 0;
+		}
+	};
+
+	template <typename N>
+	class BranchNodeIteratorImplT : public Base::template NodeIteratorImplBaseT<N>
+	{
+	private:
+		const DenseImageBranchLayer *m_layer;
+		int m_n;
+		mutable BranchNode m_cur;
+
+	public:
+		BranchNodeIteratorImplT(const DenseImageBranchLayer *layer, int n)
+		:	m_layer(layer), m_n(n)
+		{
+			set_cur();
+		}
+
+		N& operator*() const	{ return m_cur; }
+		N *operator->() const	{ return &m_cur; }
+
+		BranchNodeIteratorImplT& operator++()
+		{
+			m_n = m_layer->next_node(m_n + 1);
+			set_cur();
+			return *this;
+		}
+
+		bool operator==(const typename Base::template NodeIteratorImplBaseT<N>& baseRhs) const
+		{
+			const BranchNodeIteratorImplT& rhs = static_cast<const BranchNodeIteratorImplT&>(baseRhs);
+			return m_n == rhs.m_n;
+		}
+
+		int index() const	{ return m_n; }
+
+	private:
+		void set_cur()
+		{
+			m_cur = BranchNode(m_n != -1 ? &m_layer->slot(m_n) : NULL);
+		}
+	};
+
+	typedef BranchNodeIteratorImplT<BranchNode> BranchNodeIteratorImpl;
+	typedef BranchNodeIteratorImplT<const BranchNode> BranchNodeConstIteratorImpl;
+	typedef BranchNodeIteratorImplT<typename Base::Node> NodeIteratorImpl;
+	typedef BranchNodeIteratorImplT<const typename Base::Node> NodeConstIteratorImpl;
+
+public:
+	typedef typename Base::template NodeIteratorT<BranchNode, BranchNodeIteratorImpl> BranchNodeIterator;
+	typedef typename Base::template NodeIteratorT<const BranchNode, BranchNodeConstIteratorImpl> BranchNodeConstIterator;
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	std::vector<boost::uint64_t> m_presence;		// bit n is set iff node n exists
+	mutable boost::unordered_map<int,NodeSlot> m_slots;	// note: this is mutable because we need to be able to hand out non-const nodes from a BranchNodeIterator
+	std::vector<boost::uint64_t> m_summary;			// bit w is set iff m_presence[w] != 0
+
+	//#################### CONSTRUCTORS ####################
+public:
+	DenseImageBranchLayer()
+	{}
+
+	//#################### COPY CONSTRUCTOR & ASSIGNMENT OPERATOR ####################
+private:
+	DenseImageBranchLayer(const DenseImageBranchLayer&);
+	DenseImageBranchLayer& operator=(const DenseImageBranchLayer&);
+
+	//#################### PUBLIC METHODS ####################
+public:
+	std::vector<Edge> adjacent_edges(int n) const
+	{
+		return checked_slot(n).m_edges;
+	}
+
+	std::vector<int> adjacent_nodes(int n) const
+	{
+		const std::vector<Edge>& edges = checked_slot(n).m_edges;
+		std::vector<int> ret;
+		ret.reserve(edges.size());
+		for(typename std::vector<Edge>::const_iterator it=edges.begin(), iend=edges.end(); it!=iend; ++it)
+		{
+			ret.push_back(it->u == n ? it->v : it->u);
+		}
+		return ret;
+	}
+
+	BranchNodeIterator branch_nodes_begin()
+	{
+		return BranchNodeIterator(new BranchNodeIteratorImpl(this, next_node(0)));
+	}
+
+	BranchNodeConstIterator branch_nodes_cbegin() const
+	{
+		return BranchNodeConstIterator(new BranchNodeConstIteratorImpl(this, next_node(0)));
+	}
+
+	BranchNodeConstIterator branch_nodes_cend() const
+	{
+		return BranchNodeConstIterator(new BranchNodeConstIteratorImpl(this, -1));
+	}
+
+	BranchNodeIterator branch_nodes_end()
+	{
+		return BranchNodeIterator(new BranchNodeIteratorImpl(this, -1));
+	}
+
+	BranchProperties combine_properties(const std::set<int>& nodeIndices) const
+	{
+		std::vector<BranchProperties> properties;
+		properties.reserve(nodeIndices.size());
+		for(std::set<int>::const_iterator it=nodeIndices.begin(), iend=nodeIndices.end(); it!=iend; ++it)
+		{
+			properties.push_back(node_properties(*it));
+		}
+		return BranchProperties::combine_branch_properties(properties);
+	}
+
+	EdgeWeight edge_weight(int u, int v) const
+	{
+		const Edge *e = find_edge(u, v);
+		if(e) return e->weight;
+		else throw Exception(OSSWrapper() << "No such edge: {" << u << ',' << v << '}');
+	}
+
+	std::vector<Edge> edges() const
+	{
+		return std::vector<Edge>(edges_cbegin(), edges_cend());
+	}
+
+	typename Base::EdgeConstIterator edges_cbegin() const
+	{
+		return typename Base::EdgeConstIterator(new EdgeConstIteratorImpl(this, next_node(0)));
+	}
+
+	typename Base::EdgeConstIterator edges_cend() const
+	{
+		return typename Base::EdgeConstIterator(new EdgeConstIteratorImpl(this, -1));
+	}
+
+	template <typename Func>
+	Func for_each_edge(Func f) const
+	{
+		// Visit the edges {u,v} (with u < v) adjacent to each node u in turn (see EdgeConstIteratorImpl::seek()).
+		for(int n=next_node(0); n!=-1; n=next_node(n+1))
+		{
+			const std::vector<Edge>& edges = slot(n).m_edges;
+			typename std::vector<Edge>::const_iterator it = std::upper_bound(edges.begin(), edges.end(), n, OtherEndLess(n));
+			for(typename std::vector<Edge>::const_iterator iend=edges.end(); it!=iend; ++it) f(*it);
+		}
+		return f;
+	}
+
+	void for_each_edge_block(std::vector<Edge>& block, typename Base::EdgeBlockVisitor& visitor) const
+	{
+		block.clear();
+		for(int n=next_node(0); n!=-1; n=next_node(n+1))
+		{
+			const std::vector<Edge>& edges = slot(n).m_edges;
+			typename std::vector<Edge>::const_iterator it = std::upper_bound(edges.begin(), edges.end(), n, OtherEndLess(n));
+			for(typename std::vector<Edge>::const_iterator iend=edges.end(); it!=iend; ++it)
+			{
+				block.push_back(*it);
+				if(block.size() == static_cast<size_t>(Base::BLOCK_SIZE))
+				{
+					visitor.visit_edges(block);
+					block.clear();
+				}
+			}
+		}
+		if(!block.empty()) visitor.visit_edges(block);
+	}
+
+	template <typename Func>
+	Func for_each_node(Func f) const
+	{
+		for(int n=next_node(0); n!=-1; n=next_node(n+1)) f(n, slot(n).m_parent);
+		return f;
+	}
+
+	void for_each_node_block(std::vector<int>& nodes, std::vector<int>& parents, typename Base::NodeBlockVisitor& visitor) const
+	{
+		nodes.clear();
+		parents.clear();
+		for(int n=next_node(0); n!=-1; n=next_node(n+1))
+		{
+			nodes.push_back(n);
+			parents.push_back(slot(n).m_parent);
+			if(nodes.size() == static_cast<size_t>(Base::BLOCK_SIZE))
+			{
+				visitor.visit_nodes(nodes, parents);
+				nodes.clear();
+				parents.clear();
+			}
+		}
+		if(!nodes.empty()) visitor.visit_nodes(nodes, parents);
+	}
+
+	bool has_edge(int u, int v) const
+	{
+		return find_edge(u, v) != NULL;
+	}
+
+	bool has_node(int n) const
+	{
+		return n >= 0 && (n >> 6) < static_cast<int>(m_presence.size()) && (m_presence[n >> 6] & (boost::uint64_t(1) << (n & 63))) != 0;
+	}
+
+	std::set<int>& node_children(int n)
+	{
+		return checked_slot(n).m_children;
+	}
+
+	const std::set<int>& node_children(int n) const
+	{
+		return checked_slot(n).m_children;
+	}
+
+	int node_count() const
+	{
+		return static_cast<int>(m_slots.size());
+	}
+
+	std::vector<int> node_indices() const
+	{
+		std::vector<int> ret;
+		ret.reserve(m_slots.size());
+		for(int n=next_node(0); n!=-1; n=next_node(n+1))
+		{
+			ret.push_back(n);
+		}
+		return ret;
+	}
+
+	int node_parent(int n) const
+	{
+		return checked_slot(n).m_parent;
+	}
+
+	const NodeProperties& node_properties(int n) const
+	{
+		return checked_slot(n).m_properties;
+	}
+
+	typename Base::NodeIterator nodes_begin()
+	{
+		return typename Base::NodeIterator(new NodeIteratorImpl(this, next_node(0)));
+	}
+
+	typename Base::NodeConstIterator nodes_cbegin() const
+	{
+		return typename Base::NodeConstIterator(new NodeConstIteratorImpl(this, next_node(0)));
+	}
+
+	typename Base::NodeConstIterator nodes_cend() const
+	{
+		return typename Base::NodeConstIterator(new NodeConstIteratorImpl(this, -1));
+	}
+
+	typename Base::NodeIterator nodes_end()
+	{
+		return typename Base::NodeIterator(new NodeIteratorImpl(this, -1));
+	}
+
+	void remove_edge(int u, int v)
+	{
+		if(!has_edge(u, v)) throw Exception(OSSWrapper() << "No such edge: {" << u << ',' << v << '}');
+		erase_half_edge(u, v);
+		erase_half_edge(v, u);
+	}
+
+	void remove_node(int n)
+	{
+		NodeSlot& s = checked_slot(n);
+
+		// Remove any edges connected to the node.
+		for(typename std::vector<Edge>::const_iterator it=s.m_edges.begin(), iend=s.m_edges.end(); it!=iend; ++it)
+		{
+			erase_half_edge(it->u == n ? it->v : it->u, n);
+		}
+
+		// Release the node's slot and mark the node as absent.
+		m_slots.erase(n);
+		set_present(n, false);
+	}
+
+	void set_edge_weight(int u, int v, EdgeWeight weight)
+	{
+		if(u == v) throw Exception(OSSWrapper() << "Reflexive edges are not allowed: " << u);
+		if(!has_node(u)) throw Exception(OSSWrapper() << "No such node: " << u);
+		if(!has_node(v)) throw Exception(OSSWrapper() << "No such node: " << v);
+
+		Edge e(std::min(u, v), std::max(u, v), weight);
+		set_half_edge(u, v, e);
+		set_half_edge(v, u, e);
+	}
+
+	void set_node_children(int n, const std::set<int>& children)
+	{
+		ensure_slot(n).m_children = children;
+	}
+
+	void set_node_parent(int n, int parent)
+	{
+		ensure_slot(n).m_parent = parent;
+	}
+
+	void set_node_properties(int n, const NodeProperties& properties)
+	{
+		ensure_slot(n).m_properties = properties;
+	}
+
+	void update_edge_weight(int u, int v, EdgeWeight weight)
+	{
+		const Edge *e = find_edge(u, v);
+		if(!e || weight < e->weight) set_edge_weight(u, v, weight);
+	}
+
+	//#################### PRIVATE METHODS ####################
+private:
+	NodeSlot& checked_slot(int n) const
+	{
+		if(has_node(n)) return slot(n);
+		else throw Exception(OSSWrapper() << "No such node: " << n);
+	}
+
+	NodeSlot& ensure_slot(int n)
+	{
+		if(n < 0) throw Exception(OSSWrapper() << "Invalid node index: " << n);
+		if(has_node(n)) return slot(n);
+
+		if((n >> 6) >= static_cast<int>(m_presence.size()))
+		{
+			m_presence.resize((n >> 6) + 1, 0);
+			m_summary.resize((n >> 12) + 1, 0);
+		}
+
+		set_present(n, true);
+		return m_slots[n];
+	}
+
+	void erase_half_edge(int n, int other)
+	{
+		std::vector<Edge>& edges = slot(n).m_edges;
+		typename std::vector<Edge>::iterator it = std::lower_bound(edges.begin(), edges.end(), other, OtherEndLess(n));
+		edges.erase(it);
+	}
+
+	const Edge *find_edge(int u, int v) const
+	{
+		if(!has_node(u) || !has_node(v)) return NULL;
+		const std::vector<Edge>& edges = slot(u).m_edges;
+		typename std::vector<Edge>::const_iterator it = std::lower_bound(edges.begin(), edges.end(), v, OtherEndLess(u));
+		return it != edges.end() && OtherEndLess(u).other(*it) == v ? &*it : NULL;
+	}
+
+	static int lowest_set_bit(boost::uint64_t word)
+	{
+		// Note: This uses the standard de Bruijn sequence technique, and requires word to be non-zero.
+		static const int TABLE[64] =
+		{
+			 0,  1, 48,  2, 57, 49, 28,  3, 61, 58, 50, 42, 38, 29, 17,  4,
+			62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12,  5,
+			63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+			46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19,  9, 13,  8,  7,  6
+		};
+		const boost::uint64_t DEBRUIJN = 0x03f79d71b4cb0a89ULL;
+		return TABLE[((word & (~word + 1)) * DEBRUIJN) >> 58];
+	}
+
+	/**
+	@brief	Returns the smallest index >= n of a node in the layer, or -1 if there is no such node.
+	*/
+	int next_node(int n) const
+	{
+		int wordCount = static_cast<int>(m_presence.size());
+		int w = n >> 6;
+		if(w >= wordCount) return -1;
+
+		// Check the remainder of the word containing n.
+		boost::uint64_t bits = m_presence[w] & (~boost::uint64_t(0) << (n & 63));
+		if(bits) return (w << 6) + lowest_set_bit(bits);
+
+		// Use the summary bitmap to find the next non-empty word.
+		++w;
+		if(w >= wordCount) return -1;
+		int s = w >> 6, summaryCount = static_cast<int>(m_summary.size());
+		boost::uint64_t summaryBits = m_summary[s] & (~boost::uint64_t(0) << (w & 63));
+		while(!summaryBits)
+		{
+			if(++s == summaryCount) return -1;
+			summaryBits = m_summary[s];
+		}
+		w = (s << 6) + lowest_set_bit(summaryBits);
+		return (w << 6) + lowest_set_bit(m_presence[w]);
+	}
+
+	void set_half_edge(int n, int other, const Edge& e)
+	{
+		std::vector<Edge>& edges = slot(n).m_edges;
+		typename std::vector<Edge>::iterator it = std::lower_bound(edges.begin(), edges.end(), other, OtherEndLess(n));
+		if(it != edges.end() && OtherEndLess(n).other(*it) == other) *it = e;
+		else edges.insert(it, e);
+	}
+
+	void set_present(int n, bool present)
+	{
+		int w = n >> 6;
+		boost::uint64_t bit = boost::uint64_t(1) << (n & 63);
+		if(present) m_presence[w] |= bit;
+		else m_presence[w] &= ~bit;
+
+		boost::uint64_t summaryBit = boost::uint64_t(1) << (w & 63);
+		if(m_presence[w]) m_summary[w >> 6] |= summaryBit;
+		else m_summary[w >> 6] &= ~summaryBit;
+	}
+
+	NodeSlot& slot(int n) const
+	{
+		return m_slots.find(n)->second;
+	}
+};
+
+}
+
+#endif
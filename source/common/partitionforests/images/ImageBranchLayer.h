@@ -1,6 +1,7 @@
 /***
  * millipede: ImageBranchLayer.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_IMAGEBRANCHLAYER
@@ -215,6 +216,49 @@ public:
 		return typename Base::EdgeConstIterator(new EdgeConstIteratorImpl(m_graph.edges_cend()));
 	}
 
+	template <typename Func>
+	Func for_each_edge(Func f) const
+	{
+		return m_graph.for_each_edge(f);
+	}
+
+	void for_each_edge_block(std::vector<Edge>& block, typename Base::EdgeBlockVisitor& visitor) const
+	{
+		typename GraphType::EdgeCIter it = m_graph.edges_cbegin(), iend = m_graph.edges_cend();
+		while(it != iend)
+		{
+			block.clear();
+			for(int i=0; i<Base::BLOCK_SIZE && it!=iend; ++i, ++it) block.push_back(*it);
+			visitor.visit_edges(block);
+		}
+	}
+
+	template <typename Func>
+	Func for_each_node(Func f) const
+	{
+		for(typename std::map<int,ForestLinks>::const_iterator it=m_forestLinks.begin(), iend=m_forestLinks.end(); it!=iend; ++it)
+		{
+			f(it->first, it->second.m_parent);
+		}
+		return f;
+	}
+
+	void for_each_node_block(std::vector<int>& nodes, std::vector<int>& parents, typename Base::NodeBlockVisitor& visitor) const
+	{
+		typename std::map<int,ForestLinks>::const_iterator it = m_forestLinks.begin(), iend = m_forestLinks.end();
+		while(it != iend)
+		{
+			nodes.clear();
+			parents.clear();
+			for(int i=0; i<Base::BLOCK_SIZE && it!=iend; ++i, ++it)
+			{
+				nodes.push_back(it->first);
+				parents.push_back(it->second.m_parent);
+			}
+			visitor.visit_nodes(nodes, parents);
+		}
+	}
+
 	bool has_edge(int u, int v) const
 	{
 		return m_graph.has_edge(u, v);
@@ -7,6 +7,7 @@
 #ifndef H_MILLIPEDE_IMAGELEAFLAYER
 #define H_MILLIPEDE_IMAGELEAFLAYER
 
+#include <algorithm>
 #include <vector>
 
 #include <common/adts/WeightedEdge.h>
@@ -30,19 +31,22 @@ public:
 
 	//#################### NESTED CLASSES (EXCLUDING ITERATORS) ####################
 public:
+	/**
+	@brief	A LeafNode is a lightweight view of a node in the layer (the node data itself is stored by the layer in separate arrays).
+	*/
 	class LeafNode : public Base::Node
 	{
 	private:
-		int m_parent;
-		NodeProperties m_properties;
+		ImageLeafLayer *m_base;
+		int m_index;
 	public:
-		explicit LeafNode(const NodeProperties& properties)
-		:	m_parent(-1), m_properties(properties)
+		LeafNode(ImageLeafLayer *base, int index)
+		:	m_base(base), m_index(index)
 		{}
 
-		int parent() const							{ return m_parent; }
-		const NodeProperties& properties() const	{ return m_properties; }
-		void set_parent(int parent)					{ m_parent = parent; }
+		int parent() const						{ return m_base->node_parent(m_index); }
+		NodeProperties properties() const		{ return m_base->node_properties(m_index); }
+		void set_parent(int parent)				{ m_base->set_node_parent(m_index, parent); }
 	};
 
 	//#################### CONSTANTS ####################
@@ -63,17 +67,17 @@ private:
 		const ImageLeafLayer *m_base;
 		int m_currentNode;
 		EdgeDir m_currentDir;
-		mutable boost::shared_ptr<Edge> m_currentEdge;
+		Edge m_currentEdge;
 
 	public:
 		EdgeConstIteratorImpl(const ImageLeafLayer *base, int currentNode)
-		:	m_base(base), m_currentNode(currentNode), m_currentDir(NONE)
+		:	m_base(base), m_currentNode(currentNode), m_currentDir(NONE), m_currentEdge(-1, -1, EdgeWeight())
 		{
 			if(m_currentNode != m_base->m_sizeXYZ) advance();
 		}
 
-		const Edge& operator*() const	{ return *m_currentEdge; }
-		const Edge *operator->() const	{ return m_currentEdge.get(); }
+		const Edge& operator*() const	{ return m_currentEdge; }
+		const Edge *operator->() const	{ return &m_currentEdge; }
 
 		EdgeConstIteratorImpl& operator++()
 		{
@@ -133,30 +137,32 @@ private:
 					case ZPOS:	v = m_currentNode + m_base->m_sizeXY;	break;
 					default:	throw Exception("Cannot make current edge");	// this should never happen
 				}
-				m_currentEdge.reset(new Edge(m_currentNode, v, m_base->edge_weight(m_currentNode, v)));
+				m_currentEdge = Edge(m_currentNode, v, m_base->edge_weight(m_currentNode, v));
 			}
-			else m_currentEdge.reset();
+			else m_currentEdge = Edge(-1, -1, EdgeWeight());
 		}
 	};
 
-	// Note: Either Vec = std::vector<LeafNode> or Vec = const std::vector<LeafNode>.
-	template <typename N, typename LeafNodeVec>
+	// Note: Either N = LeafNode (or Base::Node) or N = const LeafNode (or const Base::Node).
+	template <typename N>
 	class LeafNodeIteratorImplT : public Base::template NodeIteratorImplBaseT<N>
 	{
 	private:
+		ImageLeafLayer *m_base;
 		int m_index;
-		LeafNodeVec& m_nodes;
+		mutable LeafNode m_node;
 	public:
-		LeafNodeIteratorImplT(int index, LeafNodeVec& nodes)
-		:	m_index(index), m_nodes(nodes)
+		// Note: The const_cast is safe, because the const iterators only ever hand out const nodes.
+		LeafNodeIteratorImplT(int index, const ImageLeafLayer *base)
+		:	m_base(const_cast<ImageLeafLayer*>(base)), m_index(index), m_node(m_base, index)
 		{}
 
-		N& operator*() const	{ return m_nodes[m_index]; }
-		N *operator->() const	{ return &m_nodes[m_index]; }
+		N& operator*() const	{ return m_node; }
+		N *operator->() const	{ return &m_node; }
 
 		LeafNodeIteratorImplT& operator++()
 		{
-			++m_index;
+			m_node = LeafNode(m_base, ++m_index);
 			return *this;
 		}
 
@@ -172,10 +178,10 @@ private:
 		}
 	};
 
-	typedef LeafNodeIteratorImplT<LeafNode, std::vector<LeafNode> > LeafNodeIteratorImpl;
-	typedef LeafNodeIteratorImplT<const LeafNode, const std::vector<LeafNode> > LeafNodeConstIteratorImpl;
-	typedef LeafNodeIteratorImplT<typename Base::Node, std::vector<LeafNode> > NodeIteratorImpl;
-	typedef LeafNodeIteratorImplT<const typename Base::Node, const std::vector<LeafNode> > NodeConstIteratorImpl;
+	typedef LeafNodeIteratorImplT<LeafNode> LeafNodeIteratorImpl;
+	typedef LeafNodeIteratorImplT<const LeafNode> LeafNodeConstIteratorImpl;
+	typedef LeafNodeIteratorImplT<typename Base::Node> NodeIteratorImpl;
+	typedef LeafNodeIteratorImplT<const typename Base::Node> NodeConstIteratorImpl;
 
 public:
 	typedef typename Base::template NodeIteratorT<LeafNode, LeafNodeIteratorImpl> LeafNodeIterator;
@@ -184,15 +190,9 @@ public:
 	//#################### PROTECTED VARIABLES ####################
 protected:
 	int m_sizeX, m_sizeY, m_sizeZ, m_sizeXY, m_sizeXYZ;
-	std::vector<LeafNode> m_nodes;
+	std::vector<int> m_parents;
 
 	//#################### CONSTRUCTORS ####################
-public:
-	ImageLeafLayer(const std::vector<NodeProperties>& nodeProperties, int sizeX, int sizeY, int sizeZ = 1)
-	{
-		initialise(nodeProperties, sizeX, sizeY, sizeZ);
-	}
-
 protected:
 	ImageLeafLayer() {}
 
@@ -204,6 +204,17 @@ protected:
 public:
 	virtual EdgeWeight edge_weight(int u, int v) const = 0;
 
+	/**
+	@brief	Returns the properties of the specified node.
+
+	The properties are returned by value, so that derived layers are free to store them however they like
+	(e.g. as a separate array for each property, rather than as an array of property objects).
+
+	@param[in]	n	The index of the node (which must be in the right range)
+	@return	The node's properties
+	*/
+	virtual NodeProperties node_properties(int n) const = 0;
+
 	//#################### PUBLIC METHODS ####################
 public:
 	std::vector<Edge> adjacent_edges(int n) const
@@ -259,6 +270,62 @@ public:
 		return typename Base::EdgeConstIterator(new EdgeConstIteratorImpl(this, m_sizeXYZ));
 	}
 
+	/**
+	@brief	Calls f(e) for each edge e in the layer (in the same order as edges_cbegin() and edges_cend() would visit them).
+
+	The edges are generated directly from the grid a block at a time, and their weights are calculated for the whole block
+	at once using set_edge_weights(), so there are no per-edge allocations or virtual calls.
+
+	@param[in]	f	The function object to call
+	@return	The function object, after it has been called for all of the edges
+	*/
+	template <typename Func>
+	Func for_each_edge(Func f) const
+	{
+		std::vector<Edge> block;
+		for(int n=0; n<m_sizeXYZ;)
+		{
+			n = fill_edge_block(n, block);
+			for(typename std::vector<Edge>::const_iterator it=block.begin(), iend=block.end(); it!=iend; ++it) f(*it);
+		}
+		return f;
+	}
+
+	void for_each_edge_block(std::vector<Edge>& block, typename Base::EdgeBlockVisitor& visitor) const
+	{
+		for(int n=0; n<m_sizeXYZ;)
+		{
+			n = fill_edge_block(n, block);
+			visitor.visit_edges(block);
+		}
+	}
+
+	/**
+	@brief	Calls f(n, parent) for each node n in the layer, in ascending order of index.
+
+	@param[in]	f	The function object to call
+	@return	The function object, after it has been called for all of the nodes
+	*/
+	template <typename Func>
+	Func for_each_node(Func f) const
+	{
+		for(int n=0; n<m_sizeXYZ; ++n) f(n, m_parents[n]);
+		return f;
+	}
+
+	void for_each_node_block(std::vector<int>& nodes, std::vector<int>& parents, typename Base::NodeBlockVisitor& visitor) const
+	{
+		for(int n=0; n<m_sizeXYZ;)
+		{
+			int end = std::min(n + static_cast<int>(Base::BLOCK_SIZE), m_sizeXYZ);
+			nodes.clear();
+			for(int i=n; i<end; ++i) nodes.push_back(i);
+			parents.assign(m_parents.begin() + n, m_parents.begin() + end);
+			visitor.visit_nodes(nodes, parents);
+			n = end;
+		}
+	}
+
 	bool has_edge(int u, int v) const
 	{
 		// Note: This is a 6-connected implementation.
@@ -271,39 +338,38 @@ public:
 
 	bool has_node(int n) const
 	{
-		return 0 <= n && n < static_cast<int>(m_nodes.size());
+		return 0 <= n && n < m_sizeXYZ;
 	}
 
 	LeafNodeIterator leaf_nodes_begin()
 	{
-		return LeafNodeIterator(new LeafNodeIteratorImpl(0, m_nodes));
+		return LeafNodeIterator(new LeafNodeIteratorImpl(0, this));
 	}
 
 	LeafNodeConstIterator leaf_nodes_cbegin() const
 	{
-		return LeafNodeConstIterator(new LeafNodeConstIteratorImpl(0, m_nodes));
+		return LeafNodeConstIterator(new LeafNodeConstIteratorImpl(0, this));
 	}
 
 	LeafNodeConstIterator leaf_nodes_cend() const
 	{
-		return LeafNodeConstIterator(new LeafNodeConstIteratorImpl(static_cast<int>(m_nodes.size()), m_nodes));
+		return LeafNodeConstIterator(new LeafNodeConstIteratorImpl(m_sizeXYZ, this));
 	}
 
 	LeafNodeIterator leaf_nodes_end()
 	{
-		return LeafNodeIterator(new LeafNodeIteratorImpl(static_cast<int>(m_nodes.size()), m_nodes));
+		return LeafNodeIterator(new LeafNodeIteratorImpl(m_sizeXYZ, this));
 	}
 
 	int node_count() const
 	{
-		return static_cast<int>(m_nodes.size());
+		return m_sizeXYZ;
 	}
 
 	std::vector<int> node_indices() const
 	{
-		int size = static_cast<int>(m_nodes.size());
-		std::vector<int> ret(size);
-		for(int i=0; i<size; ++i)
+		std::vector<int> ret(m_sizeXYZ);
+		for(int i=0; i<m_sizeXYZ; ++i)
 		{
 			ret[i] = i;
 		}
@@ -313,39 +379,33 @@ public:
 	// Precondition: n is in the right range
 	int node_parent(int n) const
 	{
-		return m_nodes[n].parent();
-	}
-
-	// Precondition: n is in the right range
-	const LeafProperties& node_properties(int n) const
-	{
-		return m_nodes[n].properties();
+		return m_parents[n];
 	}
 
 	typename Base::NodeIterator nodes_begin()
 	{
-		return typename Base::NodeIterator(new NodeIteratorImpl(0, m_nodes));
+		return typename Base::NodeIterator(new NodeIteratorImpl(0, this));
 	}
 
 	typename Base::NodeConstIterator nodes_cbegin() const
 	{
-		return typename Base::NodeConstIterator(new NodeConstIteratorImpl(0, m_nodes));
+		return typename Base::NodeConstIterator(new NodeConstIteratorImpl(0, this));
 	}
 
 	typename Base::NodeConstIterator nodes_cend() const
 	{
-		return typename Base::NodeConstIterator(new NodeConstIteratorImpl(static_cast<int>(m_nodes.size()), m_nodes));
+		return typename Base::NodeConstIterator(new NodeConstIteratorImpl(m_sizeXYZ, this));
 	}
 
 	typename Base::NodeIterator nodes_end()
 	{
-		return typename Base::NodeIterator(new NodeIteratorImpl(static_cast<int>(m_nodes.size()), m_nodes));
+		return typename Base::NodeIterator(new NodeIteratorImpl(m_sizeXYZ, this));
 	}
 
 	// Precondition: n is in the right range
 	void set_node_parent(int n, int parent)
 	{
-		m_nodes[n].set_parent(parent);
+		m_parents[n] = parent;
 	}
 
 	int size_x() const
@@ -365,7 +425,16 @@ public:
 		
 	//#################### PROTECTED METHODS ####################
 protected:
-	void initialise(const std::vector<NodeProperties>& nodeProperties, int sizeX, int sizeY, int sizeZ = 1)
+	/**
+	@brief	Sets the size of the layer and gives each of its nodes an initial parent of -1.
+
+	Derived layers are responsible for storing the properties of the nodes.
+
+	@param[in]	sizeX	The x size of the image
+	@param[in]	sizeY	The y size of the image
+	@param[in]	sizeZ	The z size of the image
+	*/
+	void initialise(int sizeX, int sizeY, int sizeZ = 1)
 	{
 		m_sizeX = sizeX;
 		m_sizeY = sizeY;
@@ -373,13 +442,63 @@ protected:
 		m_sizeXY = m_sizeX * m_sizeY;
 		m_sizeXYZ = m_sizeXY * m_sizeZ;
 
-		size_t size = nodeProperties.size();
-		m_nodes.reserve(size);
-		for(size_t i=0; i<size; ++i) m_nodes.push_back(LeafNode(nodeProperties[i]));
+		m_parents.assign(m_sizeXYZ, -1);
+	}
+
+	/**
+	@brief	Sets the weights of a block of edges in the layer.
+
+	The default implementation calls edge_weight() for each edge: derived layers can override it to calculate the weights
+	directly (with a single virtual call for the whole block).
+
+	@param[in,out]	edges	The edges (each of which must be in the layer)
+	*/
+	virtual void set_edge_weights(std::vector<Edge>& edges) const
+	{
+		for(typename std::vector<Edge>::iterator it=edges.begin(), iend=edges.end(); it!=iend; ++it)
+		{
+			it->weight = edge_weight(it->u, it->v);
+		}
 	}
 
 	//#################### PRIVATE METHODS ####################
 private:
+	/**
+	@brief	Fills the specified block with the edges (u,v) with u >= n, in the same order as an EdgeConstIterator would visit them,
+			until either the block is full or there are no more edges.
+
+	@param[in]	n		The node at which to start
+	@param[out]	block	The block
+	@return	The node at which to start the next block
+	*/
+	int fill_edge_block(int n, std::vector<Edge>& block) const
+	{
+		block.clear();
+		block.reserve(Base::BLOCK_SIZE);
+
+		// Note: Each node contributes at most three edges (in the +x, +y and +z directions) to the block.
+		int x = x_of(n), y = y_of(n), z = z_of(n);
+		for(; n<m_sizeXYZ && block.size() + 3 <= static_cast<size_t>(Base::BLOCK_SIZE); ++n)
+		{
+			if(x != m_sizeX - 1)	block.push_back(Edge(n, n + 1, EdgeWeight()));
+			if(y != m_sizeY - 1)	block.push_back(Edge(n, n + m_sizeX, EdgeWeight()));
+			if(z != m_sizeZ - 1)	block.push_back(Edge(n, n + m_sizeXY, EdgeWeight()));
+
+			if(++x == m_sizeX)
+			{
+				x = 0;
+				if(++y == m_sizeY)
+				{
+					y = 0;
+					++z;
+				}
+			}
+		}
+
+		set_edge_weights(block);
+		return n;
+	}
+
 	Vector3i position_of(int n) const	{ return Vector3i(x_of(n), y_of(n), z_of(n)); }
 	int x_of(int n) const				{ return GridUtil::x_of(n, m_sizeX); }
 	int y_of(int n) const				{ return GridUtil::y_of(n, m_sizeX, m_sizeY); }
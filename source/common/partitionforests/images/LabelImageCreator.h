@@ -1,14 +1,22 @@
 /***
  * millipede: LabelImageCreator.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_LABELIMAGECREATOR
 #define H_MILLIPEDE_LABELIMAGECREATOR
 
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+#include <boost/bind.hpp>
+
 #include <itkImage.h>
 
 #include <common/jobs/DataHook.h>
+#include <common/jobs/ParallelJob.h>
 #include <common/jobs/SimpleJob.h>
 #include <common/partitionforests/images/VolumeIPFMultiFeatureSelection.h>
 #include <common/util/ITKImageUtil.h>
@@ -41,11 +49,12 @@ private:
 	DataHook<LabelImagePointer> m_labellingHook;
 	itk::Size<3> m_labellingSize;
 	VolumeIPFMultiFeatureSelection_CPtr m_multiFeatureSelection;
+	int m_threadCount;
 
 	//#################### CONSTRUCTORS ####################
 public:
-	explicit LabelImageCreator(const VolumeIPFMultiFeatureSelection_CPtr& multiFeatureSelection)
-	:	m_multiFeatureSelection(multiFeatureSelection)
+	explicit LabelImageCreator(const VolumeIPFMultiFeatureSelection_CPtr& multiFeatureSelection, int threadCount = ParallelJob::default_thread_count())
+	:	m_multiFeatureSelection(multiFeatureSelection), m_threadCount(threadCount)
 	{
 		m_labellingSize = multiFeatureSelection->volume_ipf()->volume_size();
 		for(int i=0; i<3; ++i) m_labellingSize[i] += 2;		// add a single voxel border around the labelling (otherwise we can't visualize single slices etc.)
@@ -78,28 +87,75 @@ private:
 		LabelImagePointer labelling = ITKImageUtil::make_image<int>(m_labellingSize);
 		labelling->FillBuffer(0);
 
+		// Find the lowest layer containing any of the selected nodes. Every selected node is the union of some of the nodes
+		// in this layer, so the labelling can be determined from the ancestors of the voxels in this layer alone.
+		int lowestLayer = INT_MAX;
 		for(Feature f=enum_begin<Feature>(), end=enum_end<Feature>(); f!=end; ++f)
 		{
 			if(!m_multiFeatureSelection->has_selection(f)) continue;
 
 			PartitionForestSelection_CPtr selection = m_multiFeatureSelection->selection(f);
-			int value = feature_to_int(f);
-
 			typedef typename PartitionForestSelectionT::NodeConstIterator Iter;
 			for(Iter it=selection->nodes_cbegin(), iend=selection->nodes_cend(); it!=iend; ++it)
 			{
-				std::deque<int> receptiveRegion = volumeIPF->receptive_region_of(*it);
-				for(std::deque<int>::const_iterator jt=receptiveRegion.begin(), jend=receptiveRegion.end(); jt!=jend; ++jt)
+				lowestLayer = std::min(lowestLayer, it->layer());
+			}
+		}
+
+		if(lowestLayer != INT_MAX)
+		{
+			// Label the nodes in the lowest layer with the features to which they belong (later features take precedence,
+			// as they would if the receptive region of each selected node were labelled in turn).
+			std::vector<int> nodeValues(volumeIPF->leaf_layer()->node_count(), 0);
+			for(Feature f=enum_begin<Feature>(), end=enum_end<Feature>(); f!=end; ++f)
+			{
+				if(!m_multiFeatureSelection->has_selection(f)) continue;
+
+				PartitionForestSelection_CPtr selection = m_multiFeatureSelection->selection(f);
+				int value = feature_to_int(f);
+
+				typedef typename PartitionForestSelectionT::ViewNodeConstIterator Iter;
+				for(Iter it=selection->view_at_layer_cbegin(lowestLayer), iend=selection->view_at_layer_cend(lowestLayer); it!=iend; ++it)
 				{
-					itk::Index<3> position = volumeIPF->position_of_leaf(*jt);
-					itk::Index<3> index = {{position[0]+1, (m_labellingSize[1]-2) - position[1], position[2]+1}};	// note the flipped y axis
-					labelling->SetPixel(index, value);
+					nodeValues[it->index()] = value;
 				}
 			}
+
+			// Look up the ancestor of each voxel in that layer (the label volume is cached by the forest, and shared with
+			// anything else that needs to map voxels to nodes in the layer), and fill in the labelling a z-slab at a time.
+			const int *labels = NULL;
+			typename VolumeIPFT::Labels_CPtr labelsPtr;
+			if(lowestLayer > 0)
+			{
+				labelsPtr = volumeIPF->layer_labels(lowestLayer);
+				labels = &(*labelsPtr)[0];
+			}
+
+			ParallelJob::run_slabs(static_cast<int>(m_labellingSize[2]) - 2,
+								   boost::bind(&LabelImageCreator::fill_slab, this, labelling->GetBufferPointer(), labels, &nodeValues[0], _1, _2),
+								   m_threadCount);
 		}
 
 		m_labellingHook.set(labelling);
 	}
+
+	void fill_slab(int *labelling, const int *labels, const int *nodeValues, int zBegin, int zEnd) const
+	{
+		// Note:	The labelling has a single voxel border around the volume, and its y axis is flipped.
+		const int sizeX = static_cast<int>(m_labellingSize[0]) - 2, sizeY = static_cast<int>(m_labellingSize[1]) - 2;
+		const int labellingStrideY = sizeX + 2, labellingStrideZ = labellingStrideY * (sizeY + 2);
+
+		int n = zBegin * sizeX * sizeY;
+		for(int z=zBegin; z<zEnd; ++z)
+			for(int y=0; y<sizeY; ++y)
+			{
+				int *row = labelling + (z+1) * labellingStrideZ + (sizeY - y) * labellingStrideY + 1;
+				for(int x=0; x<sizeX; ++x, ++n)
+				{
+					row[x] = nodeValues[labels ? labels[n] : n];
+				}
+			}
+	}
 };
 
 }
@@ -1,16 +1,19 @@
 /***
  * millipede: MosaicImageCreator.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_MOSAICIMAGECREATOR
 #define H_MILLIPEDE_MOSAICIMAGECREATOR
 
-#include <itkShapedNeighborhoodIterator.h>
-#include <itkZeroFluxNeumannBoundaryCondition.h>
+#include <limits>
+#include <vector>
+
+#include <boost/bind.hpp>
 
-#include <common/io/util/OSSWrapper.h>
 #include <common/jobs/DataHook.h>
+#include <common/jobs/ParallelJob.h>
 #include <common/jobs/SimpleJob.h>
 #include <common/partitionforests/images/VolumeIPF.h>
 #include <common/slices/SliceOrientation.h>
@@ -32,13 +35,15 @@ private:
 	int m_layerIndex;
 	DataHook<MosaicImage::Pointer> m_mosaicImageHook;
 	SliceOrientation m_sliceOrientation;
+	int m_threadCount;
 	VolumeIPF_CPtr m_volumeIPF;
 	bool m_withBoundaries;
 
 	//#################### CONSTRUCTORS ####################
 public:
-	MosaicImageCreator(const VolumeIPF_CPtr& volumeIPF, int layerIndex, SliceOrientation sliceOrientation, bool withBoundaries)
-	:	m_layerIndex(layerIndex), m_sliceOrientation(sliceOrientation), m_volumeIPF(volumeIPF), m_withBoundaries(withBoundaries)
+	MosaicImageCreator(const VolumeIPF_CPtr& volumeIPF, int layerIndex, SliceOrientation sliceOrientation, bool withBoundaries,
+					   int threadCount = ParallelJob::default_thread_count())
+	:	m_layerIndex(layerIndex), m_sliceOrientation(sliceOrientation), m_threadCount(threadCount), m_volumeIPF(volumeIPF), m_withBoundaries(withBoundaries)
 	{}
 
 	//#################### PUBLIC METHODS ####################
@@ -55,108 +60,83 @@ public:
 
 	//#################### PRIVATE METHODS ####################
 private:
-	void execute_boundaries()
+	void execute_impl()
 	{
-		typedef itk::Image<PFNodeID,3> AncestorImage;
+		set_status("Creating mosaic image...");
 
-		// Create an image containing the ancestors of the leaves corresponding to the pixels in the specified layer of the forest.
 		itk::Size<3> volumeSize = m_volumeIPF->volume_size();
-		AncestorImage::Pointer ancestorImage = ITKImageUtil::make_image<PFNodeID>(volumeSize);
-
-		// Note: An index has signed values, whereas a size has unsigned ones. Doing this avoids signed/unsigned mismatch warnings.
-		itk::Index<3> size = ITKImageUtil::make_index_from_size(volumeSize);
-
-		itk::Index<3> p;
-		for(p[2]=0; p[2]<size[2]; ++p[2])
-			for(p[1]=0; p[1]<size[1]; ++p[1])
-				for(p[0]=0; p[0]<size[0]; ++p[0])
-				{
-					ancestorImage->SetPixel(p, m_volumeIPF->node_of(m_layerIndex, p));
-				}
-
-		// Set up an iterator to traverse the ancestor image, whilst allowing us to access the neighbours of each pixel.
-		// The neighbours in this case are used only to determine whether or not a pixel is on a boundary, and as such are
-		// dependent on the orientation of the slices being viewed.
-		typedef itk::ConstShapedNeighborhoodIterator<AncestorImage> NIT;
-		itk::Size<3> radius = {{1,1,1}};
-		NIT it(radius, ancestorImage, ancestorImage->GetLargestPossibleRegion());
-		std::vector<itk::Offset<3> > offsets = ITKImageUtil::make_4_connected_offsets(m_sliceOrientation);
-		for(std::vector<itk::Offset<3> >::const_iterator kt=offsets.begin(), kend=offsets.end(); kt!=kend; ++kt)
-		{
-			it.ActivateOffset(*kt);
-		}
-
-		// Set up a boundary condition that makes ancestor pixels beyond the image boundary equal to those on them.
-		itk::ZeroFluxNeumannBoundaryCondition<AncestorImage> condition;
-		it.OverrideBoundaryCondition(&condition);
-
-		// Create the mosaic image by traversing the ancestor image. We mark boundaries where appropriate,
-		// and obtain the non-boundary mosaic values from the properties of the ancestor nodes.
 		MosaicImage::Pointer mosaicImage = ITKImageUtil::make_image<unsigned char>(volumeSize);
 
-		for(it.GoToBegin(); !it.IsAtEnd(); ++it)
+		// Look up the ancestor of each leaf in the specified layer. The label volume is cached by the forest (and shared
+		// with anything else that needs to map voxels to nodes in this layer), so it is only built the first time around.
+		// Leaves are numbered in the same (x-fastest) order as the voxels in the image buffer.
+		const int *labels = NULL;
+		typename VolumeIPFT::Labels_CPtr labelsPtr;
+		std::vector<unsigned char> nodeValues;
+		if(m_layerIndex > 0)
 		{
-			bool regionBoundary = false;
-			for(NIT::ConstIterator jt=it.Begin(), jend=it.End(); jt!=jend; ++jt)
-			{
-				// If one of the pixel's neighbours has a different ancestor, the pixel is a boundary.
-				if(jt.Get() != it.GetCenterPixel())
-				{
-					regionBoundary = true;
-					break;
-				}
-			}
+			labelsPtr = m_volumeIPF->layer_labels(m_layerIndex);
+			labels = &(*labelsPtr)[0];
 
-			unsigned char mosaicValue;
-			if(regionBoundary)
+			// Calculate the mosaic value for each node in the layer up-front, rather than once per voxel.
+			nodeValues.resize(labelsPtr->size());
+			boost::shared_ptr<const BranchLayer> layer = m_volumeIPF->branch_layer(m_layerIndex);
+			for(typename BranchLayer::BranchNodeConstIterator it=layer->branch_nodes_cbegin(), iend=layer->branch_nodes_cend(); it!=iend; ++it)
 			{
-				mosaicValue = std::numeric_limits<unsigned char>::max();
+				PFNodeID node(m_layerIndex, it.index());
+				nodeValues[it.index()] = static_cast<unsigned char>(m_volumeIPF->branch_properties(node).mean_grey_value());
 			}
-			else
-			{
-				if(m_layerIndex > 0)	mosaicValue = static_cast<unsigned char>(m_volumeIPF->branch_properties(it.GetCenterPixel()).mean_grey_value());
-				else					mosaicValue = m_volumeIPF->leaf_properties(it.GetCenterPixel().index()).grey_value();
-			}
-			mosaicImage->SetPixel(it.GetIndex(), mosaicValue);
 		}
 
-		m_mosaicImageHook.set(mosaicImage);
-	}
+		// Fill in the mosaic image a z-slab at a time, in parallel.
+		ParallelJob::run_slabs(static_cast<int>(volumeSize[2]),
+							   boost::bind(&MosaicImageCreator::fill_slab, this, mosaicImage->GetBufferPointer(), labels, nodeValues.empty() ? NULL : &nodeValues[0], _1, _2),
+							   m_threadCount);
 
-	void execute_impl()
-	{
-		set_status("Creating mosaic image...");
-		if(m_withBoundaries)	execute_boundaries();
-		else					execute_no_boundaries();
+		m_mosaicImageHook.set(mosaicImage);
 	}
 
-	void execute_no_boundaries()
+	void fill_slab(unsigned char *mosaic, const int *labels, const unsigned char *nodeValues, int zBegin, int zEnd) const
 	{
-		itk::Size<3> volumeSize = m_volumeIPF->volume_size();
-		MosaicImage::Pointer mosaicImage = ITKImageUtil::make_image<unsigned char>(volumeSize);
-
-		// Note: An index has signed values, whereas a size has unsigned ones. Doing this avoids signed/unsigned mismatch warnings.
-		itk::Index<3> size = ITKImageUtil::make_index_from_size(volumeSize);
-
-		itk::Index<3> index;
-		for(index[2]=0; index[2]<size[2]; ++index[2])
-			for(index[1]=0; index[1]<size[1]; ++index[1])
-				for(index[0]=0; index[0]<size[0]; ++index[0])
+		const itk::Size<3>& volumeSize = m_volumeIPF->volume_size();
+		const int size[3] = { static_cast<int>(volumeSize[0]), static_cast<int>(volumeSize[1]), static_cast<int>(volumeSize[2]) };
+		const int strides[3] = { 1, size[0], size[0] * size[1] };
+
+		// The neighbours used to determine whether or not a voxel is on a boundary are its 4-connected neighbours within
+		// the slices being viewed, i.e. those along the two axes other than the one perpendicular to the slices (whose
+		// index is the same as the slice orientation). Voxels beyond the edge of the volume count as being in the same
+		// region as those on it, so the edge of the volume is not itself a boundary.
+		const int axisA = m_sliceOrientation == 0 ? 1 : 0;
+		const int axisB = m_sliceOrientation == 2 ? 1 : 2;
+
+		int p[3];
+		for(p[2]=zBegin; p[2]<zEnd; ++p[2])
+			for(p[1]=0; p[1]<size[1]; ++p[1])
+			{
+				int n = p[2] * strides[2] + p[1] * strides[1];
+				for(p[0]=0; p[0]<size[0]; ++p[0], ++n)
 				{
-					int n = m_volumeIPF->leaf_of_position(index);
+					int node = label_of(labels, n);
 
-					unsigned char mosaicValue;
-					if(m_layerIndex > 0)
+					bool regionBoundary = false;
+					if(m_withBoundaries)
 					{
-						PFNodeID ancestor = m_volumeIPF->ancestor_of(PFNodeID(0,n), m_layerIndex);
-						mosaicValue = static_cast<unsigned char>(m_volumeIPF->branch_properties(ancestor).mean_grey_value());
+						regionBoundary =	(p[axisA] > 0 && label_of(labels, n - strides[axisA]) != node) ||
+											(p[axisA] < size[axisA] - 1 && label_of(labels, n + strides[axisA]) != node) ||
+											(p[axisB] > 0 && label_of(labels, n - strides[axisB]) != node) ||
+											(p[axisB] < size[axisB] - 1 && label_of(labels, n + strides[axisB]) != node);
 					}
-					else mosaicValue = m_volumeIPF->leaf_properties(n).grey_value();
 
-					mosaicImage->SetPixel(index, mosaicValue);
+					if(regionBoundary)		mosaic[n] = std::numeric_limits<unsigned char>::max();
+					else if(nodeValues)		mosaic[n] = nodeValues[node];
+					else					mosaic[n] = m_volumeIPF->leaf_properties(n).grey_value();
 				}
+			}
+	}
 
-		m_mosaicImageHook.set(mosaicImage);
+	static int label_of(const int *labels, int n)
+	{
+		return labels ? labels[n] : n;
 	}
 };
 
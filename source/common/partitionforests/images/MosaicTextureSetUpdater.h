@@ -1,15 +1,17 @@
 /***
  * millipede: MosaicTextureSetUpdater.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_MOSAICTEXTURESETUPDATER
 #define H_MILLIPEDE_MOSAICTEXTURESETUPDATER
 
 #include <algorithm>
+#include <limits>
+#include <vector>
 
 #include <common/jobs/SimpleJob.h>
-#include <common/util/ITKImageUtil.h>
 #include "VolumeIPF.h"
 
 namespace mp {
@@ -21,6 +23,8 @@ class MosaicTextureSetUpdater : public SimpleJob
 private:
 	typedef VolumeIPF<LeafLayer,BranchLayer> VolumeIPFT;
 	typedef boost::shared_ptr<const VolumeIPFT> VolumeIPF_CPtr;
+	typedef typename VolumeIPFT::LeafRunConstIterator LeafRunConstIterator;
+	typedef typename VolumeIPFT::SliceRuns_CPtr SliceRuns_CPtr;
 
 	//#################### PRIVATE VARIABLES ####################
 private:
@@ -56,53 +60,29 @@ private:
 	{
 		set_status("Updating mosaic texture set...");
 
-		// Step 1:	Build maps in both directions between nodes and pixels.
-		std::map<int,PFNodeID> nodeLookup;
-		std::map<PFNodeID,std::vector<int> > pixelLookup;
+		std::vector<unsigned char> span;
 		for(std::set<int>::const_iterator it=m_nodes.begin(), iend=m_nodes.end(); it!=iend; ++it)
 		{
 			PFNodeID node(m_layerIndex, *it);
-			std::deque<int> receptiveRegion = m_volumeIPF->receptive_region_of(node);
-			for(std::deque<int>::const_iterator jt=receptiveRegion.begin(), jend=receptiveRegion.end(); jt!=jend; ++jt)
-			{
-				nodeLookup.insert(std::make_pair(*jt, node));
-				pixelLookup[node].push_back(*jt);
-			}
-		}
 
-		// Step 2:	Calculate the mosaic values for each pixel, and update the mosaic texture set accordingly.
-		std::vector<itk::Offset<3> > offsets = ITKImageUtil::make_4_connected_offsets(m_sliceOrientation);
+			unsigned char mosaicValue;
+			if(m_layerIndex > 0)	mosaicValue = static_cast<unsigned char>(m_volumeIPF->branch_properties(node).mean_grey_value());
+			else					mosaicValue = m_volumeIPF->leaf_properties(node.index()).grey_value();
 
-		for(std::map<PFNodeID,std::vector<int> >::const_iterator it=pixelLookup.begin(), iend=pixelLookup.end(); it!=iend; ++it)
-		{
-			const PFNodeID& ancestor = it->first;
-			for(std::vector<int>::const_iterator jt=it->second.begin(), jend=it->second.end(); jt!=jend; ++jt)
+			// Walk the runs of leaves of the node slice by slice, writing each run to the texture set as a single span.
+			// Since the runs are maximal, the ends of each run are always on the region boundary: other leaves are on it
+			// iff the leaf above or below in the same slice isn't in the node.
+			SliceRuns_CPtr sliceRuns = m_volumeIPF->slice_runs_of(node, m_sliceOrientation);
+			for(LeafRunConstIterator jt=sliceRuns->runs().begin(), jend=sliceRuns->runs().end(); jt!=jend; ++jt)
 			{
-				itk::Index<3> pos = m_volumeIPF->position_of_leaf(*jt);
-
-				bool regionBoundary = false;
-				for(size_t k=0, size=offsets.size(); k<size; ++k)
-				{
-					int adjLeaf = m_volumeIPF->leaf_of_position(pos + offsets[k]);
-					std::map<int,PFNodeID>::const_iterator adjIt = nodeLookup.find(adjLeaf);
-					if(adjIt == nodeLookup.end() || adjIt->second != ancestor)	// if either an outer boundary or an inner boundary
-					{
-						regionBoundary = true;
-						break;
-					}
-				}
-
-				unsigned char mosaicValue;
-				if(regionBoundary)
-				{
-					mosaicValue = std::numeric_limits<unsigned char>::max();
-				}
-				else
+				span.resize(jt->end - jt->begin);
+				for(int col=jt->begin; col<jt->end; ++col)
 				{
-					if(m_layerIndex > 0)	mosaicValue = static_cast<unsigned char>(m_volumeIPF->branch_properties(ancestor).mean_grey_value());
-					else					mosaicValue = m_volumeIPF->leaf_properties(ancestor.index()).grey_value();
+					bool regionBoundary =	col == jt->begin || col == jt->end - 1 ||
+											!sliceRuns->contains(jt->slice, jt->row - 1, col) || !sliceRuns->contains(jt->slice, jt->row + 1, col);
+					span[col - jt->begin] = regionBoundary ? std::numeric_limits<unsigned char>::max() : mosaicValue;
 				}
-				m_mosaicTextureSet->set_pixel(m_sliceOrientation, pos, mosaicValue);
+				m_mosaicTextureSet->set_pixels(m_sliceOrientation, jt->slice, jt->row, jt->begin, &span[0], static_cast<int>(span.size()));
 			}
 		}
 	}
@@ -1,6 +1,7 @@
 /***
  * millipede: SimpleImageLeafLayer.cpp
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #include "SimpleImageLeafLayer.h"
@@ -9,8 +10,9 @@ namespace mp {
 
 //#################### CONSTRUCTORS ####################
 SimpleImageLeafLayer::SimpleImageLeafLayer(const std::vector<SimplePixelProperties>& nodeProperties, int sizeX, int sizeY, int sizeZ)
+:	m_properties(nodeProperties)
 {
-	initialise(nodeProperties, sizeX, sizeY, sizeZ);
+	initialise(sizeX, sizeY, sizeZ);
 }
 
 //#################### PUBLIC METHODS ####################
@@ -20,4 +22,10 @@ SimpleImageLeafLayer::EdgeWeight SimpleImageLeafLayer::edge_weight(int u, int v)
 	return abs(u - v);
 }
 
+// Precondition: has_node(n)
+SimpleImageLeafLayer::NodeProperties SimpleImageLeafLayer::node_properties(int n) const
+{
+	return m_properties[n];
+}
+
 }
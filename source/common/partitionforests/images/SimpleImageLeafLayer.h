@@ -1,6 +1,7 @@
 /***
  * millipede: SimpleImageLeafLayer.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_SIMPLEIMAGELEAFLAYER
@@ -14,6 +15,10 @@ namespace mp {
 
 class SimpleImageLeafLayer : public ImageLeafLayer<SimplePixelProperties,SimpleRegionProperties>
 {
+	//#################### PRIVATE VARIABLES ####################
+private:
+	std::vector<SimplePixelProperties> m_properties;
+
 	//#################### CONSTRUCTORS ####################
 public:
 	SimpleImageLeafLayer(const std::vector<SimplePixelProperties>& nodeProperties, int sizeX, int sizeY, int sizeZ = 1);
@@ -21,6 +26,7 @@ public:
 	//#################### PUBLIC METHODS ####################
 public:
 	EdgeWeight edge_weight(int u, int v) const;
+	NodeProperties node_properties(int n) const;
 };
 
 }
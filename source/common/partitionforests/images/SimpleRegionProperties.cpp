@@ -1,6 +1,7 @@
 /***
  * millipede: SimpleRegionProperties.cpp
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #include "SimpleRegionProperties.h"
@@ -57,6 +58,23 @@ double SimpleRegionProperties::mean_value() const
 	return m_meanValue;
 }
 
+SimpleRegionProperties SimpleRegionProperties::merge(const SimpleRegionProperties& lhs, const SimpleRegionProperties& rhs)
+{
+	SimpleRegionProperties ret;
+	ret.m_area = lhs.m_area + rhs.m_area;
+	ret.m_meanValue = (lhs.m_meanValue * lhs.m_area + rhs.m_meanValue * rhs.m_area) / ret.m_area;
+	return ret;
+}
+
+// Precondition: part describes a proper subset of the region described by whole
+// Note: Both properties are sums, so the subtraction always succeeds.
+bool SimpleRegionProperties::subtract(const SimpleRegionProperties& whole, const SimpleRegionProperties& part, SimpleRegionProperties& result)
+{
+	result.m_area = whole.m_area - part.m_area;
+	result.m_meanValue = (whole.m_meanValue * whole.m_area - part.m_meanValue * part.m_area) / result.m_area;
+	return true;
+}
+
 //#################### GLOBAL OPERATORS ####################
 std::ostream& operator<<(std::ostream& os, const SimpleRegionProperties& rhs)
 {
@@ -1,6 +1,7 @@
 /***
  * millipede: SimpleRegionProperties.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_SIMPLEREGIONPROPERTIES
@@ -30,6 +31,8 @@ public:
 	static SimpleRegionProperties combine_branch_properties(const std::vector<SimpleRegionProperties>& properties);
 	static SimpleRegionProperties combine_leaf_properties(const std::vector<std::pair<Vector3i,SimplePixelProperties> >& properties);
 	double mean_value() const;
+	static SimpleRegionProperties merge(const SimpleRegionProperties& lhs, const SimpleRegionProperties& rhs);
+	static bool subtract(const SimpleRegionProperties& whole, const SimpleRegionProperties& part, SimpleRegionProperties& result);
 };
 
 //#################### GLOBAL OPERATORS ####################
@@ -1,6 +1,7 @@
 /***
  * millipede: VolumeIPF.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_VOLUMEIPF
@@ -10,7 +11,9 @@
 #include <itkSize.h>
 
 #include <common/partitionforests/base/PartitionForest.h>
+#include <common/partitionforests/base/PartitionForestLabelCache.h>
 #include <common/util/GridUtil.h>
+#include "VolumeIPFSliceIndex.h"
 
 namespace mp {
 
@@ -30,9 +33,20 @@ class VolumeIPF : public PartitionForest<LeafLayer,BranchLayer>
 private:
 	typedef typename PartitionForest<LeafLayer,BranchLayer>::LeafLayer_Ptr LeafLayer_Ptr;
 	typedef typename PartitionForest<LeafLayer,BranchLayer>::BranchLayer_Ptr BranchLayer_Ptr;
+	typedef PartitionForestLabelCache<LeafLayer,BranchLayer> LabelCache;
+	typedef boost::shared_ptr<LabelCache> LabelCache_Ptr;
+	typedef VolumeIPFSliceIndex<LeafLayer,BranchLayer> SliceIndex;
+	typedef boost::shared_ptr<SliceIndex> SliceIndex_Ptr;
+public:
+	typedef typename LabelCache::Labels_CPtr Labels_CPtr;
+	typedef typename SliceIndex::LeafRun LeafRun;
+	typedef typename SliceIndex::LeafRunConstIterator LeafRunConstIterator;
+	typedef typename SliceIndex::SliceRuns_CPtr SliceRuns_CPtr;
 
 	//#################### PRIVATE VARIABLES ####################
 private:
+	LabelCache_Ptr m_labelCache;
+	SliceIndex_Ptr m_sliceIndex;
 	itk::Size<3> m_volumeSize;
 
 	//#################### CONSTRUCTORS ####################
@@ -53,11 +67,32 @@ public:
 			(in the obvious manner)
 	*/
 	explicit VolumeIPF(const itk::Size<3>& volumeSize, const LeafLayer_Ptr& leafLayer, const BranchLayer_Ptr& lowestBranchLayer = BranchLayer_Ptr())
-	:	PartitionForest<LeafLayer,BranchLayer>(leafLayer, lowestBranchLayer), m_volumeSize(volumeSize)
-	{}
+	:	PartitionForest<LeafLayer,BranchLayer>(leafLayer, lowestBranchLayer), m_labelCache(new LabelCache(this)),
+		m_sliceIndex(new SliceIndex(this, volumeSize)), m_volumeSize(volumeSize)
+	{
+		this->add_shared_listener(m_labelCache);
+		this->add_shared_listener(m_sliceIndex);
+	}
 
 	//#################### PUBLIC METHODS ####################
 public:
+	/**
+	@brief	Returns a label volume for the specified layer of the forest, i.e. an array mapping the index of each leaf
+			to the index of its ancestor in that layer.
+
+	The label volume is built the first time it is requested and is then cached (and kept up-to-date as the forest changes),
+	so that subsequent calls (and calls to node_of for the same layer) are cheap.
+
+	@param[in]	layerIndex	The layer of the forest
+	@pre
+		-	0 <= layerIndex <= highest_layer()
+	@return	The label volume
+	*/
+	Labels_CPtr layer_labels(int layerIndex) const
+	{
+		return m_labelCache->labels(layerIndex);
+	}
+
 	/**
 	@brief	Calculates the index of the leaf node with the specified position in the volume.
 
@@ -86,8 +121,20 @@ public:
 	PFNodeID node_of(int layerIndex, const itk::Index<3>& position) const
 	{
 		int n = leaf_of_position(position);
-		if(n != -1) return this->ancestor_of(PFNodeID(0,n), layerIndex);
-		else return PFNodeID::invalid();
+		if(n == -1) return PFNodeID::invalid();
+
+		Labels_CPtr labels = m_labelCache->cached_labels(layerIndex);
+		if(labels) return PFNodeID(layerIndex, (*labels)[n]);
+		else return this->ancestor_of(PFNodeID(0,n), layerIndex);
+	}
+
+	/**
+	@brief	Discards any cached label volumes and slice runs (e.g. to reclaim memory).
+	*/
+	void release_layer_labels() const
+	{
+		m_labelCache->clear();
+		m_sliceIndex->clear();
 	}
 
 	/**
@@ -104,6 +151,37 @@ public:
 		return position;
 	}
 
+	/**
+	@brief	Calculates the position in the volume of the leaf at the specified position within a slice.
+
+	@param[in]	sliceOrientation	The orientation of the slice
+	@param[in]	slice				The slice (i.e. the coordinate of the leaf along the axis perpendicular to the slice)
+	@param[in]	row					The row of the leaf within the slice
+	@param[in]	col					The column of the leaf within the slice
+	@return	The position of the leaf in the volume
+	*/
+	static itk::Index<3> position_in_slice(SliceOrientation sliceOrientation, int slice, int row, int col)
+	{
+		return SliceIndex::position_of(sliceOrientation, slice, row, col);
+	}
+
+	/**
+	@brief	Returns the receptive region of the specified node as a set of run-length spans of leaves, bucketed by slice
+			(for the specified slice orientation).
+
+	The runs are computed the first time they are requested and are then cached (until the node is affected by a merge
+	or split), so enumerating the leaves of a node in a particular slice does not require its whole receptive region to
+	be recalculated each time.
+
+	@param[in]	node				The node
+	@param[in]	sliceOrientation	The slice orientation
+	@return	The runs
+	*/
+	SliceRuns_CPtr slice_runs_of(const PFNodeID& node, SliceOrientation sliceOrientation) const
+	{
+		return m_sliceIndex->slice_runs_of(node, sliceOrientation);
+	}
+
 	/**
 	@brief	Returns the size of the volume represented by the partition forest.
 
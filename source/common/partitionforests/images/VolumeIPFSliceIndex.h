@@ -0,0 +1,360 @@
+/***
+ * millipede: VolumeIPFSliceIndex.h
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#ifndef H_MILLIPEDE_VOLUMEIPFSLICEINDEX
+#define H_MILLIPEDE_VOLUMEIPFSLICEINDEX
+
+#include <algorithm>
+#include <climits>
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <itkIndex.h>
+#include <itkSize.h>
+
+#include <common/partitionforests/base/PartitionForest.h>
+#include <common/slices/SliceOrientation.h>
+
+namespace mp {
+
+/**
+@brief	A VolumeIPFSliceIndex maintains, for selected nodes of a volume partition forest and a given slice orientation,
+		the receptive region of each node as a set of run-length spans of leaves, bucketed by slice.
+
+This makes it possible to enumerate only those leaves of a node that lie in a given slice (e.g. to draw the node onto
+that slice) without materialising its whole receptive region each time. Within a slice, the leaves are described using
+2D (column, row) coordinates that match the image coordinates of the slice: for XY slices, the columns and rows are x
+and y; for XZ slices, they are x and z; and for YZ slices, they are y and z. Each span is maximal, so the neighbours of
+a leaf within its slice can be tested for membership of the same node using the spans alone.
+
+The spans of a node are computed the first time they are requested and cached thereafter. The index listens to the
+forest so that the cached spans of nodes affected by a merge or split are discarded (layer operations discard the whole
+cache). To bound the memory used, the least recently requested nodes are evicted once the total number of cached spans
+exceeds a fixed budget.
+
+@tparam	LeafLayer	The type of leaf layer used by the forest
+@tparam	BranchLayer	The type of branch layer used by the forest
+*/
+template <typename LeafLayer, typename BranchLayer>
+class VolumeIPFSliceIndex : public PartitionForest<LeafLayer,BranchLayer>::Listener
+{
+	//#################### NESTED CLASSES ####################
+public:
+	/**
+	@brief	A LeafRun is a maximal horizontal span of leaves in a slice, namely those with columns in [begin,end) on the specified row.
+	*/
+	struct LeafRun
+	{
+		int slice;
+		int row;
+		int begin;
+		int end;
+
+		LeafRun(int slice_, int row_, int begin_, int end_)
+		:	slice(slice_), row(row_), begin(begin_), end(end_)
+		{}
+
+		bool operator<(const LeafRun& rhs) const
+		{
+			if(slice != rhs.slice) return slice < rhs.slice;
+			if(row != rhs.row) return row < rhs.row;
+			return begin < rhs.begin;
+		}
+	};
+
+	typedef std::vector<LeafRun> LeafRuns;
+	typedef typename LeafRuns::const_iterator LeafRunConstIterator;
+
+	/**
+	@brief	A SliceRuns object holds the runs of a single node for a given slice orientation, sorted by slice, then row, then column.
+	*/
+	class SliceRuns
+	{
+	private:
+		LeafRuns m_runs;
+		SliceOrientation m_sliceOrientation;
+
+	public:
+		SliceRuns(LeafRuns& runs, SliceOrientation sliceOrientation)
+		:	m_sliceOrientation(sliceOrientation)
+		{
+			m_runs.swap(runs);
+		}
+
+	public:
+		/**
+		@brief	Returns whether or not the leaf at the specified position in the specified slice is in the node.
+
+		@param[in]	slice	The slice
+		@param[in]	row		The row of the leaf within the slice
+		@param[in]	col		The column of the leaf within the slice
+		@return	true, if the leaf is in the node, or false otherwise
+		*/
+		bool contains(int slice, int row, int col) const
+		{
+			// Find the last run starting at or before the specified position, and check whether it contains it.
+			LeafRunConstIterator it = std::upper_bound(m_runs.begin(), m_runs.end(), LeafRun(slice, row, col, col));
+			if(it == m_runs.begin()) return false;
+			--it;
+			return it->slice == slice && it->row == row && col < it->end;
+		}
+
+		/**
+		@brief	Returns the runs of the node.
+
+		@return	As described
+		*/
+		const LeafRuns& runs() const
+		{
+			return m_runs;
+		}
+
+		/**
+		@brief	Returns the range of runs of the node that lie in the specified slice.
+
+		@param[in]	slice	The slice
+		@return	As described
+		*/
+		std::pair<LeafRunConstIterator,LeafRunConstIterator> runs_in_slice(int slice) const
+		{
+			LeafRunConstIterator b = std::lower_bound(m_runs.begin(), m_runs.end(), LeafRun(slice, INT_MIN, INT_MIN, INT_MIN));
+			LeafRunConstIterator e = std::lower_bound(b, m_runs.end(), LeafRun(slice + 1, INT_MIN, INT_MIN, INT_MIN));
+			return std::make_pair(b, e);
+		}
+
+		/**
+		@brief	Returns the slice orientation for which the runs were computed.
+
+		@return	As described
+		*/
+		SliceOrientation slice_orientation() const
+		{
+			return m_sliceOrientation;
+		}
+	};
+
+	typedef boost::shared_ptr<const SliceRuns> SliceRuns_CPtr;
+
+	//#################### TYPEDEFS ####################
+private:
+	typedef PartitionForest<LeafLayer,BranchLayer> PartitionForestT;
+	typedef std::pair<PFNodeID,int> Key;
+
+	//#################### NESTED CLASSES (EXCLUDING LEAFRUN AND SLICERUNS) ####################
+private:
+	struct Entry
+	{
+		SliceRuns_CPtr runs;
+		unsigned long lastUsed;
+
+		Entry()
+		:	lastUsed(0)
+		{}
+	};
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	mutable std::map<Key,Entry> m_entries;
+	const PartitionForestT *m_forest;
+	size_t m_maxRuns;
+	mutable boost::mutex m_mutex;
+	mutable size_t m_runCount;
+	mutable unsigned long m_useCounter;
+	itk::Size<3> m_volumeSize;
+
+	//#################### CONSTRUCTORS ####################
+public:
+	/**
+	@brief	Constructs a slice index for the specified forest.
+
+	@param[in]	forest		The forest (the index must be registered as a listener of this forest to stay up-to-date)
+	@param[in]	volumeSize	The size of the volume represented by the forest
+	@param[in]	maxRuns		The maximum total number of runs to cache before evicting nodes
+	*/
+	VolumeIPFSliceIndex(const PartitionForestT *forest, const itk::Size<3>& volumeSize, size_t maxRuns = 1<<22)
+	:	m_forest(forest), m_maxRuns(maxRuns), m_runCount(0), m_useCounter(0), m_volumeSize(volumeSize)
+	{}
+
+	//#################### COPY CONSTRUCTOR & ASSIGNMENT OPERATOR ####################
+private:
+	VolumeIPFSliceIndex(const VolumeIPFSliceIndex&);
+	VolumeIPFSliceIndex& operator=(const VolumeIPFSliceIndex&);
+
+	//#################### PUBLIC METHODS ####################
+public:
+	/**
+	@brief	Discards all of the cached runs.
+	*/
+	void clear()
+	{
+		boost::mutex::scoped_lock lock(m_mutex);
+		clear_entries();
+	}
+
+	void layer_was_cloned(int index)
+	{
+		clear();
+	}
+
+	void layer_was_deleted(int index)
+	{
+		clear();
+	}
+
+	void layer_was_undeleted(int index)
+	{
+		clear();
+	}
+
+	void node_was_split(const PFNodeID& node, const std::set<PFNodeID>& results, int commandDepth)
+	{
+		// Only the receptive regions of the node being split and of the results of the split have changed.
+		boost::mutex::scoped_lock lock(m_mutex);
+		discard(node);
+		for(std::set<PFNodeID>::const_iterator it=results.begin(), iend=results.end(); it!=iend; ++it)
+		{
+			discard(*it);
+		}
+	}
+
+	void nodes_were_merged(const std::set<PFNodeID>& nodes, const PFNodeID& result, int commandDepth)
+	{
+		// Only the receptive regions of the merged nodes and of the result of the merge have changed.
+		boost::mutex::scoped_lock lock(m_mutex);
+		for(std::set<PFNodeID>::const_iterator it=nodes.begin(), iend=nodes.end(); it!=iend; ++it)
+		{
+			discard(*it);
+		}
+		discard(result);
+	}
+
+	/**
+	@brief	Returns the volume position of the leaf at the specified position within a slice.
+
+	@param[in]	sliceOrientation	The orientation of the slice
+	@param[in]	slice				The slice
+	@param[in]	row					The row of the leaf within the slice
+	@param[in]	col					The column of the leaf within the slice
+	@return	As described
+	*/
+	static itk::Index<3> position_of(SliceOrientation sliceOrientation, int slice, int row, int col)
+	{
+		itk::Index<3> position;
+		position[sliceOrientation] = slice;
+		position[col_axis(sliceOrientation)] = col;
+		position[row_axis(sliceOrientation)] = row;
+		return position;
+	}
+
+	/**
+	@brief	Returns the runs making up the receptive region of the specified node in the specified slice orientation,
+			computing (and caching) them if necessary.
+
+	@param[in]	node				The node
+	@param[in]	sliceOrientation	The slice orientation
+	@return	As described
+	*/
+	SliceRuns_CPtr slice_runs_of(const PFNodeID& node, SliceOrientation sliceOrientation) const
+	{
+		boost::mutex::scoped_lock lock(m_mutex);
+		Entry& entry = m_entries[Key(node, sliceOrientation)];
+		if(!entry.runs)
+		{
+			entry.runs = build_runs(node, sliceOrientation);
+			m_runCount += entry.runs->runs().size();
+			evict_least_recently_used(Key(node, sliceOrientation));
+		}
+		entry.lastUsed = ++m_useCounter;
+		return entry.runs;
+	}
+
+	//#################### PRIVATE METHODS ####################
+private:
+	SliceRuns_CPtr build_runs(const PFNodeID& node, SliceOrientation sliceOrientation) const
+	{
+		const int colAxis = col_axis(sliceOrientation), rowAxis = row_axis(sliceOrientation);
+		const int sizeX = static_cast<int>(m_volumeSize[0]), sizeXY = sizeX * static_cast<int>(m_volumeSize[1]);
+
+		// Convert each leaf in the receptive region into a single-leaf run.
+		std::deque<int> receptiveRegion = m_forest->receptive_region_of(node);
+		LeafRuns leaves;
+		leaves.reserve(receptiveRegion.size());
+		for(std::deque<int>::const_iterator it=receptiveRegion.begin(), iend=receptiveRegion.end(); it!=iend; ++it)
+		{
+			int position[3] = { *it % sizeX, (*it % sizeXY) / sizeX, *it / sizeXY };
+			int col = position[colAxis];
+			leaves.push_back(LeafRun(position[sliceOrientation], position[rowAxis], col, col + 1));
+		}
+
+		// Sort the leaves and coalesce adjacent ones into maximal runs.
+		std::sort(leaves.begin(), leaves.end());
+		LeafRuns runs;
+		for(LeafRunConstIterator it=leaves.begin(), iend=leaves.end(); it!=iend; ++it)
+		{
+			if(!runs.empty() && runs.back().slice == it->slice && runs.back().row == it->row && runs.back().end == it->begin)
+			{
+				runs.back().end = it->end;
+			}
+			else runs.push_back(*it);
+		}
+
+		// Trim the excess capacity, since the runs may be cached for a long time.
+		LeafRuns(runs).swap(runs);
+		return SliceRuns_CPtr(new SliceRuns(runs, sliceOrientation));
+	}
+
+	void clear_entries() const
+	{
+		m_entries.clear();
+		m_runCount = 0;
+	}
+
+	static int col_axis(SliceOrientation sliceOrientation)
+	{
+		return sliceOrientation == ORIENT_YZ ? 1 : 0;
+	}
+
+	void discard(const PFNodeID& node) const
+	{
+		for(int ori=0; ori<3; ++ori)
+		{
+			typename std::map<Key,Entry>::iterator it = m_entries.find(Key(node, ori));
+			if(it == m_entries.end()) continue;
+			if(it->second.runs) m_runCount -= it->second.runs->runs().size();
+			m_entries.erase(it);
+		}
+	}
+
+	void evict_least_recently_used(const Key& keyToKeep) const
+	{
+		while(m_runCount > m_maxRuns)
+		{
+			typename std::map<Key,Entry>::iterator victim = m_entries.end();
+			for(typename std::map<Key,Entry>::iterator it=m_entries.begin(), iend=m_entries.end(); it!=iend; ++it)
+			{
+				if(it->first == keyToKeep) continue;
+				if(victim == m_entries.end() || it->second.lastUsed < victim->second.lastUsed) victim = it;
+			}
+			if(victim == m_entries.end()) break;
+
+			if(victim->second.runs) m_runCount -= victim->second.runs->runs().size();
+			m_entries.erase(victim);
+		}
+	}
+
+	static int row_axis(SliceOrientation sliceOrientation)
+	{
+		return sliceOrientation == ORIENT_XY ? 1 : 2;
+	}
+};
+
+}
+
+#endif
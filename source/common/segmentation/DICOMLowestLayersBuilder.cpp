@@ -1,21 +1,30 @@
 /***
  * millipede: DICOMLowestLayersBuilder.cpp
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #include "DICOMLowestLayersBuilder.h"
 
-#include <itkCastImageFilter.h>
-#include <itkGradientAnisotropicDiffusionImageFilter.h>
-#include <itkGradientMagnitudeImageFilter.h>
+#include <algorithm>
+
+#include <itkConfigure.h>
 
 #include <common/dicom/volumes/DICOMVolume.h>
 #include <common/exceptions/Exception.h>
+#include <common/jobs/ParallelJob.h>
 #include <common/segmentation/watershed/MeijsterRoerdinkWatershed.h>
 #include <common/util/ITKImageUtil.h>
+#include "DiffusionGradientPreprocessor.h"
 
 namespace mp {
 
+//#################### LOCAL CONSTANTS ####################
+// Note:	The preprocessing used to be done by itk::GradientAnisotropicDiffusionImageFilter with its default UseImageSpacing setting,
+//			which is off in ITK 3.x but on from ITK 4 onwards. The preprocessor is told to behave in the same way, so that the
+//			segmentations produced do not change.
+const bool USE_IMAGE_SPACING_FOR_DIFFUSION = ITK_VERSION_MAJOR >= 4;
+
 //#################### CONSTRUCTORS ####################
 DICOMLowestLayersBuilder::DICOMLowestLayersBuilder(const DICOMSegmentationOptions& segmentationOptions, DICOMImageLeafLayer_Ptr& leafLayer,
 												   DICOMImageBranchLayer_Ptr& lowestBranchLayer)
@@ -38,7 +47,6 @@ void DICOMLowestLayersBuilder::execute_impl()
 {
 	typedef itk::Image<int,3> BaseImage;
 	typedef itk::Image<short,3> GradientMagnitudeImage;
-	typedef itk::Image<float,3> RealImage;
 	typedef itk::Image<unsigned char,3> WindowedImage;
 
 	BaseImage::Pointer baseImage = m_volumeHook.get()->base_image();
@@ -53,26 +61,22 @@ void DICOMLowestLayersBuilder::execute_impl()
 	WindowedImage::Pointer windowedImage = m_volumeHook.get()->windowed_image(m_segmentationOptions.windowSettings);
 	if(is_aborted()) return;
 
-	// Cast the input image (whether base or windowed) to make its pixels real-valued.
-	RealImage::Pointer realImage;
+	// Note:	When the lowest layers of several subvolumes are being built concurrently, the available threads are shared between them.
+	int threadCount = std::max(1, ParallelJob::default_thread_count() / std::max(1, m_segmentationOptions.threadCount));
+
+	// Cast the input image (whether base or windowed) to make its pixels real-valued. The preprocessor takes care of this,
+	// of smoothing the real image using anisotropic diffusion filtering, and of calculating the gradient magnitude of the result.
+	boost::shared_ptr<DiffusionGradientPreprocessor> preprocessor;
 	switch(m_segmentationOptions.inputType)
 	{
 		case DICOMSegmentationOptions::INPUTTYPE_BASE:
 		{
-			typedef itk::CastImageFilter<BaseImage,RealImage> CastFilter;
-			CastFilter::Pointer castFilter = CastFilter::New();
-			castFilter->SetInput(baseImage);
-			castFilter->Update();
-			realImage = castFilter->GetOutput();
+			preprocessor.reset(new DiffusionGradientPreprocessor(baseImage, m_segmentationOptions.adfConductance, m_segmentationOptions.adfIterations, USE_IMAGE_SPACING_FOR_DIFFUSION, 0.0625, threadCount));
 			break;
 		}
 		case DICOMSegmentationOptions::INPUTTYPE_WINDOWED:
 		{
-			typedef itk::CastImageFilter<WindowedImage,RealImage> CastFilter;
-			CastFilter::Pointer castFilter = CastFilter::New();
-			castFilter->SetInput(windowedImage);
-			castFilter->Update();
-			realImage = castFilter->GetOutput();
+			preprocessor.reset(new DiffusionGradientPreprocessor(windowedImage, m_segmentationOptions.adfConductance, m_segmentationOptions.adfIterations, USE_IMAGE_SPACING_FOR_DIFFUSION, 0.0625, threadCount));
 			break;
 		}
 		default:
@@ -82,29 +86,16 @@ void DICOMLowestLayersBuilder::execute_impl()
 	}
 	if(is_aborted()) return;
 
-	// Smooth this real image using anisotropic diffusion filtering.
-	typedef itk::GradientAnisotropicDiffusionImageFilter<RealImage,RealImage> ADFilter;
-	for(int i=0; i<m_segmentationOptions.adfIterations; ++i)
+	while(preprocessor->iterations_remaining() > 0)
 	{
-		ADFilter::Pointer adFilter = ADFilter::New();
-		adFilter->SetInput(realImage);
-		adFilter->SetConductanceParameter(m_segmentationOptions.adfConductance);
-		adFilter->SetNumberOfIterations(1);
-		adFilter->SetTimeStep(0.0625);
-		adFilter->Update();
-		realImage = adFilter->GetOutput();
+		preprocessor->iterate();
 
 		if(is_aborted()) return;
 		increment_progress();
 	}
 
-	// Calculate the gradient magnitude of the smoothed image.
-	typedef itk::GradientMagnitudeImageFilter<RealImage,GradientMagnitudeImage> GMFilter;
-	GMFilter::Pointer gmFilter = GMFilter::New();
-	gmFilter->SetInput(realImage);
-	gmFilter->SetUseImageSpacingOff();
-	gmFilter->Update();
-	GradientMagnitudeImage::Pointer gradientMagnitudeImage = gmFilter->GetOutput();
+	GradientMagnitudeImage::Pointer gradientMagnitudeImage = preprocessor->gradient_magnitude_image();
+	preprocessor.reset();
 
 	if(is_aborted()) return;
 	increment_progress();
@@ -5,18 +5,27 @@
 
 #include "DICOMSegmentationOptions.h"
 
+#include <common/jobs/ParallelJob.h>
+
 namespace mp {
 
 //#################### CONSTRUCTORS ####################
-DICOMSegmentationOptions::DICOMSegmentationOptions(double adfConductance_, int adfIterations_, InputType inputType_, const itk::Size<3>& subvolumeSize_,
+DICOMSegmentationOptions::DICOMSegmentationOptions(double adfConductance_, int adfIterations_, InputType inputType_, const itk::Size<3>& subvolumeSize_, int threadCount_,
 												   WaterfallAlgorithm waterfallAlgorithm_, int waterfallLayerLimit_, const WindowSettings& windowSettings_)
 :	adfConductance(adfConductance_),
 	adfIterations(adfIterations_),
 	inputType(inputType_),
 	subvolumeSize(subvolumeSize_),
+	threadCount(threadCount_),
 	waterfallAlgorithm(waterfallAlgorithm_),
 	waterfallLayerLimit(waterfallLayerLimit_),
 	windowSettings(windowSettings_)
 {}
 
+//#################### PUBLIC METHODS ####################
+int DICOMSegmentationOptions::default_thread_count()
+{
+	return ParallelJob::default_thread_count();
+}
+
 }
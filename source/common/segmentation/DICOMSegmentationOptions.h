@@ -36,12 +36,16 @@ struct DICOMSegmentationOptions
 	int adfIterations;
 	InputType inputType;
 	itk::Size<3> subvolumeSize;
+	int threadCount;					// the number of subvolumes to process concurrently, both when building their lowest layers (each builder's preprocessor then shares out the remaining threads) and when running the waterfall on them
 	WaterfallAlgorithm waterfallAlgorithm;
 	int waterfallLayerLimit;
 	WindowSettings windowSettings;
 
 	//#################### CONSTRUCTORS ####################
-	DICOMSegmentationOptions(double adfConductance_, int adfIterations_, InputType inputType_, const itk::Size<3>& subvolumeSize_, WaterfallAlgorithm waterfallAlgorithm_, int waterfallLayerLimit_, const WindowSettings& windowSettings_);
+	DICOMSegmentationOptions(double adfConductance_, int adfIterations_, InputType inputType_, const itk::Size<3>& subvolumeSize_, int threadCount_, WaterfallAlgorithm waterfallAlgorithm_, int waterfallLayerLimit_, const WindowSettings& windowSettings_);
+
+	//#################### PUBLIC METHODS ####################
+	static int default_thread_count();
 };
 
 }
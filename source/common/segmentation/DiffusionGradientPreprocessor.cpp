@@ -0,0 +1,268 @@
+/***
+ * millipede: DiffusionGradientPreprocessor.cpp
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#include "DiffusionGradientPreprocessor.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <common/exceptions/Exception.h>
+#include <common/util/ITKImageUtil.h>
+
+namespace {
+
+typedef float Neighbourhood[3][3][3];	// indexed as [z][y][x], with the voxel of interest at [1][1][1]
+
+/**
+Returns the value in the neighbourhood at an offset of si along axis i and sj along axis j (if j != -1) from its centre.
+*/
+inline float at(const Neighbourhood& n, int i, int si, int j = -1, int sj = 0)
+{
+	int pos[3] = {1,1,1};
+	pos[i] += si;
+	if(j != -1) pos[j] += sj;
+	return n[pos[2]][pos[1]][pos[0]];
+}
+
+/**
+Calculates the diffusion update for the centre of the neighbourhood, in exactly the same way as
+itk::GradientNDAnisotropicDiffusionFunction (so that the results match to within floating-point rounding).
+The derivatives along each axis i are scaled by scaleCoefficients[i] (as ITK does with its own scale coefficients).
+*/
+inline float diffusion_update(const Neighbourhood& n, float k, const double *scaleCoefficients)
+{
+	const float centre = n[1][1][1];
+
+	float dx[3];
+	for(int i=0; i<3; ++i)
+	{
+		dx[i] = (at(n, i, 1) - at(n, i, -1)) / 2.0f;
+		dx[i] = static_cast<float>(dx[i] * scaleCoefficients[i]);
+	}
+
+	float delta = 0.0f;
+	for(int i=0; i<3; ++i)
+	{
+		// Calculate the half-directional derivatives and the conductance terms (which vary with the direction,
+		// since the approximation of the gradient magnitude at each half-voxel is different).
+		float dxForward = static_cast<float>((at(n, i, 1) - centre) * scaleCoefficients[i]);
+		float dxBackward = static_cast<float>((centre - at(n, i, -1)) * scaleCoefficients[i]);
+
+		double accum = 0.0, accumBackward = 0.0;
+		for(int j=0; j<3; ++j)
+		{
+			if(j == i) continue;
+			float dxAug = static_cast<float>((at(n, i, 1, j, 1) - at(n, i, 1, j, -1)) / 2.0f * scaleCoefficients[j]);
+			float dxDim = static_cast<float>((at(n, i, -1, j, 1) - at(n, i, -1, j, -1)) / 2.0f * scaleCoefficients[j]);
+			accum += 0.25f * (dx[j] + dxAug) * (dx[j] + dxAug);
+			accumBackward += 0.25f * (dx[j] + dxDim) * (dx[j] + dxDim);
+		}
+
+		double cx = 0.0, cxBackward = 0.0;
+		if(k != 0.0f)
+		{
+			cx = std::exp((dxForward * dxForward + accum) / k);
+			cxBackward = std::exp((dxBackward * dxBackward + accumBackward) / k);
+		}
+
+		dxForward = static_cast<float>(dxForward * cx);
+		dxBackward = static_cast<float>(dxBackward * cxBackward);
+		delta += dxForward - dxBackward;
+	}
+	return delta;
+}
+
+}
+
+namespace mp {
+
+//#################### PUBLIC METHODS ####################
+DiffusionGradientPreprocessor::GradientMagnitudeImage::Pointer DiffusionGradientPreprocessor::gradient_magnitude_image()
+{
+	// Note:	The gradient magnitude image is filled in by the pass that produces the final smoothed image.
+	while(iterations_remaining() > 0) iterate();
+	return m_gradientMagnitudeImage;
+}
+
+int DiffusionGradientPreprocessor::iterations_remaining() const
+{
+	return m_iterations - m_iterationsDone;
+}
+
+void DiffusionGradientPreprocessor::iterate()
+{
+	if(iterations_remaining() <= 0) throw Exception("All of the diffusion iterations have already been run");
+
+	// Calculate the conductance term for this iteration from the average squared gradient magnitude of the current image
+	// (as per itk::GradientNDAnisotropicDiffusionFunction::InitializeIteration).
+	double gradientSum = 0.0;
+	for(int z=0; z<m_sizeZ; ++z)
+	{
+		gradientSum += m_sliceGradientSums[z];
+	}
+	double averageGradientMagnitudeSquared = gradientSum / (static_cast<double>(m_sizeX) * m_sizeY * m_sizeZ);
+	float k = static_cast<float>(averageGradientMagnitudeSquared * m_conductance * m_conductance * -2.0f);
+
+	m_current = 1 - m_current;
+	++m_iterationsDone;
+	run_pass(boost::bind(&DiffusionGradientPreprocessor::diffuse_slice, this, k, _1));
+}
+
+DiffusionGradientPreprocessor::RealImage::Pointer DiffusionGradientPreprocessor::smoothed_image() const
+{
+	itk::Size<3> size = {{m_sizeX, m_sizeY, m_sizeZ}};
+	RealImage::Pointer image = ITKImageUtil::make_image<float,3>(size);
+	image->SetSpacing(m_gradientMagnitudeImage->GetSpacing());
+	image->SetOrigin(m_gradientMagnitudeImage->GetOrigin());
+	std::copy(m_buffers[m_current].begin(), m_buffers[m_current].end(), image->GetBufferPointer());
+	return image;
+}
+
+//#################### PRIVATE METHODS ####################
+void DiffusionGradientPreprocessor::diffuse_slice(float k, int z)
+{
+	const float *in = &m_buffers[1 - m_current][0];
+	float *out = &m_buffers[m_current][0];
+
+	// Note:	The neighbourhoods of voxels on the edges of the volume are clamped to the volume (zero-flux Neumann boundary conditions).
+	const int zs[3] = { std::max(z - 1, 0), z, std::min(z + 1, m_sizeZ - 1) };
+	for(int y=0; y<m_sizeY; ++y)
+	{
+		const int ys[3] = { std::max(y - 1, 0), y, std::min(y + 1, m_sizeY - 1) };
+		const float *rows[3][3];
+		for(int dz=0; dz<3; ++dz)
+			for(int dy=0; dy<3; ++dy)
+			{
+				rows[dz][dy] = in + (zs[dz] * m_sizeY + ys[dy]) * m_sizeX;
+			}
+
+		float *outRow = out + (z * m_sizeY + y) * m_sizeX;
+		for(int x=0; x<m_sizeX; ++x)
+		{
+			const int xs[3] = { std::max(x - 1, 0), x, std::min(x + 1, m_sizeX - 1) };
+			Neighbourhood n;
+			for(int dz=0; dz<3; ++dz)
+				for(int dy=0; dy<3; ++dy)
+					for(int dx=0; dx<3; ++dx)
+					{
+						n[dz][dy][dx] = rows[dz][dy][xs[dx]];
+					}
+
+			outRow[x] = n[1][1][1] + static_cast<float>(diffusion_update(n, k, m_scaleCoefficients) * m_timeStep);
+		}
+	}
+}
+
+void DiffusionGradientPreprocessor::finish_slice(int z)
+{
+	const float *image = &m_buffers[m_current][0];
+	const bool isFinal = m_iterationsDone == m_iterations;
+	short *gradientMagnitudes = m_gradientMagnitudeImage->GetBufferPointer() + z * m_sizeX * m_sizeY;
+
+	const int zs[2] = { std::max(z - 1, 0), std::min(z + 1, m_sizeZ - 1) };
+	double gradientSum = 0.0;
+	for(int y=0; y<m_sizeY; ++y)
+	{
+		const int ys[2] = { std::max(y - 1, 0), std::min(y + 1, m_sizeY - 1) };
+		const float *row = image + (z * m_sizeY + y) * m_sizeX;
+		const float *rowsY[2] = { image + (z * m_sizeY + ys[0]) * m_sizeX, image + (z * m_sizeY + ys[1]) * m_sizeX };
+		const float *rowsZ[2] = { image + (zs[0] * m_sizeY + y) * m_sizeX, image + (zs[1] * m_sizeY + y) * m_sizeX };
+		for(int x=0; x<m_sizeX; ++x)
+		{
+			const int xs[2] = { std::max(x - 1, 0), std::min(x + 1, m_sizeX - 1) };
+			double d[3] =
+			{
+				0.5 * (static_cast<double>(row[xs[1]]) - row[xs[0]]),
+				0.5 * (static_cast<double>(rowsY[1][x]) - rowsY[0][x]),
+				0.5 * (static_cast<double>(rowsZ[1][x]) - rowsZ[0][x])
+			};
+
+			// Accumulate the squared gradient components for the next diffusion iteration
+			// (as per itk::ScalarAnisotropicDiffusionFunction::CalculateAverageGradientMagnitudeSquared).
+			for(int i=0; i<3; ++i)
+			{
+				float f = static_cast<float>(static_cast<float>(d[i]) * m_scaleCoefficients[i]);
+				gradientSum += f * f;
+			}
+
+			// If this is the final smoothed image, also calculate its gradient magnitude (as per itk::GradientMagnitudeImageFilter
+			// without image spacing, as DICOMLowestLayersBuilder has always used it).
+			if(isFinal)
+			{
+				gradientMagnitudes[y * m_sizeX + x] = static_cast<short>(std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]));
+			}
+		}
+	}
+	m_sliceGradientSums[z] = gradientSum;
+}
+
+void DiffusionGradientPreprocessor::finish_slices(const std::vector<int> *slices, int begin, int end)
+{
+	for(int i=begin; i<end; ++i)
+	{
+		finish_slice((*slices)[i]);
+	}
+}
+
+void DiffusionGradientPreprocessor::initialise(const itk::Size<3>& size, const RealImage::SpacingType& spacing, const RealImage::PointType& origin, bool useImageSpacing)
+{
+	m_sizeX = static_cast<int>(size[0]);
+	m_sizeY = static_cast<int>(size[1]);
+	m_sizeZ = static_cast<int>(size[2]);
+
+	// As per itk::FiniteDifferenceImageFilter::InitializeFunctionCoefficients.
+	for(int i=0; i<3; ++i)
+	{
+		m_scaleCoefficients[i] = useImageSpacing ? 1.0 / spacing[i] : 1.0;
+	}
+
+	m_current = 0;
+	m_iterationsDone = 0;
+	m_sliceGradientSums.resize(m_sizeZ);
+
+	size_t voxelCount = size[0] * size[1] * size[2];
+	m_buffers[0].resize(voxelCount);
+	if(m_iterations > 0) m_buffers[1].resize(voxelCount);
+
+	m_gradientMagnitudeImage = ITKImageUtil::make_image<short,3>(size);
+	m_gradientMagnitudeImage->SetSpacing(spacing);
+	m_gradientMagnitudeImage->SetOrigin(origin);
+}
+
+void DiffusionGradientPreprocessor::process_slab(const boost::function<void(int)>& produceSlice, std::vector<unsigned char> *finished, int begin, int end)
+{
+	for(int z=begin; z<end; ++z)
+	{
+		produceSlice(z);
+	}
+
+	// In fused mode, finish off all the slices whose neighbourhoods lie entirely within this slab (while they're still in the cache).
+	if(finished)
+	{
+		int finishBegin = begin == 0 ? 0 : begin + 1;
+		int finishEnd = end == m_sizeZ ? m_sizeZ : end - 1;
+		for(int z=finishBegin; z<finishEnd; ++z)
+		{
+			finish_slice(z);
+			(*finished)[z] = 1;
+		}
+	}
+}
+
+void DiffusionGradientPreprocessor::run_pass(const boost::function<void(int)>& produceSlice)
+{
+	std::vector<unsigned char> finished(m_sizeZ, 0);
+	ParallelJob::run_slabs(m_sizeZ, boost::bind(&DiffusionGradientPreprocessor::process_slab, this, boost::cref(produceSlice), m_fused ? &finished : NULL, _1, _2), m_threadCount);
+
+	// Finish off any slices that could not be finished during the pass itself (this will be all of them if we're not in fused mode).
+	std::vector<int> remaining;
+	for(int z=0; z<m_sizeZ; ++z)
+	{
+		if(!finished[z]) remaining.push_back(z);
+	}
+	ParallelJob::run_slabs(static_cast<int>(remaining.size()), boost::bind(&DiffusionGradientPreprocessor::finish_slices, this, &remaining, _1, _2), m_threadCount);
+}
+
+}
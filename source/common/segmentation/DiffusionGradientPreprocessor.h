@@ -0,0 +1,143 @@
+/***
+ * millipede: DiffusionGradientPreprocessor.h
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#ifndef H_MILLIPEDE_DIFFUSIONGRADIENTPREPROCESSOR
+#define H_MILLIPEDE_DIFFUSIONGRADIENTPREPROCESSOR
+
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <itkImage.h>
+
+#include <common/jobs/ParallelJob.h>
+
+namespace mp {
+
+/**
+@brief	A DiffusionGradientPreprocessor turns a 3D image into the gradient magnitude image of an anisotropically-diffused
+		copy of it, ready for running the watershed.
+
+It produces the same results (up to floating-point rounding) as casting the image to float, running
+itk::GradientAnisotropicDiffusionImageFilter on it (with or without image spacing, as specified) and then running
+itk::GradientMagnitudeImageFilter (without image spacing) on the smoothed result, but it only ever uses two float
+volumes (which are ping-ponged between the diffusion iterations) plus the output image, and every pass over the volume
+is split into z-slabs that are processed concurrently. When image spacing is used, the derivatives in the diffusion
+(and in the average squared gradient that determines its conductance) are scaled by 1/spacing along each axis, exactly
+as ITK does.
+
+Each iteration of the diffusion needs the average squared gradient magnitude of the image it is smoothing. In fused mode,
+this is accumulated (per slice) by the pass that produces the image, for all the slices whose neighbourhoods lie within
+the slab being processed; the few slices on the slab boundaries are finished off once all the slabs are done. The gradient
+magnitude image itself is computed in the same way by the pass that produces the final smoothed image, so it never costs
+a separate pass over the volume. Since the per-slice sums are always added together in slice order, the results do not
+depend on the number of threads used (or on whether or not fused mode is enabled).
+*/
+class DiffusionGradientPreprocessor
+{
+	//#################### TYPEDEFS ####################
+public:
+	typedef itk::Image<short,3> GradientMagnitudeImage;
+	typedef itk::Image<float,3> RealImage;
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	std::vector<float> m_buffers[2];
+	double m_conductance;
+	int m_current;								// the index of the buffer containing the current smoothed image
+	bool m_fused;
+	GradientMagnitudeImage::Pointer m_gradientMagnitudeImage;
+	int m_iterations;
+	int m_iterationsDone;
+	double m_scaleCoefficients[3];				// the amounts by which the derivatives along each axis are scaled in the diffusion
+	std::vector<double> m_sliceGradientSums;	// the sums of the squared gradient components of the current image, for each slice
+	int m_sizeX, m_sizeY, m_sizeZ;
+	int m_threadCount;
+	double m_timeStep;
+
+	//#################### CONSTRUCTORS ####################
+public:
+	/**
+	@brief	Constructs a preprocessor for the specified input image, and converts the image to float.
+
+	@param[in]	input			The input image
+	@param[in]	conductance		The conductance parameter for the anisotropic diffusion
+	@param[in]	iterations		The number of diffusion iterations to run
+	@param[in]	useImageSpacing	Whether or not to take the image spacing into account in the diffusion (as per itk::FiniteDifferenceImageFilter::SetUseImageSpacing)
+	@param[in]	timeStep		The time step for each diffusion iteration
+	@param[in]	threadCount		The maximum number of threads to use for each pass
+	@param[in]	fused			Whether or not to fuse the gradient computations into the passes that produce the smoothed images
+	*/
+	template <typename TPixel>
+	DiffusionGradientPreprocessor(const itk::SmartPointer<itk::Image<TPixel,3> >& input, double conductance, int iterations, bool useImageSpacing,
+								  double timeStep = 0.0625, int threadCount = ParallelJob::default_thread_count(), bool fused = true)
+	:	m_conductance(conductance), m_fused(fused), m_iterations(iterations), m_threadCount(threadCount), m_timeStep(timeStep)
+	{
+		initialise(input->GetLargestPossibleRegion().GetSize(), input->GetSpacing(), input->GetOrigin(), useImageSpacing);
+		const TPixel *pixels = input->GetBufferPointer();
+		run_pass(boost::bind(&DiffusionGradientPreprocessor::cast_slice<TPixel>, this, pixels, _1));
+	}
+
+	//#################### COPY CONSTRUCTOR & ASSIGNMENT OPERATOR ####################
+private:
+	DiffusionGradientPreprocessor(const DiffusionGradientPreprocessor&);
+	DiffusionGradientPreprocessor& operator=(const DiffusionGradientPreprocessor&);
+
+	//#################### PUBLIC METHODS ####################
+public:
+	/**
+	@brief	Returns the gradient magnitude image of the final smoothed image, running any remaining diffusion iterations first.
+
+	@return	As described
+	*/
+	GradientMagnitudeImage::Pointer gradient_magnitude_image();
+
+	/**
+	@brief	Returns the number of diffusion iterations that have yet to be run.
+
+	@return	As described
+	*/
+	int iterations_remaining() const;
+
+	/**
+	@brief	Runs the next diffusion iteration.
+
+	@throw Exception
+		-	If all of the diffusion iterations have already been run
+	*/
+	void iterate();
+
+	/**
+	@brief	Returns a copy of the current smoothed image.
+
+	@return	As described
+	*/
+	RealImage::Pointer smoothed_image() const;
+
+	//#################### PRIVATE METHODS ####################
+private:
+	template <typename TPixel>
+	void cast_slice(const TPixel *pixels, int z)
+	{
+		int sliceSize = m_sizeX * m_sizeY;
+		const TPixel *in = pixels + z * sliceSize;
+		float *out = &m_buffers[m_current][z * sliceSize];
+		for(int i=0; i<sliceSize; ++i)
+		{
+			out[i] = static_cast<float>(in[i]);
+		}
+	}
+
+	void diffuse_slice(float k, int z);
+	void finish_slice(int z);
+	void finish_slices(const std::vector<int> *slices, int begin, int end);
+	void initialise(const itk::Size<3>& size, const RealImage::SpacingType& spacing, const RealImage::PointType& origin, bool useImageSpacing);
+	void process_slab(const boost::function<void(int)>& produceSlice, std::vector<unsigned char> *finished, int begin, int end);
+	void run_pass(const boost::function<void(int)>& produceSlice);
+};
+
+}
+
+#endif
@@ -1,49 +1,86 @@
 /***
  * millipede: ForestBuildingWaterfallPassListener.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_FORESTBUILDINGWATERFALLPASSLISTENER
 #define H_MILLIPEDE_FORESTBUILDINGWATERFALLPASSLISTENER
 
+#include <algorithm>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
 #include <common/partitionforests/base/PartitionForest.h>
 #include "SubvolumeToVolumeIndexMapper.h"
 
 namespace mp {
 
+/**
+@brief	A ForestBuildingWaterfallPassListener records the merges made by a waterfall pass on the rooted MST of a subvolume,
+		so that they can be turned into a new layer of the forest being built for the whole volume.
+
+Rather than merging the corresponding forest nodes one pair at a time, the merges are recorded (in terms of the volume's
+node indices) and then extracted as groups of nodes, which can be passed to PartitionForest::insert_layer_above() along
+with the groups for all the other subvolumes to build the next layer of the forest in one go.
+*/
 template <typename Forest>
 struct ForestBuildingWaterfallPassListener : public WaterfallPass<typename Forest::EdgeWeight>::Listener
 {
-	//#################### TYPEDEFS ####################
-	typedef boost::shared_ptr<Forest> Forest_Ptr;
-
 	//#################### PUBLIC VARIABLES ####################
-	Forest_Ptr m_forest;
 	SubvolumeToVolumeIndexMapper m_indexMapper;
+	std::vector<std::pair<int,int> > m_merges;		// the (removed node, surviving node) pairs for the merges, in the order they were made
 
 	//#################### CONSTRUCTORS ####################
-	explicit ForestBuildingWaterfallPassListener(const Forest_Ptr& forest, const SubvolumeToVolumeIndexMapper& indexMapper)
-	:	m_forest(forest), m_indexMapper(indexMapper)
+	explicit ForestBuildingWaterfallPassListener(const SubvolumeToVolumeIndexMapper& indexMapper)
+	:	m_indexMapper(indexMapper)
 	{}
 
 	//#################### PUBLIC METHODS ####################
+	/**
+	@brief	Appends a group to the specified array for each node that survived the merges recorded since the last call,
+			containing the node itself and all the nodes that were merged into it, and then discards the recorded merges.
+
+	@param[out]	groups	The array to which to append the groups
+	*/
+	void extract_groups(std::vector<std::set<int> >& groups)
+	{
+		// Find the node into which each removed node was finally merged by working backwards through the merges: at the point
+		// at which a node was merged into another, the other node was still present, so anything that later happened to it
+		// has already been seen.
+		std::map<int,int> targets;
+		for(std::vector<std::pair<int,int> >::const_reverse_iterator it=m_merges.rbegin(), iend=m_merges.rend(); it!=iend; ++it)
+		{
+			std::map<int,int>::const_iterator jt = targets.find(it->second);
+			targets[it->first] = jt != targets.end() ? jt->second : it->second;
+		}
+
+		std::map<int,std::set<int> > groupMap;
+		for(std::map<int,int>::const_iterator it=targets.begin(), iend=targets.end(); it!=iend; ++it)
+		{
+			std::set<int>& group = groupMap[it->second];
+			group.insert(it->second);
+			group.insert(it->first);
+		}
+
+		for(std::map<int,std::set<int> >::const_iterator it=groupMap.begin(), iend=groupMap.end(); it!=iend; ++it)
+		{
+			groups.push_back(it->second);
+		}
+
+		std::vector<std::pair<int,int> >().swap(m_merges);
+	}
+
 	void merge_nodes(int u, int v)
 	{
-		// Merge the corresponding nodes in the top-most layer of the forest.
-		std::set<PFNodeID> mergees;
-		mergees.insert(PFNodeID(m_forest->highest_layer(), m_indexMapper(u)));
-		mergees.insert(PFNodeID(m_forest->highest_layer(), m_indexMapper(v)));
-		m_forest->merge_sibling_nodes(mergees, Forest::DONT_CHECK_PRECONDITIONS);
+		// Note: As in RootedMST::merge_nodes, the node with the smaller index survives (the index mapper preserves the order of the nodes).
+		int mappedU = m_indexMapper(u), mappedV = m_indexMapper(v);
+		m_merges.push_back(std::make_pair(std::max(mappedU, mappedV), std::min(mappedU, mappedV)));
 	}
 };
 
-template <typename Forest>
-boost::shared_ptr<ForestBuildingWaterfallPassListener<Forest> >
-make_forest_building_waterfall_pass_listener(const boost::shared_ptr<Forest>& forest, const SubvolumeToVolumeIndexMapper& indexMapper)
-{
-	return boost::shared_ptr<ForestBuildingWaterfallPassListener<Forest> >(new ForestBuildingWaterfallPassListener<Forest>(forest, indexMapper));
-}
-
 }
 
 #endif
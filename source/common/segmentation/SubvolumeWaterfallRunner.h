@@ -0,0 +1,136 @@
+/***
+ * millipede: SubvolumeWaterfallRunner.h
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#ifndef H_MILLIPEDE_SUBVOLUMEWATERFALLRUNNER
+#define H_MILLIPEDE_SUBVOLUMEWATERFALLRUNNER
+
+#include <set>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <common/adts/RootedMST.h>
+#include <common/exceptions/Exception.h>
+#include <common/jobs/ParallelJob.h>
+#include <common/segmentation/waterfall/WaterfallPass.h>
+#include "ForestBuildingWaterfallPassListener.h"
+#include "SubvolumeToVolumeIndexMapper.h"
+
+namespace mp {
+
+/**
+@brief	A SubvolumeWaterfallRunner runs waterfall passes over the rooted MSTs of the subvolumes of a volume, and turns the
+		merges they make into the groups of nodes needed to build the next layer of the forest for the whole volume.
+
+The pass for each subvolume only touches its own MST, and records its merges in its own listener rather than applying
+them to the forest, so the passes for different subvolumes can safely be run concurrently. The groups are collected from
+the listeners in subvolume order once all the passes have finished, so the layers built from them are identical to those
+that would be built by running the passes one after the other, whatever the number of threads used.
+
+@tparam	Forest	The type of forest being built
+*/
+template <typename Forest>
+class SubvolumeWaterfallRunner
+{
+	//#################### TYPEDEFS ####################
+public:
+	typedef typename Forest::EdgeWeight EdgeWeight;
+	typedef boost::shared_ptr<RootedMST<EdgeWeight> > RootedMST_Ptr;
+	typedef boost::shared_ptr<WaterfallPass<EdgeWeight> > WaterfallPass_Ptr;
+
+private:
+	typedef ForestBuildingWaterfallPassListener<Forest> Listener;
+	typedef boost::shared_ptr<Listener> Listener_Ptr;
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	std::vector<Listener_Ptr> m_listeners;
+	std::vector<RootedMST_Ptr> m_msts;
+	std::vector<WaterfallPass_Ptr> m_passes;
+	int m_threadCount;
+
+	//#################### CONSTRUCTORS ####################
+public:
+	/**
+	@brief	Constructs a runner for the specified subvolumes.
+
+	@param[in]	passes			The waterfall pass to run on each subvolume's MST (each subvolume must have its own pass object)
+	@param[in]	msts			The rooted MSTs of the subvolumes
+	@param[in]	indexMappers	The mappers from the node indices of each subvolume to those of the whole volume
+	@param[in]	threadCount		The maximum number of threads to use
+	@throw Exception
+		-	If the numbers of passes, MSTs and index mappers differ
+	*/
+	SubvolumeWaterfallRunner(const std::vector<WaterfallPass_Ptr>& passes, const std::vector<RootedMST_Ptr>& msts,
+							 const std::vector<SubvolumeToVolumeIndexMapper>& indexMappers, int threadCount = ParallelJob::default_thread_count())
+	:	m_msts(msts), m_passes(passes), m_threadCount(threadCount)
+	{
+		if(passes.size() != msts.size() || indexMappers.size() != msts.size())
+		{
+			throw Exception("There must be exactly one waterfall pass and index mapper for each subvolume MST");
+		}
+
+		for(size_t i=0, size=passes.size(); i<size; ++i)
+		{
+			Listener_Ptr listener(new Listener(indexMappers[i]));
+			m_passes[i]->add_shared_listener(listener);
+			m_listeners.push_back(listener);
+		}
+	}
+
+	//#################### PUBLIC METHODS ####################
+public:
+	/**
+	@brief	Returns whether or not every subvolume's MST has been reduced to a single node (in which case further passes
+			would have no effect).
+
+	@return	As described
+	*/
+	bool finished() const
+	{
+		for(size_t i=0, size=m_msts.size(); i<size; ++i)
+		{
+			if(m_msts[i]->node_count() != 1) return false;
+		}
+		return true;
+	}
+
+	/**
+	@brief	Runs a waterfall pass on the MST of each subvolume (unless it has already been reduced to a single node), and
+			appends the groups of volume nodes that were merged to the specified array, in subvolume order.
+
+	@param[out]	groups	The array to which to append the groups
+	*/
+	void run(std::vector<std::set<int> >& groups)
+	{
+		int subvolumeCount = static_cast<int>(m_msts.size());
+		std::vector<std::vector<std::set<int> > > subvolumeGroups(subvolumeCount);
+		ParallelJob::run_slabs(subvolumeCount, boost::bind(&SubvolumeWaterfallRunner::run_subvolumes, this, &subvolumeGroups, _1, _2), m_threadCount);
+
+		for(int i=0; i<subvolumeCount; ++i)
+		{
+			groups.insert(groups.end(), subvolumeGroups[i].begin(), subvolumeGroups[i].end());
+		}
+	}
+
+	//#################### PRIVATE METHODS ####################
+private:
+	void run_subvolumes(std::vector<std::vector<std::set<int> > > *subvolumeGroups, int begin, int end)
+	{
+		for(int i=begin; i<end; ++i)
+		{
+			if(m_msts[i]->node_count() != 1)
+			{
+				m_passes[i]->run(*m_msts[i]);
+			}
+			m_listeners[i]->extract_groups((*subvolumeGroups)[i]);
+		}
+	}
+};
+
+}
+
+#endif
@@ -1,11 +1,14 @@
 /***
  * millipede: VolumeIPFBuilder.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_VOLUMEIPFBUILDER
 #define H_MILLIPEDE_VOLUMEIPFBUILDER
 
+#include <algorithm>
+
 #include <itkRegionOfInterestImageFilter.h>
 
 #include <common/adts/RootedMST.h>
@@ -13,13 +16,14 @@
 #include <common/io/util/OSSWrapper.h>
 #include <common/jobs/CompositeJob.h>
 #include <common/jobs/DataHook.h>
+#include <common/jobs/ParallelJob.h>
 #include <common/partitionforests/images/VolumeIPF.h>
 #include <common/segmentation/waterfall/GolodetzWaterfallPass.h>
 #include <common/segmentation/waterfall/MarcoteguiWaterfallPass.h>
 #include <common/segmentation/waterfall/NichollsWaterfallPass.h>
 #include <common/util/GridUtil.h>
-#include "ForestBuildingWaterfallPassListener.h"
 #include "SubvolumeToVolumeIndexMapper.h"
+#include "SubvolumeWaterfallRunner.h"
 
 namespace mp {
 
@@ -54,6 +58,10 @@ private:
 		{
 			set_status("Extracting subvolume...");
 
+			// Note:	Running the extraction pipeline modifies the requested region of the (shared) input image,
+			//			so subvolumes must be extracted one at a time when they are being processed in parallel.
+			boost::mutex::scoped_lock lock(base->m_extractionMutex);
+
 			typedef DICOMVolume::BaseImage Image;
 			typedef itk::RegionOfInterestImageFilter<Image,Image> RegionExtractor;
 			RegionExtractor::Pointer extractor = RegionExtractor::New();
@@ -224,6 +232,7 @@ private:
 			itk::Size<3> subvolumeSize = base->m_segmentationOptions.subvolumeSize, volumeSize = base->m_volume->size();
 
 			std::vector<boost::shared_ptr<WaterfallPass<int> > > waterfallPasses(subvolumeCount);
+			std::vector<SubvolumeToVolumeIndexMapper> indexMappers;
 			for(int i=0; i<subvolumeCount; ++i)
 			{
 				switch(base->m_segmentationOptions.waterfallAlgorithm)
@@ -243,22 +252,21 @@ private:
 					default:
 						throw Exception("Tried to use an invalid waterfall algorithm");
 				}
-				SubvolumeToVolumeIndexMapper indexMapper(i, subvolumeSize, volumeSize);
-				waterfallPasses[i]->add_shared_listener(make_forest_building_waterfall_pass_listener(volumeIPF, indexMapper));
+				indexMappers.push_back(SubvolumeToVolumeIndexMapper(i, subvolumeSize, volumeSize));
 			}
 
+			// The passes for the different subvolumes are run concurrently, but the groups they produce are always
+			// collected in subvolume order, so the forest built is the same whatever the number of threads.
+			SubvolumeWaterfallRunner<VolumeIPFT> runner(waterfallPasses, msts, indexMappers, base->m_segmentationOptions.threadCount);
 			while(volumeIPF->highest_layer() < base->m_segmentationOptions.waterfallLayerLimit)
 			{
-				volumeIPF->clone_layer(volumeIPF->highest_layer());
+				// Build the next layer of the forest from the merges made by the passes, grouping the nodes of the current
+				// highest layer in one go rather than cloning it and merging the nodes one pair at a time.
+				std::vector<std::set<int> > groups;
+				runner.run(groups);
 				if(is_aborted()) return;
 
-				for(int i=0; i<subvolumeCount; ++i)
-				{
-					if(msts[i]->node_count() != 1)
-					{
-						waterfallPasses[i]->run(*msts[i]);
-					}
-				}
+				volumeIPF->insert_layer_above(volumeIPF->highest_layer(), groups, VolumeIPFT::DONT_CHECK_PRECONDITIONS);
 				if(is_aborted()) return;
 			}
 		}
@@ -273,6 +281,7 @@ private:
 private:
 	LeafLayer_Ptr m_combinedLeafLayer;
 	BranchLayer_Ptr m_combinedLowestBranchLayer;
+	boost::mutex m_extractionMutex;
 	itk::Size<3> m_gridSize;
 	std::vector<LeafLayer_Ptr> m_leafLayers;
 	std::vector<BranchLayer_Ptr> m_lowestBranchLayers;
@@ -298,15 +307,37 @@ public:
 		m_leafLayers.resize(subvolumeCount);
 		m_lowestBranchLayers.resize(subvolumeCount);
 
+		// The lowest layers of the subvolumes are independent of each other until they are combined, so if more than one
+		// thread is available, they can be built concurrently (each subvolume's extractor and builder forming a single unit).
+		int threadCount = std::min(segmentationOptions.threadCount, subvolumeCount);
+		ParallelJob_Ptr parallelJob;
+		if(threadCount > 1)
+		{
+			parallelJob.reset(new ParallelJob(threadCount));
+		}
+
 		for(int i=0; i<subvolumeCount; ++i)
 		{
 			ExtractSubvolumeJob *extractor = new ExtractSubvolumeJob(this, i);
 			LowestLayersBuilder *builder = new LowestLayersBuilder(m_segmentationOptions, m_leafLayers[i], m_lowestBranchLayers[i]);
 			builder->set_volume_hook(extractor->subvolumeHook);
-			add_subjob(extractor);
-			add_subjob(builder);
+
+			if(parallelJob)
+			{
+				CompositeJob_Ptr subvolumeJob(new CompositeJob);
+				subvolumeJob->add_subjob(extractor);
+				subvolumeJob->add_subjob(builder);
+				parallelJob->add_subjob(subvolumeJob);
+			}
+			else
+			{
+				add_subjob(extractor);
+				add_subjob(builder);
+			}
 		}
 
+		if(parallelJob) add_subjob(parallelJob);
+
 		add_subjob(new CombineLeafLayersJob(this));
 		add_subjob(new CombineLowestBranchLayersJob(this));
 		add_subjob(new CreateForestJob(this));
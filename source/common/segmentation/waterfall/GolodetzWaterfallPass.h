@@ -1,17 +1,32 @@
 /***
  * millipede: GolodetzWaterfallPass.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_GOLODETZWATERFALLPASS
 #define H_MILLIPEDE_GOLODETZWATERFALLPASS
 
-#include <map>
+#include <algorithm>
+#include <climits>
+#include <vector>
 
 #include "WaterfallPass.h"
 
 namespace mp {
 
+/**
+@brief	A GolodetzWaterfallPass implements a single pass of the waterfall algorithm described in Stuart Golodetz's thesis.
+
+The pass works on a flat snapshot of the rooted MST that is taken at the start of each run: the nodes are numbered densely
+(as "slots", in ascending order of node index), and the tree structure, parent edge weights and per-node algorithm data are
+all stored in parallel arrays. The up, down and merge passes are then explicit-stack traversals over these arrays, so deep
+trees cannot overflow the call stack and no allocations are made per node. The arrays are retained between runs, so that
+repeatedly running the pass on the same MST (as when building a partition forest) does not reallocate them either.
+
+The merges are performed (and reported to the listeners) in exactly the same order as by a recursive post-order traversal
+of the MST that visits the children of each node in ascending order of node index.
+*/
 template <typename EdgeWeight>
 class GolodetzWaterfallPass : public WaterfallPass<EdgeWeight>
 {
@@ -28,32 +43,81 @@ public:
 	};
 
 	//#################### NESTED CLASSES ####################
-public:
+private:
+	/**
+	The arrows on a node (i.e. the nodes at the other ends of the edges along which water would flow) are represented implicitly:
+	each node records how many arrows it has and whether one of them points to its parent, and each node also records whether
+	its parent has an arrow pointing down to it.
+	*/
 	struct NodeData
 	{
-		std::set<int> m_arrows;						// the nodes at the other ends of arrowed edges (ones along which water would flow)
+		int m_arrowCount;							// the number of arrowed edges leading out of the node
+		bool m_arrowFromParent;						// whether the node's parent has an arrow pointing along the parent edge (i.e. to this node)
+		bool m_arrowToParent;						// whether the node has an arrow pointing along its parent edge
 		bool m_checkParent;							// whether the parent route needs checking in the down pass
 		int m_distance;								// the node's distance value (see algorithm description)
 		NodeClassifier m_parentBottomClassifier;	// the classification of the node with regard to the node's parent edge
 		NodeClassifier m_parentTopClassifier;		// the classification of the node's parent with regard to the node's parent edge
 
 		NodeData()
-		:	m_checkParent(false),
+		:	m_arrowCount(0),
+			m_arrowFromParent(false),
+			m_arrowToParent(false),
+			m_checkParent(false),
 			m_distance(0),
 			m_parentBottomClassifier(UNDETERMINED),
 			m_parentTopClassifier(UNDETERMINED)
 		{}
 	};
 
+	//#################### PRIVATE VARIABLES ####################
+private:
+	std::vector<int> m_childOffsets;			// the children of slot s are m_children[m_childOffsets[s]] ... m_children[m_childOffsets[s+1]-1]
+	std::vector<int> m_children;				// the slots of the children of each slot, in ascending order
+	std::vector<NodeData> m_data;				// the algorithm data for each slot
+	std::vector<int> m_nodeIndices;				// the (current) MST node index for each slot
+	std::vector<int> m_parentSlots;				// the slot of the parent of each slot (or -1 for the root)
+	std::vector<EdgeWeight> m_parentWeights;	// the weight of the parent edge of each slot (undefined for the root)
+	std::vector<int> m_postorder;				// the slots in the order in which a recursive post-order traversal would visit them
+	std::vector<int> m_scratch;					// scratch space used when building the flat tree
+	std::vector<int> m_slots;					// the slot for each MST node index (or -1 if there is no such node)
+
 	//#################### PUBLIC METHODS ####################
 public:
+	/**
+	@brief	Returns the classification of the specified node with regard to its parent edge, as calculated by the last run.
+
+	@param[in]	n	The index of a node in the MST
+	@pre
+		-	The last run was a run_without_merge_pass() on the MST containing n
+	@return	As described
+	*/
+	NodeClassifier parent_bottom_classifier(int n) const
+	{
+		return m_data[m_slots[n]].m_parentBottomClassifier;
+	}
+
+	/**
+	@brief	Returns the classification of the parent of the specified node with regard to the node's parent edge, as calculated by the last run.
+
+	@param[in]	n	The index of a node in the MST
+	@pre
+		-	The last run was a run_without_merge_pass() on the MST containing n
+	@return	As described
+	*/
+	NodeClassifier parent_top_classifier(int n) const
+	{
+		return m_data[m_slots[n]].m_parentTopClassifier;
+	}
+
 	RootedMST<EdgeWeight>& run(RootedMST<EdgeWeight>& mst)
 	{
 		if(mst.node_count() > 1)
 		{
-			up_pass(mst, mst.tree_root());
-			down_pass(mst, mst.tree_root());
-			merge_pass(mst, mst.tree_root());
+			build_flat_tree(mst);
+			up_pass();
+			down_pass();
+			merge_pass(mst);
 		}
 		return mst;
 	}
@@ -62,229 +126,221 @@ public:
 	{
 		if(mst.node_count() > 1)
 		{
-			up_pass(mst, mst.tree_root());
-			down_pass(mst, mst.tree_root());
+			build_flat_tree(mst);
+			up_pass();
+			down_pass();
 		}
 		return mst;
 	}
 
 	//#################### PRIVATE METHODS ####################
 private:
-	static NodeClassifier classify_node(const NodeData& data, int other)
+	void build_flat_tree(const RootedMST<EdgeWeight>& mst)
 	{
-		NodeClassifier classifier;
-		switch(data.m_arrows.size())
+		// Number the nodes densely in ascending order of node index.
+		m_nodeIndices = mst.node_indices();
+		int slotCount = static_cast<int>(m_nodeIndices.size());
+		m_slots.assign(m_nodeIndices.back() + 1, -1);
+		for(int s=0; s<slotCount; ++s) m_slots[m_nodeIndices[s]] = s;
+
+		// Record the parent and parent edge weight of each slot, and count the children.
+		m_parentSlots.resize(slotCount);
+		m_parentWeights.resize(slotCount);
+		m_childOffsets.assign(slotCount + 1, 0);
+		for(int s=0; s<slotCount; ++s)
 		{
-			case 0:
-			{
-				classifier = NO_FLOW;
-				break;
-			}
-			case 1:
-			{
-				classifier = *data.m_arrows.begin() == other ? UNAMBIGUOUS_IN : UNAMBIGUOUS_OUT;
-				break;
-			}
-			default:
+			int parent = mst.tree_parent(m_nodeIndices[s]);
+			m_parentSlots[s] = parent != -1 ? m_slots[parent] : -1;
+			if(parent != -1)
 			{
-				classifier = data.m_arrows.find(other) != data.m_arrows.end() ? AMBIGUOUS_IN : AMBIGUOUS_OUT;
-				break;
+				m_parentWeights[s] = mst.parent_edge_weight(m_nodeIndices[s]);
+				++m_childOffsets[m_parentSlots[s] + 1];
 			}
 		}
-		return classifier;
-	}
+		for(int s=0; s<slotCount; ++s) m_childOffsets[s+1] += m_childOffsets[s];
 
-	static void down_pass(RootedMST<EdgeWeight>& mst, int cur)
-	{
-		int parent = mst.tree_parent(cur);
-
-		// Check for a better upwards route if necessary.
-		NodeData data = mst.template node_data<NodeData>(cur);
-		if(data.m_checkParent)
+		// Fill in the children of each slot. Since the slots are visited in ascending order, each child list ends up sorted.
+		m_children.resize(slotCount - 1);
+		m_scratch.assign(m_childOffsets.begin(), m_childOffsets.end() - 1);
+		for(int s=0; s<slotCount; ++s)
 		{
-			const NodeData& parentData = mst.template node_data<NodeData>(parent);
-			if(parentData.m_arrows.find(cur) == parentData.m_arrows.end())
-			{
-				// There is a potential upwards route.
-				int upwardsDistance = parentData.m_distance + 1;
-				if(upwardsDistance < data.m_distance)
-				{
-					// The upwards route is strictly better.
-					data.m_arrows.clear();
-					data.m_arrows.insert(parent);
-					data.m_distance = upwardsDistance;
-				}
-				else if(upwardsDistance == data.m_distance)
-				{
-					// The upwards route is just as good.
-					data.m_arrows.insert(parent);
-				}
-			}
+			if(m_parentSlots[s] != -1) m_children[m_scratch[m_parentSlots[s]]++] = s;
 		}
 
-		// Classify the node and its parent with respect to the parent edge.
-		if(parent != -1)
+		// Calculate the post-order. A pre-order traversal that visits the children of each node in descending order is
+		// exactly the reverse of a post-order traversal that visits them in ascending order.
+		m_postorder.clear();
+		m_scratch.clear();
+		m_scratch.push_back(m_slots[mst.tree_root()]);
+		while(!m_scratch.empty())
 		{
-			const NodeData& parentData = mst.template node_data<NodeData>(parent);
-			data.m_parentBottomClassifier = classify_node(data, parent);
-			data.m_parentTopClassifier = classify_node(parentData, cur);
+			int s = m_scratch.back();
+			m_scratch.pop_back();
+			m_postorder.push_back(s);
+			m_scratch.insert(m_scratch.end(), m_children.begin() + m_childOffsets[s], m_children.begin() + m_childOffsets[s+1]);
 		}
+		std::reverse(m_postorder.begin(), m_postorder.end());
 
-		mst.set_node_data(cur, data);
-
-		// Recurse on the children.
-		std::set<int> children = mst.tree_children(cur);
-		for(std::set<int>::const_iterator it=children.begin(), iend=children.end(); it!=iend; ++it)
-		{
-			down_pass(mst, *it);
-		}
+		m_data.assign(slotCount, NodeData());
 	}
 
-	int merge_pass(RootedMST<EdgeWeight>& mst, int cur)
+	static NodeClassifier classify_node(int arrowCount, bool arrowToOther)
 	{
-		// Recurse on the children.
-		std::set<int> children = mst.tree_children(cur);
-		for(std::set<int>::const_iterator it=children.begin(), iend=children.end(); it!=iend; ++it)
+		switch(arrowCount)
 		{
-			cur = merge_pass(mst, *it);
+			case 0:		return NO_FLOW;
+			case 1:		return arrowToOther ? UNAMBIGUOUS_IN : UNAMBIGUOUS_OUT;
+			default:	return arrowToOther ? AMBIGUOUS_IN : AMBIGUOUS_OUT;
 		}
+	}
 
-		// Merge the parent edge if necessary.
-		int parent = mst.tree_parent(cur);
-		const NodeData& data = mst.template node_data<NodeData>(cur);
-		if(data.m_parentBottomClassifier == UNAMBIGUOUS_IN || data.m_parentTopClassifier == UNAMBIGUOUS_IN ||
-		   (data.m_parentBottomClassifier == NO_FLOW && data.m_parentTopClassifier == NO_FLOW))
+	void down_pass()
+	{
+		// Process the slots in pre-order (i.e. each parent before its children).
+		for(typename std::vector<int>::const_reverse_iterator it=m_postorder.rbegin(), iend=m_postorder.rend(); it!=iend; ++it)
 		{
-			NodeData parentData = mst.template node_data<NodeData>(parent);
-			int oldParent = parent;
-			parent = this->merge_nodes(mst, parent, cur);
-
-			// Ensure that the data associated with the new parent node is correct.
-			parentData.m_arrows.erase(cur);
-			parentData.m_arrows.insert(-cur);	// the - is to represent a node which no longer exists
-			mst.set_node_data(parent, parentData);
+			int cur = *it;
+			int parent = m_parentSlots[cur];
+			NodeData& data = m_data[cur];
 
-			if(parent != oldParent)
+			// Check for a better upwards route if necessary.
+			if(data.m_checkParent && !data.m_arrowFromParent)
 			{
-				// Ensure that the new parent's parent (if any) and children refer to it by its new name.
-				int grandparent = mst.tree_parent(parent);
-				if(grandparent != -1)
+				// There is a potential upwards route. Note that the distance of an unescapable parent (INT_MAX)
+				// deliberately wraps round here, since that is how the original formulation of the pass behaves.
+				int parentDistance = m_data[parent].m_distance;
+				int upwardsDistance = parentDistance != INT_MAX ? parentDistance + 1 : INT_MIN;
+				if(upwardsDistance < data.m_distance)
 				{
-					NodeData grandparentData = mst.template node_data<NodeData>(grandparent);
-					if(grandparentData.m_arrows.find(oldParent) != grandparentData.m_arrows.end())
+					// The upwards route is strictly better: replace all the node's arrows with a single arrow to its parent.
+					for(int k=m_childOffsets[cur], kend=m_childOffsets[cur+1]; k!=kend; ++k)
 					{
-						grandparentData.m_arrows.erase(oldParent);
-						grandparentData.m_arrows.insert(parent);
-						mst.set_node_data(grandparent, grandparentData);
+						m_data[m_children[k]].m_arrowFromParent = false;
 					}
+					data.m_arrowCount = 1;
+					data.m_arrowToParent = true;
+					data.m_distance = upwardsDistance;
 				}
-
-				std::set<int> children = mst.tree_children(parent);
-				for(std::set<int>::const_iterator it=children.begin(), iend=children.end(); it!=iend; ++it)
+				else if(upwardsDistance == data.m_distance)
 				{
-					NodeData childData = mst.template node_data<NodeData>(*it);
-					if(childData.m_arrows.find(oldParent) != childData.m_arrows.end())
-					{
-						childData.m_arrows.erase(oldParent);
-						childData.m_arrows.insert(parent);
-						mst.set_node_data(*it, childData);
-					}
+					// The upwards route is just as good.
+					++data.m_arrowCount;
+					data.m_arrowToParent = true;
 				}
 			}
-		}
 
-		return parent;
+			// Classify the node and its parent with respect to the parent edge.
+			if(parent != -1)
+			{
+				data.m_parentBottomClassifier = classify_node(data.m_arrowCount, data.m_arrowToParent);
+				data.m_parentTopClassifier = classify_node(m_data[parent].m_arrowCount, data.m_arrowFromParent);
+			}
+		}
 	}
 
-	static void up_pass(RootedMST<EdgeWeight>& mst, int cur)
+	void merge_pass(RootedMST<EdgeWeight>& mst)
 	{
-		int parent = mst.tree_parent(cur);
-		NodeData data;
-
-		// Recursively process any children.
-		std::set<int> children = mst.tree_children(cur);
-		for(std::set<int>::const_iterator it=children.begin(), iend=children.end(); it!=iend; ++it)
-		{
-			up_pass(mst, *it);
-		}
-
-		// Construct the weight -> edges map.
-		std::map<EdgeWeight,std::set<int> > weightToEdges;
-		if(parent != -1)
+		for(typename std::vector<int>::const_iterator it=m_postorder.begin(), iend=m_postorder.end(); it!=iend; ++it)
 		{
-			weightToEdges[mst.edge_weight(parent, cur)].insert(parent);
-		}
-		for(std::set<int>::const_iterator it=children.begin(), iend=children.end(); it!=iend; ++it)
-		{
-			weightToEdges[mst.edge_weight(cur, *it)].insert(*it);
-		}
-
-		// If this node has a unique edge of steepest descent (i.e. a unique lowest-valued edge
-		// leading out of it, which can be the parent edge), add an arrow on the node pointing
-		// along the edge and early-out.
-		const std::set<int>& lowestEdges = weightToEdges.begin()->second;
-		if(lowestEdges.size() == 1)
-		{
-			data.m_arrows = lowestEdges;
-			mst.set_node_data(cur, data);
-			return;
+			// Merge the parent edge if necessary. Note that the merge decisions depend only on the classifiers
+			// calculated in the down pass, so the arrows do not need to be maintained across merges.
+			int cur = *it;
+			const NodeData& data = m_data[cur];
+			if(data.m_parentBottomClassifier == UNAMBIGUOUS_IN || data.m_parentTopClassifier == UNAMBIGUOUS_IN ||
+			   (data.m_parentBottomClassifier == NO_FLOW && data.m_parentTopClassifier == NO_FLOW))
+			{
+				// The merged node takes over the parent's slot (but may have a new index).
+				int parent = m_parentSlots[cur];
+				m_nodeIndices[parent] = this->merge_nodes(mst, m_nodeIndices[parent], m_nodeIndices[cur]);
+			}
 		}
+	}
 
-		// Otherwise, consider all the lowest-valued child edges (i.e. ignore the parent for now,
-		// even if it is also a lowest-valued edge) which satisfy the two conditions:
-		//
-		// (a)	There is no arrow on the node at the other end of the edge pointing along the
-		//		edge towards this node
-		// (b)	The node at the other end of the edge has a distance value not equal to INT_MAX
-		//
-		// If there are no such child edges, then this node is unescapable along a child edge and
-		// should be given a distance value of INT_MAX. Otherwise, each of these child edges can be
-		// assigned a distance value equal to 1 greater than the value on the node at the other end of
-		// the edge: this value on the node will be 0 for nodes from which there is a unique path of
-		// steepest descent, and non-zero otherwise. Pick all the child edges whose distance value is
-		// minimal and add arrows to this node pointing along them (these indicate the initial paths
-		// of steepest descent from this node). Store the minimum distance value as this node's value.
-
-		std::set<int> lowestChildEdges = lowestEdges;
-		lowestChildEdges.erase(parent);
-		for(std::set<int>::iterator it=lowestChildEdges.begin(), iend=lowestChildEdges.end(); it!=iend; /* No-op */)
+	void up_pass()
+	{
+		// Process the slots in post-order (i.e. each parent after its children).
+		for(typename std::vector<int>::const_iterator it=m_postorder.begin(), iend=m_postorder.end(); it!=iend; ++it)
 		{
-			const NodeData& childData = mst.template node_data<NodeData>(*it);
-			if(childData.m_arrows.find(cur) != childData.m_arrows.end() || childData.m_distance == INT_MAX)
+			int cur = *it;
+			int parent = m_parentSlots[cur];
+			int childBegin = m_childOffsets[cur], childEnd = m_childOffsets[cur+1];
+			NodeData& data = m_data[cur];
+
+			// Find the lowest weight of any edge leading out of the node (which can be the parent edge),
+			// and count the number of edges with that weight.
+			bool parentIsLowest = parent != -1;
+			EdgeWeight lowestWeight = parentIsLowest ? m_parentWeights[cur] : EdgeWeight();
+			int lowestCount = parentIsLowest ? 1 : 0;
+			int lowestChild = -1;
+			for(int k=childBegin; k!=childEnd; ++k)
 			{
-				lowestChildEdges.erase(it++);
+				const EdgeWeight& weight = m_parentWeights[m_children[k]];
+				if(lowestCount == 0 || weight < lowestWeight)
+				{
+					lowestWeight = weight;
+					lowestCount = 1;
+					lowestChild = m_children[k];
+					parentIsLowest = false;
+				}
+				else if(weight == lowestWeight) ++lowestCount;
 			}
-			else ++it;
-		}
 
-		if(!lowestChildEdges.empty())
-		{
-			std::map<int,std::set<int> > distanceToEdges;
-			for(std::set<int>::const_iterator it=lowestChildEdges.begin(), iend=lowestChildEdges.end(); it!=iend; ++it)
+			// If this node has a unique edge of steepest descent, add an arrow on the node pointing
+			// along the edge and move on.
+			if(lowestCount == 1)
 			{
-				const NodeData& childData = mst.template node_data<NodeData>(*it);
-				distanceToEdges[childData.m_distance+1].insert(*it);
+				data.m_arrowCount = 1;
+				if(parentIsLowest) data.m_arrowToParent = true;
+				else m_data[lowestChild].m_arrowFromParent = true;
+				continue;
 			}
 
-			int minDistance = distanceToEdges.begin()->first;
-			const std::set<int>& minEdges = distanceToEdges.begin()->second;
+			// Otherwise, consider all the lowest-valued child edges (i.e. ignore the parent for now,
+			// even if it is also a lowest-valued edge) which satisfy the two conditions:
+			//
+			// (a)	There is no arrow on the node at the other end of the edge pointing along the
+			//		edge towards this node
+			// (b)	The node at the other end of the edge has a distance value not equal to INT_MAX
+			//
+			// If there are no such child edges, then this node is unescapable along a child edge and
+			// should be given a distance value of INT_MAX. Otherwise, each of these child edges can be
+			// assigned a distance value equal to 1 greater than the value on the node at the other end of
+			// the edge: this value on the node will be 0 for nodes from which there is a unique path of
+			// steepest descent, and non-zero otherwise. Pick all the child edges whose distance value is
+			// minimal and add arrows to this node pointing along them (these indicate the initial paths
+			// of steepest descent from this node). Store the minimum distance value as this node's value.
+			int minDistance = INT_MAX;
+			for(int k=childBegin; k!=childEnd; ++k)
+			{
+				const NodeData& childData = m_data[m_children[k]];
+				if(m_parentWeights[m_children[k]] == lowestWeight && !childData.m_arrowToParent && childData.m_distance != INT_MAX)
+				{
+					minDistance = std::min(minDistance, childData.m_distance + 1);
+				}
+			}
 
-			data.m_arrows = minEdges;
+			if(minDistance != INT_MAX)
+			{
+				for(int k=childBegin; k!=childEnd; ++k)
+				{
+					NodeData& childData = m_data[m_children[k]];
+					if(m_parentWeights[m_children[k]] == lowestWeight && !childData.m_arrowToParent && childData.m_distance != INT_MAX &&
+					   childData.m_distance + 1 == minDistance)
+					{
+						childData.m_arrowFromParent = true;
+						++data.m_arrowCount;
+					}
+				}
+			}
 			data.m_distance = minDistance;
-		}
-		else
-		{
-			data.m_distance = INT_MAX;
-		}
 
-		// Now consider the parent edge: if it was a lowest-valued edge, mark it as a potential
-		// path of steepest descent to avoid the need to check again in the down pass.
-		if(lowestEdges.find(parent) != lowestEdges.end())
-		{
-			data.m_checkParent = true;
+			// Now consider the parent edge: if it was a lowest-valued edge, mark it as a potential
+			// path of steepest descent to avoid the need to check again in the down pass.
+			if(parent != -1 && m_parentWeights[cur] == lowestWeight)
+			{
+				data.m_checkParent = true;
+			}
 		}
-
-		mst.set_node_data(cur, data);
 	}
 };
 
@@ -1,12 +1,13 @@
 /***
  * millipede: MarcoteguiWaterfallPass.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_MARCOTEGUIWATERFALLPASS
 #define H_MILLIPEDE_MARCOTEGUIWATERFALLPASS
 
-#include <common/adts/PriorityQueue.h>
+#include <common/adts/DaryPriorityQueue.h>
 #include <common/util/NullType.h>
 #include "GolodetzWaterfallPass.h"
 
@@ -18,8 +19,7 @@ class MarcoteguiWaterfallPass : public WaterfallPass<EdgeWeight>
 	//#################### TYPEDEFS ####################
 private:
 	typedef GolodetzWaterfallPass<EdgeWeight> GolodetzWaterfallPassT;
-	typedef typename GolodetzWaterfallPassT::NodeData GolodetzNodeData;
-	typedef PriorityQueue<int,EdgeWeight,NullType> PQ;
+	typedef DaryPriorityQueue<int,EdgeWeight,NullType,std::less<EdgeWeight>,2> PQ;
 
 	//#################### ENUMERATIONS ####################
 private:
@@ -36,21 +36,31 @@ private:
 		NodeFlag m_nodeFlag;
 		bool m_parentWillMerge;
 
+		NodeData()
+		:	m_nodeFlag(UNMARKED), m_parentWillMerge(false)
+		{}
+
 		NodeData(NodeFlag nodeFlag, bool parentWillMerge)
 		:	m_nodeFlag(nodeFlag), m_parentWillMerge(parentWillMerge)
 		{}
 	};
 
+	//#################### PRIVATE VARIABLES ####################
+private:
+	std::vector<NodeData> m_nodeData;	// the data for each node in the MST, indexed by node index
+
 	//#################### PUBLIC METHODS ####################
 public:
 	RootedMST<EdgeWeight>& run(RootedMST<EdgeWeight>& mst)
 	{
 		// Run a Golodetz waterfall pass on the MST (without doing any merging) in order to classify the edges.
-		GolodetzWaterfallPassT().run_without_merge_pass(mst);
+		GolodetzWaterfallPassT golodetzPass;
+		golodetzPass.run_without_merge_pass(mst);
 
 		// Mark (and record) any edges which are part of a local minimum. Note that we represent the edges by their child node in the tree.
 		std::list<int> localMinima;
-		mark_local_minima(mst, mst.tree_root(), localMinima);
+		m_nodeData.assign(mst.node_index_bound(), NodeData());
+		mark_local_minima(mst, golodetzPass, mst.tree_root(), localMinima);
 
 		// Build the initial propagation queue from the unmarked edges adjacent to the local minima.
 		PQ pq = build_initial_propagation_queue(mst, localMinima);
@@ -78,9 +88,9 @@ private:
 		return adjEdges;
 	}
 
-	static PQ build_initial_propagation_queue(const RootedMST<EdgeWeight>& mst, const std::list<int>& localMinima)
+	PQ build_initial_propagation_queue(const RootedMST<EdgeWeight>& mst, const std::list<int>& localMinima)
 	{
-		PQ pq;
+		PQ pq(mst.node_index_bound());
 		for(std::list<int>::const_iterator it=localMinima.begin(), iend=localMinima.end(); it!=iend; ++it)
 		{
 			enqueue_relevant_adjacent_edges(*it, pq, mst);
@@ -88,7 +98,7 @@ private:
 		return pq;
 	}
 
-	static void enqueue_relevant_adjacent_edges(int e, PQ& pq, const RootedMST<EdgeWeight>& mst)
+	void enqueue_relevant_adjacent_edges(int e, PQ& pq, const RootedMST<EdgeWeight>& mst)
 	{
 		std::vector<int> adjEdges = adjacent_edges(e, mst);
 		for(std::vector<int>::const_iterator it=adjEdges.begin(), iend=adjEdges.end(); it!=iend; ++it)
@@ -96,8 +106,8 @@ private:
 			int parent = mst.tree_parent(*it);
 			if(parent != -1)
 			{
-				NodeFlag flag = mst.template node_data<NodeData>(*it).m_nodeFlag;
-				NodeFlag parentFlag = mst.template node_data<NodeData>(parent).m_nodeFlag;
+				NodeFlag flag = m_nodeData[*it].m_nodeFlag;
+				NodeFlag parentFlag = m_nodeData[parent].m_nodeFlag;
 				if(flag == UNMARKED || parentFlag == UNMARKED)
 				{
 					EdgeWeight weight = mst.edge_weight(parent, *it);
@@ -107,21 +117,20 @@ private:
 		}
 	}
 
-	static bool mark_local_minima(RootedMST<EdgeWeight>& mst, int cur, std::list<int>& localMinima)
+	bool mark_local_minima(RootedMST<EdgeWeight>& mst, const GolodetzWaterfallPassT& golodetzPass, int cur, std::list<int>& localMinima)
 	{
 		// Recurse on the children.
 		bool childEdgeIsLocalMinimum = false;	// are any of the child edges of this node a local minimum?
 		std::set<int> children = mst.tree_children(cur);
 		for(std::set<int>::const_iterator it=children.begin(), iend=children.end(); it!=iend; ++it)
 		{
-			bool result = mark_local_minima(mst, *it, localMinima);
+			bool result = mark_local_minima(mst, golodetzPass, *it, localMinima);
 			childEdgeIsLocalMinimum = childEdgeIsLocalMinimum || result;
 		}
 
 		// Check whether the parent edge of this node is a singular minimum, or part of a minimal plateau, and record it if so.
 		bool parentEdgeIsLocalMinimum = false;
-		const GolodetzNodeData& data = mst.template node_data<GolodetzNodeData>(cur);
-		if(minimum_contribution(data.m_parentBottomClassifier) + minimum_contribution(data.m_parentTopClassifier) == 2)
+		if(minimum_contribution(golodetzPass.parent_bottom_classifier(cur)) + minimum_contribution(golodetzPass.parent_top_classifier(cur)) == 2)
 		{
 			parentEdgeIsLocalMinimum = true;
 			localMinima.push_back(cur);
@@ -129,9 +138,9 @@ private:
 
 		// Mark this node if its parent edge or one of its child edges is a local minimum. If the
 		// parent edge is the local minimum, also set the parent edge to be merged later.
-		if(parentEdgeIsLocalMinimum)		mst.set_node_data(cur, NodeData(MARKED, true));
-		else if(childEdgeIsLocalMinimum)	mst.set_node_data(cur, NodeData(MARKED, false));
-		else								mst.set_node_data(cur, NodeData(UNMARKED, false));
+		if(parentEdgeIsLocalMinimum)		m_nodeData[cur] = NodeData(MARKED, true);
+		else if(childEdgeIsLocalMinimum)	m_nodeData[cur] = NodeData(MARKED, false);
+		else								m_nodeData[cur] = NodeData(UNMARKED, false);
 
 		return parentEdgeIsLocalMinimum;
 	}
@@ -146,15 +155,15 @@ private:
 		}
 
 		// Where necessary, merge the parent edge of this node (if any).
-		NodeData curData = mst.template node_data<NodeData>(cur);
+		NodeData curData = m_nodeData[cur];
 		int parent = mst.tree_parent(cur);
 		if(curData.m_parentWillMerge)
 		{
-			NodeData parentData = mst.template node_data<NodeData>(parent);
+			NodeData parentData = m_nodeData[parent];
 			parent = this->merge_nodes(mst, parent, cur);
 
 			// Note: Since the merging is unpredictable, we need to restore the parent's data afterwards.
-			mst.set_node_data(parent, parentData);
+			m_nodeData[parent] = parentData;
 		}
 
 		return parent;
@@ -165,7 +174,7 @@ private:
 		return (nc == GolodetzWaterfallPassT::AMBIGUOUS_IN || nc == GolodetzWaterfallPassT::NO_FLOW || nc == GolodetzWaterfallPassT::UNAMBIGUOUS_IN) ? 1 : 0;
 	}
 
-	static void propagate_markers(PQ& pq, RootedMST<EdgeWeight>& mst)
+	void propagate_markers(PQ& pq, RootedMST<EdgeWeight>& mst)
 	{
 		while(!pq.empty())
 		{
@@ -173,13 +182,13 @@ private:
 			pq.pop();
 
 			int cur = e.id(), parent = mst.tree_parent(e.id());
-			NodeData curData = mst.template node_data<NodeData>(cur), parentData = mst.template node_data<NodeData>(parent);
+			NodeData curData = m_nodeData[cur], parentData = m_nodeData[parent];
 			if(curData.m_nodeFlag != MARKED || parentData.m_nodeFlag != MARKED)
 			{
 				curData.m_nodeFlag = parentData.m_nodeFlag = MARKED;
 				curData.m_parentWillMerge = true;
-				mst.set_node_data(cur, curData);
-				mst.set_node_data(parent, parentData);
+				m_nodeData[cur] = curData;
+				m_nodeData[parent] = parentData;
 				enqueue_relevant_adjacent_edges(cur, pq, mst);
 			}
 		}
@@ -1,6 +1,7 @@
 /***
  * millipede: MeijsterRoerdinkWatershed.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_MEIJSTERROERDINKWATERSHED
@@ -23,7 +24,7 @@
 #include <itkImageRegionIteratorWithIndex.h>
 #include <itkShapedNeighborhoodIterator.h>
 
-#include <common/adts/DisjointSetForest.h>
+#include <common/adts/DenseDisjointSetForest.h>
 #include <common/exceptions/Exception.h>
 
 namespace mp {
@@ -329,7 +330,7 @@ private:
 	void construct_arrows()
 	{
 		m_labelCount = 0;
-		DisjointSetForest<Index> minima;
+		DenseDisjointSetForest<Index> minima;
 
 		// Step 1:	Add all the minimum points to a disjoint set forest.
 		{
@@ -1,6 +1,7 @@
 /***
  * millipede: SliceTextureSet.h
  * Copyright Stuart Golodetz, 2009. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_SLICETEXTURESET
@@ -80,6 +81,26 @@ public:
 		}
 	}
 
+	/**
+	@brief	Sets a span of pixels in the texture for the specified slice.
+
+	The span lies on the specified row of the slice, and starts at the specified column. Rows and columns are the
+	image coordinates of the slice (e.g. y and x for an XY slice, or z and y for a YZ slice). Writing pixels a span
+	at a time is much cheaper than writing them individually, and the texture only re-uploads the affected region
+	of the slice when it is next bound.
+
+	@param[in]	ori		The orientation of the slice
+	@param[in]	slice	The index of the slice
+	@param[in]	row		The row of the span
+	@param[in]	col		The column of the first pixel in the span
+	@param[in]	pixels	The new values of the pixels in the span
+	@param[in]	count	The number of pixels in the span
+	*/
+	void set_pixels(SliceOrientation ori, int slice, int row, int col, const TPixel *pixels, int count)
+	{
+		m_textures[ori][slice]->set_pixels(ITKImageUtil::make_index(col, row), pixels, count);
+	}
+
 	void set_textures(SliceOrientation ori, const std::vector<ITKImageTexture_Ptr>& textures)
 	{
 		m_textures[ori] = textures;
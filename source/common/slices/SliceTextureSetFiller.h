@@ -1,6 +1,7 @@
 /***
  * millipede: SliceTextureSetFiller.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_SLICETEXTURESETFILLER
@@ -153,8 +154,9 @@ public:
 			createTextureJob->sliceImageHook = extractSliceJob->sliceImageHook;
 			textureSetFillerJob->textureHooks.push_back(createTextureJob->textureHook);
 
+			// Note:	Textures are only uploaded when they are first bound, so creating them doesn't need to happen on the main thread.
 			add_subjob(extractSliceJob);
-			add_main_thread_subjob(createTextureJob);
+			add_subjob(createTextureJob);
 		}
 
 		add_subjob(textureSetFillerJob);
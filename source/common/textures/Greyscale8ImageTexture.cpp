@@ -1,6 +1,7 @@
 /***
  * millipede: Greyscale8ImageTexture.cpp
  * Copyright Stuart Golodetz, 2009. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #include "Greyscale8ImageTexture.h"
@@ -13,9 +14,7 @@ namespace mp {
 //#################### CONSTRUCTORS ####################
 Greyscale8ImageTexture::Greyscale8ImageTexture(const ImagePointer& image, bool clamp)
 :	ITKImageTexture<Greyscale8Image>(image, clamp)
-{
-	reload();
-}
+{}
 
 //#################### PUBLIC METHODS ####################
 boost::shared_ptr<ITKImageTexture<Greyscale8Image> > Greyscale8ImageTexture::clone() const
@@ -40,7 +39,7 @@ void Greyscale8ImageTexture::reload_partial_image(int minX, int minY, int maxX,
 	int xOffset = -1, yOffset = -1;
 	ImagePointer input = scaled_partial_image<Resampler,Interpolator>(minX, minY, maxX, maxY, 50, xOffset, yOffset);
 	itk::Size<2> size = input->GetLargestPossibleRegion().GetSize();
-	glTexSubImage2D(GL_TEXTURE_2D, 0, xOffset, yOffset, size[0], size[1], GL_LUMINANCE, GL_UNSIGNED_BYTE, input->GetBufferPointer());
+	upload_sub_image(xOffset, yOffset, size[0], size[1], GL_LUMINANCE, 1, input->GetBufferPointer());
 }
 
 }
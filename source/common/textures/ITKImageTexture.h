@@ -1,13 +1,17 @@
 /***
  * millipede: ITKImageTexture.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_ITKIMAGETEXTURE
 #define H_MILLIPEDE_ITKIMAGETEXTURE
 
-#include <climits>
+#include <algorithm>
 #include <cmath>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
 
 #include <itkAffineTransform.h>
 #include <itkExtractImageFilter.h>
@@ -18,6 +22,13 @@
 
 namespace mp {
 
+/**
+An ITKImageTexture is a texture whose contents are stored in a 2D ITK image. Changes to the image are made via the texture,
+which keeps track of the regions of it that have become dirty and re-uploads them the next time it is bound. Nearby dirty
+regions are coalesced, so that e.g. writing a contiguous area of the image span by span results in a single upload.
+Pixels may be written from worker threads while the GUI thread binds the texture: the image is locked both while pixels
+are being written and while they are being uploaded, so that a partially-written span is never uploaded.
+*/
 template <typename ImageType>
 class ITKImageTexture : public Texture
 {
@@ -27,18 +38,50 @@ protected:
 	typedef typename Image::Pointer ImagePointer;
 	typedef typename ImageType::PixelType Pixel;
 
+	//#################### NESTED CLASSES ####################
+private:
+	struct DirtyRegion
+	{
+		itk::Index<2> lower, upper;
+
+		DirtyRegion(const itk::Index<2>& lower_, const itk::Index<2>& upper_)
+		:	lower(lower_), upper(upper_)
+		{}
+
+		void absorb(const DirtyRegion& rhs)
+		{
+			for(int i=0; i<2; ++i)
+			{
+				lower[i] = std::min(lower[i], rhs.lower[i]);
+				upper[i] = std::max(upper[i], rhs.upper[i]);
+			}
+		}
+
+		bool touches(const DirtyRegion& rhs) const
+		{
+			for(int i=0; i<2; ++i)
+			{
+				if(lower[i] > rhs.upper[i] + 1 || rhs.lower[i] > upper[i] + 1) return false;
+			}
+			return true;
+		}
+	};
+
+	//#################### ENUMERATIONS ####################
+private:
+	enum { MAX_DIRTY_REGIONS = 8 };		// beyond this, the dirty regions are merged into their bounding box
+
 	//#################### PRIVATE VARIABLES ####################
 private:
-	mutable itk::Index<2> m_dirtyLower, m_dirtyUpper;
+	mutable boost::mutex m_imageMutex;		///< guards both the pixels of the image and the dirty regions
+	mutable std::vector<DirtyRegion> m_dirtyRegions;
 	ImagePointer m_image;
 
 	//#################### CONSTRUCTORS ####################
 public:
 	explicit ITKImageTexture(const ImagePointer& image, bool clamp)
 	:	Texture(clamp), m_image(image)
-	{
-		reset_dirty_region();
-	}
+	{}
 
 	//#################### COPY CONSTRUCTOR & ASSIGNMENT OPERATOR ####################
 private:
@@ -54,10 +97,7 @@ public:
 	void bind() const
 	{
 		Texture::bind();
-		if(is_dirty())
-		{
-			reload_dirty_region();
-		}
+		reload_dirty_region();
 	}
 
 	const Pixel& get_pixel(const itk::Index<2>& index) const
@@ -67,37 +107,71 @@ public:
 
 	void reload() const
 	{
+		boost::mutex::scoped_lock lock(m_imageMutex);
 		Texture::reload();
-		reset_dirty_region();
+		m_dirtyRegions.clear();
 	}
 
 	void reload_dirty_region() const
 	{
-		reload_partial(m_dirtyLower[0], m_dirtyLower[1], m_dirtyUpper[0], m_dirtyUpper[1]);
+		boost::mutex::scoped_lock lock(m_imageMutex);
+		if(m_dirtyRegions.empty()) return;
+
+		std::vector<DirtyRegion> regions;
+		regions.swap(m_dirtyRegions);
+
+		// If the image has to be rescaled for uploading, each partial reload rescales the whole image, so it's cheaper
+		// to reload the bounding box of the dirty regions in one go.
+		if(regions.size() > 1 && needs_scaling())
+		{
+			for(size_t i=1, size=regions.size(); i<size; ++i) regions[0].absorb(regions[i]);
+			regions.erase(regions.begin() + 1, regions.end());
+		}
+
+		for(typename std::vector<DirtyRegion>::const_iterator it=regions.begin(), iend=regions.end(); it!=iend; ++it)
+		{
+			Texture::reload_partial(it->lower[0], it->lower[1], it->upper[0], it->upper[1]);
+		}
 	}
 
 	void reload_partial(int minX, int minY, int maxX, int maxY) const
 	{
+		boost::mutex::scoped_lock lock(m_imageMutex);
 		Texture::reload_partial(minX, minY, maxX, maxY);
-		reset_dirty_region();
+		m_dirtyRegions.clear();
 	}
 
 	void set_pixel(const itk::Index<2>& index, const Pixel& pixel)
 	{
+		boost::mutex::scoped_lock lock(m_imageMutex);
 		m_image->SetPixel(index, pixel);
+		mark_dirty(DirtyRegion(index, index));
+	}
 
-		// Update the dirty region for the image based on the pixel's position.
-		for(int i=0; i<2; ++i)
-		{
-			m_dirtyLower[i] = std::min(m_dirtyLower[i], index[i]);
-			m_dirtyUpper[i] = std::max(m_dirtyUpper[i], index[i]);
-		}
+	/**
+	@brief	Sets a horizontal span of pixels in the image, starting at the specified position.
+
+	@param[in]	begin	The position of the first pixel in the span
+	@param[in]	pixels	The new values of the pixels in the span
+	@param[in]	count	The number of pixels in the span (the span must lie within a single row of the image)
+	*/
+	void set_pixels(const itk::Index<2>& begin, const Pixel *pixels, int count)
+	{
+		if(count <= 0) return;
+
+		boost::mutex::scoped_lock lock(m_imageMutex);
+		std::copy(pixels, pixels + count, m_image->GetBufferPointer() + m_image->ComputeOffset(begin));
+
+		itk::Index<2> end = begin;
+		end[0] += count - 1;
+		mark_dirty(DirtyRegion(begin, end));
 	}
 
 	//#################### PROTECTED METHODS ####################
 protected:
 	ImagePointer clone_image() const
 	{
+		boost::mutex::scoped_lock lock(m_imageMutex);
 		typedef itk::ImageDuplicator<Image> Duplicator;
 		typename Duplicator::Pointer duplicator = Duplicator::New();
 		duplicator->SetInputImage(m_image);
@@ -172,15 +246,43 @@ protected:
 
 	//#################### PRIVATE METHODS ####################
 private:
-	bool is_dirty() const
+	// Precondition: m_imageMutex is locked
+	void mark_dirty(DirtyRegion region)
 	{
-		return  m_dirtyLower[0] != INT_MAX;
+		// Absorb any existing dirty regions that the new region overlaps or touches. Note that absorbing one region
+		// may make the new region touch others, so we keep going until nothing changes.
+		for(bool absorbed=true; absorbed;)
+		{
+			absorbed = false;
+			for(size_t i=0, size=m_dirtyRegions.size(); i<size; ++i)
+			{
+				if(region.touches(m_dirtyRegions[i]))
+				{
+					region.absorb(m_dirtyRegions[i]);
+					m_dirtyRegions[i] = m_dirtyRegions.back();
+					m_dirtyRegions.pop_back();
+					absorbed = true;
+					break;
+				}
+			}
+		}
+		m_dirtyRegions.push_back(region);
+
+		if(m_dirtyRegions.size() > MAX_DIRTY_REGIONS)
+		{
+			for(size_t i=1, size=m_dirtyRegions.size(); i<size; ++i) m_dirtyRegions[0].absorb(m_dirtyRegions[i]);
+			m_dirtyRegions.erase(m_dirtyRegions.begin() + 1, m_dirtyRegions.end());
+		}
 	}
 
-	void reset_dirty_region() const
+	bool needs_scaling() const
 	{
-		m_dirtyLower[0] = m_dirtyLower[1] = INT_MAX;
-		m_dirtyUpper[0] = m_dirtyUpper[1] = INT_MIN;
+		itk::Size<2> size = m_image->GetLargestPossibleRegion().GetSize();
+		for(int i=0; i<2; ++i)
+		{
+			if((size[i] & (size[i] - 1)) != 0) return true;
+		}
+		return false;
 	}
 };
 
@@ -1,6 +1,7 @@
 /***
  * millipede: RGB24ImageTexture.cpp
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #include "RGB24ImageTexture.h"
@@ -13,9 +14,7 @@ namespace mp {
 //#################### CONSTRUCTORS ####################
 RGB24ImageTexture::RGB24ImageTexture(const ImagePointer& image, const boost::optional<RGB24>& colourKey, bool clamp)
 :	ITKImageTexture<RGB24Image>(image, clamp), m_colourKey(colourKey)
-{
-	reload();
-}
+{}
 
 //#################### PUBLIC METHODS ####################
 boost::shared_ptr<ITKImageTexture<RGB24Image> > RGB24ImageTexture::clone() const
@@ -84,16 +83,15 @@ void RGB24ImageTexture::reload_partial_image(int minX, int minY, int maxX, int m
 	const RGB24 *const pixels = input->GetBufferPointer();
 	itk::Size<2> size = input->GetLargestPossibleRegion().GetSize();
 
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	if(m_colourKey)
 	{
 		std::vector<unsigned char> data = make_buffer_with_colour_key(pixels, size);
-		glTexSubImage2D(GL_TEXTURE_2D, 0, xOffset, yOffset, size[0], size[1], GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
+		upload_sub_image(xOffset, yOffset, size[0], size[1], GL_RGBA, 4, &data[0]);
 	}
 	else
 	{
 		std::vector<unsigned char> data = make_buffer_without_colour_key(pixels, size);
-		glTexSubImage2D(GL_TEXTURE_2D, 0, xOffset, yOffset, size[0], size[1], GL_RGB, GL_UNSIGNED_BYTE, &data[0]);
+		upload_sub_image(xOffset, yOffset, size[0], size[1], GL_RGB, 3, &data[0]);
 	}
 }
 
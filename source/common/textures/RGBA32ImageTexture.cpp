@@ -1,6 +1,7 @@
 /***
  * millipede: RGBA32ImageTexture.cpp
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #include "RGBA32ImageTexture.h"
@@ -13,9 +14,7 @@ namespace mp {
 //#################### CONSTRUCTORS ####################
 RGBA32ImageTexture::RGBA32ImageTexture(const ImagePointer& image, bool clamp)
 :	ITKImageTexture<RGBA32Image>(image, clamp)
-{
-	reload();
-}
+{}
 
 //#################### PUBLIC METHODS ####################
 boost::shared_ptr<ITKImageTexture<RGBA32Image> > RGBA32ImageTexture::clone() const
@@ -62,9 +61,7 @@ void RGBA32ImageTexture::reload_partial_image(int minX, int minY, int maxX, int
 	const RGBA32 *const pixels = input->GetBufferPointer();
 	itk::Size<2> size = input->GetLargestPossibleRegion().GetSize();
 	std::vector<unsigned char> data = make_buffer(pixels, size);
-
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-	glTexSubImage2D(GL_TEXTURE_2D, 0, xOffset, yOffset, size[0], size[1], GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
+	upload_sub_image(xOffset, yOffset, size[0], size[1], GL_RGBA, 4, &data[0]);
 }
 
 }
@@ -1,6 +1,7 @@
 /***
  * millipede: Texture.cpp
  * Copyright Stuart Golodetz, 2009. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #include "Texture.h"
@@ -16,6 +17,16 @@
 namespace mp {
 
 //#################### HELPER CLASSES ####################
+struct PixelBufferDeleter
+{
+	void operator()(void *p)
+	{
+		GLuint *id = static_cast<GLuint*>(p);
+		if(glIsBuffer(*id)) glDeleteBuffers(1, id);
+		delete id;
+	}
+};
+
 struct TextureDeleter
 {
 	void operator()(void *p)
@@ -42,11 +53,11 @@ Texture::~Texture()
 
 //#################### PUBLIC METHODS ####################
 /**
-Binds the texture to GL_TEXTURE_2D (reloads it first if necessary).
+Binds the texture to GL_TEXTURE_2D (loads or reloads it first if necessary).
 */
 void Texture::bind() const
 {
-	if(!glIsTexture(*m_id)) reload();
+	if(!m_id || !glIsTexture(*m_id)) reload();
 	glBindTexture(GL_TEXTURE_2D, *m_id);
 }
 
@@ -83,6 +94,49 @@ void Texture::reload_partial(int minX, int minY, int maxX, int maxY) const
 	reload_partial_image(minX, minY, maxX, maxY);
 }
 
+//#################### PROTECTED METHODS ####################
+/**
+Uploads a block of pixels to the [xOffset,yOffset]-[xOffset+width-1,yOffset+height-1] region of the currently-bound texture.
+Where pixel buffer objects are available (OpenGL 2.1 onwards), the pixels are staged in one, so that the transfer to the
+texture itself can proceed asynchronously. Each texture has its own pixel buffer object, created in the same context as
+the texture itself (and recreated along with it if the texture has to be reloaded in a different context).
+
+@param[in]	xOffset			The x offset of the region in the texture
+@param[in]	yOffset			The y offset of the region in the texture
+@param[in]	width			The width of the region
+@param[in]	height			The height of the region
+@param[in]	format			The format of the pixels (e.g. GL_LUMINANCE), each of whose components is a GL_UNSIGNED_BYTE
+@param[in]	bytesPerPixel	The number of bytes per pixel
+@param[in]	pixels			The pixels, tightly packed row by row
+*/
+void Texture::upload_sub_image(int xOffset, int yOffset, int width, int height, GLenum format, int bytesPerPixel, const void *pixels) const
+{
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	if(GLEE_VERSION_2_1)
+	{
+		if(!m_pixelBufferID || !glIsBuffer(*m_pixelBufferID))
+		{
+			GLuint id;
+			glGenBuffers(1, &id);
+			m_pixelBufferID.reset(new GLuint(id), PixelBufferDeleter());
+		}
+
+		// Note:	Respecifying the buffer's data store on each upload lets the driver allocate a fresh one if the previous
+		//			upload is still in flight. Once the transfer has been issued, the data store is orphaned, so that the
+		//			buffer does not hold on to a copy of the pixels between uploads.
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, *m_pixelBufferID);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, width * height * bytesPerPixel, pixels, GL_STREAM_DRAW);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, xOffset, yOffset, width, height, format, GL_UNSIGNED_BYTE, NULL);	// the pixels are taken from the buffer
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, 0, NULL, GL_STREAM_DRAW);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	else
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, 0, xOffset, yOffset, width, height, format, GL_UNSIGNED_BYTE, pixels);
+	}
+}
+
 //#################### PRIVATE METHODS ####################
 void Texture::prepare_for_reload() const
 {
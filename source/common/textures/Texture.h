@@ -1,6 +1,7 @@
 /***
  * millipede: Texture.h
  * Copyright Stuart Golodetz, 2009. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_TEXTURE
@@ -15,6 +16,7 @@ namespace mp {
 /**
 This class represents OpenGL textures. Essentially it's just a simple wrapper for an OpenGL texture ID,
 but with reloading capabilities (i.e. the texture will reload itself if the screen resolution is changed).
+Textures are loaded lazily, the first time they are bound, so they can be created without a current OpenGL context.
 */
 class Texture
 {
@@ -23,6 +25,10 @@ protected:
 	bool m_clamp;
 	mutable boost::shared_ptr<GLuint> m_id;
 
+	//#################### PRIVATE VARIABLES ####################
+private:
+	mutable boost::shared_ptr<GLuint> m_pixelBufferID;	///< the pixel buffer object (if any) through which partial uploads are staged
+
 	//#################### CONSTRUCTORS ####################
 protected:
 	explicit Texture(bool clamp);
@@ -43,6 +49,10 @@ public:
 	virtual void reload() const;
 	virtual void reload_partial(int minX, int minY, int maxX, int maxY) const;
 
+	//#################### PROTECTED METHODS ####################
+protected:
+	void upload_sub_image(int xOffset, int yOffset, int width, int height, GLenum format, int bytesPerPixel, const void *pixels) const;
+
 	//#################### PRIVATE METHODS ####################
 private:
 	void prepare_for_reload() const;
@@ -0,0 +1,59 @@
+/***
+ * millipede: AtomicUtil.h
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#ifndef H_MILLIPEDE_ATOMICUTIL
+#define H_MILLIPEDE_ATOMICUTIL
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+	#pragma intrinsic(_InterlockedCompareExchange, _InterlockedExchangeAdd)
+#endif
+
+namespace mp {
+
+/**
+@brief	This namespace contains the few atomic operations on integers that are needed by the lock-free data structures
+		(it wraps the compiler intrinsics, since neither the language nor the version of Boost in use provides them).
+*/
+namespace AtomicUtil {
+
+/**
+@brief	Atomically adds delta to *target.
+
+@param[in,out]	target	The integer to update
+@param[in]		delta	The amount to add to it
+@return	The new value of *target
+*/
+inline int add(volatile int *target, int delta)
+{
+#ifdef _MSC_VER
+	return _InterlockedExchangeAdd(reinterpret_cast<volatile long*>(target), delta) + delta;
+#else
+	return __sync_add_and_fetch(target, delta);
+#endif
+}
+
+/**
+@brief	Atomically replaces *target with desired if (and only if) it is currently equal to expected.
+
+@param[in,out]	target		The integer to update
+@param[in]		expected	The value *target must have for the update to happen
+@param[in]		desired		The value with which to replace it
+@return	The value of *target before the operation (the update happened iff this is equal to expected)
+*/
+inline int compare_and_swap(volatile int *target, int expected, int desired)
+{
+#ifdef _MSC_VER
+	return _InterlockedCompareExchange(reinterpret_cast<volatile long*>(target), desired, expected);
+#else
+	return __sync_val_compare_and_swap(target, expected, desired);
+#endif
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,72 @@
+/***
+ * millipede: MemoryUtil.h
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#ifndef H_MILLIPEDE_MEMORYUTIL
+#define H_MILLIPEDE_MEMORYUTIL
+
+#include <cstddef>
+#include <set>
+#include <vector>
+
+namespace mp {
+
+/**
+@brief	This namespace contains functions that estimate the amount of memory occupied by standard containers
+		(e.g. so that the undo history can be kept within a memory budget).
+
+The estimates are approximate: they include the container objects themselves and the memory they allocate for
+their elements, but assume a typical per-node overhead for node-based containers.
+*/
+namespace MemoryUtil {
+
+/// The approximate per-node overhead of a std::set (the colour and three links of a red-black tree node)
+enum { SET_NODE_OVERHEAD = 4 * sizeof(void*) };
+
+/**
+@brief	Returns the approximate amount of memory (in bytes) occupied by a std::set.
+
+@param[in]	s	The set
+@return	As described
+*/
+template <typename T>
+size_t footprint(const std::set<T>& s)
+{
+	return sizeof(s) + s.size() * (sizeof(T) + SET_NODE_OVERHEAD);
+}
+
+/**
+@brief	Returns the approximate amount of memory (in bytes) occupied by a std::vector of plain values.
+
+@param[in]	v	The vector
+@return	As described
+*/
+template <typename T>
+size_t footprint(const std::vector<T>& v)
+{
+	return sizeof(v) + v.capacity() * sizeof(T);
+}
+
+/**
+@brief	Returns the approximate amount of memory (in bytes) occupied by a std::vector of sets.
+
+@param[in]	v	The vector
+@return	As described
+*/
+template <typename T>
+size_t footprint(const std::vector<std::set<T> >& v)
+{
+	size_t ret = sizeof(v) + (v.capacity() - v.size()) * sizeof(std::set<T>);
+	for(typename std::vector<std::set<T> >::const_iterator it=v.begin(), iend=v.end(); it!=iend; ++it)
+	{
+		ret += footprint(*it);
+	}
+	return ret;
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,359 @@
+/***
+ * millipede: CompactMesh.h
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#ifndef H_MILLIPEDE_COMPACTMESH
+#define H_MILLIPEDE_COMPACTMESH
+
+#include <algorithm>
+#include <cassert>
+#include <set>
+#include <vector>
+
+#include "Mesh.h"
+#include "MeshUtil.h"
+
+namespace mp {
+
+/**
+@brief	A CompactMesh is an index-based snapshot of the topology of a Mesh, stored in flat arrays.
+
+The adjacent nodes, labels and incident triangles of the nodes are stored in compressed sparse row (CSR) form, i.e.
+as one contiguous array of entries for all the nodes together with an array of offsets into it. The labels are
+renumbered densely (in ascending order), and each node additionally has a bitset of its labels, so that testing
+whether one node has all the labels of another is a handful of word operations rather than a set intersection.
+
+This makes it much smaller than the Mesh it is built from (which has a std::set per node for both its adjacent nodes
+and its labels), and makes it suitable for algorithms that repeatedly sweep over the nodes (e.g. smoothing), which can
+do so in parallel. The topology of a CompactMesh is fixed once it has been constructed: algorithms that change the
+topology of a mesh must do so on the Mesh itself.
+
+@tparam	Label	The type of label used in the mesh
+*/
+template <typename Label>
+class CompactMesh
+{
+	//#################### TYPEDEFS ####################
+public:
+	typedef std::vector<int>::const_iterator IndexIterator;
+private:
+	typedef Mesh<Label> MeshT;
+	typedef MeshNode<Label> MeshNodeT;
+	typedef std::vector<MeshNodeT> MeshNodeVector;
+	typedef MeshTriangle<Label> MeshTriangleT;
+	typedef std::list<MeshTriangleT> MeshTriangleList;
+	typedef unsigned int LabelWord;
+
+	//#################### ENUMERATIONS ####################
+private:
+	enum { BITS_PER_WORD = sizeof(LabelWord) * 8 };
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	std::vector<int> m_adjacencyOffsets;	///< the offsets of the nodes' entries in m_adjacentNodes (one more than the number of nodes)
+	std::vector<int> m_adjacentNodes;		///< the adjacent nodes of each node, in ascending order
+	std::vector<LabelWord> m_labelBits;		///< the bitsets of the nodes' (dense) labels, with m_labelWordCount words per node
+	int m_labelWordCount;					///< the number of words in the label bitset of each node
+	std::vector<Label> m_labels;			///< the distinct labels used in the mesh, in ascending order (indexed by dense label)
+	std::vector<int> m_nodeLabelOffsets;	///< the offsets of the nodes' entries in m_nodeLabels (one more than the number of nodes)
+	std::vector<int> m_nodeLabels;			///< the dense labels of each node, in ascending order
+	std::vector<int> m_nodeTriangleOffsets;	///< the offsets of the nodes' entries in m_nodeTriangles (one more than the number of nodes)
+	std::vector<int> m_nodeTriangles;		///< the triangles incident on each node, in ascending order
+	std::vector<Vector3d> m_positions;		///< the positions of the nodes
+	std::vector<int> m_triangleIndices;		///< the node indices of the triangles (three per triangle, in winding order)
+	std::vector<int> m_triangleLabels;		///< the dense labels of the triangles (two per triangle, in ascending order)
+
+	//#################### CONSTRUCTORS ####################
+public:
+	/**
+	@brief	Constructs a compact mesh from the specified mesh.
+
+	The nodes and triangles of the compact mesh have the same indices as in the original mesh (where the index
+	of a triangle is its position in the mesh's triangle list).
+
+	@param[in]	mesh	The mesh
+	*/
+	explicit CompactMesh(const MeshT& mesh)
+	{
+		const MeshNodeVector& nodes = mesh.nodes();
+		const MeshTriangleList& triangles = mesh.triangles();
+		int nodeCount = static_cast<int>(nodes.size());
+
+		// Determine the distinct labels used in the mesh.
+		std::set<Label> labels;
+		for(int i=0; i<nodeCount; ++i)
+		{
+			const std::set<SourcedLabel<Label> >& sourcedLabels = nodes[i].sourced_labels();
+			for(typename std::set<SourcedLabel<Label> >::const_iterator jt=sourcedLabels.begin(), jend=sourcedLabels.end(); jt!=jend; ++jt)
+			{
+				labels.insert(jt->label);
+			}
+		}
+		m_labels.assign(labels.begin(), labels.end());
+		m_labelWordCount = std::max(1, static_cast<int>((m_labels.size() + BITS_PER_WORD - 1) / BITS_PER_WORD));
+
+		// Fill in the positions, adjacent nodes and labels of the nodes.
+		m_positions.reserve(nodeCount);
+		m_adjacencyOffsets.reserve(nodeCount + 1);
+		m_nodeLabelOffsets.reserve(nodeCount + 1);
+		m_labelBits.resize(nodeCount * m_labelWordCount);
+		for(int i=0; i<nodeCount; ++i)
+		{
+			m_positions.push_back(nodes[i].position());
+
+			m_adjacencyOffsets.push_back(static_cast<int>(m_adjacentNodes.size()));
+			m_adjacentNodes.insert(m_adjacentNodes.end(), nodes[i].adjacent_nodes().begin(), nodes[i].adjacent_nodes().end());
+
+			m_nodeLabelOffsets.push_back(static_cast<int>(m_nodeLabels.size()));
+			const std::set<SourcedLabel<Label> >& sourcedLabels = nodes[i].sourced_labels();
+			for(typename std::set<SourcedLabel<Label> >::const_iterator jt=sourcedLabels.begin(), jend=sourcedLabels.end(); jt!=jend; ++jt)
+			{
+				int l = dense_label(jt->label);
+				m_nodeLabels.push_back(l);
+				m_labelBits[i * m_labelWordCount + l / BITS_PER_WORD] |= LabelWord(1) << (l % BITS_PER_WORD);
+			}
+		}
+		m_adjacencyOffsets.push_back(static_cast<int>(m_adjacentNodes.size()));
+		m_nodeLabelOffsets.push_back(static_cast<int>(m_nodeLabels.size()));
+
+		// Fill in the triangles, counting the number of triangles incident on each node as we go.
+		int triangleCount = static_cast<int>(triangles.size());
+		m_triangleIndices.reserve(triangleCount * 3);
+		m_triangleLabels.reserve(triangleCount * 2);
+		m_nodeTriangleOffsets.resize(nodeCount + 1);
+		for(typename MeshTriangleList::const_iterator it=triangles.begin(), iend=triangles.end(); it!=iend; ++it)
+		{
+			for(int k=0; k<3; ++k)
+			{
+				m_triangleIndices.push_back(it->index(k));
+				++m_nodeTriangleOffsets[it->index(k) + 1];
+			}
+
+			assert(it->labels().size() == 2);
+			for(typename std::set<Label>::const_iterator jt=it->labels().begin(), jend=it->labels().end(); jt!=jend; ++jt)
+			{
+				m_triangleLabels.push_back(dense_label(*jt));
+			}
+		}
+
+		// Convert the counts into offsets and fill in the incident triangles of each node.
+		for(int i=0; i<nodeCount; ++i)
+		{
+			m_nodeTriangleOffsets[i+1] += m_nodeTriangleOffsets[i];
+		}
+		m_nodeTriangles.resize(triangleCount * 3);
+		std::vector<int> fillPositions(m_nodeTriangleOffsets.begin(), m_nodeTriangleOffsets.end() - 1);
+		for(int t=0; t<triangleCount; ++t)
+		{
+			for(int k=0; k<3; ++k)
+			{
+				m_nodeTriangles[fillPositions[m_triangleIndices[t*3 + k]]++] = t;
+			}
+		}
+	}
+
+	//#################### PUBLIC METHODS ####################
+public:
+	/**
+	@brief	Returns the number of nodes adjacent to the specified node.
+
+	@param[in]	i	The index of the node
+	@return	As described
+	*/
+	int adjacent_node_count(int i) const
+	{
+		return m_adjacencyOffsets[i+1] - m_adjacencyOffsets[i];
+	}
+
+	IndexIterator adjacent_nodes_cbegin(int i) const
+	{
+		return m_adjacentNodes.begin() + m_adjacencyOffsets[i];
+	}
+
+	IndexIterator adjacent_nodes_cend(int i) const
+	{
+		return m_adjacentNodes.begin() + m_adjacencyOffsets[i+1];
+	}
+
+	/**
+	@brief	Determines the type of a mesh node (in the same way as MeshUtil::classify_node).
+
+	@param[in]	i						The index of the node to be classified
+	@param[out]	laplacianNeighbours		If non-null, a vector to which the neighbours of this node to be used for Laplacian smoothing are appended (in ascending order)
+	@return	The type of the mesh node
+	*/
+	MeshNodeType::Enum classify_node(int i, std::vector<int> *laplacianNeighbours = NULL) const
+	{
+		if(node_label_count(i) == 2)
+		{
+			// This is a simple node.
+			if(laplacianNeighbours)
+			{
+				laplacianNeighbours->insert(laplacianNeighbours->end(), adjacent_nodes_cbegin(i), adjacent_nodes_cend(i));
+			}
+			return MeshNodeType::SIMPLE;
+		}
+
+		// Count the number of adjacent nodes with at least the same labels as this one.
+		// Iff it's equal to two, this is an edge node. Otherwise, it's a corner.
+		int edgeCriterion = 0;
+		for(IndexIterator jt=adjacent_nodes_cbegin(i), jend=adjacent_nodes_cend(i); jt!=jend; ++jt)
+		{
+			if(has_labels_of(*jt, i))
+			{
+				++edgeCriterion;
+				if(laplacianNeighbours) laplacianNeighbours->push_back(*jt);
+			}
+		}
+
+		return edgeCriterion == 2 ? MeshNodeType::EDGE : MeshNodeType::CORNER;
+	}
+
+	/**
+	@brief	Returns the dense label corresponding to the specified label.
+
+	@param[in]	label	The label
+	@pre
+		-	label is used in the mesh
+	@return	As described
+	*/
+	int dense_label(const Label& label) const
+	{
+		typename std::vector<Label>::const_iterator it = std::lower_bound(m_labels.begin(), m_labels.end(), label);
+		assert(it != m_labels.end() && !(label < *it));
+		return static_cast<int>(it - m_labels.begin());
+	}
+
+	/**
+	@brief	Returns whether or not node j has (at least) all of the labels of node i.
+
+	@param[in]	j	The index of the node whose labels are to be checked
+	@param[in]	i	The index of the node whose labels must be present
+	@return	true, if node j has all of node i's labels, or false otherwise
+	*/
+	bool has_labels_of(int j, int i) const
+	{
+		const LabelWord *jBits = &m_labelBits[j * m_labelWordCount];
+		const LabelWord *iBits = &m_labelBits[i * m_labelWordCount];
+		for(int w=0; w<m_labelWordCount; ++w)
+		{
+			if((iBits[w] & jBits[w]) != iBits[w]) return false;
+		}
+		return true;
+	}
+
+	IndexIterator incident_triangles_cbegin(int i) const
+	{
+		return m_nodeTriangles.begin() + m_nodeTriangleOffsets[i];
+	}
+
+	IndexIterator incident_triangles_cend(int i) const
+	{
+		return m_nodeTriangles.begin() + m_nodeTriangleOffsets[i+1];
+	}
+
+	/**
+	@brief	Returns the label with the specified dense label.
+
+	@param[in]	l	The dense label
+	@return	As described
+	*/
+	const Label& label(int l) const
+	{
+		return m_labels[l];
+	}
+
+	/**
+	@brief	Returns the number of distinct labels used in the mesh.
+
+	@return	As described
+	*/
+	int label_count() const
+	{
+		return static_cast<int>(m_labels.size());
+	}
+
+	int node_count() const
+	{
+		return static_cast<int>(m_positions.size());
+	}
+
+	/**
+	@brief	Returns the number of labels of the specified node.
+
+	@param[in]	i	The index of the node
+	@return	As described
+	*/
+	int node_label_count(int i) const
+	{
+		return m_nodeLabelOffsets[i+1] - m_nodeLabelOffsets[i];
+	}
+
+	/**
+	@brief	Returns the offset of the specified node's first entry in the (flattened) array of node labels.
+
+	The entries for node i are at offsets [node_label_offset(i), node_label_offset(i+1)); clients can use this
+	to maintain their own flat arrays with one element per (node, label) pair.
+
+	@param[in]	i	The index of the node (may be node_count(), to get the total number of entries)
+	@return	As described
+	*/
+	int node_label_offset(int i) const
+	{
+		return m_nodeLabelOffsets[i];
+	}
+
+	IndexIterator node_labels_cbegin(int i) const
+	{
+		return m_nodeLabels.begin() + m_nodeLabelOffsets[i];
+	}
+
+	IndexIterator node_labels_cend(int i) const
+	{
+		return m_nodeLabels.begin() + m_nodeLabelOffsets[i+1];
+	}
+
+	const std::vector<Vector3d>& positions() const
+	{
+		return m_positions;
+	}
+
+	/**
+	@brief	Returns the number of triangles in the mesh.
+
+	@return	As described
+	*/
+	int triangle_count() const
+	{
+		return static_cast<int>(m_triangleIndices.size() / 3);
+	}
+
+	/**
+	@brief	Returns the index of the specified vertex of the specified triangle.
+
+	@param[in]	t	The index of the triangle
+	@param[in]	k	The vertex of the triangle (0, 1 or 2, in winding order)
+	@return	As described
+	*/
+	int triangle_index(int t, int k) const
+	{
+		return m_triangleIndices[t*3 + k];
+	}
+
+	/**
+	@brief	Returns one of the dense labels of the specified triangle.
+
+	@param[in]	t	The index of the triangle
+	@param[in]	k	Which label to return (0 for the smaller label, 1 for the larger one)
+	@return	As described
+	*/
+	int triangle_label(int t, int k) const
+	{
+		return m_triangleLabels[t*2 + k];
+	}
+};
+
+}
+
+#endif
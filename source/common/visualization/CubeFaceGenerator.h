@@ -1,74 +1,88 @@
 /***
  * millipede: CubeFaceGenerator.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_CUBEFACEGENERATOR
 #define H_MILLIPEDE_CUBEFACEGENERATOR
 
-#include <set>
+#include <vector>
 
 #include <common/exceptions/Exception.h>
-#include <common/io/util/OSSWrapper.h>
-#include <common/jobs/SimpleJob.h>
 #include "MeshBuildingData.h"
 
 namespace mp {
 
 /**
 @brief	A CubeFaceGenerator determines the multiple material marching squares (M3S) pattern on a cube face
-		and generates global nodes and edges (stored implicitly in the nodes) accordingly. It also builds
-		a map from local to global nodes and stores this against the face in the cube table.
+		and generates nodes and edges (stored implicitly in the nodes) accordingly. It also builds a map
+		from local face nodes to nodes in the node table, in the form of a cube face.
+
+A single generator is used for many faces (e.g. all those in a slab of the volume): generate() is called directly
+for each face in turn. The nodes are added to a node table supplied by the caller rather than the global one,
+so several generators working on different parts of the volume can safely run concurrently.
 
 @tparam	Label			The type of label stored at the cube vertices and in the mesh nodes
 @tparam	PriorityPred	A predicate type defining an ordering over the labels for resolving conflicts that arise during the algorithm
 */
 template <typename Label, typename PriorityPred>
-class CubeFaceGenerator : public SimpleJob
+class CubeFaceGenerator
 {
 	//#################### TYPEDEFS ####################
 private:
 	typedef GlobalNodeTable<Label> GlobalNodeTableT;
-	typedef itk::Image<Label,3> LabelImage;
-	typedef typename LabelImage::Pointer LabelImagePointer;
 	typedef MeshBuildingData<Label> MeshBuildingDataT;
-	typedef boost::shared_ptr<MeshBuildingDataT> MeshBuildingData_Ptr;
 	typedef MeshNode<Label> MeshNodeT;
 
 	//#################### PRIVATE VARIABLES ####################
 private:
-	CubeFace m_cubeFace;
-	MeshBuildingData_Ptr m_data;
-	std::vector<CubeFace::Edge> m_edges;
-	CubeFaceDesignator::Enum m_faceDesignator;
-	int m_x, m_y, m_z;
-	LabelImagePointer m_labelling;
+	const MeshBuildingDataT& m_data;
+	GlobalNodeTableT& m_nodeTable;
 
 	//#################### CONSTRUCTORS ####################
 public:
 	/**
-	@brief	Constructs a CubeFaceGenerator job to work on the specified cube face.
+	@brief	Constructs a CubeFaceGenerator.
 
-	@param[in]	data			The mesh building data shared by all sub-jobs of MeshBuilder
-	@param[in]	x				The x position of the cube in the volume
-	@param[in]	y				The y position of the cube in the volume
-	@param[in]	z				The z position of the cube in the volume
-	@param[in]	faceDesignator	The cube face designator
+	@param[in]	data		The mesh building data shared by all sub-jobs of MeshBuilder (only the labelling is used)
+	@param[in]	nodeTable	The node table to which to add the nodes generated on the faces
 	*/
-	CubeFaceGenerator(const MeshBuildingData_Ptr& data, int x, int y, int z, CubeFaceDesignator::Enum faceDesignator)
-	:	m_data(data), m_faceDesignator(faceDesignator), m_x(x), m_y(y), m_z(z)
+	CubeFaceGenerator(const MeshBuildingDataT& data, GlobalNodeTableT& nodeTable)
+	:	m_data(data), m_nodeTable(nodeTable)
 	{}
 
 	//#################### PUBLIC METHODS ####################
 public:
 	/**
-	@brief	Returns the length of the job.
+	@brief	Generates the nodes and edges for the specified cube face.
 
-	@return	As described
+	@param[in]	x				The x position of the cube in the volume
+	@param[in]	y				The y position of the cube in the volume
+	@param[in]	z				The z position of the cube in the volume
+	@param[in]	faceDesignator	The cube face designator
+	@param[out]	cubeFace		The cube face, mapping its local nodes to nodes in the node table (only written if the face is relevant)
+	@return	true, if the face has any edges on it (and is thus relevant to the mesh), or false otherwise
 	*/
-	int length() const
+	bool generate(int x, int y, int z, CubeFaceDesignator::Enum faceDesignator, CubeFace& cubeFace)
 	{
-		return 1;
+		Vector3i vertexPositions[4];
+		CubeTable::face_vertices(x, y, z, faceDesignator, vertexPositions);
+
+		Label vertexLabels[4];
+		for(int i=0; i<4; ++i) vertexLabels[i] = m_data.label(vertexPositions[i]);
+
+		// By far the most common case is a face whose vertices all share the same label, so check for it up-front.
+		if(vertexLabels[1] == vertexLabels[0] && vertexLabels[2] == vertexLabels[0] && vertexLabels[3] == vertexLabels[0]) return false;
+
+		std::vector<CubeFace::Edge> edges = edges_on_face(vertexLabels);
+		if(edges.size() == 0) return false;		// if there aren't any edges, this cube face is irrelevant to the mesh
+
+		cubeFace = construct_initial_cube_face(edges);
+		fill_in_global_indices(x, y, z, faceDesignator, cubeFace);
+		fill_in_sourced_labels(cubeFace, vertexLabels, vertexPositions);
+		fill_in_adjacent_nodes(cubeFace, edges);
+		return true;
 	}
 
 	//#################### PRIVATE METHODS ####################
@@ -76,12 +90,13 @@ private:
 	/**
 	@brief	Constructs the cube face, marking which face nodes are being used based on the face edges.
 
+	@param[in]	edges	The edges on the face
 	@return	The constructed cube face
 	*/
-	CubeFace construct_initial_cube_face() const
+	static CubeFace construct_initial_cube_face(const std::vector<CubeFace::Edge>& edges)
 	{
 		CubeFace cubeFace;
-		for(std::vector<CubeFace::Edge>::const_iterator it=m_edges.begin(), iend=m_edges.end(); it!=iend; ++it)
+		for(std::vector<CubeFace::Edge>::const_iterator it=edges.begin(), iend=edges.end(); it!=iend; ++it)
 		{
 			cubeFace.set_used(it->u);
 			cubeFace.set_used(it->v);
@@ -89,37 +104,63 @@ private:
 		return cubeFace;
 	}
 
+	/**
+	@brief	Counts the distinct labels on the face vertices (labels that are equivalent under PriorityPred count as the same).
+
+	@param[in]	labels	The labels on the four face vertices
+	@return	As described
+	*/
+	static int count_unique_labels(const Label *labels)
+	{
+		PriorityPred pred;
+		int count = 0;
+		for(int i=0; i<4; ++i)
+		{
+			bool seen = false;
+			for(int j=0; j<i && !seen; ++j)
+			{
+				seen = !pred(labels[i], labels[j]) && !pred(labels[j], labels[i]);
+			}
+			if(!seen) ++count;
+		}
+		return count;
+	}
+
 	/**
 	@brief	Determines the global positions of the face nodes.
 
-	@return	A std::vector containing the positions (in a format suitable for looking up the nodes in the global node table)
+	@param[in]	x				The x position of the cube in the volume
+	@param[in]	y				The y position of the cube in the volume
+	@param[in]	z				The z position of the cube in the volume
+	@param[in]	faceDesignator	The cube face designator
+	@return	A std::vector containing the positions (in a format suitable for looking up the nodes in the node table)
 	*/
-	std::vector<typename GlobalNodeTableT::NodePosition> determine_node_positions() const
+	static std::vector<typename GlobalNodeTableT::NodePosition> determine_node_positions(int x, int y, int z, CubeFaceDesignator::Enum faceDesignator)
 	{
 		typedef typename GlobalNodeTableT::NodePosition Pos;
 		std::vector<Pos> positions(CubeFace::POTENTIAL_NODE_COUNT);
-		switch(m_faceDesignator)
+		switch(faceDesignator)
 		{
 			case CubeFaceDesignator::FACE_XY:
-				positions[CubeFace::TOP_NODE]		= Pos(Vector3i(m_x,m_y+1,m_z), GlobalNodeTableT::OFFSET_100);
-				positions[CubeFace::LEFT_NODE]		= Pos(Vector3i(m_x,m_y,m_z), GlobalNodeTableT::OFFSET_010);
-				positions[CubeFace::MIDDLE_NODE]	= Pos(Vector3i(m_x,m_y,m_z), GlobalNodeTableT::OFFSET_110);
-				positions[CubeFace::RIGHT_NODE]		= Pos(Vector3i(m_x+1,m_y,m_z), GlobalNodeTableT::OFFSET_010);
-				positions[CubeFace::BOTTOM_NODE]	= Pos(Vector3i(m_x,m_y,m_z), GlobalNodeTableT::OFFSET_100);
+				positions[CubeFace::TOP_NODE]		= Pos(Vector3i(x,y+1,z), GlobalNodeTableT::OFFSET_100);
+				positions[CubeFace::LEFT_NODE]		= Pos(Vector3i(x,y,z), GlobalNodeTableT::OFFSET_010);
+				positions[CubeFace::MIDDLE_NODE]	= Pos(Vector3i(x,y,z), GlobalNodeTableT::OFFSET_110);
+				positions[CubeFace::RIGHT_NODE]		= Pos(Vector3i(x+1,y,z), GlobalNodeTableT::OFFSET_010);
+				positions[CubeFace::BOTTOM_NODE]	= Pos(Vector3i(x,y,z), GlobalNodeTableT::OFFSET_100);
 				break;
 			case CubeFaceDesignator::FACE_XZ:
-				positions[CubeFace::TOP_NODE]		= Pos(Vector3i(m_x,m_y,m_z+1), GlobalNodeTableT::OFFSET_100);
-				positions[CubeFace::LEFT_NODE]		= Pos(Vector3i(m_x,m_y,m_z), GlobalNodeTableT::OFFSET_001);
-				positions[CubeFace::MIDDLE_NODE]	= Pos(Vector3i(m_x,m_y,m_z), GlobalNodeTableT::OFFSET_101);
-				positions[CubeFace::RIGHT_NODE]		= Pos(Vector3i(m_x+1,m_y,m_z), GlobalNodeTableT::OFFSET_001);
-				positions[CubeFace::BOTTOM_NODE]	= Pos(Vector3i(m_x,m_y,m_z), GlobalNodeTableT::OFFSET_100);
+				positions[CubeFace::TOP_NODE]		= Pos(Vector3i(x,y,z+1), GlobalNodeTableT::OFFSET_100);
+				positions[CubeFace::LEFT_NODE]		= Pos(Vector3i(x,y,z), GlobalNodeTableT::OFFSET_001);
+				positions[CubeFace::MIDDLE_NODE]	= Pos(Vector3i(x,y,z), GlobalNodeTableT::OFFSET_101);
+				positions[CubeFace::RIGHT_NODE]		= Pos(Vector3i(x+1,y,z), GlobalNodeTableT::OFFSET_001);
+				positions[CubeFace::BOTTOM_NODE]	= Pos(Vector3i(x,y,z), GlobalNodeTableT::OFFSET_100);
 				break;
 			case CubeFaceDesignator::FACE_YZ:
-				positions[CubeFace::TOP_NODE]		= Pos(Vector3i(m_x,m_y,m_z+1), GlobalNodeTableT::OFFSET_010);
-				positions[CubeFace::LEFT_NODE]		= Pos(Vector3i(m_x,m_y,m_z), GlobalNodeTableT::OFFSET_001);
-				positions[CubeFace::MIDDLE_NODE]	= Pos(Vector3i(m_x,m_y,m_z), GlobalNodeTableT::OFFSET_011);
-				positions[CubeFace::RIGHT_NODE]		= Pos(Vector3i(m_x,m_y+1,m_z), GlobalNodeTableT::OFFSET_001);
-				positions[CubeFace::BOTTOM_NODE]	= Pos(Vector3i(m_x,m_y,m_z), GlobalNodeTableT::OFFSET_010);
+				positions[CubeFace::TOP_NODE]		= Pos(Vector3i(x,y,z+1), GlobalNodeTableT::OFFSET_010);
+				positions[CubeFace::LEFT_NODE]		= Pos(Vector3i(x,y,z), GlobalNodeTableT::OFFSET_001);
+				positions[CubeFace::MIDDLE_NODE]	= Pos(Vector3i(x,y,z), GlobalNodeTableT::OFFSET_011);
+				positions[CubeFace::RIGHT_NODE]		= Pos(Vector3i(x,y+1,z), GlobalNodeTableT::OFFSET_001);
+				positions[CubeFace::BOTTOM_NODE]	= Pos(Vector3i(x,y,z), GlobalNodeTableT::OFFSET_010);
 				break;
 			default:
 				throw Exception("Invalid face designator");		// this should never happen
@@ -130,15 +171,14 @@ private:
 	/**
 	@brief	Determines the pattern of edges on the face, based on the labels of the face vertices.
 
-	@param[in]	labels	The labels on the face vertices
+	@param[in]	labels	The labels on the four face vertices
 	@return	The edges induced by these labels
 	*/
-	static std::vector<CubeFace::Edge> edges_on_face(const std::vector<Label>& labels)
+	static std::vector<CubeFace::Edge> edges_on_face(const Label *labels)
 	{
 		std::vector<CubeFace::Edge> edges;
 
-		std::set<Label, PriorityPred> uniqueLabels(labels.begin(), labels.end());
-		const size_t uniqueLabelCount = uniqueLabels.size();
+		const int uniqueLabelCount = count_unique_labels(labels);
 
 		switch(uniqueLabelCount)
 		{
@@ -242,116 +282,100 @@ private:
 	}
 
 	/**
-	@brief	Executes the job.
-	*/
-	void execute_impl()
-	{
-		set_status(OSSWrapper() << "Generating cube face (" << m_x << ',' << m_y << ',' << m_z << ',' << m_faceDesignator << ')');
-
-		m_labelling = m_data->labelling();
-
-		std::vector<Vector3i> vertexPositions = m_data->cube_table().face_vertices(m_x, m_y, m_z, m_faceDesignator);
-
-		std::vector<Label> vertexLabels(4);
-		for(int i=0; i<4; ++i) vertexLabels[i] = m_data->label(vertexPositions[i]);
-
-		m_edges = edges_on_face(vertexLabels);
-		if(m_edges.size() == 0) return;			// if there aren't any edges, this cube face is irrelevant to the mesh
-
-		m_cubeFace = construct_initial_cube_face();
-		fill_in_global_indices();
-		fill_in_sourced_labels(vertexLabels, vertexPositions);
-		fill_in_adjacent_nodes();
-		m_data->cube_table().set_cube_face(m_x, m_y, m_z, m_faceDesignator, m_cubeFace);
-	}
-
-	/**
-	@brief	Updates the nodes adjacent to each global node, based on the edges found on this cube face.
+	@brief	Updates the nodes adjacent to each node on the face, based on the edges found on it.
 
 	Note that the endpoints of the edges passed in are *local* to the cube face, so they will be
-	mapped to global indices before being stored in the global nodes.
+	mapped to node table indices before being stored in the nodes.
+
+	@param[in]	cubeFace	The cube face
+	@param[in]	edges		The edges on the face
 	*/
-	void fill_in_adjacent_nodes()
+	void fill_in_adjacent_nodes(const CubeFace& cubeFace, const std::vector<CubeFace::Edge>& edges)
 	{
-		GlobalNodeTableT& globalNodeTable = m_data->global_node_table();
-		for(std::vector<CubeFace::Edge>::const_iterator it=m_edges.begin(), iend=m_edges.end(); it!=iend; ++it)
+		for(std::vector<CubeFace::Edge>::const_iterator it=edges.begin(), iend=edges.end(); it!=iend; ++it)
 		{
-			int u = m_cubeFace.global_node_index(it->u);
-			int v = m_cubeFace.global_node_index(it->v);
-			globalNodeTable(u).add_adjacent_node(v);
-			globalNodeTable(v).add_adjacent_node(u);
+			int u = cubeFace.global_node_index(it->u);
+			int v = cubeFace.global_node_index(it->v);
+			m_nodeTable(u).add_adjacent_node(v);
+			m_nodeTable(v).add_adjacent_node(u);
 		}
 	}
 
 	/**
-	@brief	Fills in the global indices of any used cube face nodes.
+	@brief	Fills in the node table indices of any used cube face nodes.
+
+	@param[in]		x				The x position of the cube in the volume
+	@param[in]		y				The y position of the cube in the volume
+	@param[in]		z				The z position of the cube in the volume
+	@param[in]		faceDesignator	The cube face designator
+	@param[in,out]	cubeFace		The cube face
 	*/
-	void fill_in_global_indices()
+	void fill_in_global_indices(int x, int y, int z, CubeFaceDesignator::Enum faceDesignator, CubeFace& cubeFace)
 	{
-		std::vector<typename GlobalNodeTableT::NodePosition> nodePositions = determine_node_positions();
+		std::vector<typename GlobalNodeTableT::NodePosition> nodePositions = determine_node_positions(x, y, z, faceDesignator);
 		for(CubeFace::NodeDesignator n=enum_begin<CubeFace::NodeDesignator>(), end=enum_end<CubeFace::NodeDesignator>(); n!=end; ++n)
 		{
-			if(m_cubeFace.is_used(n))
+			if(cubeFace.is_used(n))
 			{
-				int globalNodeIndex = m_data->global_node_table().find_index(nodePositions[n]);
-				m_cubeFace.set_global_node_index(n, globalNodeIndex);
+				int globalNodeIndex = m_nodeTable.find_index(nodePositions[n]);
+				cubeFace.set_global_node_index(n, globalNodeIndex);
 			}
 		}
 	}
 
 	/**
-	@brief	Fills in the sourced labels for each global node referenced by the cube face.
+	@brief	Fills in the sourced labels for each node referenced by the cube face.
 
 	Specifically, this involves selecting the face vertices that produce labels for a given node,
 	and writing their labels and positions into the node structure.
 
+	@param[in]	cubeFace			The cube face
 	@param[in]	vertexLabels		The labels of the face vertices
 	@param[in]	vertexPositions		The positions of the face vertices
 	*/
-	void fill_in_sourced_labels(const std::vector<Label>& vertexLabels, const std::vector<Vector3i>& vertexPositions)
+	void fill_in_sourced_labels(const CubeFace& cubeFace, const Label *vertexLabels, const Vector3i *vertexPositions)
 	{
-		GlobalNodeTableT& globalNodeTable = m_data->global_node_table();
 		for(CubeFace::NodeDesignator n=enum_begin<CubeFace::NodeDesignator>(), end=enum_end<CubeFace::NodeDesignator>(); n!=end; ++n)
 		{
-			if(m_cubeFace.is_used(n))
+			if(cubeFace.is_used(n))
 			{
-				MeshNodeT& node = globalNodeTable(m_cubeFace.global_node_index(n));
-				const std::vector<CubeFace::VertexDesignator>& labelSources = label_sources(n);
-				for(std::vector<CubeFace::VertexDesignator>::const_iterator it=labelSources.begin(), iend=labelSources.end(); it!=iend; ++it)
+				MeshNodeT& node = m_nodeTable(cubeFace.global_node_index(n));
+				int labelSourceCount;
+				const CubeFace::VertexDesignator *labelSources = label_sources(n, labelSourceCount);
+				for(int i=0; i<labelSourceCount; ++i)
 				{
-					node.add_sourced_label(vertexLabels[*it], vertexPositions[*it]);
+					node.add_sourced_label(vertexLabels[labelSources[i]], vertexPositions[labelSources[i]]);
 				}
 			}
 		}
 	}
 
 	/**
-	@brief	Returns the set of face vertices that provide the labels for the specified face node.
+	@brief	Returns the face vertices that provide the labels for the specified face node.
 
-	@param[in]	n	A face node designator
-	@return	The set of face vertices that provide labels for n
+	@param[in]	n		A face node designator
+	@param[out]	count	The number of face vertices that provide labels for n
+	@return	A pointer to an array containing the face vertices that provide labels for n
 	*/
-	static const std::vector<CubeFace::VertexDesignator>& label_sources(CubeFace::NodeDesignator n)
+	static const CubeFace::VertexDesignator *label_sources(CubeFace::NodeDesignator n, int& count)
 	{
-		static std::vector<std::vector<CubeFace::VertexDesignator> > labelSources(CubeFace::POTENTIAL_NODE_COUNT);
-		static bool done = false;
-		if(!done)
+		// Note:	These tables are statically initialized (rather than being built on first use) so that
+		//			generators in different threads can safely use them at the same time.
+		static const CubeFace::VertexDesignator TOP_SOURCES[] = { CubeFace::TOP_LEFT_VERTEX, CubeFace::TOP_RIGHT_VERTEX };
+		static const CubeFace::VertexDesignator LEFT_SOURCES[] = { CubeFace::TOP_LEFT_VERTEX, CubeFace::BOTTOM_LEFT_VERTEX };
+		static const CubeFace::VertexDesignator MIDDLE_SOURCES[] = { CubeFace::TOP_LEFT_VERTEX, CubeFace::TOP_RIGHT_VERTEX, CubeFace::BOTTOM_LEFT_VERTEX, CubeFace::BOTTOM_RIGHT_VERTEX };
+		static const CubeFace::VertexDesignator RIGHT_SOURCES[] = { CubeFace::TOP_RIGHT_VERTEX, CubeFace::BOTTOM_RIGHT_VERTEX };
+		static const CubeFace::VertexDesignator BOTTOM_SOURCES[] = { CubeFace::BOTTOM_LEFT_VERTEX, CubeFace::BOTTOM_RIGHT_VERTEX };
+
+		switch(n)
 		{
-			labelSources[CubeFace::TOP_NODE].push_back(CubeFace::TOP_LEFT_VERTEX);
-			labelSources[CubeFace::TOP_NODE].push_back(CubeFace::TOP_RIGHT_VERTEX);
-			labelSources[CubeFace::LEFT_NODE].push_back(CubeFace::TOP_LEFT_VERTEX);
-			labelSources[CubeFace::LEFT_NODE].push_back(CubeFace::BOTTOM_LEFT_VERTEX);
-			labelSources[CubeFace::MIDDLE_NODE].push_back(CubeFace::TOP_LEFT_VERTEX);
-			labelSources[CubeFace::MIDDLE_NODE].push_back(CubeFace::TOP_RIGHT_VERTEX);
-			labelSources[CubeFace::MIDDLE_NODE].push_back(CubeFace::BOTTOM_LEFT_VERTEX);
-			labelSources[CubeFace::MIDDLE_NODE].push_back(CubeFace::BOTTOM_RIGHT_VERTEX);
-			labelSources[CubeFace::RIGHT_NODE].push_back(CubeFace::TOP_RIGHT_VERTEX);
-			labelSources[CubeFace::RIGHT_NODE].push_back(CubeFace::BOTTOM_RIGHT_VERTEX);
-			labelSources[CubeFace::BOTTOM_NODE].push_back(CubeFace::BOTTOM_LEFT_VERTEX);
-			labelSources[CubeFace::BOTTOM_NODE].push_back(CubeFace::BOTTOM_RIGHT_VERTEX);
-			done = true;
+			case CubeFace::TOP_NODE:	count = 2; return TOP_SOURCES;
+			case CubeFace::LEFT_NODE:	count = 2; return LEFT_SOURCES;
+			case CubeFace::MIDDLE_NODE:	count = 4; return MIDDLE_SOURCES;
+			case CubeFace::RIGHT_NODE:	count = 2; return RIGHT_SOURCES;
+			case CubeFace::BOTTOM_NODE:	count = 2; return BOTTOM_SOURCES;
+			default:					throw Exception("Invalid node designator");		// this should never happen
 		}
-		return labelSources[n];
 	}
 };
 
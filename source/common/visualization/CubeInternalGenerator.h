@@ -1,19 +1,21 @@
 /***
  * millipede: CubeInternalGenerator.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_CUBEINTERNALGENERATOR
 #define H_MILLIPEDE_CUBEINTERNALGENERATOR
 
-#include <common/io/util/OSSWrapper.h>
-#include <common/jobs/SimpleJob.h>
+#include <utility>
+#include <vector>
+
 #include "MeshBuildingData.h"
 
 namespace mp {
 
 /**
-@brief	A CubeInternalGenerator handles node and edge generation within a cube.
+@brief	A CubeInternalGenerator handles node and edge generation within cubes.
 
 The nodes and edges added depend on the number of face-centre nodes.
 
@@ -23,64 +25,112 @@ The nodes and edges added depend on the number of face-centre nodes.
 
 It is not possible for there to be a single face-centre node, so that case is explicitly excluded.
 
+So that many cubes can be processed concurrently, the work is split into two steps. Calling generate() for a cube only
+reads the mesh building data and records the nodes and edges to be added; commit() then adds all the recorded nodes and
+edges to the mesh building data in one go. Cube-centre nodes are created in the order in which their cubes were generated.
+
 @tparam	Label	The type of label stored at the cube vertices and in the mesh nodes
 */
 template <typename Label>
-class CubeInternalGenerator : public SimpleJob
+class CubeInternalGenerator
 {
+	//#################### NESTED CLASSES ####################
+private:
+	struct CubeCentre
+	{
+		Vector3i cube;
+		std::vector<int> faceCentreNodes;
+
+		CubeCentre(const Vector3i& cube_, const std::vector<int>& faceCentreNodes_)
+		:	cube(cube_), faceCentreNodes(faceCentreNodes_)
+		{}
+	};
+
 	//#################### TYPEDEFS ####################
 private:
 	typedef GlobalNodeTable<Label> GlobalNodeTableT;
 	typedef MeshBuildingData<Label> MeshBuildingDataT;
-	typedef boost::shared_ptr<MeshBuildingDataT> MeshBuildingData_Ptr;
 	typedef MeshNode<Label> MeshNodeT;
 
 	//#################### PRIVATE VARIABLES ####################
 private:
-	MeshBuildingData_Ptr m_data;
-	int m_x, m_y, m_z;
+	std::vector<CubeCentre> m_cubeCentres;
+	MeshBuildingDataT& m_data;
+	std::vector<std::pair<int,int> > m_faceCentreEdges;
 
 	//#################### CONSTRUCTORS ####################
 public:
 	/**
-	@brief	Constructs a CubeInternalGenerator job to work on the specified cube.
+	@brief	Constructs a CubeInternalGenerator.
 
-	@param[in]	data			The mesh building data shared by all sub-jobs of MeshBuilder
-	@param[in]	x				The x position of the cube in the volume
-	@param[in]	y				The y position of the cube in the volume
-	@param[in]	z				The z position of the cube in the volume
+	@param[in]	data	The mesh building data shared by all sub-jobs of MeshBuilder
 	*/
-	CubeInternalGenerator(const MeshBuildingData_Ptr& data, int x, int y, int z)
-	:	m_data(data), m_x(x), m_y(y), m_z(z)
+	explicit CubeInternalGenerator(MeshBuildingDataT& data)
+	:	m_data(data)
 	{}
 
 	//#################### PUBLIC METHODS ####################
 public:
 	/**
-	@brief	Returns the length of the job.
+	@brief	Adds the nodes and edges recorded by generate() to the mesh building data.
 
-	@return	As described
+	@post
+		-	There are no recorded nodes or edges left to add
 	*/
-	int length() const
+	void commit()
 	{
-		return 1;
+		CubeTable& cubeTable = m_data.cube_table();
+		GlobalNodeTableT& globalNodeTable = m_data.global_node_table();
+
+		// Add the edges joining pairs of face-centre nodes.
+		for(std::vector<std::pair<int,int> >::const_iterator it=m_faceCentreEdges.begin(), iend=m_faceCentreEdges.end(); it!=iend; ++it)
+		{
+			globalNodeTable(it->first).add_adjacent_node(it->second);
+			globalNodeTable(it->second).add_adjacent_node(it->first);
+		}
+
+		// Create the cube-centre nodes, assign them all the labels of their cubes, and join them to all the face centres.
+		for(typename std::vector<CubeCentre>::const_iterator it=m_cubeCentres.begin(), iend=m_cubeCentres.end(); it!=iend; ++it)
+		{
+			const Vector3i& cube = it->cube;
+			int cubeCentreNode = globalNodeTable.find_index(typename GlobalNodeTableT::NodePosition(cube, GlobalNodeTableT::OFFSET_111));
+			cubeTable.set_cube_centre_node(cube.x, cube.y, cube.z, cubeCentreNode);
+
+			MeshNodeT& c = globalNodeTable(cubeCentreNode);
+			std::vector<Vector3i> vertexPositions = cubeTable.cube_vertices(cube.x, cube.y, cube.z);
+			for(int i=0; i<8; ++i)
+			{
+				Label vertexLabel = m_data.label(vertexPositions[i]);
+				c.add_sourced_label(vertexLabel, vertexPositions[i]);
+			}
+
+			const std::vector<int>& faceCentreNodes = it->faceCentreNodes;
+			for(size_t i=0, size=faceCentreNodes.size(); i<size; ++i)
+			{
+				MeshNodeT& fc = globalNodeTable(faceCentreNodes[i]);
+				c.add_adjacent_node(faceCentreNodes[i]);
+				fc.add_adjacent_node(cubeCentreNode);
+			}
+		}
+
+		m_faceCentreEdges.clear();
+		m_cubeCentres.clear();
 	}
 
-	//#################### PRIVATE METHODS ####################
-private:
 	/**
-	@brief	Executes the job.
+	@brief	Determines which nodes and edges need to be added within the specified cube, and records them for commit().
+
+	@param[in]	x	The x position of the cube in the volume
+	@param[in]	y	The y position of the cube in the volume
+	@param[in]	z	The z position of the cube in the volume
 	*/
-	void execute_impl()
+	void generate(int x, int y, int z)
 	{
-		set_status(OSSWrapper() << "Generating internals of cube (" << m_x << ',' << m_y << ',' << m_z << ')');
-
-		CubeTable& cubeTable = m_data->cube_table();
-		GlobalNodeTableT& globalNodeTable = m_data->global_node_table();
+		if(m_data.is_uniform_cube(x, y, z)) return;		// a cube whose vertices all have the same label has no face-centre nodes
 
-		std::vector<int> faceCentreNodes = cubeTable.lookup_face_centre_nodes(m_x, m_y, m_z);
+		std::vector<int> faceCentreNodes = m_data.cube_table().lookup_face_centre_nodes(x, y, z);
 
-		// Add additional nodes and edges as necessary depending on the number of face-centre nodes.
+		// Record additional nodes and edges as necessary depending on the number of face-centre nodes.
 		switch(faceCentreNodes.size())
 		{
 			case 0:
@@ -89,33 +139,14 @@ private:
 			}
 			case 2:
 			{
-				// Add an edge joining the two face-centre nodes.
-				MeshNodeT& fc0 = globalNodeTable(faceCentreNodes[0]);
-				MeshNodeT& fc1 = globalNodeTable(faceCentreNodes[1]);
-				fc0.add_adjacent_node(faceCentreNodes[1]);
-				fc1.add_adjacent_node(faceCentreNodes[0]);
+				// Record an edge joining the two face-centre nodes.
+				m_faceCentreEdges.push_back(std::make_pair(faceCentreNodes[0], faceCentreNodes[1]));
 				break;
 			}
 			default:	// > 2 face-centre nodes
 			{
-				// Create a cube-centre node, assign it all the labels of the cube, and join it to all the face centres.
-				int cubeCentreNode = globalNodeTable.find_index(typename GlobalNodeTableT::NodePosition(Vector3i(m_x, m_y, m_z), GlobalNodeTableT::OFFSET_111));
-				cubeTable.set_cube_centre_node(m_x, m_y, m_z, cubeCentreNode);
-
-				MeshNodeT& c = globalNodeTable(cubeCentreNode);
-				std::vector<Vector3i> vertexPositions = cubeTable.cube_vertices(m_x, m_y, m_z);
-				for(int i=0; i<8; ++i)
-				{
-					Label vertexLabel = m_data->label(vertexPositions[i]);
-					c.add_sourced_label(vertexLabel, vertexPositions[i]);
-				}
-
-				for(size_t i=0, size=faceCentreNodes.size(); i<size; ++i)
-				{
-					MeshNodeT& fc = globalNodeTable(faceCentreNodes[i]);
-					c.add_adjacent_node(faceCentreNodes[i]);
-					fc.add_adjacent_node(cubeCentreNode);
-				}
+				// Record a cube-centre node, to be joined to all the face centres.
+				m_cubeCentres.push_back(CubeCentre(Vector3i(x, y, z), faceCentreNodes));
 				break;
 			}
 		}
@@ -1,6 +1,7 @@
 /***
  * millipede: CubeTable.cpp
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #include "CubeTable.h"
@@ -28,6 +29,12 @@ std::vector<Vector3i> CubeTable::cube_vertices(int x, int y, int z)
 std::vector<Vector3i> CubeTable::face_vertices(int x, int y, int z, CubeFaceDesignator::Enum f)
 {
 	std::vector<Vector3i> verts(4);
+	face_vertices(x, y, z, f, &verts[0]);
+	return verts;
+}
+
+void CubeTable::face_vertices(int x, int y, int z, CubeFaceDesignator::Enum f, Vector3i *verts)
+{
 	switch(f)
 	{
 		case CubeFaceDesignator::FACE_XY:
@@ -45,12 +52,11 @@ std::vector<Vector3i> CubeTable::face_vertices(int x, int y, int z, CubeFaceDesi
 		default:
 			throw Exception("Invalid face designator");		// this should never happen
 	}
-	return verts;
 }
 
 int CubeTable::lookup_cube_centre_node(int x, int y, int z) const
 {
-	std::map<Vector3i,int>::const_iterator it = m_cubeCentreNodes.find(Vector3i(x,y,z));
+	CubeCentreNodeTable::const_iterator it = m_cubeCentreNodes.find(Vector3i(x,y,z));
 	if(it != m_cubeCentreNodes.end()) return it->second;
 	else return -1;
 }
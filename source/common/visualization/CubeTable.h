@@ -1,16 +1,17 @@
 /***
  * millipede: CubeTable.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_CUBETABLE
 #define H_MILLIPEDE_CUBETABLE
 
-#include <map>
 #include <set>
 #include <vector>
 
 #include <boost/optional.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <common/math/Vector3.h>
 #include "CubeFace.h"
@@ -22,12 +23,13 @@ class CubeTable
 {
 	//#################### TYPEDEFS ####################
 private:
-	typedef std::map<Vector3i,CubeFace> FaceSubtable;
+	typedef boost::unordered_map<Vector3i,int> CubeCentreNodeTable;
+	typedef boost::unordered_map<Vector3i,CubeFace> FaceSubtable;
 	typedef FaceSubtable::const_iterator FaceSubtableCIter;
 
 	//#################### PRIVATE VARIABLES ####################
 private:
-	std::map<Vector3i,int> m_cubeCentreNodes;
+	CubeCentreNodeTable m_cubeCentreNodes;
 	FaceSubtable m_faceSubtables[3];
 
 	//#################### PUBLIC METHODS ####################
@@ -53,6 +55,19 @@ public:
 	*/
 	static std::vector<Vector3i> face_vertices(int x, int y, int z, CubeFaceDesignator::Enum f);
 
+	/**
+	@brief	Writes the positions of the four vertices of the specified face in cube (x,y,z) into a caller-supplied array.
+
+	This avoids allocating a std::vector for every face when visiting all the faces in a volume.
+
+	@param[in]	x		The x position of the cube in the volume
+	@param[in]	y		The y position of the cube in the volume
+	@param[in]	z		The z position of the cube in the volume
+	@param[in]	f		The cube face designator
+	@param[out]	verts	An array of (at least) four vertices, to be filled in the order top-left, top-right, bottom-left, bottom-right
+	*/
+	static void face_vertices(int x, int y, int z, CubeFaceDesignator::Enum f, Vector3i *verts);
+
 	/**
 	@brief	Looks up the node (if any) at the centre of cube (x,y,z).
 
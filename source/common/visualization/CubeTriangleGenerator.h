@@ -1,6 +1,7 @@
 /***
  * millipede: CubeTriangleGenerator.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_CUBETRIANGLEGENERATOR
@@ -14,8 +15,6 @@
 #include <boost/utility.hpp>
 
 #include <common/adts/Edge.h>
-#include <common/io/util/OSSWrapper.h>
-#include <common/jobs/SimpleJob.h>
 #include "FanTriangulator.h"
 #include "NodeLoop.h"
 #include "SchroederTriangulator.h"
@@ -26,10 +25,13 @@ namespace mp {
 @brief	A CubeTriangleGenerator finds node loops in a given cube and triangulates them,
 		ensuring that the resulting triangles are oriented consistently as it does so.
 
+A single generator is used for many cubes: generate() is called directly for each cube in turn. It only reads
+the mesh building data, so several generators working on different parts of the volume can run concurrently.
+
 @tparam	Label	The type of label stored at the cube vertices and in the mesh nodes
 */
 template <typename Label>
-class CubeTriangleGenerator : public SimpleJob
+class CubeTriangleGenerator
 {
 	//#################### CONSTANTS ####################
 private:
@@ -43,7 +45,6 @@ private:
 private:
 	typedef GlobalNodeTable<Label> GlobalNodeTableT;
 	typedef MeshBuildingData<Label> MeshBuildingDataT;
-	typedef boost::shared_ptr<MeshBuildingDataT> MeshBuildingData_Ptr;
 	typedef MeshNode<Label> MeshNodeT;
 	typedef MeshTriangle<Label> MeshTriangleT;
 	typedef std::list<MeshTriangleT> MeshTriangleList;
@@ -53,34 +54,42 @@ private:
 
 	//#################### PRIVATE VARIABLES ####################
 private:
-	MeshBuildingData_Ptr m_data;
-	MeshTriangleList& m_triangles;
-	int m_x, m_y, m_z;
+	const MeshBuildingDataT& m_data;
 
 	//#################### CONSTRUCTORS ####################
 public:
 	/**
-	@brief	Constructs a CubeTriangleGenerator job to work on the specified cube.
+	@brief	Constructs a CubeTriangleGenerator.
 
-	@param[in]	data			The mesh building data shared by all sub-jobs of MeshBuilder
-	@param[in]	x				The x position of the cube in the volume
-	@param[in]	y				The y position of the cube in the volume
-	@param[in]	z				The z position of the cube in the volume
+	@param[in]	data	The mesh building data shared by all sub-jobs of MeshBuilder
 	*/
-	CubeTriangleGenerator(const MeshBuildingData_Ptr& data, int x, int y, int z)
-	:	m_data(data), m_triangles(*data->triangles()), m_x(x), m_y(y), m_z(z)
+	explicit CubeTriangleGenerator(const MeshBuildingDataT& data)
+	:	m_data(data)
 	{}
 
 	//#################### PUBLIC METHODS ####################
 public:
 	/**
-	@brief	Returns the length of the job.
+	@brief	Generates the triangles for the specified cube.
 
-	@return	As described
+	@param[in]		x			The x position of the cube in the volume
+	@param[in]		y			The y position of the cube in the volume
+	@param[in]		z			The z position of the cube in the volume
+	@param[in,out]	triangles	The list onto whose end to splice the generated triangles
 	*/
-	int length() const
+	void generate(int x, int y, int z, MeshTriangleList& triangles)
 	{
-		return 1;
+		if(m_data.is_uniform_cube(x, y, z)) return;		// a cube whose vertices all have the same label contains no triangles
+
+		std::set<int> nodeSet = m_data.cube_table().lookup_cube_nodes(x, y, z);
+		if(nodeSet.empty()) return;		// if the cube has no nodes, it doesn't contain any triangles
+
+		int cubeCentreIndex = m_data.cube_table().lookup_cube_centre_node(x, y, z);
+		TypedNodeLoopList typedNodeLoops = find_typed_node_loops(nodeSet, cubeCentreIndex);
+		MeshTriangleList cubeTriangles = triangulate_typed_node_loops(typedNodeLoops, cubeCentreIndex);
+		ensure_consistent_triangle_orientation(cubeTriangles);
+
+		triangles.splice(triangles.end(), cubeTriangles);
 	}
 
 	//#################### PRIVATE METHODS ####################
@@ -93,9 +102,9 @@ private:
 
 	@param[in,out]	triangles	The triangles that have been generated
 	*/
-	void ensure_consistent_triangle_orientation(MeshTriangleList& triangles)
+	void ensure_consistent_triangle_orientation(MeshTriangleList& triangles) const
 	{
-		const GlobalNodeTableT& globalNodeTable = m_data->global_node_table();
+		const GlobalNodeTableT& globalNodeTable = m_data.global_node_table();
 
 		for(typename MeshTriangleList::iterator it=triangles.begin(), iend=triangles.end(); it!=iend; ++it)
 		{
@@ -129,31 +138,17 @@ private:
 		}
 	}
 
-	/**
-	@brief	Executes the job.
-	*/
-	void execute_impl()
-	{
-		set_status(OSSWrapper() << "Generating triangles for cube (" << m_x << ',' << m_y << ',' << m_z << ')');
-
-		TypedNodeLoopList typedNodeLoops = find_typed_node_loops();
-		MeshTriangleList triangles = triangulate_typed_node_loops(typedNodeLoops);
-		ensure_consistent_triangle_orientation(triangles);
-
-		// Splice the triangles onto the global triangle list.
-		m_triangles.splice(m_triangles.end(), triangles);
-	}
-
 	/**
 	@brief	Finds a typed node loop from the remaining nodes and (implicit) edges in the local node map, if possible.
 
 	Note that some (implicit) edges in the local node map will be removed as each node loop is found. This is essential,
 	as find_typed_node_loops() - i.e. the caller of this method - would not otherwise terminate.
 
-	@param[in,out]	localNodeMap	A map containing the nodes within this cube
+	@param[in,out]	localNodeMap		A map containing the nodes within this cube
+	@param[in]		cubeCentreIndex		The index of the cube centre node (if any), or -1 otherwise
 	@return	The typed node loop found, if any, or boost::none otherwise
 	*/
-	boost::optional<TypedNodeLoop> find_typed_node_loop(std::map<int,MeshNodeT>& localNodeMap) const
+	boost::optional<TypedNodeLoop> find_typed_node_loop(std::map<int,MeshNodeT>& localNodeMap, int cubeCentreIndex) const
 	{
 		// Step 1:	Find a start node with exactly two labels and a remaining edge. If no such node exists, we've found all the loops.
 		int startIndex = -1;
@@ -196,7 +191,6 @@ private:
 		std::vector<int> nodeIndices;
 		int curIndex = startIndex;
 		TriangulateFlag flag = TRIANGULATE_SCHROEDER;
-		int cubeCentreIndex = m_data->cube_table().lookup_cube_centre_node(m_x, m_y, m_z);
 
 		do
 		{
@@ -263,18 +257,18 @@ private:
 	/**
 	@brief	Finds all the typed node loops in the cube.
 
+	@param[in]	nodeSet				The indices of the nodes used by the cube
+	@param[in]	cubeCentreIndex		The index of the cube centre node (if any), or -1 otherwise
 	@return	The typed node loops as a std::list
 	*/
-	TypedNodeLoopList find_typed_node_loops() const
+	TypedNodeLoopList find_typed_node_loops(const std::set<int>& nodeSet, int cubeCentreIndex) const
 	{
 		TypedNodeLoopList typedNodeLoops;
 
-		std::set<int> nodeSet = m_data->cube_table().lookup_cube_nodes(m_x, m_y, m_z);
-
 		// Make a local node map with only the local nodes in it. This is necessary for two reasons:
 		// (a) Nodes in the global node table refer to adjacent nodes not in this cube
 		// (b) We want to be able to remove edges from further consideration without damaging the global node table
-		const GlobalNodeTableT& globalNodeTable = m_data->global_node_table();
+		const GlobalNodeTableT& globalNodeTable = m_data.global_node_table();
 		std::map<int,MeshNodeT> localNodeMap;
 		for(std::set<int>::const_iterator it=nodeSet.begin(), iend=nodeSet.end(); it!=iend; ++it)
 		{
@@ -287,7 +281,7 @@ private:
 
 		// Iteratively try to find a typed node loop from the local node map until we've got them all.
 		boost::optional<TypedNodeLoop> typedNodeLoop;
-		while((typedNodeLoop = find_typed_node_loop(localNodeMap)))
+		while((typedNodeLoop = find_typed_node_loop(localNodeMap, cubeCentreIndex)))
 		{
 			typedNodeLoops.push_back(*typedNodeLoop);
 		}
@@ -301,15 +295,16 @@ private:
 	Node loops that go through the cube centre node (if any) will be triangulated using the
 	fan approach. All other node loops will be triangulated using the Schroeder method.
 
-	@param[in]	typedNodeLoops	The typed node loops
+	@param[in]	typedNodeLoops		The typed node loops
+	@param[in]	cubeCentreIndex		The index of the cube centre node (if any), or -1 otherwise
 	@return	A std::list of the mesh triangles resulting from triangulating all the node loops
 	*/
-	MeshTriangleList triangulate_typed_node_loops(const TypedNodeLoopList& typedNodeLoops)
+	MeshTriangleList triangulate_typed_node_loops(const TypedNodeLoopList& typedNodeLoops, int cubeCentreIndex) const
 	{
 		MeshTriangleList triangles;
 
-		FanTriangulator<Label> fanTriangulator(m_data->cube_table().lookup_cube_centre_node(m_x, m_y, m_z));
-		SchroederTriangulator<Label> schroederTriangulator(*m_data->global_node_table().master_array());
+		FanTriangulator<Label> fanTriangulator(cubeCentreIndex);
+		SchroederTriangulator<Label> schroederTriangulator(*m_data.global_node_table().master_array());
 
 		for(typename TypedNodeLoopList::const_iterator it=typedNodeLoops.begin(), iend=typedNodeLoops.end(); it!=iend; ++it)
 		{
@@ -1,16 +1,17 @@
 /***
  * millipede: GlobalNodeTable.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_GLOBALNODETABLE
 #define H_MILLIPEDE_GLOBALNODETABLE
 
 #include <cassert>
-#include <map>
 #include <vector>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
 
 #include "MeshNode.h"
 
@@ -50,6 +51,10 @@ public:
 		NodePosition(const Vector3i& base_, NodeOffset offset_)
 		:	base(base_), offset(offset_)
 		{}
+
+	public:
+		const Vector3i& get_base() const	{ return base; }
+		NodeOffset get_offset() const		{ return offset; }
 	};
 
 	//#################### TYPEDEFS ####################
@@ -58,12 +63,14 @@ private:
 	typedef std::vector<MeshNodeT> MeshNodeVector;
 	typedef boost::shared_ptr<MeshNodeVector> MeshNodeVector_Ptr;
 	typedef boost::shared_ptr<const MeshNodeVector> MeshNodeVector_CPtr;
-	typedef std::map<Vector3i,int> Subtable;
+	typedef boost::unordered_map<Vector3i,int> Subtable;
+	typedef Subtable::const_iterator SubtableCIter;
 	typedef Subtable::iterator SubtableIter;
 
 	//#################### PRIVATE VARIABLES ####################
 private:
 	MeshNodeVector_Ptr m_masterArray;
+	std::vector<NodePosition> m_nodePositions;
 	Subtable m_subtables[OFFSET_COUNT];
 
 	//#################### CONSTRUCTORS ####################
@@ -147,11 +154,25 @@ public:
 				// This will never happen: offset != OFFSET_COUNT
 				break;
 			}
+			m_nodePositions.push_back(pos);
 			m_subtables[offset].insert(std::make_pair(base, index));
 			return index;
 		}
 	}
 
+	/**
+	@brief	Looks up the index of the global node at the specified position, without creating it if it doesn't exist.
+
+	@param[in]	pos		The position of the node
+	@return	The index of the node, if it exists, or -1 otherwise
+	*/
+	int lookup_index(const NodePosition& pos) const
+	{
+		if(pos.offset == OFFSET_COUNT) return -1;
+		SubtableCIter it = m_subtables[pos.offset].find(pos.base);
+		return it != m_subtables[pos.offset].end() ? it->second : -1;
+	}
+
 	const MeshNodeVector_Ptr& master_array()
 	{
 		return m_masterArray;
@@ -162,6 +183,28 @@ public:
 		return m_masterArray;
 	}
 
+	/**
+	@brief	Returns the number of nodes in the table.
+
+	@return	As described
+	*/
+	int node_count() const
+	{
+		return static_cast<int>(m_masterArray->size());
+	}
+
+	/**
+	@brief	Returns the position (in the format used by find_index()) of the specified node.
+
+	@param[in]	n	The index of the node
+	@return	As described
+	*/
+	const NodePosition& node_position(int n) const
+	{
+		assert(0 <= n && n < static_cast<int>(m_nodePositions.size()));
+		return m_nodePositions[n];
+	}
+
 	//#################### PRIVATE METHODS ####################
 private:
 	static MeshNodeT make_node(double x, double y, double z)
@@ -1,22 +1,36 @@
 /***
  * millipede: LaplacianSmoother.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_LAPLACIANSMOOTHER
 #define H_MILLIPEDE_LAPLACIANSMOOTHER
 
+#include <boost/bind.hpp>
+
 #include <common/io/util/OSSWrapper.h>
+#include <common/jobs/ParallelJob.h>
+#include "CompactMesh.h"
 #include "MeshTransformer.h"
-#include "MeshUtil.h"
 
 namespace mp {
 
+/**
+@brief	A LaplacianSmoother smooths a mesh by repeatedly moving each node towards the average position of its neighbours.
+
+Simple nodes may move towards all of their neighbours, edge nodes only along the edge on which they lie, and corner
+nodes are fixed. Since none of this changes during smoothing, the neighbours that affect each node are determined
+once up-front (using a CompactMesh); each iteration is then a parallel loop over flat arrays of positions.
+
+@tparam	Label	The type of label used in the mesh
+*/
 template <typename Label>
 class LaplacianSmoother : public MeshTransformer<Label>
 {
 	//#################### TYPEDEFS ####################
 private:
+	typedef CompactMesh<Label> CompactMeshT;
 	typedef Mesh<Label> MeshT;
 	typedef boost::shared_ptr<MeshT> Mesh_Ptr;
 	typedef MeshNode<Label> MeshNodeT;
@@ -26,11 +40,12 @@ private:
 private:
 	int m_iterations;	///< the number of smoothing iterations to perform
 	double m_lambda;	///< the "relaxation factor" for the smoothing process
+	int m_threadCount;	///< the maximum number of threads to use for each iteration
 
 	//#################### CONSTRUCTORS ####################
 public:
-	LaplacianSmoother(double lambda, int iterations)
-	:	m_iterations(iterations), m_lambda(lambda)
+	LaplacianSmoother(double lambda, int iterations, int threadCount = ParallelJob::default_thread_count())
+	:	m_iterations(iterations), m_lambda(lambda), m_threadCount(threadCount)
 	{}
 
 	//#################### PUBLIC METHODS ####################
@@ -45,51 +60,57 @@ private:
 	void execute_impl()
 	{
 		Mesh_Ptr mesh = this->get_mesh();
-		for(int i=0; i<m_iterations; ++i)
-		{
-			this->set_status(OSSWrapper() << "Smoothing mesh (iteration " << i << ")...");
-			iterate(mesh);
-		}
-	}
-
-	void iterate(const Mesh_Ptr& mesh)
-	{
 		MeshNodeVector& nodes = mesh->nodes();
 		int nodeCount = static_cast<int>(nodes.size());
 
-		// Calculate the new node positions. Note that they have to be stored separately since we need
-		// the old node positions in order to calculate them.
-		std::vector<Vector3d> newPositions(nodeCount);
+		// Determine the neighbours which might affect each node (this depends on the node type, and is empty for corner nodes,
+		// since they are topologically important and must stay fixed).
+		CompactMeshT compactMesh(*mesh);
+		std::vector<int> neighbourOffsets(nodeCount + 1);
+		std::vector<int> neighbours;
 		for(int i=0; i<nodeCount; ++i)
 		{
-			newPositions[i] = nodes[i].position();
-
-			std::set<int> neighbours;								// holds the neighbours which might affect a node (depends on the node type)
-			switch(MeshUtil::classify_node(i, nodes, neighbours))	// the type of node affects how the node is allowed to move
+			neighbourOffsets[i] = static_cast<int>(neighbours.size());
+			if(compactMesh.classify_node(i, &neighbours) == MeshNodeType::CORNER)
 			{
-				case MeshNodeType::SIMPLE:
-				case MeshNodeType::EDGE:
-				{
-					for(std::set<int>::const_iterator jt=neighbours.begin(), jend=neighbours.end(); jt!=jend; ++jt)
-					{
-						Vector3d offset = nodes[*jt].position() - nodes[i].position();
-						offset *= m_lambda / neighbours.size();
-						newPositions[i] += offset;
-					}
-					break;
-				}
-				case MeshNodeType::CORNER:
-				{
-					// Corner nodes are topologically important and must stay fixed.
-					break;
-				}
+				neighbours.resize(neighbourOffsets[i]);
 			}
 		}
+		neighbourOffsets[nodeCount] = static_cast<int>(neighbours.size());
+
+		// Smooth the node positions. Note that the new positions have to be stored separately since we need
+		// the old node positions in order to calculate them.
+		std::vector<Vector3d> positions = compactMesh.positions();
+		std::vector<Vector3d> newPositions(nodeCount);
+		for(int i=0; i<m_iterations; ++i)
+		{
+			this->set_status(OSSWrapper() << "Smoothing mesh (iteration " << i << ")...");
+			ParallelJob::run_slabs(nodeCount, boost::bind(&LaplacianSmoother::smooth_nodes, this, boost::cref(positions), boost::cref(neighbourOffsets),
+														  boost::cref(neighbours), boost::ref(newPositions), _1, _2), m_threadCount);
+			positions.swap(newPositions);
+		}
 
 		// Copy them across to the mesh.
 		for(int i=0; i<nodeCount; ++i)
 		{
-			nodes[i].set_position(newPositions[i]);
+			nodes[i].set_position(positions[i]);
+		}
+	}
+
+	void smooth_nodes(const std::vector<Vector3d>& positions, const std::vector<int>& neighbourOffsets, const std::vector<int>& neighbours,
+					  std::vector<Vector3d>& newPositions, int nodeBegin, int nodeEnd) const
+	{
+		for(int i=nodeBegin; i<nodeEnd; ++i)
+		{
+			newPositions[i] = positions[i];
+
+			int neighbourCount = neighbourOffsets[i+1] - neighbourOffsets[i];
+			for(int k=neighbourOffsets[i], kend=neighbourOffsets[i+1]; k<kend; ++k)
+			{
+				Vector3d offset = positions[neighbours[k]] - positions[i];
+				offset *= m_lambda / neighbourCount;
+				newPositions[i] += offset;
+			}
 		}
 	}
 };
@@ -1,14 +1,24 @@
 /***
  * millipede: MeshBuilder.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_MESHBUILDER
 #define H_MILLIPEDE_MESHBUILDER
 
+#include <algorithm>
 #include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include <common/jobs/CompositeJob.h>
+#include <common/jobs/ParallelJob.h>
+#include <common/jobs/SimpleJob.h>
 #include "CubeFaceGenerator.h"
 #include "CubeInternalGenerator.h"
 #include "CubeTriangleGenerator.h"
@@ -19,6 +29,12 @@ namespace mp {
 /**
 @brief	A MeshBuilder builds a 3D mesh from a 3D label image using the multiple material marching cubes (M3C) algorithm.
 
+Each stage of the algorithm (generating the cube faces, the cube internals and the triangles) processes z-slabs of the
+volume concurrently. Cube faces are generated into a separate node table for each slab; these are then stitched together
+(merging the nodes on the planes between slabs), with the nodes being added to the global node table in the order in which
+a cube-by-cube build would have created them. The results of the later stages are likewise combined in slab order. This
+ensures that the mesh does not depend on the number of threads used.
+
 @tparam	Label			The type of label to be used
 @tparam	PriorityPred	A predicate type defining an ordering over the labels for resolving conflicts that arise during the algorithm
 */
@@ -38,103 +54,353 @@ private:
 	typedef MeshNode<Label> MeshNodeT;
 	typedef MeshTriangle<Label> MeshTriangleT;
 	typedef std::list<MeshTriangleT> MeshTriangleList;
+	typedef boost::shared_ptr<MeshTriangleList> MeshTriangleList_Ptr;
+
+	/**
+	A creation key identifies the point at which a cube-by-cube build would have created a face node,
+	namely the cube face (in the order in which the faces would have been visited) and the node on it.
+	*/
+	typedef unsigned long long CreationKey;
+
+	//#################### NESTED CLASSES ####################
+private:
+	/**
+	@brief	A FaceSlab holds the cube faces generated for a z-slab of the volume, before they are stitched into the global tables.
+	*/
+	struct FaceSlab
+	{
+		struct SlabFace
+		{
+			int x, y, z;
+			CubeFaceDesignator::Enum f;
+			CubeFace cubeFace;
+
+			SlabFace(int x_, int y_, int z_, CubeFaceDesignator::Enum f_, const CubeFace& cubeFace_)
+			:	x(x_), y(y_), z(z_), f(f_), cubeFace(cubeFace_)
+			{}
+		};
+
+		int zBegin;
+		std::vector<int> duplicateOf;			// for each node, the index of the same node in the previous slab (if any), or -1 otherwise
+		std::vector<SlabFace> faces;			// the relevant faces in the slab (referring to nodes in the slab's node table)
+		std::vector<int> globalIndices;			// for each node, its index in the global node table (filled in during stitching)
+		std::vector<CreationKey> nodeKeys;		// for each node, the earliest point at which a cube-by-cube build would have created it
+		GlobalNodeTableT nodeTable;				// the nodes on the faces in the slab
+
+		explicit FaceSlab(int zBegin_)
+		:	zBegin(zBegin_)
+		{}
+	};
+
+	typedef boost::shared_ptr<FaceSlab> FaceSlab_Ptr;
+	typedef CubeInternalGenerator<Label> CubeInternalGeneratorT;
+	typedef boost::shared_ptr<CubeInternalGeneratorT> CubeInternalGenerator_Ptr;
 
 	//#################### JOBS ####################
 private:
-	template <typename Spawnee>
-	struct ForEachCubeFaceJobSpawner : SimpleJob
+	/**
+	@brief	The GenerateCubeFacesJob generates the nodes and edges on every cube face in the volume, in parallel z-slabs,
+			and then stitches the results for the slabs into the global node and cube tables.
+	*/
+	struct GenerateCubeFacesJob : SimpleJob
 	{
-		MeshBuildingData_Ptr data;
+		MeshBuilder *base;
 		int xSize, ySize, zSize;
 		int xDim[3], yDim[3], zDim[3];
 
 		mutable boost::mutex mut;
-		boost::shared_ptr<Spawnee> spawnee;
-		int spawneeCount;
+		std::map<int,FaceSlab_Ptr> slabs;		// the slabs processed so far, keyed by their first z plane
 
-		ForEachCubeFaceJobSpawner(const MeshBuildingData_Ptr& data_, int xSize_, int ySize_, int zSize_)
-		:	data(data_), xSize(xSize_), ySize(ySize_), zSize(zSize_)
+		GenerateCubeFacesJob(MeshBuilder *base_, int xSize_, int ySize_, int zSize_)
+		:	base(base_), xSize(xSize_), ySize(ySize_), zSize(zSize_)
 		{
 			xDim[CubeFaceDesignator::FACE_XY] = xSize;		xDim[CubeFaceDesignator::FACE_XZ] = xSize;		xDim[CubeFaceDesignator::FACE_YZ] = xSize+1;
 			yDim[CubeFaceDesignator::FACE_XY] = ySize;		yDim[CubeFaceDesignator::FACE_XZ] = ySize+1;	yDim[CubeFaceDesignator::FACE_YZ] = ySize;
 			zDim[CubeFaceDesignator::FACE_XY] = zSize+1;	zDim[CubeFaceDesignator::FACE_XZ] = zSize;		zDim[CubeFaceDesignator::FACE_YZ] = zSize;
+		}
 
-			spawneeCount = 0;
-			for(CubeFaceDesignator::Enum f=enum_begin<CubeFaceDesignator::Enum>(), end=enum_end<CubeFaceDesignator::Enum>(); f!=end; ++f)
-			{
-				spawneeCount += xDim[f] * yDim[f] * zDim[f];
-			}
+		CreationKey creation_key(CubeFaceDesignator::Enum f, int x, int y, int z, CubeFace::NodeDesignator n) const
+		{
+			// A cube-by-cube build visits the faces in (f,x,y,z) order, and the nodes on each face in designator order.
+			CreationKey key = f;
+			key = key * (xSize + 1) + x;
+			key = key * (ySize + 1) + y;
+			key = key * (zSize + 1) + z;
+			return key * CubeFace::POTENTIAL_NODE_COUNT + n;
 		}
 
 		void execute_impl()
 		{
-			for(CubeFaceDesignator::Enum f=enum_begin<CubeFaceDesignator::Enum>(), end=enum_end<CubeFaceDesignator::Enum>(); f!=end; ++f)
-				for(int x=0; x<xDim[f]; ++x)
+			set_status("Generating cube faces...");
+			ParallelJob::run_slabs(zSize + 1, boost::bind(&GenerateCubeFacesJob::generate_slab, this, _1, _2), base->m_threadCount);
+			if(is_aborted()) return;
+
+			set_status("Stitching cube faces...");
+			stitch_slabs();
+			slabs.clear();
+			increment_progress();
+		}
+
+		void generate_slab(int zBegin, int zEnd)
+		{
+			FaceSlab_Ptr slab(new FaceSlab(zBegin));
+			CubeFaceGenerator<Label,PriorityPred> generator(*base->m_data, slab->nodeTable);
+			CubeFace cubeFace;
+
+			for(int z=zBegin; z<zEnd; ++z)
+			{
+				for(CubeFaceDesignator::Enum f=enum_begin<CubeFaceDesignator::Enum>(), end=enum_end<CubeFaceDesignator::Enum>(); f!=end; ++f)
+				{
+					if(z >= zDim[f]) continue;
 					for(int y=0; y<yDim[f]; ++y)
-						for(int z=0; z<zDim[f]; ++z)
+						for(int x=0; x<xDim[f]; ++x)
 						{
+							if(!generator.generate(x, y, z, f, cubeFace)) continue;
+							slab->faces.push_back(typename FaceSlab::SlabFace(x, y, z, f, cubeFace));
+
+							// Keep track of the earliest point at which a cube-by-cube build would have created each node on the face.
+							// Note that nodes are always added to the slab's node table in designator order, so a new node's index
+							// is always the number of keys recorded so far.
+							for(CubeFace::NodeDesignator n=enum_begin<CubeFace::NodeDesignator>(), nend=enum_end<CubeFace::NodeDesignator>(); n!=nend; ++n)
 							{
-								boost::mutex::scoped_lock lock(mut);
-								spawnee.reset(new Spawnee(data, x, y, z, f));
+								if(!cubeFace.is_used(n)) continue;
+								int i = cubeFace.global_node_index(n);
+								CreationKey key = creation_key(f, x, y, z, n);
+								if(i == static_cast<int>(slab->nodeKeys.size())) slab->nodeKeys.push_back(key);
+								else slab->nodeKeys[i] = std::min(slab->nodeKeys[i], key);
 							}
-							spawnee->execute();
-
-							if(is_aborted()) return;
-							increment_progress();
 						}
+				}
+
+				if(is_aborted()) return;
+				increment_progress();
+			}
+
+			boost::mutex::scoped_lock lock(mut);
+			slabs.insert(std::make_pair(zBegin, slab));
 		}
 
 		int length() const
 		{
-			return spawneeCount;
+			return zSize + 2;
 		}
 
-		std::string status() const
+		void stitch_slabs()
 		{
-			boost::mutex::scoped_lock lock(mut);
-			return spawnee ? spawnee->status() : "";
+			GlobalNodeTableT& globalNodeTable = base->m_data->global_node_table();
+			CubeTable& cubeTable = base->m_data->cube_table();
+
+			std::vector<FaceSlab*> orderedSlabs;
+			for(typename std::map<int,FaceSlab_Ptr>::const_iterator it=slabs.begin(), iend=slabs.end(); it!=iend; ++it)
+			{
+				FaceSlab& slab = *it->second;
+				slab.duplicateOf.assign(slab.nodeTable.node_count(), -1);
+				slab.globalIndices.assign(slab.nodeTable.node_count(), -1);
+				orderedSlabs.push_back(&slab);
+			}
+			const int slabCount = static_cast<int>(orderedSlabs.size());
+
+			// Step 1:	Find the nodes that were generated by two adjacent slabs. These can only lie on the z plane at the start of the
+			//			later slab (the faces at the end of the earlier slab generate nodes on it too). We keep the copy in the earlier
+			//			slab, and give it the earlier of the two creation keys.
+			for(int s=1; s<slabCount; ++s)
+			{
+				FaceSlab& prev = *orderedSlabs[s-1];
+				FaceSlab& cur = *orderedSlabs[s];
+				for(int i=0, count=cur.nodeTable.node_count(); i<count; ++i)
+				{
+					const typename GlobalNodeTableT::NodePosition& pos = cur.nodeTable.node_position(i);
+					if(pos.get_base().z != cur.zBegin) continue;
+
+					int j = prev.nodeTable.lookup_index(pos);
+					if(j == -1) continue;
+
+					cur.duplicateOf[i] = j;
+					prev.nodeKeys[j] = std::min(prev.nodeKeys[j], cur.nodeKeys[i]);
+				}
+			}
+
+			// Step 2:	Add the distinct nodes to the global node table in creation key order, so that they get the same indices
+			//			as they would in a cube-by-cube build.
+			std::vector<std::pair<CreationKey,std::pair<int,int> > > creationOrder;
+			for(int s=0; s<slabCount; ++s)
+			{
+				const FaceSlab& slab = *orderedSlabs[s];
+				for(int i=0, count=slab.nodeTable.node_count(); i<count; ++i)
+				{
+					if(slab.duplicateOf[i] == -1) creationOrder.push_back(std::make_pair(slab.nodeKeys[i], std::make_pair(s, i)));
+				}
+			}
+			std::sort(creationOrder.begin(), creationOrder.end());
+
+			for(size_t k=0, size=creationOrder.size(); k<size; ++k)
+			{
+				FaceSlab& slab = *orderedSlabs[creationOrder[k].second.first];
+				int i = creationOrder[k].second.second;
+				slab.globalIndices[i] = globalNodeTable.find_index(slab.nodeTable.node_position(i));
+			}
+
+			for(int s=1; s<slabCount; ++s)
+			{
+				FaceSlab& slab = *orderedSlabs[s];
+				for(int i=0, count=slab.nodeTable.node_count(); i<count; ++i)
+				{
+					if(slab.duplicateOf[i] != -1) slab.globalIndices[i] = orderedSlabs[s-1]->globalIndices[slab.duplicateOf[i]];
+				}
+			}
+
+			// Step 3:	Merge the sourced labels and adjacent nodes of the slab nodes into the global nodes.
+			for(int s=0; s<slabCount; ++s)
+			{
+				const FaceSlab& slab = *orderedSlabs[s];
+				for(int i=0, count=slab.nodeTable.node_count(); i<count; ++i)
+				{
+					const MeshNodeT& slabNode = slab.nodeTable(i);
+					MeshNodeT& globalNode = globalNodeTable(slab.globalIndices[i]);
+
+					const std::set<SourcedLabel<Label> >& sourcedLabels = slabNode.sourced_labels();
+					for(typename std::set<SourcedLabel<Label> >::const_iterator it=sourcedLabels.begin(), iend=sourcedLabels.end(); it!=iend; ++it)
+					{
+						globalNode.add_sourced_label(it->label, it->source);
+					}
+
+					const std::set<int>& adjacentNodes = slabNode.adjacent_nodes();
+					for(std::set<int>::const_iterator it=adjacentNodes.begin(), iend=adjacentNodes.end(); it!=iend; ++it)
+					{
+						globalNode.add_adjacent_node(slab.globalIndices[*it]);
+					}
+				}
+			}
+
+			// Step 4:	Add the cube faces to the global cube table, mapping their nodes to global indices as we go.
+			for(int s=0; s<slabCount; ++s)
+			{
+				const FaceSlab& slab = *orderedSlabs[s];
+				for(typename std::vector<typename FaceSlab::SlabFace>::const_iterator it=slab.faces.begin(), iend=slab.faces.end(); it!=iend; ++it)
+				{
+					CubeFace cubeFace = it->cubeFace;
+					for(CubeFace::NodeDesignator n=enum_begin<CubeFace::NodeDesignator>(), end=enum_end<CubeFace::NodeDesignator>(); n!=end; ++n)
+					{
+						if(cubeFace.is_used(n)) cubeFace.set_global_node_index(n, slab.globalIndices[cubeFace.global_node_index(n)]);
+					}
+					cubeTable.set_cube_face(it->x, it->y, it->z, it->f, cubeFace);
+				}
+			}
 		}
 	};
 
-	template <typename Spawnee>
-	struct ForEachCubeJobSpawner : SimpleJob
+	/**
+	@brief	The GenerateCubeInternalsJob generates the nodes and edges within every cube in the volume.
+
+	The cubes are examined in parallel z-slabs, after which the nodes and edges found for each slab are added in slab order.
+	*/
+	struct GenerateCubeInternalsJob : SimpleJob
 	{
-		MeshBuildingData_Ptr data;
+		MeshBuilder *base;
 		int xSize, ySize, zSize;
 
 		mutable boost::mutex mut;
-		boost::shared_ptr<Spawnee> spawnee;
+		std::map<int,CubeInternalGenerator_Ptr> generators;		// the generators for the slabs processed so far, keyed by their first z position
 
-		ForEachCubeJobSpawner(const MeshBuildingData_Ptr& data_, int xSize_, int ySize_, int zSize_)
-		:	data(data_), xSize(xSize_), ySize(ySize_), zSize(zSize_)
+		GenerateCubeInternalsJob(MeshBuilder *base_, int xSize_, int ySize_, int zSize_)
+		:	base(base_), xSize(xSize_), ySize(ySize_), zSize(zSize_)
 		{}
 
 		void execute_impl()
 		{
-			for(int z=0; z<zSize; ++z)
+			set_status("Generating cube internals...");
+			ParallelJob::run_slabs(zSize, boost::bind(&GenerateCubeInternalsJob::generate_slab, this, _1, _2), base->m_threadCount);
+			if(is_aborted()) return;
+
+			for(typename std::map<int,CubeInternalGenerator_Ptr>::const_iterator it=generators.begin(), iend=generators.end(); it!=iend; ++it)
+			{
+				it->second->commit();
+			}
+			generators.clear();
+			increment_progress();
+		}
+
+		void generate_slab(int zBegin, int zEnd)
+		{
+			CubeInternalGenerator_Ptr generator(new CubeInternalGeneratorT(*base->m_data));
+			for(int z=zBegin; z<zEnd; ++z)
+			{
 				for(int y=0; y<ySize; ++y)
 					for(int x=0; x<xSize; ++x)
 					{
-						{
-							boost::mutex::scoped_lock lock(mut);
-							spawnee.reset(new Spawnee(data, x, y, z));
-						}
-						spawnee->execute();
-
-						if(is_aborted()) return;
-						increment_progress();
+						generator->generate(x, y, z);
 					}
+
+				if(is_aborted()) return;
+				increment_progress();
+			}
+
+			boost::mutex::scoped_lock lock(mut);
+			generators.insert(std::make_pair(zBegin, generator));
 		}
 
 		int length() const
 		{
-			return xSize * ySize * zSize;
+			return zSize + 1;
 		}
+	};
 
-		std::string status() const
+	/**
+	@brief	The GenerateCubeTrianglesJob generates the triangles for every cube in the volume.
+
+	The cubes are triangulated in parallel z-slabs, after which the triangles for each slab are spliced onto the global
+	triangle list in slab order.
+	*/
+	struct GenerateCubeTrianglesJob : SimpleJob
+	{
+		MeshBuilder *base;
+		int xSize, ySize, zSize;
+
+		mutable boost::mutex mut;
+		std::map<int,MeshTriangleList_Ptr> triangles;		// the triangles for the slabs processed so far, keyed by their first z position
+
+		GenerateCubeTrianglesJob(MeshBuilder *base_, int xSize_, int ySize_, int zSize_)
+		:	base(base_), xSize(xSize_), ySize(ySize_), zSize(zSize_)
+		{}
+
+		void execute_impl()
 		{
+			set_status("Generating triangles...");
+			ParallelJob::run_slabs(zSize, boost::bind(&GenerateCubeTrianglesJob::generate_slab, this, _1, _2), base->m_threadCount);
+			if(is_aborted()) return;
+
+			MeshTriangleList& globalTriangles = *base->m_data->triangles();
+			for(typename std::map<int,MeshTriangleList_Ptr>::const_iterator it=triangles.begin(), iend=triangles.end(); it!=iend; ++it)
+			{
+				globalTriangles.splice(globalTriangles.end(), *it->second);
+			}
+			triangles.clear();
+			increment_progress();
+		}
+
+		void generate_slab(int zBegin, int zEnd)
+		{
+			MeshTriangleList_Ptr slabTriangles(new MeshTriangleList);
+			CubeTriangleGenerator<Label> generator(*base->m_data);
+			for(int z=zBegin; z<zEnd; ++z)
+			{
+				for(int y=0; y<ySize; ++y)
+					for(int x=0; x<xSize; ++x)
+					{
+						generator.generate(x, y, z, *slabTriangles);
+					}
+
+				if(is_aborted()) return;
+				increment_progress();
+			}
+
 			boost::mutex::scoped_lock lock(mut);
-			return spawnee ? spawnee->status() : "";
+			triangles.insert(std::make_pair(zBegin, slabTriangles));
+		}
+
+		int length() const
+		{
+			return zSize + 1;
 		}
 	};
 
@@ -199,6 +465,7 @@ private:
 private:
 	MeshBuildingData_Ptr m_data;
 	DataHook<Mesh_Ptr> m_meshHook;
+	int m_threadCount;
 
 	//#################### CONSTRUCTORS ####################
 public:
@@ -211,25 +478,27 @@ public:
 
 	@param[in]	volumeSize	The size of the labelled volume
 	@param[in]	labelling	An optional itk::SmartPointer to a label image
+	@param[in]	threadCount	The maximum number of threads to use for each stage of the algorithm
 	@pre
 		-	If a labelling is passed in here, it must be non-null
 		-	If a labelling is passed in here, its size must equal volumeSize
 	*/
-	explicit MeshBuilder(const itk::Size<3>& volumeSize, const boost::optional<LabelImagePointer>& labelling = boost::none)
-	:	m_data(new MeshBuildingDataT)
+	explicit MeshBuilder(const itk::Size<3>& volumeSize, const boost::optional<LabelImagePointer>& labelling = boost::none,
+						 int threadCount = ParallelJob::default_thread_count())
+	:	m_data(new MeshBuildingDataT), m_threadCount(threadCount)
 	{
 		if(labelling) set_labelling(*labelling);
 
 		int xSize = volumeSize[0] - 1, ySize = volumeSize[1] - 1, zSize = volumeSize[2] - 1;
 
-		// Add the spawner for the CubeFaceGenerator sub-jobs.
-		add_subjob(new ForEachCubeFaceJobSpawner<CubeFaceGenerator<Label,PriorityPred> >(m_data, xSize, ySize, zSize));
+		// Add the sub-job that generates the cube faces.
+		add_subjob(new GenerateCubeFacesJob(this, xSize, ySize, zSize));
 
-		// Add the spawner for the CubeInternalGenerator sub-jobs.
-		add_subjob(new ForEachCubeJobSpawner<CubeInternalGenerator<Label> >(m_data, xSize, ySize, zSize));
+		// Add the sub-job that generates the cube internals.
+		add_subjob(new GenerateCubeInternalsJob(this, xSize, ySize, zSize));
 
-		// Add the spawner for the CubeTriangleGenerator sub-jobs.
-		add_subjob(new ForEachCubeJobSpawner<CubeTriangleGenerator<Label> >(m_data, xSize, ySize, zSize));
+		// Add the sub-job that generates the triangles.
+		add_subjob(new GenerateCubeTrianglesJob(this, xSize, ySize, zSize));
 
 		// Add the AddTriangleEdgesJob sub-job.
 		add_subjob(new AddTriangleEdgesJob(this));
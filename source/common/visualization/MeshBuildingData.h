@@ -1,6 +1,7 @@
 /***
  * millipede: MeshBuildingData.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_MESHBUILDINGDATA
@@ -52,11 +53,44 @@ public:
 		return m_cubeTable;
 	}
 
+	const CubeTable& cube_table() const
+	{
+		return m_cubeTable;
+	}
+
 	GlobalNodeTableT& global_node_table()
 	{
 		return m_globalNodeTable;
 	}
 
+	const GlobalNodeTableT& global_node_table() const
+	{
+		return m_globalNodeTable;
+	}
+
+	/**
+	@brief	Returns whether or not all eight vertices of cube (x,y,z) have the same label.
+
+	Such cubes (by far the most common kind) contribute nothing to the mesh, so this can be used to skip them quickly.
+
+	@param[in]	x	The x position of the cube in the volume
+	@param[in]	y	The y position of the cube in the volume
+	@param[in]	z	The z position of the cube in the volume
+	@return	true, if all the vertices of the cube have the same label, or false otherwise
+	*/
+	bool is_uniform_cube(int x, int y, int z) const
+	{
+		const LabelImagePointer& labelling = m_labellingHook.get();
+		itk::Index<3> index = {{x, y, z}};
+		Label label = labelling->GetPixel(index);
+		for(int i=1; i<8; ++i)
+		{
+			itk::Index<3> vertex = {{x + (i & 1), y + ((i >> 1) & 1), z + ((i >> 2) & 1)}};
+			if(labelling->GetPixel(vertex) != label) return false;
+		}
+		return true;
+	}
+
 	Label label(const Vector3i& pos) const
 	{
 		itk::Index<3> index = {{pos.x, pos.y, pos.z}};
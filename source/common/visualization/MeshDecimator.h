@@ -1,14 +1,15 @@
 /***
  * millipede: MeshDecimator.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_MESHDECIMATOR
 #define H_MILLIPEDE_MESHDECIMATOR
 
-#include <common/adts/PriorityQueue.h>
+#include <common/adts/DaryPriorityQueue.h>
+#include "CompactMesh.h"
 #include "MeshTransformer.h"
-#include "MeshUtil.h"
 #include "SimpleMeshNodeDecimator.h"
 
 namespace mp {
@@ -18,6 +19,7 @@ class MeshDecimator : public MeshTransformer<Label>
 {
 	//#################### TYPEDEFS ####################
 private:
+	typedef CompactMesh<Label> CompactMeshT;
 	typedef Mesh<Label> MeshT;
 	typedef boost::shared_ptr<MeshT> Mesh_Ptr;
 	typedef MeshNodeDecimator<Label> MeshNodeDecimatorT;
@@ -27,14 +29,14 @@ private:
 	typedef MeshTriangle<Label> MeshTriangleT;
 	typedef std::list<MeshTriangleT> MeshTriangleList;
 	typedef std::set<MeshTriangleT> MeshTriangleSet;
-	typedef PriorityQueue<int, double, MeshNodeDecimator_Ptr> PriQ;
+	typedef DaryPriorityQueue<int, double, MeshNodeDecimator_Ptr, std::less<double>, 2> PriQ;	// binary, so that ties between equal metrics are broken as they always have been
 	typedef SimpleMeshNodeDecimator<Label> SimpleMeshNodeDecimatorT;
 
-	typedef std::map<int,std::set<MeshTriangleT> > AdjacentTriangleMap;
+	typedef std::vector<MeshTriangleSet> AdjacentTriangleTable;
 
 	//#################### PRIVATE VARIABLES ####################
 private:
-	AdjacentTriangleMap m_adjacentTriangleMap;	///< a map from the mesh nodes to the triangles surrounding them
+	AdjacentTriangleTable m_adjacentTriangles;	///< the triangles surrounding each mesh node (indexed by node)
 	int m_reductionTarget;						///< the percentage of triangles to try and remove - in the range [0,100] (obviously)
 
 	//#################### CONSTRUCTORS ####################
@@ -66,10 +68,10 @@ private:
 			n1.add_adjacent_node(i0);	n1.add_adjacent_node(i2);
 			n2.add_adjacent_node(i0);	n2.add_adjacent_node(i1);
 
-			// Update the adjacent triangles map.
+			// Update the adjacent triangles table.
 			for(int j=0; j<3; ++j)
 			{
-				m_adjacentTriangleMap[it->index(j)].insert(*it);
+				m_adjacentTriangles[it->index(j)].insert(*it);
 			}
 		}
 
@@ -93,29 +95,33 @@ private:
 		}
 	}
 
-	void construct_adjacent_triangle_map(const Mesh_Ptr& mesh)
+	void construct_adjacent_triangle_table(const Mesh_Ptr& mesh)
 	{
+		// Note:	The table is never resized after this, so the decimators can safely keep references to its sets.
+		m_adjacentTriangles.assign(mesh->nodes().size(), MeshTriangleSet());
+
 		const MeshTriangleList& triangles = mesh->triangles();
 		for(typename MeshTriangleList::const_iterator it=triangles.begin(), iend=triangles.end(); it!=iend; ++it)
 		{
 			for(int j=0; j<3; ++j)
 			{
-				m_adjacentTriangleMap[it->index(j)].insert(*it);
+				m_adjacentTriangles[it->index(j)].insert(*it);
 			}
 		}
 	}
 
 	void construct_priority_queue(PriQ& pq, const Mesh_Ptr& mesh) const
 	{
-		const MeshNodeVector& nodes = mesh->nodes();
-		int nodeCount = static_cast<int>(nodes.size());
+		// Classify the nodes using a compact snapshot of the mesh, which avoids building label sets for every node.
+		CompactMeshT compactMesh(*mesh);
+		int nodeCount = compactMesh.node_count();
 		for(int i=0; i<nodeCount; ++i)
 		{
-			switch(MeshUtil::classify_node(i, nodes))
+			switch(compactMesh.classify_node(i))
 			{
 				case MeshNodeType::SIMPLE:
 				{
-					MeshNodeDecimator_Ptr nodeDecimator(new SimpleMeshNodeDecimatorT(i, mesh, m_adjacentTriangleMap.find(i)->second));
+					MeshNodeDecimator_Ptr nodeDecimator(new SimpleMeshNodeDecimatorT(i, mesh, m_adjacentTriangles[i]));
 					if(nodeDecimator->valid()) pq.insert(i, nodeDecimator->metric(), nodeDecimator);
 					break;
 				}
@@ -138,9 +144,9 @@ private:
 		this->set_status("Decimating mesh...");
 
 		Mesh_Ptr mesh = this->get_mesh();
-		construct_adjacent_triangle_map(mesh);
+		construct_adjacent_triangle_table(mesh);
 
-		PriQ pq;
+		PriQ pq(mesh->nodes().size());
 		construct_priority_queue(pq, mesh);
 
 		int trisToRemove = mesh->triangles().size() * m_reductionTarget / 100;
@@ -234,14 +240,14 @@ private:
 			nodes[*it].remove_adjacent_node(index);
 		}
 
-		// Remove the old adjacent triangles around the decimated node from the adjacent triangles map (but leave them
+		// Remove the old adjacent triangles around the decimated node from the adjacent triangles table (but leave them
 		// in the main list, as it's too costly to remove them at this stage and we can do it at the end).
-		MeshTriangleSet adjacentTriangles = m_adjacentTriangleMap.find(index)->second;
+		MeshTriangleSet adjacentTriangles = m_adjacentTriangles[index];
 		for(typename MeshTriangleSet::const_iterator it=adjacentTriangles.begin(), iend=adjacentTriangles.end(); it!=iend; ++it)
 		{
 			for(int j=0; j<3; ++j)
 			{
-				m_adjacentTriangleMap.find(it->index(j))->second.erase(*it);
+				m_adjacentTriangles[it->index(j)].erase(*it);
 			}
 		}
 	}
@@ -1,35 +1,50 @@
 /***
  * millipede: MeshRenderer.cpp
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
+#include <algorithm>
 #include <cassert>
 #include <climits>
 
+#include "CompactMesh.h"
 #include "MeshRenderer.h"
-#include "MeshUtil.h"
 
 namespace mp {
 
+//#################### HELPER CLASSES ####################
+struct BufferDeleter
+{
+	void operator()(void *p)
+	{
+		GLuint *id = static_cast<GLuint*>(p);
+		if(glIsBuffer(*id)) glDeleteBuffers(1, id);
+		delete id;
+	}
+};
+
 //#################### CONSTRUCTORS ####################
 MeshRenderer::MeshRenderer(const Mesh_CPtr& mesh, const boost::optional<std::map<int,RGBA32> >& submeshColourMap, const boost::optional<std::map<std::string,int> >& submeshNameMap)
-:	m_wireframeEnabled(false)
+:	m_vertexBuffersEnabled(true), m_wireframeEnabled(false)
 {
 	if(submeshColourMap) m_submeshColourMap = *submeshColourMap;
 	if(submeshNameMap) m_submeshNameMap = *submeshNameMap;
 
-	const std::vector<MeshNodeT>& nodes = mesh->nodes();
-	const std::list<MeshTriangleT>& triangles = mesh->triangles();
+	// Note:	We work from a compact snapshot of the mesh, which provides dense label indices and a flat layout for the
+	//			per-(node,label) clone indices (rather than a std::map per node).
+	CompactMesh<int> compactMesh(*mesh);
+	const std::vector<Vector3d>& positions = compactMesh.positions();
+	int nodeCount = compactMesh.node_count();
 
 	// Step 1:	Set up the submesh for each label used.
-	for(std::vector<MeshNodeT>::const_iterator it=nodes.begin(), iend=nodes.end(); it!=iend; ++it)
+	int labelCount = compactMesh.label_count();
+	std::vector<Submesh*> labelSubmeshes(labelCount);
+	for(int l=0; l<labelCount; ++l)
 	{
-		std::set<int> labels = it->labels();
-		for(std::set<int>::const_iterator jt=labels.begin(), jend=labels.end(); jt!=jend; ++jt)
-		{
-			Submesh_Ptr& submesh = m_submeshes[*jt];
-			if(!submesh) submesh.reset(new Submesh);
-		}
+		Submesh_Ptr& submesh = m_submeshes[compactMesh.label(l)];
+		if(!submesh) submesh.reset(new Submesh);
+		labelSubmeshes[l] = submesh.get();
 	}
 
 	// Step 2:	Clone each node for each of its labels, and store the clones in the relevant arrays (keeping a track of where they go).
@@ -37,55 +52,58 @@ MeshRenderer::MeshRenderer(const Mesh_CPtr& mesh, const boost::optional<std::map
 	m_meshLowerBound = Vector3d(INT_MAX, INT_MAX, INT_MAX);
 	m_meshUpperBound = Vector3d(INT_MIN, INT_MIN, INT_MIN);
 
-	std::vector<std::map<int,int> > clonedNodeIndices(nodes.size());
-	for(size_t i=0, size=nodes.size(); i<size; ++i)
+	std::vector<int> clonedNodeIndices(compactMesh.node_label_offset(nodeCount));
+	for(int i=0; i<nodeCount; ++i)
 	{
-		const Vector3d& pos = nodes[i].position();
+		const Vector3d& pos = positions[i];
 		m_meshLowerBound.x = std::min(m_meshLowerBound.x, pos.x);	m_meshUpperBound.x = std::max(m_meshUpperBound.x, pos.x);
 		m_meshLowerBound.y = std::min(m_meshLowerBound.y, pos.y);	m_meshUpperBound.y = std::max(m_meshUpperBound.y, pos.y);
 		m_meshLowerBound.z = std::min(m_meshLowerBound.z, pos.z);	m_meshUpperBound.z = std::max(m_meshUpperBound.z, pos.z);
 
-		std::set<int> labels = nodes[i].labels();
-		for(std::set<int>::const_iterator jt=labels.begin(), jend=labels.end(); jt!=jend; ++jt)
+		int entry = compactMesh.node_label_offset(i);
+		for(CompactMesh<int>::IndexIterator jt=compactMesh.node_labels_cbegin(i), jend=compactMesh.node_labels_cend(i); jt!=jend; ++jt, ++entry)
 		{
-			Submesh& submesh = *m_submeshes[*jt];
-			clonedNodeIndices[i].insert(std::make_pair(*jt, submesh.vertexArray.size() / 3));
+			Submesh& submesh = *labelSubmeshes[*jt];
+			clonedNodeIndices[entry] = static_cast<int>(submesh.vertexArray.size() / 6);
 
-			submesh.vertexArray.push_back(pos.x);
-			submesh.vertexArray.push_back(pos.y);
-			submesh.vertexArray.push_back(pos.z);
+			submesh.vertexArray.push_back(static_cast<GLfloat>(pos.x));
+			submesh.vertexArray.push_back(static_cast<GLfloat>(pos.y));
+			submesh.vertexArray.push_back(static_cast<GLfloat>(pos.z));
+			submesh.vertexArray.insert(submesh.vertexArray.end(), 3, 0.0f);	// the normal is filled in later
 		}
 	}
 
-	// Step 3:	Prepare the normal array for each label.
-	for(std::map<int,Submesh_Ptr>::const_iterator it=m_submeshes.begin(), iend=m_submeshes.end(); it!=iend; ++it)
+	// Step 3:	Prepare the normal array for each label. Note that the normals are accumulated in double precision,
+	//			and only copied into the (interleaved) vertex arrays once they have been normalized.
+	std::vector<std::vector<double> > normalArrays(labelCount);
+	for(int l=0; l<labelCount; ++l)
 	{
-		it->second->normalArray.resize(it->second->vertexArray.size());
+		normalArrays[l].resize(labelSubmeshes[l]->vertexArray.size() / 2);
 	}
 
 	// Step 4:	Run through the triangles, filling in the index array and adding to the values in the normal array for each label.
-	for(std::list<MeshTriangleT>::const_iterator it=triangles.begin(), iend=triangles.end(); it!=iend; ++it)
+	for(int t=0, triangleCount=compactMesh.triangle_count(); t<triangleCount; ++t)
 	{
-		int indices[3] = {it->index(0), it->index(1), it->index(2)};
+		int indices[3] = {compactMesh.triangle_index(t,0), compactMesh.triangle_index(t,1), compactMesh.triangle_index(t,2)};
 
 		// The length of this is twice the triangle's area.
-		Vector3d normal = MeshUtil::calculate_unnormalized_normal(*it, nodes);
-
-		const std::set<int>& labelSet = it->labels();
-		std::vector<int> labels(labelSet.begin(), labelSet.end());
-		assert(labels.size() == 2);
+		Vector3d normal = (positions[indices[1]] - positions[indices[0]]).cross(positions[indices[2]] - positions[indices[0]]);
 
 		for(int j=0; j<2; ++j)
 		{
-			const int label = labels[j];
+			const int label = compactMesh.triangle_label(t,j);
 
 			int clones[3];
 			for(int k=0; k<3; ++k)
 			{
-				clones[k] = clonedNodeIndices[indices[k]][label];
+				CompactMesh<int>::IndexIterator nodeLabelsBegin = compactMesh.node_labels_cbegin(indices[k]);
+				CompactMesh<int>::IndexIterator jt = std::find(nodeLabelsBegin, compactMesh.node_labels_cend(indices[k]), label);
+				assert(jt != compactMesh.node_labels_cend(indices[k]));
+				clones[k] = clonedNodeIndices[compactMesh.node_label_offset(indices[k]) + (jt - nodeLabelsBegin)];
 			}
 
-			Submesh& submesh = *m_submeshes[label];
+			Submesh& submesh = *labelSubmeshes[label];
+			std::vector<double>& normalArray = normalArrays[label];
 			if(j == 0)	// the winding stored in the triangle is correct for the first label...
 			{
 				submesh.indexArray.push_back(clones[0]);
@@ -95,9 +113,9 @@ MeshRenderer::MeshRenderer(const Mesh_CPtr& mesh, const boost::optional<std::map
 				for(int k=0; k<3; ++k)
 				{
 					int normalOffset = clones[k] * 3;
-					submesh.normalArray[normalOffset]   += normal.x;
-					submesh.normalArray[normalOffset+1] += normal.y;
-					submesh.normalArray[normalOffset+2] += normal.z;
+					normalArray[normalOffset]   += normal.x;
+					normalArray[normalOffset+1] += normal.y;
+					normalArray[normalOffset+2] += normal.z;
 				}
 			}
 			else		// ...but reversed for the second label
@@ -109,28 +127,29 @@ MeshRenderer::MeshRenderer(const Mesh_CPtr& mesh, const boost::optional<std::map
 				for(int k=0; k<3; ++k)
 				{
 					int normalOffset = clones[k] * 3;
-					submesh.normalArray[normalOffset]   -= normal.x;
-					submesh.normalArray[normalOffset+1] -= normal.y;
-					submesh.normalArray[normalOffset+2] -= normal.z;
+					normalArray[normalOffset]   -= normal.x;
+					normalArray[normalOffset+1] -= normal.y;
+					normalArray[normalOffset+2] -= normal.z;
 				}
 			}
 		}
 	}
 
-	// Step 5:	Normalize all the normals in all the normal arrays (except for those which are too close to zero to normalize).
-	for(std::map<int,Submesh_Ptr>::const_iterator it=m_submeshes.begin(), iend=m_submeshes.end(); it!=iend; ++it)
+	// Step 5:	Normalize all the normals in all the normal arrays (except for those which are too close to zero to normalize),
+	//			and copy them into the vertex arrays.
+	for(int l=0; l<labelCount; ++l)
 	{
-		std::vector<double>& normalArray = it->second->normalArray;
+		const std::vector<double>& normalArray = normalArrays[l];
+		std::vector<GLfloat>& vertexArray = labelSubmeshes[l]->vertexArray;
 		for(size_t j=0, size=normalArray.size(); j<size; j+=3)
 		{
 			Vector3d v(normalArray[j], normalArray[j+1], normalArray[j+2]);
-			if(v.length() >= MathConstants::SMALL_EPSILON)
-			{
-				v.normalize();
-				normalArray[j]   = v.x;
-				normalArray[j+1] = v.y;
-				normalArray[j+2] = v.z;
-			}
+			if(v.length() >= MathConstants::SMALL_EPSILON) v.normalize();
+
+			size_t normalOffset = j*2 + 3;
+			vertexArray[normalOffset]   = static_cast<GLfloat>(v.x);
+			vertexArray[normalOffset+1] = static_cast<GLfloat>(v.y);
+			vertexArray[normalOffset+2] = static_cast<GLfloat>(v.z);
 		}
 	}
 }
@@ -175,6 +194,16 @@ void MeshRenderer::render() const
 	const int defaultColourCount = sizeof(defaultColours) / sizeof(RGBA32);
 	int currentDefaultColour = 0;
 
+	// Note:	Vertex buffer objects are part of the core API from OpenGL 1.5 onwards.
+	bool useVertexBuffers = m_vertexBuffersEnabled && GLEE_VERSION_1_5;
+
+	// Set up the rendering state once for all of the submeshes.
+	glPushAttrib(GL_ENABLE_BIT | GL_POLYGON_BIT);
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+	if(m_wireframeEnabled)	setup_wireframe_rendering();
+	else					setup_solid_rendering();
+
 	for(std::map<int,Submesh_Ptr>::const_iterator it=m_submeshes.begin(), iend=m_submeshes.end(); it!=iend; ++it)
 	{
 		RGBA32 colour;
@@ -189,12 +218,17 @@ void MeshRenderer::render() const
 			currentDefaultColour = (currentDefaultColour + 1) % defaultColourCount;
 		}
 
-		if(it->second->enabled)
-		{
-			if(m_wireframeEnabled)	render_submesh_wireframe(*it->second, colour);
-			else					render_submesh_solid(*it->second, colour);
-		}
+		if(it->second->enabled) render_submesh(*it->second, colour, useVertexBuffers);
 	}
+
+	if(useVertexBuffers)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	glPopClientAttrib();
+	glPopAttrib();
 }
 
 void MeshRenderer::set_submesh_enabled(const std::string& submeshName, bool submeshEnabled)
@@ -208,6 +242,12 @@ void MeshRenderer::set_submesh_enabled(const std::string& submeshName, bool subm
 	jt->second->enabled = submeshEnabled;
 }
 
+void MeshRenderer::set_vertex_buffers_enabled(bool vertexBuffersEnabled)
+{
+	// Note:	Disabling vertex buffers forces the mesh to be rendered from client-side arrays, as on implementations that lack them.
+	m_vertexBuffersEnabled = vertexBuffersEnabled;
+}
+
 void MeshRenderer::set_wireframe_enabled(bool wireframeEnabled)
 {
 	m_wireframeEnabled = wireframeEnabled;
@@ -236,7 +276,7 @@ std::vector<std::string> MeshRenderer::submesh_names() const
 }
 
 //#################### PRIVATE METHODS ####################
-void MeshRenderer::render_submesh_solid(const Submesh& submesh, const RGBA32& colour) const
+void MeshRenderer::render_submesh(const Submesh& submesh, const RGBA32& colour, bool useVertexBuffers)
 {
 	if(submesh.indexArray.empty() || submesh.vertexArray.empty())
 	{
@@ -244,11 +284,31 @@ void MeshRenderer::render_submesh_solid(const Submesh& submesh, const RGBA32& co
 		return;
 	}
 
-	glPushAttrib(GL_ENABLE_BIT | GL_POLYGON_BIT);
-	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	// Note:	When a buffer object is bound, the array "pointers" are interpreted as offsets into it.
+	const char *vertices, *indices;
+	if(useVertexBuffers)
+	{
+		if(!submesh.vertexBuffer || !glIsBuffer(*submesh.vertexBuffer) || !glIsBuffer(*submesh.indexBuffer)) upload_submesh(submesh);
+		glBindBuffer(GL_ARRAY_BUFFER, *submesh.vertexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *submesh.indexBuffer);
+		vertices = indices = NULL;
+	}
+	else
+	{
+		vertices = reinterpret_cast<const char*>(&submesh.vertexArray[0]);
+		indices = reinterpret_cast<const char*>(&submesh.indexArray[0]);
+	}
+
+	const GLsizei stride = 6 * sizeof(GLfloat);
+	glVertexPointer(3, GL_FLOAT, stride, vertices);
+	glNormalPointer(GL_FLOAT, stride, vertices + 3 * sizeof(GLfloat));
+
+	glColor4ub(colour[0], colour[1], colour[2], colour[3]);
+	glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(submesh.indexArray.size()), GL_UNSIGNED_INT, indices);
+}
 
-	glVertexPointer(3, GL_DOUBLE, 0, &submesh.vertexArray[0]);
-	glNormalPointer(GL_DOUBLE, 0, &submesh.normalArray[0]);
+void MeshRenderer::setup_solid_rendering()
+{
 	glEnableClientState(GL_VERTEX_ARRAY);
 	glEnableClientState(GL_NORMAL_ARRAY);
 
@@ -265,35 +325,25 @@ void MeshRenderer::render_submesh_solid(const Submesh& submesh, const RGBA32& co
 	glLightfv(GL_LIGHT0, GL_DIFFUSE, diffuse);
 	glLightfv(GL_LIGHT0, GL_POSITION, position);
 	glEnable(GL_LIGHT0);
-
-	glColor4ub(colour[0], colour[1], colour[2], colour[3]);
-	glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(submesh.indexArray.size()), GL_UNSIGNED_INT, &submesh.indexArray[0]);
-
-	glPopClientAttrib();
-	glPopAttrib();
 }
 
-void MeshRenderer::render_submesh_wireframe(const Submesh& submesh, const RGBA32& colour) const
+void MeshRenderer::setup_wireframe_rendering()
 {
-	if(submesh.indexArray.empty() || submesh.vertexArray.empty())
-	{
-		// This should never actually happen - I'm just playing it safe.
-		return;
-	}
-
-	glPushAttrib(GL_ENABLE_BIT | GL_POLYGON_BIT);
-	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
-
 	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-
-	glVertexPointer(3, GL_DOUBLE, 0, &submesh.vertexArray[0]);
 	glEnableClientState(GL_VERTEX_ARRAY);
+}
 
-	glColor4ub(colour[0], colour[1], colour[2], colour[3]);
-	glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(submesh.indexArray.size()), GL_UNSIGNED_INT, &submesh.indexArray[0]);
-
-	glPopClientAttrib();
-	glPopAttrib();
+void MeshRenderer::upload_submesh(const Submesh& submesh)
+{
+	GLuint ids[2];
+	glGenBuffers(2, ids);
+	submesh.vertexBuffer.reset(new GLuint(ids[0]), BufferDeleter());
+	submesh.indexBuffer.reset(new GLuint(ids[1]), BufferDeleter());
+
+	glBindBuffer(GL_ARRAY_BUFFER, ids[0]);
+	glBufferData(GL_ARRAY_BUFFER, submesh.vertexArray.size() * sizeof(GLfloat), &submesh.vertexArray[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ids[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, submesh.indexArray.size() * sizeof(GLuint), &submesh.indexArray[0], GL_STATIC_DRAW);
 }
 
 }
@@ -1,6 +1,7 @@
 /***
  * millipede: MeshRenderer.h
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #ifndef H_MILLIPEDE_MESHRENDERER
@@ -17,6 +18,13 @@
 
 namespace mp {
 
+/**
+@brief	A MeshRenderer renders a mesh as a set of submeshes, one per label.
+
+The vertices of each submesh are stored as interleaved float positions and normals. Where vertex buffer objects are
+supported (OpenGL 1.5 onwards), these (and the submesh indices) are uploaded to the GPU the first time the submesh is
+rendered, and only re-uploaded if the buffers are lost; otherwise, they are rendered from client-side arrays.
+*/
 class MeshRenderer
 {
 	//#################### NESTED CLASSES ####################
@@ -24,9 +32,10 @@ private:
 	struct Submesh
 	{
 		bool enabled;
-		std::vector<GLuint> indexArray;		// consecutive triples of GLuints which reference vertices in the vertex array to form triangles
-		std::vector<double> normalArray;	// consecutive triples of doubles which form vertex normals (one normal per vertex)
-		std::vector<double> vertexArray;	// consecutive triples of doubles which form vertices
+		std::vector<GLuint> indexArray;						// consecutive triples of GLuints which reference vertices in the vertex array to form triangles
+		mutable boost::shared_ptr<GLuint> indexBuffer;		// the buffer object holding the index array (once uploaded)
+		std::vector<GLfloat> vertexArray;					// consecutive sextuples of floats which form vertices (the position followed by the normal)
+		mutable boost::shared_ptr<GLuint> vertexBuffer;		// the buffer object holding the vertex array (once uploaded)
 
 		Submesh()
 		:	enabled(true)
@@ -47,6 +56,7 @@ private:
 	std::map<int,RGBA32> m_submeshColourMap;
 	std::map<std::string,int> m_submeshNameMap;
 	std::map<int,Submesh_Ptr> m_submeshes;
+	bool m_vertexBuffersEnabled;
 	bool m_wireframeEnabled;
 
 	//#################### CONSTRUCTORS ####################
@@ -61,14 +71,17 @@ public:
 	const Vector3d& mesh_upper_bound() const;
 	void render() const;
 	void set_submesh_enabled(const std::string& submeshName, bool submeshEnabled);
+	void set_vertex_buffers_enabled(bool vertexBuffersEnabled);
 	void set_wireframe_enabled(bool wireframeEnabled);
 	bool submesh_enabled(const std::string& submeshName) const;
 	std::vector<std::string> submesh_names() const;
 
 	//#################### PRIVATE METHODS ####################
 private:
-	void render_submesh_solid(const Submesh& submesh, const RGBA32& colour) const;
-	void render_submesh_wireframe(const Submesh& submesh, const RGBA32& colour) const;
+	static void render_submesh(const Submesh& submesh, const RGBA32& colour, bool useVertexBuffers);
+	static void setup_solid_rendering();
+	static void setup_wireframe_rendering();
+	static void upload_submesh(const Submesh& submesh);
 };
 
 //#################### TYPEDEFS ####################
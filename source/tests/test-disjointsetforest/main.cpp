@@ -1,11 +1,20 @@
 /***
  * test-disjointsetforest: main.cpp
  * Copyright Stuart Golodetz, 2009. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #define BOOST_TEST_MODULE DisjointSetForest Test
 #include <boost/test/included/unit_test.hpp>
 
+#include <cstdlib>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <common/adts/ConcurrentDisjointSetForest.h>
+#include <common/adts/DenseDisjointSetForest.h>
 #include <common/adts/DisjointSetForest.h>
 using namespace mp;
 
@@ -84,3 +93,129 @@ BOOST_AUTO_TEST_CASE(union_sets_test)
 		BOOST_CHECK_EQUAL(dsf.value_of(9), "m");
 		BOOST_CHECK_EQUAL(dsf.value_of(84), "g");
 }
+
+BOOST_AUTO_TEST_CASE(dense_test)
+{
+	DenseDisjointSetForest<std::string> dsf;
+		BOOST_CHECK_THROW(dsf.find_set(17), Exception);
+		BOOST_CHECK_THROW(dsf.find_set(-1), Exception);
+	dsf.add_element(23, "s");
+	dsf.add_element(9, "m");
+	dsf.add_element(84, "g");
+		BOOST_CHECK_EQUAL(dsf.element_count(), 3);
+		BOOST_CHECK_EQUAL(dsf.set_count(), 3);
+		BOOST_CHECK_EQUAL(dsf.find_set(23), 23);
+		BOOST_CHECK_EQUAL(dsf.find_set(9), 9);
+		BOOST_CHECK_EQUAL(dsf.find_set(84), 84);
+		BOOST_CHECK_THROW(dsf.find_set(10), Exception);
+	dsf.union_sets(23, 84);
+		BOOST_CHECK_EQUAL(dsf.set_count(), 2);
+		BOOST_CHECK_EQUAL(dsf.find_set(23), dsf.find_set(84));
+		BOOST_CHECK_EQUAL(dsf.find_set(9), 9);
+	dsf.union_sets(84, 9);
+		BOOST_CHECK_EQUAL(dsf.element_count(), 3);
+		BOOST_CHECK_EQUAL(dsf.set_count(), 1);
+		BOOST_CHECK(dsf.find_set(9) == dsf.find_set(84) && dsf.find_set(84) == dsf.find_set(23));
+		BOOST_CHECK_EQUAL(dsf.value_of(23), "s");
+		BOOST_CHECK_EQUAL(dsf.value_of(9), "m");
+		BOOST_CHECK_EQUAL(dsf.value_of(84), "g");
+}
+
+BOOST_AUTO_TEST_CASE(dense_matches_sparse_test)
+{
+	// The dense forest uses the same linking rule as the original, so it should choose exactly the same roots.
+	const int SIZE = 1000;
+	DisjointSetForest<> sparse;
+	DenseDisjointSetForest<> dense(SIZE);
+	for(int i=0; i<SIZE; ++i)
+	{
+		sparse.add_element(i);
+		dense.add_element(i);
+	}
+
+	srand(12345);
+	for(int k=0; k<SIZE; ++k)
+	{
+		int x = rand() % SIZE, y = rand() % SIZE;
+		sparse.union_sets(x, y);
+		dense.union_sets(x, y);
+	}
+
+	BOOST_CHECK_EQUAL(dense.set_count(), sparse.set_count());
+	for(int i=0; i<SIZE; ++i)
+	{
+		BOOST_CHECK_EQUAL(dense.find_set(i), sparse.find_set(i));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_test)
+{
+	ConcurrentDisjointSetForest<std::string> dsf(100);
+		BOOST_CHECK_THROW(dsf.add_element(100, "x"), Exception);
+		BOOST_CHECK_THROW(dsf.find_set(17), Exception);
+	dsf.add_element(23, "s");
+	dsf.add_element(9, "m");
+	dsf.add_element(84, "g");
+		BOOST_CHECK_EQUAL(dsf.element_count(), 3);
+		BOOST_CHECK_EQUAL(dsf.set_count(), 3);
+	dsf.union_sets(23, 84);
+		BOOST_CHECK_EQUAL(dsf.set_count(), 2);
+		BOOST_CHECK_EQUAL(dsf.find_set(84), 23);
+		BOOST_CHECK_EQUAL(dsf.find_set(9), 9);
+	dsf.union_sets(84, 9);
+		BOOST_CHECK_EQUAL(dsf.set_count(), 1);
+		BOOST_CHECK_EQUAL(dsf.find_set(23), 9);
+		BOOST_CHECK_EQUAL(dsf.find_set(84), 9);
+		BOOST_CHECK_EQUAL(dsf.value_of(84), "g");
+}
+
+void union_random_pairs(ConcurrentDisjointSetForest<> *dsf, const std::vector<std::pair<int,int> > *pairs, int begin, int end)
+{
+	for(int k=begin; k<end; ++k)
+	{
+		dsf->union_sets((*pairs)[k].first, (*pairs)[k].second);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_threads_test)
+{
+	const int SIZE = 100000;
+	const int PAIR_COUNT = 60000;
+	const int THREAD_COUNT = 4;
+
+	srand(23);
+	std::vector<std::pair<int,int> > pairs;
+	for(int k=0; k<PAIR_COUNT; ++k) pairs.push_back(std::make_pair(rand() % SIZE, rand() % SIZE));
+
+	DisjointSetForest<> expected;
+	ConcurrentDisjointSetForest<> dsf(SIZE);
+	for(int i=0; i<SIZE; ++i)
+	{
+		expected.add_element(i);
+		dsf.add_element(i);
+	}
+	for(int k=0; k<PAIR_COUNT; ++k) expected.union_sets(pairs[k].first, pairs[k].second);
+
+	boost::thread_group threads;
+	for(int t=0; t<THREAD_COUNT; ++t)
+	{
+		int begin = t * PAIR_COUNT / THREAD_COUNT, end = (t+1) * PAIR_COUNT / THREAD_COUNT;
+		threads.create_thread(boost::bind(&union_random_pairs, &dsf, &pairs, begin, end));
+	}
+	threads.join_all();
+
+	// The sets must be the same as those produced sequentially, and each must be rooted at its smallest element.
+	BOOST_CHECK_EQUAL(dsf.set_count(), expected.set_count());
+	std::vector<int> smallest(SIZE, SIZE);
+	for(int i=0; i<SIZE; ++i)
+	{
+		int root = expected.find_set(i);
+		smallest[root] = std::min(smallest[root], i);
+	}
+	int mismatches = 0;
+	for(int i=0; i<SIZE; ++i)
+	{
+		if(dsf.find_set(i) != smallest[expected.find_set(i)]) ++mismatches;
+	}
+	BOOST_CHECK_EQUAL(mismatches, 0);
+}
@@ -0,0 +1,152 @@
+/***
+ * test-fastmarching: main.cpp
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#include <iostream>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <common/interfacemotion/FastMarching.h>
+#include <common/util/ITKImageUtil.h>
+using namespace mp;
+
+//#################### TYPEDEFS ####################
+typedef itk::Image<short,2> GradientMagnitudeImage;
+typedef std::list<itk::Index<2> > Indices;
+
+//#################### CONSTANTS ####################
+const int SIZE_X = 40, SIZE_Y = 9, WALL_X = 30;
+
+// The shapes expected at various times for a front propagating from (2,4) over the image made by make_gradient_magnitude_image()
+// (a '#' marks a voxel in the shape). Note that at time 2.0, the front has just passed (22,4): the time calculated for it is
+// 1.9999999999999958, which is in the first stop interval, [0,2].
+const char *SHAPE_AT_TIME_0[SIZE_Y] =
+{
+	"........................................",
+	"........................................",
+	"........................................",
+	"........................................",
+	"..#.....................................",
+	"........................................",
+	"........................................",
+	"........................................",
+	"........................................"
+};
+
+const char *SHAPE_AT_TIME_2[SIZE_Y] =
+{
+	"######################..................",
+	"######################..................",
+	"######################..................",
+	"######################..................",
+	"#######################.................",
+	"######################..................",
+	"######################..................",
+	"######################..................",
+	"######################.................."
+};
+
+const char *SHAPE_AT_TIME_4[SIZE_Y] =
+{
+	"##############################..........",
+	"##############################..........",
+	"##############################..........",
+	"##############################..........",
+	"##############################..........",
+	"##############################..........",
+	"##############################..........",
+	"##############################..........",
+	"##############################.........."
+};
+
+const char *SHAPE_AT_TIME_6[SIZE_Y] =
+{
+	"########################################",
+	"########################################",
+	"########################################",
+	"########################################",
+	"########################################",
+	"########################################",
+	"########################################",
+	"########################################",
+	"########################################"
+};
+
+//#################### HELPERS ####################
+bool check_shape(const std::string& name, const Indices& shape, const char *const *expectedRows)
+{
+	std::vector<std::string> rows(SIZE_Y, std::string(SIZE_X, '.'));
+	for(Indices::const_iterator it=shape.begin(), iend=shape.end(); it!=iend; ++it)
+	{
+		rows[(*it)[1]][(*it)[0]] = '#';
+	}
+
+	bool correct = true;
+	for(int y=0; y<SIZE_Y; ++y)
+	{
+		if(rows[y] != expectedRows[y]) correct = false;
+	}
+
+	std::cout << name << ": " << shape.size() << " voxels, " << (correct ? "correct" : "INCORRECT") << '\n';
+	if(!correct)
+	{
+		for(int y=0; y<SIZE_Y; ++y) std::cout << rows[y] << "   " << expectedRows[y] << '\n';
+	}
+	return correct;
+}
+
+FastMarching<2> make_fast_marching()
+{
+	// The gradient magnitude is zero everywhere except along a wall at x = WALL_X, so the front crosses each voxel of the
+	// flat regions in a time of about 0.1, but takes about 2.0 to cross the wall (see FastMarching::compute_new_time_at).
+	GradientMagnitudeImage::Pointer gradients = ITKImageUtil::make_image<short>(SIZE_X, SIZE_Y);
+	gradients->FillBuffer(0);
+	for(int y=0; y<SIZE_Y; ++y)
+	{
+		itk::Index<2> index = {{WALL_X, y}};
+		gradients->SetPixel(index, 3);
+	}
+
+	Indices seeds;
+	itk::Index<2> seed = {{2, 4}};
+	seeds.push_back(seed);
+
+	return FastMarching<2>(gradients, seeds);
+}
+
+//#################### TESTS ####################
+void shape_at_first_stop_test()
+{
+	FastMarching<2> fastMarching = make_fast_marching();
+
+	// The front passes 199 voxels in the first stop interval, 71 in the second (when it reaches the wall) and 90 in the third
+	// (when it crosses the wall and fills the region beyond it). The growth of the region during the first interval is deemed
+	// to include the 360 voxels of the image as well (see FastMarching::get_shape_at_first_stop), so it only falls below a
+	// threshold of 1000 in the interval ending at time 2.0: a threshold of 300 lies between 199 and 360 + 199, and so makes
+	// the search carry on to the interval ending at time 4.0 (as does a threshold of 100). The growth only falls below
+	// thresholds of 50 or 1 once there is nothing left for the front to pass (after time 6.0). In each case, the shape is
+	// the region at the end of the interval concerned.
+	check_shape("Shape at first stop (threshold 1000)", fastMarching.get_shape_at_first_stop(1000), SHAPE_AT_TIME_2);
+	check_shape("Shape at first stop (threshold 300)", fastMarching.get_shape_at_first_stop(300), SHAPE_AT_TIME_4);
+	check_shape("Shape at first stop (threshold 100)", fastMarching.get_shape_at_first_stop(100), SHAPE_AT_TIME_4);
+	check_shape("Shape at first stop (threshold 50)", fastMarching.get_shape_at_first_stop(50), SHAPE_AT_TIME_6);
+	check_shape("Shape at first stop (threshold 1)", fastMarching.get_shape_at_first_stop(1), SHAPE_AT_TIME_6);
+}
+
+void shape_at_time_test()
+{
+	FastMarching<2> fastMarching = make_fast_marching();
+	check_shape("Shape at time 0.0", fastMarching.get_shape_at_time(0.0), SHAPE_AT_TIME_0);
+	check_shape("Shape at time 2.0", fastMarching.get_shape_at_time(2.0), SHAPE_AT_TIME_2);
+	check_shape("Shape at time 4.0", fastMarching.get_shape_at_time(4.0), SHAPE_AT_TIME_4);
+	check_shape("Shape at time 6.0", fastMarching.get_shape_at_time(6.0), SHAPE_AT_TIME_6);
+}
+
+int main()
+{
+	shape_at_first_stop_test();
+	shape_at_time_test();
+	return 0;
+}
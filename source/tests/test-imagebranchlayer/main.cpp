@@ -0,0 +1,275 @@
+/***
+ * test-imagebranchlayer: main.cpp
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#include <cassert>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/shared_ptr.hpp>
+using boost::shared_ptr;
+
+#include <common/adts/RootedMST.h>
+#include <common/partitionforests/base/PartitionForest.h>
+#include <common/partitionforests/images/DenseImageBranchLayer.h>
+#include <common/partitionforests/images/SimpleImageBranchLayer.h>
+#include <common/partitionforests/images/SimpleImageLeafLayer.h>
+using namespace mp;
+
+//#################### TYPEDEFS ####################
+typedef DenseImageBranchLayer<SimpleRegionProperties> DenseSimpleImageBranchLayer;
+
+//#################### HELPERS ####################
+struct EdgeCollector
+{
+	std::vector<WeightedEdge<int> > edges;
+
+	void operator()(const WeightedEdge<int>& e)
+	{
+		edges.push_back(e);
+	}
+};
+
+struct EdgeChecksummer
+{
+	long checksum;
+
+	EdgeChecksummer() : checksum(0) {}
+
+	template <typename Edge>
+	void operator()(const Edge& e)
+	{
+		checksum += e.u ^ e.v ^ e.weight;
+	}
+};
+
+struct NodeChecksummer
+{
+	long checksum;
+
+	NodeChecksummer() : checksum(0) {}
+
+	void operator()(int n, int parent)
+	{
+		checksum += n + parent;
+	}
+};
+
+class Stopwatch
+{
+private:
+	boost::posix_time::ptime m_start;
+public:
+	Stopwatch() : m_start(boost::posix_time::microsec_clock::universal_time()) {}
+
+	double elapsed_ms() const
+	{
+		return (boost::posix_time::microsec_clock::universal_time() - m_start).total_microseconds() / 1000.0;
+	}
+};
+
+void report(const std::string& layerName, const std::string& phase, double ms, long checksum)
+{
+	std::cout << std::left << std::setw(24) << layerName << std::setw(28) << phase << std::right << std::setw(10) << std::fixed << std::setprecision(1) << ms << " ms"
+			  << "   (checksum " << checksum << ")\n";
+}
+
+bool same_edges(const std::vector<WeightedEdge<int> >& lhs, const std::vector<WeightedEdge<int> >& rhs)
+{
+	if(lhs.size() != rhs.size()) return false;
+	for(size_t i=0, size=lhs.size(); i<size; ++i)
+	{
+		if(lhs[i].u != rhs[i].u || lhs[i].v != rhs[i].v || lhs[i].weight != rhs[i].weight) return false;
+	}
+	return true;
+}
+
+shared_ptr<SimpleImageLeafLayer> make_leaf_layer(int sizeX, int sizeY, int sizeZ)
+{
+	// Fill the leaf layer with deterministic pseudo-random values, so that both layer types see exactly the same input.
+	std::vector<SimplePixelProperties> leafProperties;
+	leafProperties.reserve(sizeX * sizeY * sizeZ);
+	unsigned int seed = 12345;
+	for(int i=0, count=sizeX*sizeY*sizeZ; i<count; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		leafProperties.push_back(SimplePixelProperties((seed >> 16) % 256));
+	}
+	return shared_ptr<SimpleImageLeafLayer>(new SimpleImageLeafLayer(leafProperties, sizeX, sizeY, sizeZ));
+}
+
+std::vector<std::set<int> > make_block_groups(int sizeX, int sizeY, int sizeZ, int blockSize)
+{
+	std::vector<std::set<int> > groups;
+	for(int bz=0; bz<sizeZ; bz+=blockSize)
+		for(int by=0; by<sizeY; by+=blockSize)
+			for(int bx=0; bx<sizeX; bx+=blockSize)
+			{
+				std::set<int> group;
+				for(int z=bz; z<bz+blockSize && z<sizeZ; ++z)
+					for(int y=by; y<by+blockSize && y<sizeY; ++y)
+						for(int x=bx; x<bx+blockSize && x<sizeX; ++x)
+						{
+							group.insert((z * sizeY + y) * sizeX + x);
+						}
+				groups.push_back(group);
+			}
+	return groups;
+}
+
+//#################### BENCHMARKS ####################
+void benchmark_leaf_layer(const shared_ptr<SimpleImageLeafLayer>& leafLayer)
+{
+	typedef SimpleImageLeafLayer::EdgeConstIterator EdgeConstIterator;
+
+	// Iterate over all the edges in the leaf layer.
+	Stopwatch sw;
+	long checksum = 0;
+	EdgeCollector iteratorEdges;
+	for(EdgeConstIterator it=leafLayer->edges_cbegin(), iend=leafLayer->edges_cend(); it!=iend; ++it)
+	{
+		checksum += it->u ^ it->v ^ it->weight;
+		iteratorEdges(*it);
+	}
+	report("ImageLeafLayer", "edge iteration", sw.elapsed_ms(), checksum);
+
+	// Traverse the same edges using the layer's native for_each_edge() (which uses fill_edge_block()) and, via the layer
+	// interface, using the block-based version. Both should visit exactly the same edges in the same order as the iterator.
+	sw = Stopwatch();
+	long nativeChecksum = leafLayer->for_each_edge(EdgeChecksummer()).checksum;
+	report("ImageLeafLayer", "for_each_edge (native)", sw.elapsed_ms(), nativeChecksum);
+
+	const IForestLayer<SimpleRegionProperties,int>& ilf = *leafLayer;
+	sw = Stopwatch();
+	long blockChecksum = ilf.for_each_edge(EdgeChecksummer()).checksum;
+	report("ImageLeafLayer", "for_each_edge (blocks)", sw.elapsed_ms(), blockChecksum);
+
+	assert(nativeChecksum == checksum && blockChecksum == checksum);
+	assert(same_edges(leafLayer->for_each_edge(EdgeCollector()).edges, iteratorEdges.edges));
+	assert(same_edges(ilf.for_each_edge(EdgeCollector()).edges, iteratorEdges.edges));
+
+	std::cout << '\n';
+}
+
+template <typename BranchLayer>
+void benchmark(const std::string& layerName, const shared_ptr<SimpleImageLeafLayer>& leafLayer, const std::vector<std::set<int> >& groups, int lookupCount)
+{
+	typedef PartitionForest<SimpleImageLeafLayer,BranchLayer> IPF;
+	typedef typename BranchLayer::Edge Edge;
+
+	// Construct the lowest branch layer.
+	Stopwatch sw;
+	shared_ptr<BranchLayer> lowestBranchLayer = IPF::make_lowest_branch_layer(leafLayer, groups);
+	report(layerName, "make_lowest_branch_layer", sw.elapsed_ms(), lowestBranchLayer->node_count());
+
+	IPF ipf(leafLayer, lowestBranchLayer);
+
+	// Clone the lowest branch layer (this exercises node/edge iteration and insertion).
+	sw = Stopwatch();
+	ipf.clone_layer(1);
+	report(layerName, "clone_layer", sw.elapsed_ms(), ipf.branch_layer(2)->node_count());
+
+	// Iterate over all the edges in the layer.
+	sw = Stopwatch();
+	long checksum = 0;
+	for(typename IPF::EdgeConstIterator it=lowestBranchLayer->edges_cbegin(), iend=lowestBranchLayer->edges_cend(); it!=iend; ++it)
+	{
+		checksum += it->u ^ it->v ^ it->weight;
+	}
+	report(layerName, "edge iteration", sw.elapsed_ms(), checksum);
+
+	// Traverse the same edges using the layer's native for_each_edge() and, via the layer interface, using the block-based version.
+	// Note:	Each traversal is timed before calling report(), since the order in which its arguments are evaluated is unspecified.
+	sw = Stopwatch();
+	long nativeEdgeChecksum = lowestBranchLayer->for_each_edge(EdgeChecksummer()).checksum;
+	report(layerName, "for_each_edge (native)", sw.elapsed_ms(), nativeEdgeChecksum);
+
+	const IForestLayer<SimpleRegionProperties,int>& ibl = *lowestBranchLayer;
+	sw = Stopwatch();
+	long blockEdgeChecksum = ibl.for_each_edge(EdgeChecksummer()).checksum;
+	report(layerName, "for_each_edge (blocks)", sw.elapsed_ms(), blockEdgeChecksum);
+
+	sw = Stopwatch();
+	long nativeNodeChecksum = lowestBranchLayer->for_each_node(NodeChecksummer()).checksum;
+	report(layerName, "for_each_node (native)", sw.elapsed_ms(), nativeNodeChecksum);
+
+	sw = Stopwatch();
+	long blockNodeChecksum = ibl.for_each_node(NodeChecksummer()).checksum;
+	report(layerName, "for_each_node (blocks)", sw.elapsed_ms(), blockNodeChecksum);
+
+	assert(nativeEdgeChecksum == checksum && blockEdgeChecksum == checksum);
+	assert(nativeNodeChecksum == blockNodeChecksum);
+
+	// Perform random lookups of parents, children and edge weights.
+	std::vector<int> nodes = lowestBranchLayer->node_indices();
+	sw = Stopwatch();
+	checksum = 0;
+	unsigned int seed = 54321;
+	for(int i=0; i<lookupCount; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		int n = nodes[(seed >> 8) % nodes.size()];
+		checksum += lowestBranchLayer->node_parent(n);
+		checksum += static_cast<long>(lowestBranchLayer->node_children(n).size());
+		std::vector<int> adjacentNodes = lowestBranchLayer->adjacent_nodes(n);
+		for(std::vector<int>::const_iterator jt=adjacentNodes.begin(), jend=adjacentNodes.end(); jt!=jend; ++jt)
+		{
+			checksum += lowestBranchLayer->edge_weight(n, *jt);
+		}
+	}
+	report(layerName, "random lookups", sw.elapsed_ms(), checksum);
+
+	// Construct a rooted MST from the lowest branch layer (as the waterfall does).
+	sw = Stopwatch();
+	RootedMST<int> mst(*lowestBranchLayer);
+	report(layerName, "RootedMST construction (Prim)", sw.elapsed_ms(), mst.node_count());
+
+	sw = Stopwatch();
+	RootedMST<int> kruskalMST(*lowestBranchLayer, RootedMST<int>::ALGORITHM_KRUSKAL);
+	report(layerName, "RootedMST construction (Kruskal)", sw.elapsed_ms(), kruskalMST.node_count());
+
+	// Merge disjoint pairs of adjacent sibling nodes in the highest layer.
+	sw = Stopwatch();
+	shared_ptr<BranchLayer> layer = ipf.branch_layer(2);
+	std::vector<int> layerNodes = layer->node_indices();
+	std::set<int> used;
+	for(std::vector<int>::const_iterator it=layerNodes.begin(), iend=layerNodes.end(); it!=iend; ++it)
+	{
+		if(used.find(*it) != used.end()) continue;
+		std::vector<int> adjacentNodes = layer->adjacent_nodes(*it);
+		for(std::vector<int>::const_iterator jt=adjacentNodes.begin(), jend=adjacentNodes.end(); jt!=jend; ++jt)
+		{
+			if(used.find(*jt) != used.end()) continue;
+
+			std::set<PFNodeID> mergees;
+			mergees.insert(PFNodeID(2, *it));
+			mergees.insert(PFNodeID(2, *jt));
+			ipf.merge_sibling_nodes(mergees);
+			used.insert(*it);
+			used.insert(*jt);
+			break;
+		}
+	}
+	report(layerName, "merge_sibling_nodes", sw.elapsed_ms(), layer->node_count());
+
+	std::cout << '\n';
+}
+
+int main()
+{
+	const int SIZE_X = 64, SIZE_Y = 64, SIZE_Z = 32, BLOCK_SIZE = 2, LOOKUP_COUNT = 200000;
+
+	shared_ptr<SimpleImageLeafLayer> leafLayer = make_leaf_layer(SIZE_X, SIZE_Y, SIZE_Z);
+	std::vector<std::set<int> > groups = make_block_groups(SIZE_X, SIZE_Y, SIZE_Z, BLOCK_SIZE);
+
+	std::cout << "Volume: " << SIZE_X << 'x' << SIZE_Y << 'x' << SIZE_Z << ", lowest branch layer nodes: " << groups.size() << "\n\n";
+
+	benchmark_leaf_layer(leafLayer);
+	benchmark<SimpleImageBranchLayer>("ImageBranchLayer", leafLayer, groups, LOOKUP_COUNT);
+	benchmark<DenseSimpleImageBranchLayer>("DenseImageBranchLayer", leafLayer, groups, LOOKUP_COUNT);
+
+	return 0;
+}
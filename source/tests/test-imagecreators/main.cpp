@@ -0,0 +1,154 @@
+/***
+ * test-imagecreators: main.cpp
+ * Added by Varduhi Yeghiazaryan, 2013.
+ ***/
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/shared_ptr.hpp>
+using boost::shared_ptr;
+
+#include <common/jobs/ParallelJob.h>
+#include <common/partitionforests/images/AbdominalFeature.h>
+#include <common/partitionforests/images/DICOMImageBranchLayer.h>
+#include <common/partitionforests/images/DICOMImageLeafLayer.h>
+#include <common/partitionforests/images/LabelImageCreator.h>
+#include <common/partitionforests/images/MosaicImageCreator.h>
+#include <common/partitionforests/images/VolumeIPFMultiFeatureSelection.h>
+using namespace mp;
+
+//#################### TYPEDEFS ####################
+typedef VolumeIPF<DICOMImageLeafLayer,DICOMImageBranchLayer> VolumeIPFT;
+typedef shared_ptr<VolumeIPFT> VolumeIPF_Ptr;
+typedef VolumeIPFMultiFeatureSelection<DICOMImageLeafLayer,DICOMImageBranchLayer,AbdominalFeature::Enum> VolumeIPFMultiFeatureSelectionT;
+typedef shared_ptr<VolumeIPFMultiFeatureSelectionT> VolumeIPFMultiFeatureSelection_Ptr;
+
+//#################### HELPERS ####################
+class Stopwatch
+{
+private:
+	boost::posix_time::ptime m_start;
+public:
+	Stopwatch() : m_start(boost::posix_time::microsec_clock::universal_time()) {}
+
+	double elapsed_ms() const
+	{
+		return (boost::posix_time::microsec_clock::universal_time() - m_start).total_microseconds() / 1000.0;
+	}
+};
+
+template <typename ImagePointer>
+long checksum(const ImagePointer& image)
+{
+	long result = 0;
+	const typename ImagePointer::ObjectType::PixelType *p = image->GetBufferPointer();
+	for(int i=0, count=static_cast<int>(image->GetLargestPossibleRegion().GetNumberOfPixels()); i<count; ++i)
+	{
+		result = result * 31 + p[i];
+	}
+	return result;
+}
+
+void report(const std::string& name, int threadCount, double ms, int voxelCount, long sum)
+{
+	std::cout << std::left << std::setw(40) << name << std::right << std::setw(3) << threadCount << " threads"
+			  << std::setw(10) << std::fixed << std::setprecision(1) << ms << " ms"
+			  << std::setw(10) << std::setprecision(1) << voxelCount / (ms * 1000.0) << " Mvoxels/s"
+			  << "   (checksum " << sum << ")\n";
+}
+
+VolumeIPF_Ptr make_synthetic_forest(int sizeX, int sizeY, int sizeZ, int blockSize)
+{
+	// Fill the leaf layer with deterministic pseudo-random values.
+	std::vector<DICOMPixelProperties> leafProperties;
+	leafProperties.reserve(sizeX * sizeY * sizeZ);
+	unsigned int seed = 12345;
+	for(int i=0, count=sizeX*sizeY*sizeZ; i<count; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		int value = (seed >> 16) % 256;
+		leafProperties.push_back(DICOMPixelProperties(value, static_cast<short>(value), static_cast<unsigned char>(value)));
+	}
+	shared_ptr<DICOMImageLeafLayer> leafLayer(new DICOMImageLeafLayer(leafProperties, sizeX, sizeY, sizeZ));
+
+	// Group the leaves into cubic blocks to make the lowest branch layer.
+	std::vector<std::set<int> > groups;
+	for(int bz=0; bz<sizeZ; bz+=blockSize)
+		for(int by=0; by<sizeY; by+=blockSize)
+			for(int bx=0; bx<sizeX; bx+=blockSize)
+			{
+				std::set<int> group;
+				for(int z=bz; z<bz+blockSize && z<sizeZ; ++z)
+					for(int y=by; y<by+blockSize && y<sizeY; ++y)
+						for(int x=bx; x<bx+blockSize && x<sizeX; ++x)
+						{
+							group.insert((z * sizeY + y) * sizeX + x);
+						}
+				groups.push_back(group);
+			}
+	shared_ptr<DICOMImageBranchLayer> lowestBranchLayer = VolumeIPFT::make_lowest_branch_layer(leafLayer, groups);
+
+	itk::Size<3> volumeSize = {{sizeX, sizeY, sizeZ}};
+	return VolumeIPF_Ptr(new VolumeIPFT(volumeSize, leafLayer, lowestBranchLayer));
+}
+
+//#################### BENCHMARKS ####################
+void benchmark_label_image_creator(const VolumeIPF_Ptr& volumeIPF, int threadCount)
+{
+	// Identify every seventh block as liver, and every eleventh one as kidney (some of the blocks are both).
+	VolumeIPFMultiFeatureSelection_Ptr mfs(new VolumeIPFMultiFeatureSelectionT(volumeIPF));
+	shared_ptr<const DICOMImageBranchLayer> layer = volumeIPF->branch_layer(1);
+	int k = 0;
+	for(DICOMImageBranchLayer::BranchNodeConstIterator it=layer->branch_nodes_cbegin(), iend=layer->branch_nodes_cend(); it!=iend; ++it, ++k)
+	{
+		if(k % 7 == 0) mfs->identify_node(PFNodeID(1, it.index()), AbdominalFeature::LIVER);
+		if(k % 11 == 0) mfs->identify_node(PFNodeID(1, it.index()), AbdominalFeature::KIDNEY);
+	}
+
+	LabelImageCreator<DICOMImageLeafLayer,DICOMImageBranchLayer,AbdominalFeature::Enum> creator(mfs, threadCount);
+	Stopwatch stopwatch;
+	creator.execute();
+	double ms = stopwatch.elapsed_ms();
+
+	int voxelCount = static_cast<int>(volumeIPF->leaf_layer()->node_count());
+	report("LabelImageCreator", threadCount, ms, voxelCount, checksum(creator.get_labelling_hook().get()));
+}
+
+void benchmark_mosaic_image_creator(const VolumeIPF_Ptr& volumeIPF, int layerIndex, bool withBoundaries, int threadCount)
+{
+	MosaicImageCreator<DICOMImageLeafLayer,DICOMImageBranchLayer> creator(volumeIPF, layerIndex, ORIENT_XY, withBoundaries, threadCount);
+	Stopwatch stopwatch;
+	creator.execute();
+	double ms = stopwatch.elapsed_ms();
+
+	std::ostringstream oss;
+	oss << "MosaicImageCreator (layer " << layerIndex << (withBoundaries ? ", boundaries)" : ")");
+	int voxelCount = static_cast<int>(volumeIPF->leaf_layer()->node_count());
+	report(oss.str(), threadCount, ms, voxelCount, checksum(creator.get_mosaic_image_hook().get()));
+}
+
+int main()
+{
+	const int SIZE = 192;
+	VolumeIPF_Ptr volumeIPF = make_synthetic_forest(SIZE, SIZE, SIZE, 4);
+
+	// Build the label volume for the branch layer up-front, so that it is shared between all the runs below.
+	volumeIPF->layer_labels(1);
+
+	int threadCounts[] = { 1, ParallelJob::default_thread_count() };
+	for(int i=0; i<2; ++i)
+	{
+		int threadCount = threadCounts[i];
+		benchmark_mosaic_image_creator(volumeIPF, 0, false, threadCount);
+		benchmark_mosaic_image_creator(volumeIPF, 0, true, threadCount);
+		benchmark_mosaic_image_creator(volumeIPF, 1, false, threadCount);
+		benchmark_mosaic_image_creator(volumeIPF, 1, true, threadCount);
+		benchmark_label_image_creator(volumeIPF, threadCount);
+	}
+
+	return 0;
+}
@@ -1,6 +1,7 @@
 /***
  * test-jobs: main.cpp
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #include <iostream>
@@ -11,6 +12,7 @@
 #include <common/io/util/OSSWrapper.h>
 #include <common/jobs/CompositeJob.h>
 #include <common/jobs/DataHook.h>
+#include <common/jobs/JobGraph.h>
 #include <common/jobs/MainThreadJobQueue.h>
 #include <common/jobs/SimpleJob.h>
 using namespace mp;
@@ -250,9 +252,66 @@ public:
 void test3()
 {
 	boost::shared_ptr<OverallJob> job(new OverallJob);
+	job->set_input(84);
 	Job::execute_in_thread(job);
+	job->wait_until_stopped();
+	std::cout << job->get_output() << '\n';
+}
+
+//#################### TEST 4 ####################
+class SumJob : public SimpleJob
+{
+private:
+	DataHook<double> m_lhs;
+	DataHook<double> m_output;
+	DataHook<double> m_rhs;
+public:
+	DataHook<double> get_output_hook() const			{ return m_output; }
+	int length() const									{ return 1; }
+	void set_input_hooks(const DataHook<double>& lhs, const DataHook<double>& rhs)	{ m_lhs = lhs; m_rhs = rhs; }
+private:
+	void execute_impl()									{ m_output.set(m_lhs.get() + m_rhs.get()); }
+};
+
+class OverallGraphJob : public JobGraph
+{
+private:
+	DataHook<int> m_input;
+	DataHook<double> m_output;
+public:
+	OverallGraphJob()
+	:	JobGraph(2)
+	{
+		// A feeds both B1 and B2 (which may run at the same time, B2 in the main thread), and D combines their outputs.
+		InitialJob *jobA = new InitialJob;
+		IntermediateJob *jobB1 = new IntermediateJob;
+		IntermediateJob *jobB2 = new IntermediateJob;
+		SumJob *jobD = new SumJob;
+		jobA->set_input_hook(m_input);
+		jobB1->set_input_hook(jobA->get_output_hook());
+		jobB2->set_input_hook(jobA->get_output_hook());
+		jobD->set_input_hooks(jobB1->get_output_hook(), jobB2->get_output_hook());
+		m_output = jobD->get_output_hook();
+
+		int a = add_subjob(jobA);
+		int b1 = add_subjob(jobB1);
+		int b2 = add_main_thread_subjob(jobB2);
+		int d = add_subjob(jobD);
+		add_dependency(a, b1);
+		add_dependency(a, b2);
+		add_dependency(b1, d);
+		add_dependency(b2, d);
+	}
+
+	double get_output() const	{ return m_output.get(); }
+	void set_input(int input)	{ m_input.set(input); }
+};
+
+void test4()
+{
+	boost::shared_ptr<OverallGraphJob> job(new OverallGraphJob);
 	job->set_input(84);
-	while(!job->is_finished());
+	Job::execute_managed(job);
 	std::cout << job->get_output() << '\n';
 }
 
@@ -261,5 +320,6 @@ int main()
 	//test1();
 	//test2();
 	test3();
+	test4();
 	return 0;
 }
@@ -1,18 +1,30 @@
 /***
  * test-meshbuilder: main.cpp
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
+#include <iostream>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <common/jobs/ParallelJob.h>
 #include <common/partitionforests/images/AbdominalFeature.h>
 #include <common/util/ITKImageUtil.h>
+#include <common/visualization/CompactMesh.h>
 #include <common/visualization/LaplacianSmoother.h>
 #include <common/visualization/MeshBuilder.h>
 #include <common/visualization/MeshDecimator.h>
 #include <common/visualization/MeshRenderer.h>
+#include <common/visualization/MeshUtil.h>
 using namespace mp;
 
 //#################### TYPEDEFS ####################
 typedef int Label;
+typedef CompactMesh<Label> CompactMeshT;
 typedef LaplacianSmoother<Label> LaplacianSmootherT;
 typedef Mesh<Label> MeshT;
 typedef boost::shared_ptr<MeshT> Mesh_Ptr;
@@ -20,7 +32,272 @@ typedef MeshBuilder<Label> MeshBuilderT;
 typedef boost::shared_ptr<MeshBuilderT> MeshBuilder_Ptr;
 typedef MeshDecimator<Label> MeshDecimatorT;
 
+//#################### HELPERS ####################
+std::vector<int> canonical_face(int i, int j, int k, Label label1, Label label2)
+{
+	// Rotate the node indices so that the smallest comes first (this preserves the winding order), then append the labels.
+	std::vector<int> face;
+	if(i < j && i < k)	{ face.push_back(i); face.push_back(j); face.push_back(k); }
+	else if(j < k)		{ face.push_back(j); face.push_back(k); face.push_back(i); }
+	else				{ face.push_back(k); face.push_back(i); face.push_back(j); }
+	face.push_back(label1);
+	face.push_back(label2);
+	return face;
+}
+
+void mesh_util_smooth(MeshT& mesh, double lambda, int iterations)
+{
+	// Smooth the mesh in the way that LaplacianSmoother originally did, classifying every node using MeshUtil on each iteration.
+	std::vector<MeshNode<Label> >& nodes = mesh.nodes();
+	int nodeCount = static_cast<int>(nodes.size());
+	for(int iteration=0; iteration<iterations; ++iteration)
+	{
+		std::vector<Vector3d> newPositions(nodeCount);
+		for(int i=0; i<nodeCount; ++i)
+		{
+			newPositions[i] = nodes[i].position();
+
+			std::set<int> neighbours;
+			if(MeshUtil::classify_node(i, nodes, neighbours) == MeshNodeType::CORNER) continue;
+			for(std::set<int>::const_iterator jt=neighbours.begin(), jend=neighbours.end(); jt!=jend; ++jt)
+			{
+				Vector3d offset = nodes[*jt].position() - nodes[i].position();
+				offset *= lambda / neighbours.size();
+				newPositions[i] += offset;
+			}
+		}
+
+		for(int i=0; i<nodeCount; ++i)
+		{
+			nodes[i].set_position(newPositions[i]);
+		}
+	}
+}
+
+MeshBuilderT::LabelImagePointer make_blobby_labelling(int size, int labelCount, int blobSize)
+{
+	// Assign a deterministic pseudo-random label to each cubic blob of voxels.
+	MeshBuilderT::LabelImagePointer labelling = ITKImageUtil::make_image<Label>(size, size, size);
+	for(int z=0; z<size; ++z)
+		for(int y=0; y<size; ++y)
+			for(int x=0; x<size; ++x)
+			{
+				unsigned int h = (x/blobSize) * 73856093u ^ (y/blobSize) * 19349663u ^ (z/blobSize) * 83492791u;
+				h = h * 2654435761u;
+				h ^= h >> 13;
+				itk::Index<3> index = {{x, y, z}};
+				labelling->SetPixel(index, (h >> 7) % labelCount);
+			}
+	return labelling;
+}
+
+bool same_topology(const MeshT& lhs, const MeshT& rhs)
+{
+	const std::vector<MeshNode<Label> >& lhsNodes = lhs.nodes();
+	const std::vector<MeshNode<Label> >& rhsNodes = rhs.nodes();
+	if(lhsNodes.size() != rhsNodes.size()) return false;
+	for(size_t i=0, size=lhsNodes.size(); i<size; ++i)
+	{
+		if(lhsNodes[i].position() != rhsNodes[i].position()) return false;
+		if(lhsNodes[i].labels() != rhsNodes[i].labels()) return false;
+		if(lhsNodes[i].adjacent_nodes() != rhsNodes[i].adjacent_nodes()) return false;
+	}
+
+	const std::list<MeshTriangle<Label> >& lhsTriangles = lhs.triangles();
+	const std::list<MeshTriangle<Label> >& rhsTriangles = rhs.triangles();
+	if(lhsTriangles.size() != rhsTriangles.size()) return false;
+	for(std::list<MeshTriangle<Label> >::const_iterator it=lhsTriangles.begin(), jt=rhsTriangles.begin(), iend=lhsTriangles.end(); it!=iend; ++it, ++jt)
+	{
+		for(int k=0; k<3; ++k)
+		{
+			if(it->index(k) != jt->index(k)) return false;
+		}
+		if(it->labels() != jt->labels()) return false;
+	}
+
+	return true;
+}
+
 //#################### FUNCTIONS ####################
+void test_parallel()
+{
+	// Build the same mesh using different numbers of threads: the results should be identical,
+	// since the slabs are stitched together in the order in which a serial build would visit them.
+	MeshBuilderT::LabelImagePointer labelling = make_blobby_labelling(64, 5, 4);
+
+	Mesh_Ptr serialMesh;
+	int threadCounts[] = { 1, 4, ParallelJob::default_thread_count() };
+	for(int i=0; i<3; ++i)
+	{
+		MeshBuilderT builder(labelling->GetLargestPossibleRegion().GetSize(), labelling, threadCounts[i]);
+		boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+		builder.execute();
+		boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+
+		Mesh_Ptr mesh = builder.get_mesh();
+		std::cout << threadCounts[i] << " thread(s): " << elapsed.total_milliseconds() << " ms, "
+				  << mesh->nodes().size() << " nodes, " << mesh->triangles().size() << " triangles";
+		if(serialMesh) std::cout << (same_topology(*mesh, *serialMesh) ? " (matches the serial mesh)" : " (DIFFERS FROM THE SERIAL MESH)");
+		else serialMesh = mesh;
+		std::cout << std::endl;
+	}
+}
+
+void test_original_builder()
+{
+	// Check the mesh against the one that the original builder (which ran a separate job for each cube face and each cube)
+	// produced for the same labelling, for several thread counts. The labelling is chosen so that the mesh spans more than
+	// one slab and contains a cube-centre node (node 37).
+	Label pixels[] = {
+		2,2,1,
+		2,1,1,
+		1,2,0,
+
+		2,1,1,
+		1,1,1,
+		1,0,2,
+
+		1,1,0,
+		0,1,1,
+		0,2,2,
+	};
+	MeshBuilderT::LabelImagePointer labelling = ITKImageUtil::make_filled_image<Label>(3, 3, 3, pixels);
+
+	const double expectedPositions[][3] = {
+		{0.5,1,0}, {1,0.5,0}, {0,0.5,1}, {0.5,0,1}, {0.5,1,2}, {0,0.5,2},
+		{0.5,2,0}, {0,1.5,0}, {1,1.5,0}, {0.5,2,1}, {1,1.5,1}, {0.5,2,2},
+		{0.5,1.5,2}, {1,1.5,2}, {1.5,0,0}, {2,0.5,2}, {1.5,0,2}, {1.5,2,0},
+		{1.5,1.5,0}, {2,1.5,0}, {1.5,2,1}, {1.5,1.5,1}, {2,1.5,1}, {2,1.5,2},
+		{1,0,0.5}, {0,0,1.5}, {0,1,0.5}, {0,1,1.5}, {0.5,2,0.5}, {1,2,0.5},
+		{0,2,1.5}, {1,2,1.5}, {2,0,1.5}, {2,2,0.5}, {1,1.5,0.5}, {1,1.5,1.5},
+		{2,1.5,0.5}, {1.5,1.5,0.5}
+	};
+	const int expectedNodeCount = sizeof(expectedPositions) / sizeof(expectedPositions[0]);
+
+	// Each triangle is given as its three node indices (in winding order), followed by its two labels.
+	const int expectedTriangles[][5] = {
+		{0,1,24,1,2}, {24,3,0,1,2}, {3,2,26,1,2}, {26,0,3,1,2}, {1,14,24,1,2}, {7,0,26,1,2},
+		{34,8,28,1,2}, {6,28,8,1,2}, {10,9,34,0,1}, {28,34,9,0,1}, {28,29,34,0,2}, {8,37,18,1,2},
+		{37,21,22,1,2}, {37,22,36,1,2}, {34,37,8,1,2}, {10,37,21,0,1}, {37,18,19,0,1}, {37,19,36,0,1},
+		{34,37,10,0,1}, {37,17,18,0,2}, {37,21,20,0,2}, {20,37,33,0,2}, {33,37,36,0,2}, {37,34,29,0,2},
+		{37,29,17,0,2}, {2,3,25,1,2}, {4,5,27,0,1}, {16,15,32,0,1}, {10,35,9,0,1}, {12,9,35,0,1},
+		{4,27,12,0,1}, {9,12,30,0,1}, {27,30,12,0,1}, {11,12,35,0,2}, {35,31,11,0,2}, {12,13,35,1,2},
+		{10,21,35,0,1}, {23,22,21,1,2}, {35,13,23,1,2}, {23,21,35,1,2}, {21,20,35,0,2}, {31,35,20,0,2}
+	};
+	const int expectedTriangleCount = sizeof(expectedTriangles) / sizeof(expectedTriangles[0]);
+
+	std::set<std::vector<int> > expectedFaces;
+	for(int i=0; i<expectedTriangleCount; ++i)
+	{
+		expectedFaces.insert(canonical_face(expectedTriangles[i][0], expectedTriangles[i][1], expectedTriangles[i][2], expectedTriangles[i][3], expectedTriangles[i][4]));
+	}
+
+	int threadCounts[] = { 1, 2, 4 };
+	for(int i=0; i<3; ++i)
+	{
+		MeshBuilderT builder(labelling->GetLargestPossibleRegion().GetSize(), labelling, threadCounts[i]);
+		builder.execute();
+		Mesh_Ptr mesh = builder.get_mesh();
+
+		const std::vector<MeshNode<Label> >& nodes = mesh->nodes();
+		bool samePositions = static_cast<int>(nodes.size()) == expectedNodeCount;
+		for(int j=0; samePositions && j<expectedNodeCount; ++j)
+		{
+			samePositions = nodes[j].position() == Vector3d(expectedPositions[j][0], expectedPositions[j][1], expectedPositions[j][2]);
+		}
+
+		std::set<std::vector<int> > faces;
+		for(std::list<MeshTriangle<Label> >::const_iterator it=mesh->triangles().begin(), iend=mesh->triangles().end(); it!=iend; ++it)
+		{
+			const std::set<Label>& labels = it->labels();
+			if(labels.size() != 2) faces.insert(std::vector<int>());		// no triangle in the expected mesh has other than two labels
+			else faces.insert(canonical_face(it->index(0), it->index(1), it->index(2), *labels.begin(), *labels.rbegin()));
+		}
+		bool sameFaces = static_cast<int>(mesh->triangles().size()) == expectedTriangleCount && faces == expectedFaces;
+
+		std::cout << threadCounts[i] << " thread(s): node positions " << (samePositions ? "match" : "DIFFER FROM") << " the original builder's, "
+				  << "faces " << (sameFaces ? "match" : "DIFFER FROM") << " the original builder's" << std::endl;
+	}
+}
+
+void test_mesh_util_equivalence()
+{
+	// Check that CompactMesh classifies every node (and chooses its Laplacian neighbours) in the same way as MeshUtil,
+	// and that LaplacianSmoother moves every node to the same position as the original MeshUtil-based smoothing.
+	MeshBuilderT::LabelImagePointer labelling = make_blobby_labelling(24, 5, 3);
+	MeshBuilderT builder(labelling->GetLargestPossibleRegion().GetSize(), labelling);
+	builder.execute();
+	Mesh_Ptr mesh = builder.get_mesh();
+	MeshT referenceMesh = *mesh;
+
+	const std::vector<MeshNode<Label> >& nodes = mesh->nodes();
+	int nodeCount = static_cast<int>(nodes.size());
+	CompactMeshT compactMesh(*mesh);
+	int mismatches = 0;
+	std::map<MeshNodeType::Enum,int> typeCounts;
+	for(int i=0; i<nodeCount; ++i)
+	{
+		std::vector<int> compactNeighbours;
+		MeshNodeType::Enum compactType = compactMesh.classify_node(i, &compactNeighbours);
+
+		std::set<int> neighbours;
+		MeshNodeType::Enum type = MeshUtil::classify_node(i, nodes, neighbours);
+
+		if(compactType != type || std::set<int>(compactNeighbours.begin(), compactNeighbours.end()) != neighbours) ++mismatches;
+		++typeCounts[type];
+	}
+	std::cout << "Classified " << nodeCount << " nodes (" << typeCounts[MeshNodeType::SIMPLE] << " simple, " << typeCounts[MeshNodeType::EDGE] << " edge, "
+			  << typeCounts[MeshNodeType::CORNER] << " corner): " << mismatches << " differ(s) from MeshUtil" << std::endl;
+
+	LaplacianSmootherT smoother(0.5, 6, 4);
+	smoother.set_mesh(mesh);
+	smoother.execute();
+	mesh_util_smooth(referenceMesh, 0.5, 6);
+
+	const std::vector<MeshNode<Label> >& referenceNodes = referenceMesh.nodes();
+	mismatches = 0;
+	for(int i=0; i<nodeCount; ++i)
+	{
+		if(nodes[i].position() != referenceNodes[i].position()) ++mismatches;
+	}
+	std::cout << "Smoothed " << nodeCount << " nodes: " << mismatches << " position(s) differ from the MeshUtil-based smoothing" << std::endl;
+}
+
+void test_parallel_smoothing()
+{
+	// Smooth the same mesh using different numbers of threads: the node positions should be identical,
+	// since each node's new position depends only on the old positions of its neighbours.
+	MeshBuilderT::LabelImagePointer labelling = make_blobby_labelling(48, 5, 3);
+
+	std::vector<MeshNode<Label> > serialNodes;
+	int threadCounts[] = { 1, 4, ParallelJob::default_thread_count() };
+	for(int i=0; i<3; ++i)
+	{
+		MeshBuilderT builder(labelling->GetLargestPossibleRegion().GetSize(), labelling);
+		builder.execute();
+
+		LaplacianSmootherT smoother(0.5, 6, threadCounts[i]);
+		smoother.set_mesh(builder.get_mesh());
+		boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+		smoother.execute();
+		boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+
+		const std::vector<MeshNode<Label> >& nodes = builder.get_mesh()->nodes();
+		std::cout << threadCounts[i] << " thread(s): smoothed " << nodes.size() << " nodes in " << elapsed.total_milliseconds() << " ms";
+		if(i > 0)
+		{
+			bool same = nodes.size() == serialNodes.size();
+			for(size_t j=0, size=nodes.size(); same && j<size; ++j)
+			{
+				same = nodes[j].position() == serialNodes[j].position();
+			}
+			std::cout << (same ? " (matches the serial smoothing)" : " (DIFFERS FROM THE SERIAL SMOOTHING)");
+		}
+		else serialNodes = nodes;
+		std::cout << std::endl;
+	}
+}
+
 void test_simple()
 {
 #if 1
@@ -119,6 +396,10 @@ void test_decimation()
 
 int main()
 {
+	test_original_builder();
+	test_parallel();
+	test_mesh_util_equivalence();
+	test_parallel_smoothing();
 	test_simple();
 	test_smoothing();
 	test_decimation();
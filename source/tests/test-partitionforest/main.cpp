@@ -1,20 +1,29 @@
 /***
  * test-partitionforest: main.cpp
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <sstream>
 
 #include <boost/shared_ptr.hpp>
 using boost::shared_ptr;
 
 #include <common/adts/RootedMST.h>
 #include <common/commands/UndoableCommandManager.h>
+#include <common/partitionforests/base/PartitionForestMFSManager.h>
 #include <common/partitionforests/base/PartitionForestMultiFeatureSelection.h>
 #include <common/partitionforests/base/PartitionForestTouchListener.h>
 #include <common/partitionforests/graphviz/PartitionForestGraphvizOutputter.h>
+#include <common/partitionforests/images/DICOMImageBranchLayer.h>
+#include <common/partitionforests/images/DICOMImageLeafLayer.h>
 #include <common/partitionforests/images/SimpleImageBranchLayer.h>
 #include <common/partitionforests/images/SimpleImageLeafLayer.h>
+#include <common/partitionforests/images/VolumeIPF.h>
+#include <common/util/ITKImageUtil.h>
 using namespace mp;
 
 //#################### ENUMERATIONS ####################
@@ -25,11 +34,14 @@ enum SimpleFeature
 };
 
 //#################### TYPEDEFS ####################
+typedef PartitionForest<DICOMImageLeafLayer, DICOMImageBranchLayer> DICOMIPF;
 typedef PartitionForest<SimpleImageLeafLayer, SimpleImageBranchLayer> IPF;
 typedef PartitionForestSelection<SimpleImageLeafLayer, SimpleImageBranchLayer> Selection;
 typedef PartitionForestMultiFeatureSelection<SimpleImageLeafLayer, SimpleImageBranchLayer, SimpleFeature> MFS;
 typedef PartitionForestGraphvizOutputter<SimpleImageLeafLayer,SimpleImageBranchLayer,SimpleFeature> GVO;
+typedef VolumeIPF<SimpleImageLeafLayer, SimpleImageBranchLayer> VIPF;
 
+typedef boost::shared_ptr<DICOMIPF> DICOMIPF_Ptr;
 typedef boost::shared_ptr<IPF> IPF_Ptr;
 typedef boost::shared_ptr<Selection> Selection_Ptr;
 typedef boost::shared_ptr<const Selection> Selection_CPtr;
@@ -275,6 +287,57 @@ struct ForestTouchListener : PartitionForestTouchListener<SimpleImageLeafLayer,S
 };
 
 //#################### HELPERS ####################
+template <unsigned int Dimension>
+void check_dicom_leaf_layer(const itk::Size<Dimension>& size)
+{
+	// Fill some images with arbitrary values and construct a leaf layer from them.
+	typename itk::Image<int,Dimension>::Pointer baseImage = ITKImageUtil::make_image<int,Dimension>(size);
+	typename itk::Image<short,Dimension>::Pointer gradientMagnitudeImage = ITKImageUtil::make_image<short,Dimension>(size);
+	typename itk::Image<unsigned char,Dimension>::Pointer windowedImage = ITKImageUtil::make_image<unsigned char,Dimension>(size);
+	int *baseValues = baseImage->GetBufferPointer();
+	short *gradientMagnitudeValues = gradientMagnitudeImage->GetBufferPointer();
+	unsigned char *greyValues = windowedImage->GetBufferPointer();
+	int nodeCount = static_cast<int>(baseImage->GetLargestPossibleRegion().GetNumberOfPixels());
+	for(int n=0; n<nodeCount; ++n)
+	{
+		baseValues[n] = (n * 37) % 101 - 50;
+		gradientMagnitudeValues[n] = static_cast<short>((n * 13) % 17);
+		greyValues[n] = static_cast<unsigned char>((n * 7) % 256);
+	}
+
+	DICOMImageLeafLayer leafLayer(baseImage, windowedImage, gradientMagnitudeImage);
+
+	// Check that the node properties and edge weights are those of the images.
+	bool propertiesCorrect = true;
+	for(int n=0; n<nodeCount; ++n)
+	{
+		DICOMPixelProperties properties = leafLayer.node_properties(n);
+		if(properties.base_value() != baseValues[n] ||
+		   properties.gradient_magnitude_value() != gradientMagnitudeValues[n] ||
+		   properties.grey_value() != greyValues[n])
+		{
+			propertiesCorrect = false;
+		}
+	}
+
+	bool edgeWeightsCorrect = true;
+	int edgeCount = 0;
+	for(DICOMImageLeafLayer::EdgeConstIterator it=leafLayer.edges_cbegin(), iend=leafLayer.edges_cend(); it!=iend; ++it, ++edgeCount)
+	{
+		short expectedWeight = std::max(gradientMagnitudeValues[it->u], gradientMagnitudeValues[it->v]);
+		if(it->weight != expectedWeight || leafLayer.edge_weight(it->u, it->v) != expectedWeight) edgeWeightsCorrect = false;
+	}
+
+	// Check that the layer shares the images' pixel buffers rather than copying them.
+	bool buffersShared = leafLayer.base_image()->GetBufferPointer() == baseValues &&
+						 leafLayer.gradient_magnitude_image()->GetBufferPointer() == gradientMagnitudeValues &&
+						 leafLayer.grey_image()->GetBufferPointer() == greyValues;
+
+	std::cout << Dimension << "D images: node properties " << (propertiesCorrect ? "correct" : "INCORRECT")
+			  << ", " << edgeCount << " edge weights " << (edgeWeightsCorrect ? "correct" : "INCORRECT")
+			  << ", pixel buffers " << (buffersShared ? "shared" : "NOT shared") << '\n';
+}
+
 IPF_Ptr default_ipf(const ICommandManager_Ptr& manager)
 {
 	// Construct the forest.
@@ -377,6 +440,15 @@ IPF_Ptr small_ipf(const ICommandManager_Ptr& manager)
 }
 
 //#################### TESTS ####################
+void dicom_leaf_layer_test()
+{
+	itk::Size<2> size2D = {{5, 4}};
+	check_dicom_leaf_layer(size2D);
+
+	itk::Size<3> size3D = {{4, 3, 5}};
+	check_dicom_leaf_layer(size3D);
+}
+
 void feature_selection_test()
 {
 	ICommandManager_Ptr manager(new UndoableCommandManager);
@@ -668,6 +740,243 @@ void graphviz_thesis_zipping()
 	ipf->zip_chains(chains);
 }
 
+void incremental_properties_test()
+{
+	// Construct a 6x6 forest, and merge most of its first branch layer into a single node.
+	std::vector<SimplePixelProperties> leafProperties;
+	for(int i=0; i<36; ++i) leafProperties.push_back(SimplePixelProperties((i * 7) % 13));
+	shared_ptr<SimpleImageLeafLayer> leafLayer(new SimpleImageLeafLayer(leafProperties, 6, 6));
+	IPF_Ptr ipf(new IPF(leafLayer));
+
+	ICommandManager_Ptr manager(new UndoableCommandManager);
+	ipf->set_command_manager(manager);
+
+	ipf->clone_layer(0);
+	std::set<PFNodeID> mergees;
+	for(int i=0; i<30; ++i) mergees.insert(PFNodeID(1,i));
+	ipf->merge_sibling_nodes(mergees);	mergees.clear();
+	ipf->clone_layer(1);
+
+	// Split the merged node unevenly, so that the properties of the largest group are derived by subtraction.
+	std::vector<std::set<int> > groups(3);
+	for(int i=0; i<30; ++i)
+	{
+		if(i < 6)		groups[0].insert(i);
+		else if(i < 9)	groups[1].insert(i);
+		else			groups[2].insert(i);
+	}
+	ipf->split_node(PFNodeID(1,0), groups);
+
+	// Check that the incrementally-maintained properties of each branch node match those computed directly from its
+	// receptive region, after each of a sequence of changes to the forest.
+	for(int pass=0; pass<4; ++pass)
+	{
+		int mismatches = 0;
+		for(int layerIndex=1; layerIndex<=ipf->highest_layer(); ++layerIndex)
+		{
+			for(IPF::BranchNodeConstIterator it=ipf->branch_nodes_cbegin(layerIndex), iend=ipf->branch_nodes_cend(layerIndex); it!=iend; ++it)
+			{
+				std::deque<int> receptiveRegion = ipf->receptive_region_of(PFNodeID(layerIndex, it.index()));
+				double sum = 0.0;
+				for(std::deque<int>::const_iterator jt=receptiveRegion.begin(), jend=receptiveRegion.end(); jt!=jend; ++jt)
+				{
+					sum += ipf->leaf_properties(*jt).value();
+				}
+
+				const SimpleRegionProperties& properties = it->properties();
+				if(properties.area() != static_cast<int>(receptiveRegion.size())) ++mismatches;
+				if(std::fabs(properties.mean_value() - sum / receptiveRegion.size()) > 1e-9) ++mismatches;
+			}
+		}
+		std::cout << "Incremental properties pass " << pass << ": " << mismatches << " mismatches\n";
+
+		switch(pass)
+		{
+			case 0:
+				mergees.insert(PFNodeID(1,0));	mergees.insert(PFNodeID(1,9));
+				ipf->merge_sibling_nodes(mergees);	mergees.clear();
+				break;
+			case 1:
+				manager->undo();
+				manager->undo();
+				break;
+			case 2:
+				manager->redo();
+				break;
+		}
+	}
+
+	// Do the same for a 6x6x2 DICOM forest, whose properties include extrema (grey values and bounding box coordinates).
+	// The splits below move out some, but not all, of the voxels attaining several of the extrema of the split nodes
+	// (so that the extrema of the largest groups can be derived by subtraction), and then all of the voxels attaining one.
+	std::vector<DICOMPixelProperties> dicomLeafProperties;
+	for(int i=0; i<72; ++i) dicomLeafProperties.push_back(DICOMPixelProperties(i, 0, static_cast<unsigned char>((i * 7) % 13)));
+	shared_ptr<DICOMImageLeafLayer> dicomLeafLayer(new DICOMImageLeafLayer(dicomLeafProperties, 6, 6, 2));
+	DICOMIPF_Ptr dicomIPF(new DICOMIPF(dicomLeafLayer));
+	dicomIPF->set_command_manager(manager);
+
+	dicomIPF->clone_layer(0);
+	for(int i=0; i<72; ++i) mergees.insert(PFNodeID(1,i));
+	dicomIPF->merge_sibling_nodes(mergees);	mergees.clear();
+	dicomIPF->clone_layer(1);
+
+	for(int pass=0; pass<5; ++pass)
+	{
+		int mismatches = 0;
+		for(int layerIndex=1; layerIndex<=dicomIPF->highest_layer(); ++layerIndex)
+		{
+			for(DICOMIPF::BranchNodeConstIterator it=dicomIPF->branch_nodes_cbegin(layerIndex), iend=dicomIPF->branch_nodes_cend(layerIndex); it!=iend; ++it)
+			{
+				std::deque<int> receptiveRegion = dicomIPF->receptive_region_of(PFNodeID(layerIndex, it.index()));
+				DICOMRegionProperties expected = dicomLeafLayer->combine_properties(std::set<int>(receptiveRegion.begin(), receptiveRegion.end()));
+				const DICOMRegionProperties& actual = it->properties();
+				if(actual.voxel_count() != expected.voxel_count()) ++mismatches;
+				if(actual.min_grey_value() != expected.min_grey_value() || actual.max_grey_value() != expected.max_grey_value()) ++mismatches;
+				if(actual.x_min() != expected.x_min() || actual.y_min() != expected.y_min() || actual.z_min() != expected.z_min()) ++mismatches;
+				if(actual.x_max() != expected.x_max() || actual.y_max() != expected.y_max() || actual.z_max() != expected.z_max()) ++mismatches;
+				if(std::fabs(actual.mean_grey_value() - expected.mean_grey_value()) > 1e-9) ++mismatches;
+				if((actual.centroid() - expected.centroid()).length() > 1e-9) ++mismatches;
+			}
+		}
+		std::cout << "Incremental DICOM properties pass " << pass << ": " << mismatches << " mismatches\n";
+
+		switch(pass)
+		{
+			case 0:
+			{
+				// Move out the first two rows of the lower slice.
+				std::vector<std::set<int> > dicomGroups(2);
+				for(int i=0; i<72; ++i) dicomGroups[i < 12 ? 0 : 1].insert(i);
+				dicomIPF->split_node(PFNodeID(1,0), dicomGroups);
+				break;
+			}
+			case 1:
+			{
+				// Move out the rest of the lower slice (the remainder is the upper slice, whose z coordinates are all 1).
+				std::vector<std::set<int> > dicomGroups(2);
+				for(int i=12; i<72; ++i) dicomGroups[i < 36 ? 0 : 1].insert(i);
+				dicomIPF->split_node(PFNodeID(1,12), dicomGroups);
+				break;
+			}
+			case 2:
+				manager->undo();
+				manager->undo();
+				break;
+			case 3:
+				manager->redo();
+				break;
+		}
+	}
+
+	// Check that deleting the second branch layer and undoing the deletion restores the properties of its nodes exactly,
+	// even though they were derived incrementally (recombining them from the layer below does not give bit-identical values).
+	std::vector<std::vector<char> > snapshots(2);
+	for(int pass=0; pass<2; ++pass)
+	{
+		std::vector<char>& snapshot = snapshots[pass];
+		for(DICOMIPF::BranchNodeConstIterator it=dicomIPF->branch_nodes_cbegin(2), iend=dicomIPF->branch_nodes_cend(2); it!=iend; ++it)
+		{
+			size_t size = snapshot.size();
+			snapshot.resize(size + DICOMRegionProperties::BINARY_SIZE);
+			it->properties().write_binary(&snapshot[size]);
+		}
+
+		if(pass == 0)
+		{
+			dicomIPF->delete_layer(2);
+			manager->undo();
+		}
+	}
+	std::cout << "Incremental DICOM properties after undoing a layer deletion: " << (snapshots[0] == snapshots[1] ? "unchanged" : "CHANGED") << '\n';
+}
+
+void insert_layer_test()
+{
+	shared_ptr<UndoableCommandManager> manager(new UndoableCommandManager);
+	IPF_Ptr ipf = default_ipf(manager), expected = default_ipf(ICommandManager_Ptr(new BasicCommandManager));
+	std::ostringstream original;
+	ipf->output(original);
+
+	// Check that inserting a layer by grouping nodes has the same effect as cloning the layer and merging the nodes.
+	std::vector<std::set<int> > groups(1);
+	groups[0].insert(0);
+	groups[0].insert(6);
+	ipf->insert_layer_above(2, groups);
+
+	expected->clone_layer(2);
+	std::set<PFNodeID> mergees;
+		mergees.insert(PFNodeID(3,0));	mergees.insert(PFNodeID(3,6));
+	expected->merge_sibling_nodes(mergees);
+
+	std::ostringstream actualOutput, expectedOutput;
+	ipf->output(actualOutput);
+	expected->output(expectedOutput);
+	std::cout << "Layer inserted " << (actualOutput.str() == expectedOutput.str() ? "correctly" : "INCORRECTLY") << '\n';
+
+	// Check that undoing the insertion restores the original forest.
+	manager->undo();
+	std::ostringstream afterUndo;
+	ipf->output(afterUndo);
+	std::cout << "Layer insertion undone " << (afterUndo.str() == original.str() ? "correctly" : "INCORRECTLY") << '\n';
+
+	// Check that groups of nodes that are not siblings are rejected.
+	groups[0].clear();
+	groups[0].insert(0);
+	groups[0].insert(2);
+	try
+	{
+		ipf->insert_layer_above(1, groups);
+		std::cout << "Non-sibling layer group INCORRECTLY accepted\n";
+	}
+	catch(Exception& e)
+	{
+		std::cout << "Non-sibling layer group correctly rejected: " << e.cause() << '\n';
+	}
+}
+
+void label_cache_test()
+{
+	// Construct a 4x3x2 volume forest with a single branch layer (a clone of the leaf layer).
+	std::vector<SimplePixelProperties> leafProperties;
+	for(int i=0; i<24; ++i) leafProperties.push_back(SimplePixelProperties(i));
+	shared_ptr<SimpleImageLeafLayer> leafLayer(new SimpleImageLeafLayer(leafProperties, 4, 3, 2));
+	itk::Size<3> volumeSize = {{4, 3, 2}};
+	VIPF ipf(volumeSize, leafLayer);
+
+	ICommandManager_Ptr manager(new UndoableCommandManager);
+	ipf.set_command_manager(manager);
+	ipf.clone_layer(0);
+
+	// Hold on to the label volume for the branch layer (as an image creator reading it on other threads would), and
+	// check that changing the forest leaves the held labels alone but updates the ones the cache hands out next.
+	VIPF::Labels_CPtr heldLabels = ipf.layer_labels(1);
+	std::vector<int> heldCopy(*heldLabels);
+	std::set<PFNodeID> mergees;
+		mergees.insert(PFNodeID(1,0));	mergees.insert(PFNodeID(1,1));	mergees.insert(PFNodeID(1,5));
+	ipf.merge_sibling_nodes(mergees);	mergees.clear();
+	std::cout << "Held labels " << (*heldLabels == heldCopy ? "unchanged" : "CHANGED") << " by merge\n";
+
+	// Check that the labels handed out (with and without a client holding on to them) match the forest at each step.
+	for(int pass=0; pass<3; ++pass)
+	{
+		if(pass == 1)
+		{
+			heldLabels.reset();
+			mergees.insert(PFNodeID(1,2));	mergees.insert(PFNodeID(1,3));	mergees.insert(PFNodeID(1,7));
+			ipf.merge_sibling_nodes(mergees);	mergees.clear();
+		}
+		else if(pass == 2) manager->undo();
+
+		VIPF::Labels_CPtr labels = ipf.layer_labels(1);
+		int mismatches = 0;
+		for(int i=0; i<24; ++i)
+		{
+			if((*labels)[i] != ipf.ancestor_of(PFNodeID(0,i), 1).index()) ++mismatches;
+		}
+		std::cout << "Label cache pass " << pass << ": " << mismatches << " mismatches\n";
+	}
+}
+
 void listener_test()
 {
 	SimplePixelProperties arr[] = {0,1,2,3,4,5,6,7,8};
@@ -819,6 +1128,67 @@ void selection_test()
 	manager->undo();
 }
 
+void slice_index_test()
+{
+	// Construct a 4x3x2 volume forest with a few irregularly-shaped nodes in its first branch layer.
+	std::vector<SimplePixelProperties> leafProperties;
+	for(int i=0; i<24; ++i) leafProperties.push_back(SimplePixelProperties(i));
+	shared_ptr<SimpleImageLeafLayer> leafLayer(new SimpleImageLeafLayer(leafProperties, 4, 3, 2));
+	itk::Size<3> volumeSize = {{4, 3, 2}};
+	VIPF ipf(volumeSize, leafLayer);
+
+	ICommandManager_Ptr manager(new UndoableCommandManager);
+	ipf.set_command_manager(manager);
+
+	ipf.clone_layer(0);
+	std::set<PFNodeID> mergees;
+		mergees.insert(PFNodeID(1,0));	mergees.insert(PFNodeID(1,1));	mergees.insert(PFNodeID(1,5));	mergees.insert(PFNodeID(1,17));
+	ipf.merge_sibling_nodes(mergees);	mergees.clear();
+		mergees.insert(PFNodeID(1,2));	mergees.insert(PFNodeID(1,3));	mergees.insert(PFNodeID(1,7));	mergees.insert(PFNodeID(1,11));
+	ipf.merge_sibling_nodes(mergees);	mergees.clear();
+
+	// Check that the runs for each node and orientation cover exactly its receptive region, and request them for
+	// each node before the forest changes so that the cached runs of the changed nodes must be discarded.
+	for(int pass=0; pass<3; ++pass)
+	{
+		int mismatches = 0;
+		shared_ptr<const SimpleImageBranchLayer> layer = ipf.branch_layer(1);
+		for(SimpleImageBranchLayer::BranchNodeConstIterator it=layer->branch_nodes_cbegin(), iend=layer->branch_nodes_cend(); it!=iend; ++it)
+		{
+			PFNodeID node(1, it.index());
+			std::deque<int> receptiveRegion = ipf.receptive_region_of(node);
+			std::set<int> expected(receptiveRegion.begin(), receptiveRegion.end());
+			for(int ori=0; ori<3; ++ori)
+			{
+				SliceOrientation sliceOrientation = SliceOrientation(ori);
+				VIPF::SliceRuns_CPtr sliceRuns = ipf.slice_runs_of(node, sliceOrientation);
+				std::set<int> actual;
+				for(int slice=0; slice<static_cast<int>(volumeSize[ori]); ++slice)
+				{
+					std::pair<VIPF::LeafRunConstIterator,VIPF::LeafRunConstIterator> runs = sliceRuns->runs_in_slice(slice);
+					for(VIPF::LeafRunConstIterator jt=runs.first, jend=runs.second; jt!=jend; ++jt)
+					{
+						for(int col=jt->begin; col<jt->end; ++col)
+						{
+							actual.insert(ipf.leaf_of_position(VIPF::position_in_slice(sliceOrientation, slice, jt->row, col)));
+							if(!sliceRuns->contains(slice, jt->row, col)) ++mismatches;
+						}
+					}
+				}
+				if(actual != expected) ++mismatches;
+			}
+		}
+		std::cout << "Slice index pass " << pass << ": " << mismatches << " mismatches\n";
+
+		if(pass == 0)
+		{
+				mergees.insert(PFNodeID(1,0));	mergees.insert(PFNodeID(1,2));
+			ipf.merge_sibling_nodes(mergees);	mergees.clear();
+		}
+		else if(pass == 1) manager->undo();
+	}
+}
+
 void switch_parent_test()
 {
 	ICommandManager_Ptr manager(new UndoableCommandManager);
@@ -856,6 +1226,53 @@ void touch_listener_test()
 	manager->undo();
 }
 
+void undo_budget_test()
+{
+	shared_ptr<UndoableCommandManager> manager(new UndoableCommandManager);
+	IPF_Ptr ipf = default_ipf(manager);
+
+	// Check that undoing a layer deletion rebuilds the deleted layer exactly.
+	std::ostringstream before, after;
+	ipf->output(before);
+	ipf->delete_layer(2);
+	manager->undo();
+	ipf->output(after);
+	std::cout << "Layer deletion undone " << (before.str() == after.str() ? "correctly" : "INCORRECTLY") << '\n';
+
+	// Make a few more changes, then check that reducing the budget trims the oldest of them from the history
+	// (but that the most recent change can always be undone).
+	ipf->delete_layer(4);
+	std::set<PFNodeID> mergees;
+		mergees.insert(PFNodeID(2,0));	mergees.insert(PFNodeID(2,6));
+	ipf->merge_sibling_nodes(mergees);
+	std::cout << "History uses " << manager->memory_usage() << " bytes\n";
+
+	manager->set_memory_budget(manager->memory_usage() - 1);
+	int undoable = 0;
+	while(manager->can_undo())
+	{
+		manager->undo();
+		++undoable;
+	}
+	std::cout << "After trimming, " << undoable << " command(s) could be undone, using " << manager->memory_usage() << " bytes\n";
+
+	manager->clear_history();
+	std::cout << "After clearing, the history uses " << manager->memory_usage() << " bytes\n";
+
+	// Check that removing a multi-feature selection accounts for the selection that the command retains.
+	MFS_Ptr initialMFS(new MFS(ipf)), extraMFS(new MFS(ipf));
+	PartitionForestMFSManager<MFS> mfsManager("Initial", initialMFS);
+	mfsManager.set_command_manager(manager);
+	mfsManager.add_multi_feature_selection("Extra", extraMFS);
+	extraMFS->identify_node(PFNodeID(0,0), LIVER);
+	extraMFS->identify_node(PFNodeID(0,7), KIDNEY);
+	manager->clear_history();
+	size_t mfsUsage = extraMFS->memory_usage();
+	extraMFS.reset();
+	mfsManager.remove_multi_feature_selection("Extra");
+	std::cout << "Removing a multi-feature selection using " << mfsUsage << " bytes adds " << manager->memory_usage() << " bytes to the history\n";
+}
+
 void unzip_zip_test()
 {
 	ICommandManager_Ptr manager(new UndoableCommandManager);
@@ -883,6 +1300,7 @@ void unzip_zip_test()
 
 int main()
 {
+	//dicom_leaf_layer_test();
 	//feature_selection_test();
 	//graphviz_test();
 
@@ -901,12 +1319,17 @@ int main()
 	//graphviz_thesis_nodeswillbemerged();
 	graphviz_thesis_nodewassplit();
 
+	//incremental_properties_test();
+	//insert_layer_test();
+	//label_cache_test();
 	//listener_test();
 	//lowest_branch_layer_test();
 	//nonsibling_node_merging_test();
 	//selection_test();
+	//slice_index_test();
 	//switch_parent_test();
 	//touch_listener_test();
+	//undo_budget_test();
 	//unzip_zip_test();
 	return 0;
 }
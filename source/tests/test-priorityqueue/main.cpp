@@ -1,15 +1,28 @@
 /***
  * test-priorityqueue: main.cpp
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
 #define BOOST_TEST_MODULE PriorityQueue Test
 #include <boost/test/included/unit_test.hpp>
 
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <common/adts/DaryPriorityQueue.h>
 #include <common/adts/PriorityQueue.h>
+#include <common/adts/RadixPriorityQueue.h>
+#include <common/util/NullType.h>
 using namespace mp;
 
 typedef	PriorityQueue<std::string, double, int, std::greater<double> > PQ;
+typedef DaryPriorityQueue<int, double, int, std::greater<double> > DPQ;
+typedef RadixPriorityQueue<int, int, int> RPQ;
 
 BOOST_AUTO_TEST_CASE(clear_test)
 {
@@ -123,3 +136,196 @@ BOOST_AUTO_TEST_CASE(update_key_test)
 	pq.pop();
 		BOOST_CHECK_EQUAL(pq.empty(), true);
 }
+
+//#################### DARY PRIORITY QUEUE ####################
+
+BOOST_AUTO_TEST_CASE(dary_test)
+{
+	DPQ pq;
+	pq.insert(5, 1.0, 23);
+	pq.insert(2, 0.9, 13);
+	pq.insert(9, 1.1, 7);
+		BOOST_CHECK_EQUAL(pq.size(), 3);
+		BOOST_CHECK_EQUAL(pq.contains(2), true);
+		BOOST_CHECK_EQUAL(pq.contains(3), false);
+		BOOST_CHECK_EQUAL(pq.contains(100), false);
+		BOOST_CHECK_EQUAL(pq.element(5).data(), 23);
+		BOOST_CHECK_EQUAL(pq.top().id(), 9);
+	BOOST_CHECK_THROW(pq.insert(5, 2.0, 0), Exception);
+	pq.update_key(2, 1.2);
+		BOOST_CHECK_EQUAL(pq.top().id(), 2);
+	pq.erase(9);
+		BOOST_CHECK_EQUAL(pq.contains(9), false);
+	pq.pop();
+		BOOST_CHECK_EQUAL(pq.top().id(), 5);
+		BOOST_CHECK_CLOSE(pq.top().key(), 1.0, 0.001);
+	pq.clear();
+		BOOST_CHECK_EQUAL(pq.empty(), true);
+		BOOST_CHECK_EQUAL(pq.contains(5), false);
+}
+
+BOOST_AUTO_TEST_CASE(dary_random_test)
+{
+	// Perform a random sequence of operations on a DaryPriorityQueue, and check after each one that its front element
+	// has the smallest key of those that should be in the queue.
+	srand(23);
+	const int idBound = 500;
+	std::vector<int> keys(idBound, -1);	// the key of each element that should be in the queue (or -1 if none)
+	DaryPriorityQueue<int, int, NullType> pq;
+	for(int i=0; i<20000; ++i)
+	{
+		int id = rand() % idBound, key = rand() % 1000;
+		switch(rand() % 4)
+		{
+			case 0:
+			case 1:
+				if(keys[id] == -1)	pq.insert(id, key, NullType());
+				else				pq.update_key(id, key);
+				keys[id] = key;
+				break;
+			case 2:
+				if(!pq.empty())
+				{
+					keys[pq.top().id()] = -1;
+					pq.pop();
+				}
+				break;
+			default:
+				if(keys[id] != -1)
+				{
+					pq.erase(id);
+					keys[id] = -1;
+				}
+				break;
+		}
+
+		int minKey = INT_MAX;
+		size_t size = 0;
+		for(int j=0; j<idBound; ++j)
+		{
+			BOOST_CHECK_EQUAL(pq.contains(j), keys[j] != -1);
+			if(keys[j] != -1)
+			{
+				minKey = std::min(minKey, keys[j]);
+				++size;
+			}
+		}
+		BOOST_REQUIRE_EQUAL(pq.size(), size);
+		if(size != 0) BOOST_REQUIRE_EQUAL(pq.top().key(), minKey);
+	}
+}
+
+//#################### RADIX PRIORITY QUEUE ####################
+
+BOOST_AUTO_TEST_CASE(radix_test)
+{
+	RPQ pq;
+	pq.insert(5, 10, 23);
+	pq.insert(2, 3, 13);
+	pq.insert(9, 70, 7);
+		BOOST_CHECK_EQUAL(pq.size(), 3);
+		BOOST_CHECK_EQUAL(pq.contains(2), true);
+		BOOST_CHECK_EQUAL(pq.contains(3), false);
+		BOOST_CHECK_EQUAL(pq.element(9).data(), 7);
+		BOOST_CHECK_EQUAL(pq.top().id(), 2);
+	pq.pop();
+		BOOST_CHECK_EQUAL(pq.top().id(), 5);
+	BOOST_CHECK_THROW(pq.insert(1, 2, 0), Exception);	// 2 is smaller than the last extracted key
+	BOOST_CHECK_THROW(pq.update_key(9, 4), Exception);
+	pq.update_key(9, 15);
+		BOOST_CHECK_EQUAL(pq.top().id(), 5);
+	pq.erase(5);
+		BOOST_CHECK_EQUAL(pq.top().id(), 9);
+		BOOST_CHECK_EQUAL(pq.top().key(), 15);
+	pq.pop();
+		BOOST_CHECK_EQUAL(pq.empty(), true);
+}
+
+BOOST_AUTO_TEST_CASE(radix_signed_keys_test)
+{
+	RadixPriorityQueue<int, int, NullType> pq(0, -1000);
+	int keys[] = {5, -7, 0, -1000, 999, -1};
+	for(int i=0; i<6; ++i) pq.insert(i, keys[i], NullType());
+
+	int expected[] = {-1000, -7, -1, 0, 5, 999};
+	for(int i=0; i<6; ++i)
+	{
+		BOOST_CHECK_EQUAL(pq.top().key(), expected[i]);
+		pq.pop();
+	}
+}
+
+BOOST_AUTO_TEST_CASE(radix_random_test)
+{
+	// Simulate a monotone propagation (each extracted element inserts or decreases the keys of some others),
+	// and check the extraction order against a DaryPriorityQueue.
+	srand(23);
+	const int idBound = 2000;
+	DaryPriorityQueue<int, int, NullType> reference;
+	RadixPriorityQueue<int, int, NullType> pq;
+	std::vector<bool> done(idBound, false);
+	reference.insert(0, 0, NullType());
+	pq.insert(0, 0, NullType());
+	while(!reference.empty())
+	{
+		int key = reference.top().key();
+		BOOST_REQUIRE_EQUAL(pq.top().key(), key);
+		int id = pq.top().id();
+		reference.erase(id);
+		pq.pop();
+		done[id] = true;
+
+		for(int k=0; k<4; ++k)
+		{
+			int adj = rand() % idBound, adjKey = key + rand() % 100;
+			if(done[adj]) continue;
+			if(!pq.contains(adj))
+			{
+				pq.insert(adj, adjKey, NullType());
+				reference.insert(adj, adjKey, NullType());
+			}
+			else if(adjKey < pq.element(adj).key())
+			{
+				pq.update_key(adj, adjKey);
+				reference.update_key(adj, adjKey);
+			}
+		}
+		BOOST_REQUIRE_EQUAL(pq.size(), reference.size());
+	}
+}
+
+//#################### BENCHMARK ####################
+
+template <typename Queue>
+double time_propagation(Queue& pq, int n)
+{
+	// Time a Dijkstra-like workload: n elements are inserted, each has its key decreased once, and then all are popped.
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	srand(23);
+	for(int i=0; i<n; ++i) pq.insert(i, 1000 + rand() % 1000000, NullType());
+	for(int i=0; i<n; ++i) pq.update_key(i, 1000 + rand() % 1000);
+	long checksum = 0;
+	while(!pq.empty())
+	{
+		checksum += pq.top().key();
+		pq.pop();
+	}
+	boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+	BOOST_CHECK(checksum > 0);
+	return elapsed.total_microseconds() / 1000.0;
+}
+
+BOOST_AUTO_TEST_CASE(benchmark)
+{
+	const int n = 200000;
+
+	PriorityQueue<int, int, NullType> pq;
+	DaryPriorityQueue<int, int, NullType> dpq(n);
+	DaryPriorityQueue<int, int, NullType, std::less<int>, 2> bpq(n);
+	RadixPriorityQueue<int, int, NullType> rpq(n);
+
+	std::cout << "PriorityQueue:               " << time_propagation(pq, n) << " ms\n";
+	std::cout << "DaryPriorityQueue (binary):  " << time_propagation(bpq, n) << " ms\n";
+	std::cout << "DaryPriorityQueue (4-ary):   " << time_propagation(dpq, n) << " ms\n";
+	std::cout << "RadixPriorityQueue:          " << time_propagation(rpq, n) << " ms\n";
+}
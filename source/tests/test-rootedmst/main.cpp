@@ -3,8 +3,10 @@
  * Copyright Stuart Golodetz, 2010. All rights reserved.
  ***/
 
+#include <cstdlib>
 #include <iostream>
 
+#include <common/adts/AdjacencyGraph.h>
 #include <common/adts/RootedMST.h>
 #include <common/partitionforests/images/DICOMImageLeafLayer.h>
 #include <common/partitionforests/images/SimpleImageLeafLayer.h>
@@ -78,10 +80,47 @@ void simple_leaf_layer_mst()
 	std::copy(mst.edges_cbegin(), mst.edges_cend(), std::ostream_iterator<MST::Edge>(std::cout, " "));
 }
 
+template <typename EdgeWeight>
+EdgeWeight total_weight(const RootedMST<EdgeWeight>& mst)
+{
+	EdgeWeight total = EdgeWeight();
+	for(typename RootedMST<EdgeWeight>::EdgeConstIterator it=mst.edges_cbegin(), iend=mst.edges_cend(); it!=iend; ++it)
+	{
+		total += it->weight;
+	}
+	return total;
+}
+
+void kruskal_prim_mst()
+{
+	// Check that Kruskal's and Prim's algorithms produce spanning trees of the same weight for random graphs
+	// (the trees themselves may legitimately differ when there are edges of equal weight).
+	srand(42);
+	for(int trial=0; trial<100; ++trial)
+	{
+		int nodeCount = 2 + rand() % 200;
+		AdjacencyGraph<int, int> graph;
+		for(int i=0; i<nodeCount; ++i) graph.set_node_properties(i, i);
+		for(int i=1; i<nodeCount; ++i) graph.set_edge_weight(rand() % i, i, rand() % 1000 - 500);
+		for(int i=0; i<2*nodeCount; ++i)
+		{
+			int u = rand() % nodeCount, v = rand() % nodeCount;
+			if(u != v) graph.set_edge_weight(u, v, rand() % 1000 - 500);
+		}
+
+		RootedMST<int> primMST(graph), kruskalMST(graph, RootedMST<int>::ALGORITHM_KRUSKAL);
+		if(total_weight(primMST) != total_weight(kruskalMST) || kruskalMST.node_count() != nodeCount || kruskalMST.tree_root() != 0)
+		{
+			std::cout << "Kruskal/Prim mismatch in trial " << trial << '\n';
+		}
+	}
+}
+
 int main()
 {
 	adjacency_graph_mst();
 	ct_leaf_layer_mst();
+	kruskal_prim_mst();
 	simple_leaf_layer_mst();
 	return 0;
 }
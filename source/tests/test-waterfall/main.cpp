@@ -1,11 +1,20 @@
 /***
  * test-waterfall: main.cpp
  * Copyright Stuart Golodetz, 2010. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/shared_ptr.hpp>
 using boost::shared_ptr;
@@ -16,10 +25,16 @@ using boost::shared_ptr;
 #include <itkImageFileReader.h>
 #include <itkImageFileWriter.h>
 
+#include <common/adts/AdjacencyGraph.h>
 #include <common/dicom/volumes/DICOMVolume.h>
+#include <common/exceptions/Exception.h>
+#include <common/io/files/VolumeIPFFile.h>
 #include <common/partitionforests/base/PartitionForest.h>
 #include <common/partitionforests/images/DICOMImageBranchLayer.h>
 #include <common/partitionforests/images/DICOMImageLeafLayer.h>
+#include <common/partitionforests/images/VolumeIPF.h>
+#include <common/segmentation/SubvolumeToVolumeIndexMapper.h>
+#include <common/segmentation/SubvolumeWaterfallRunner.h>
 #include <common/segmentation/waterfall/GolodetzWaterfallPass.h>
 #include <common/segmentation/waterfall/MarcoteguiWaterfallPass.h>
 #include <common/segmentation/waterfall/NichollsWaterfallPass.h>
@@ -30,7 +45,405 @@ using namespace mp;
 typedef PartitionForest<DICOMImageLeafLayer,DICOMImageBranchLayer> IPF;
 typedef shared_ptr<IPF> IPF_Ptr;
 
+//#################### REFERENCE IMPLEMENTATIONS ####################
+/**
+@brief	The original (recursive) implementation of the Golodetz waterfall pass, which stores its per-node data in the MST.
+
+This is retained purely as a reference against which to check the (iterative) GolodetzWaterfallPass.
+*/
+template <typename EdgeWeight>
+class RecursiveGolodetzWaterfallPass : public WaterfallPass<EdgeWeight>
+{
+	//#################### ENUMERATIONS ####################
+public:
+	enum NodeClassifier
+	{
+		UNDETERMINED,
+		AMBIGUOUS_IN,
+		AMBIGUOUS_OUT,
+		NO_FLOW,
+		UNAMBIGUOUS_IN,
+		UNAMBIGUOUS_OUT,
+	};
+
+	//#################### NESTED CLASSES ####################
+public:
+	struct NodeData
+	{
+		std::set<int> m_arrows;						// the nodes at the other ends of arrowed edges (ones along which water would flow)
+		bool m_checkParent;							// whether the parent route needs checking in the down pass
+		int m_distance;								// the node's distance value (see algorithm description)
+		NodeClassifier m_parentBottomClassifier;	// the classification of the node with regard to the node's parent edge
+		NodeClassifier m_parentTopClassifier;		// the classification of the node's parent with regard to the node's parent edge
+
+		NodeData()
+		:	m_checkParent(false),
+			m_distance(0),
+			m_parentBottomClassifier(UNDETERMINED),
+			m_parentTopClassifier(UNDETERMINED)
+		{}
+	};
+
+	//#################### PRIVATE VARIABLES ####################
+private:
+	std::vector<NodeData> m_nodeData;	// the data for each node in the MST, indexed by node index
+
+	//#################### PUBLIC METHODS ####################
+public:
+	RootedMST<EdgeWeight>& run(RootedMST<EdgeWeight>& mst)
+	{
+		if(mst.node_count() > 1)
+		{
+			m_nodeData.assign(mst.node_index_bound(), NodeData());
+			up_pass(mst, mst.tree_root());
+			down_pass(mst, mst.tree_root());
+			merge_pass(mst, mst.tree_root());
+		}
+		return mst;
+	}
+
+	RootedMST<EdgeWeight>& run_without_merge_pass(RootedMST<EdgeWeight>& mst)
+	{
+		if(mst.node_count() > 1)
+		{
+			m_nodeData.assign(mst.node_index_bound(), NodeData());
+			up_pass(mst, mst.tree_root());
+			down_pass(mst, mst.tree_root());
+		}
+		return mst;
+	}
+
+	//#################### PRIVATE METHODS ####################
+private:
+	static NodeClassifier classify_node(const NodeData& data, int other)
+	{
+		NodeClassifier classifier;
+		switch(data.m_arrows.size())
+		{
+			case 0:
+			{
+				classifier = NO_FLOW;
+				break;
+			}
+			case 1:
+			{
+				classifier = *data.m_arrows.begin() == other ? UNAMBIGUOUS_IN : UNAMBIGUOUS_OUT;
+				break;
+			}
+			default:
+			{
+				classifier = data.m_arrows.find(other) != data.m_arrows.end() ? AMBIGUOUS_IN : AMBIGUOUS_OUT;
+				break;
+			}
+		}
+		return classifier;
+	}
+
+	void down_pass(RootedMST<EdgeWeight>& mst, int cur)
+	{
+		int parent = mst.tree_parent(cur);
+
+		// Check for a better upwards route if necessary.
+		NodeData data = m_nodeData[cur];
+		if(data.m_checkParent)
+		{
+			const NodeData& parentData = m_nodeData[parent];
+			if(parentData.m_arrows.find(cur) == parentData.m_arrows.end())
+			{
+				// There is a potential upwards route.
+				int upwardsDistance = parentData.m_distance + 1;
+				if(upwardsDistance < data.m_distance)
+				{
+					// The upwards route is strictly better.
+					data.m_arrows.clear();
+					data.m_arrows.insert(parent);
+					data.m_distance = upwardsDistance;
+				}
+				else if(upwardsDistance == data.m_distance)
+				{
+					// The upwards route is just as good.
+					data.m_arrows.insert(parent);
+				}
+			}
+		}
+
+		// Classify the node and its parent with respect to the parent edge.
+		if(parent != -1)
+		{
+			const NodeData& parentData = m_nodeData[parent];
+			data.m_parentBottomClassifier = classify_node(data, parent);
+			data.m_parentTopClassifier = classify_node(parentData, cur);
+		}
+
+		m_nodeData[cur] = data;
+
+		// Recurse on the children.
+		std::set<int> children = mst.tree_children(cur);
+		for(std::set<int>::const_iterator it=children.begin(), iend=children.end(); it!=iend; ++it)
+		{
+			down_pass(mst, *it);
+		}
+	}
+
+	int merge_pass(RootedMST<EdgeWeight>& mst, int cur)
+	{
+		// Recurse on the children.
+		std::set<int> children = mst.tree_children(cur);
+		for(std::set<int>::const_iterator it=children.begin(), iend=children.end(); it!=iend; ++it)
+		{
+			cur = merge_pass(mst, *it);
+		}
+
+		// Merge the parent edge if necessary.
+		int parent = mst.tree_parent(cur);
+		const NodeData& data = m_nodeData[cur];
+		if(data.m_parentBottomClassifier == UNAMBIGUOUS_IN || data.m_parentTopClassifier == UNAMBIGUOUS_IN ||
+		   (data.m_parentBottomClassifier == NO_FLOW && data.m_parentTopClassifier == NO_FLOW))
+		{
+			NodeData parentData = m_nodeData[parent];
+			int oldParent = parent;
+			parent = this->merge_nodes(mst, parent, cur);
+
+			// Ensure that the data associated with the new parent node is correct.
+			parentData.m_arrows.erase(cur);
+			parentData.m_arrows.insert(-cur);	// the - is to represent a node which no longer exists
+			m_nodeData[parent] = parentData;
+
+			if(parent != oldParent)
+			{
+				// Ensure that the new parent's parent (if any) and children refer to it by its new name.
+				int grandparent = mst.tree_parent(parent);
+				if(grandparent != -1)
+				{
+					NodeData grandparentData = m_nodeData[grandparent];
+					if(grandparentData.m_arrows.find(oldParent) != grandparentData.m_arrows.end())
+					{
+						grandparentData.m_arrows.erase(oldParent);
+						grandparentData.m_arrows.insert(parent);
+						m_nodeData[grandparent] = grandparentData;
+					}
+				}
+
+				std::set<int> children = mst.tree_children(parent);
+				for(std::set<int>::const_iterator it=children.begin(), iend=children.end(); it!=iend; ++it)
+				{
+					NodeData childData = m_nodeData[*it];
+					if(childData.m_arrows.find(oldParent) != childData.m_arrows.end())
+					{
+						childData.m_arrows.erase(oldParent);
+						childData.m_arrows.insert(parent);
+						m_nodeData[*it] = childData;
+					}
+				}
+			}
+		}
+
+		return parent;
+	}
+
+	void up_pass(RootedMST<EdgeWeight>& mst, int cur)
+	{
+		int parent = mst.tree_parent(cur);
+		NodeData data;
+
+		// Recursively process any children.
+		std::set<int> children = mst.tree_children(cur);
+		for(std::set<int>::const_iterator it=children.begin(), iend=children.end(); it!=iend; ++it)
+		{
+			up_pass(mst, *it);
+		}
+
+		// Construct the weight -> edges map.
+		std::map<EdgeWeight,std::set<int> > weightToEdges;
+		if(parent != -1)
+		{
+			weightToEdges[mst.edge_weight(parent, cur)].insert(parent);
+		}
+		for(std::set<int>::const_iterator it=children.begin(), iend=children.end(); it!=iend; ++it)
+		{
+			weightToEdges[mst.edge_weight(cur, *it)].insert(*it);
+		}
+
+		// If this node has a unique edge of steepest descent (i.e. a unique lowest-valued edge
+		// leading out of it, which can be the parent edge), add an arrow on the node pointing
+		// along the edge and early-out.
+		const std::set<int>& lowestEdges = weightToEdges.begin()->second;
+		if(lowestEdges.size() == 1)
+		{
+			data.m_arrows = lowestEdges;
+			m_nodeData[cur] = data;
+			return;
+		}
+
+		// Otherwise, consider all the lowest-valued child edges (i.e. ignore the parent for now,
+		// even if it is also a lowest-valued edge) which satisfy the two conditions:
+		//
+		// (a)	There is no arrow on the node at the other end of the edge pointing along the
+		//		edge towards this node
+		// (b)	The node at the other end of the edge has a distance value not equal to INT_MAX
+		//
+		// If there are no such child edges, then this node is unescapable along a child edge and
+		// should be given a distance value of INT_MAX. Otherwise, each of these child edges can be
+		// assigned a distance value equal to 1 greater than the value on the node at the other end of
+		// the edge: this value on the node will be 0 for nodes from which there is a unique path of
+		// steepest descent, and non-zero otherwise. Pick all the child edges whose distance value is
+		// minimal and add arrows to this node pointing along them (these indicate the initial paths
+		// of steepest descent from this node). Store the minimum distance value as this node's value.
+
+		std::set<int> lowestChildEdges = lowestEdges;
+		lowestChildEdges.erase(parent);
+		for(std::set<int>::iterator it=lowestChildEdges.begin(), iend=lowestChildEdges.end(); it!=iend; /* No-op */)
+		{
+			const NodeData& childData = m_nodeData[*it];
+			if(childData.m_arrows.find(cur) != childData.m_arrows.end() || childData.m_distance == INT_MAX)
+			{
+				lowestChildEdges.erase(it++);
+			}
+			else ++it;
+		}
+
+		if(!lowestChildEdges.empty())
+		{
+			std::map<int,std::set<int> > distanceToEdges;
+			for(std::set<int>::const_iterator it=lowestChildEdges.begin(), iend=lowestChildEdges.end(); it!=iend; ++it)
+			{
+				const NodeData& childData = m_nodeData[*it];
+				distanceToEdges[childData.m_distance+1].insert(*it);
+			}
+
+			int minDistance = distanceToEdges.begin()->first;
+			const std::set<int>& minEdges = distanceToEdges.begin()->second;
+
+			data.m_arrows = minEdges;
+			data.m_distance = minDistance;
+		}
+		else
+		{
+			data.m_distance = INT_MAX;
+		}
+
+		// Now consider the parent edge: if it was a lowest-valued edge, mark it as a potential
+		// path of steepest descent to avoid the need to check again in the down pass.
+		if(lowestEdges.find(parent) != lowestEdges.end())
+		{
+			data.m_checkParent = true;
+		}
+
+		m_nodeData[cur] = data;
+	}
+};
+
 //#################### HELPER FUNCTIONS ####################
+/**
+Builds a forest for a volume made up of a grid of subvolumes (in the same way as VolumeIPFBuilder), running the waterfall
+passes for the subvolumes on the specified number of threads, and outputs it to the specified stream. Returns the time
+spent running the passes (in milliseconds).
+*/
+double build_subvolume_forest(const std::vector<DICOMPixelProperties>& volumeProperties, const itk::Size<3>& volumeSize, const itk::Size<3>& subvolumeSize,
+							  int layerLimit, int threadCount, std::ostream& os)
+{
+	typedef SubvolumeWaterfallRunner<IPF> Runner;
+
+	int subvolumeCount = 1;
+	for(int i=0; i<3; ++i) subvolumeCount *= volumeSize[i] / subvolumeSize[i];
+	int sx = subvolumeSize[0], sy = subvolumeSize[1], sz = subvolumeSize[2];
+
+	// Build the lowest layers and rooted MST of each subvolume, grouping the voxels into 2x2x2 blocks in place of the watershed.
+	std::vector<Runner::WaterfallPass_Ptr> passes;
+	std::vector<Runner::RootedMST_Ptr> msts;
+	std::vector<SubvolumeToVolumeIndexMapper> indexMappers;
+	std::vector<std::set<int> > volumeGroups;
+	for(int i=0; i<subvolumeCount; ++i)
+	{
+		SubvolumeToVolumeIndexMapper indexMapper(i, subvolumeSize, volumeSize);
+		std::vector<DICOMPixelProperties> properties(sx * sy * sz);
+		for(int n=0, count=static_cast<int>(properties.size()); n<count; ++n)
+		{
+			properties[n] = volumeProperties[indexMapper(n)];
+		}
+
+		std::vector<std::set<int> > groups;
+		for(int z=0; z<sz; z+=2)
+			for(int y=0; y<sy; y+=2)
+				for(int x=0; x<sx; x+=2)
+				{
+					std::set<int> group, volumeGroup;
+					for(int dz=0; dz<2; ++dz)
+						for(int dy=0; dy<2; ++dy)
+							for(int dx=0; dx<2; ++dx)
+							{
+								int n = ((z + dz) * sy + (y + dy)) * sx + (x + dx);
+								group.insert(n);
+								volumeGroup.insert(indexMapper(n));
+							}
+					groups.push_back(group);
+					volumeGroups.push_back(volumeGroup);
+				}
+
+		shared_ptr<DICOMImageLeafLayer> leafLayer(new DICOMImageLeafLayer(properties, sx, sy, sz));
+		shared_ptr<DICOMImageBranchLayer> lowestBranchLayer = IPF::make_lowest_branch_layer(leafLayer, groups);
+		msts.push_back(Runner::RootedMST_Ptr(new RootedMST<int>(*lowestBranchLayer)));
+		passes.push_back(Runner::WaterfallPass_Ptr(new GolodetzWaterfallPass<int>));
+		indexMappers.push_back(indexMapper);
+	}
+
+	// Build the forest for the whole volume.
+	shared_ptr<DICOMImageLeafLayer> leafLayer(new DICOMImageLeafLayer(volumeProperties, volumeSize[0], volumeSize[1], volumeSize[2]));
+	IPF_Ptr ipf(new IPF(leafLayer, IPF::make_lowest_branch_layer(leafLayer, volumeGroups)));
+
+	Runner runner(passes, msts, indexMappers, threadCount);
+	double ms = 0.0;
+	while(ipf->highest_layer() < layerLimit)
+	{
+		std::vector<std::set<int> > groups;
+		boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+		runner.run(groups);
+		ms += (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000.0;
+		ipf->insert_layer_above(ipf->highest_layer(), groups, IPF::DONT_CHECK_PRECONDITIONS);
+	}
+
+	ipf->output(os);
+	return ms;
+}
+
+/**
+Outputs every node of every layer of a volume IPF (its parent, children and properties) and every edge (with its weight)
+to a string, so that two forests can be compared exactly.
+*/
+std::string describe_volume_ipf(const VolumeIPFFile::VolumeIPF_CPtr& volumeIPF)
+{
+	std::ostringstream os;
+	os << volumeIPF->volume_size() << ' ' << volumeIPF->highest_layer() << '\n';
+
+	shared_ptr<const DICOMImageLeafLayer> leafLayer = volumeIPF->leaf_layer();
+	for(int n=0, count=leafLayer->node_count(); n<count; ++n)
+	{
+		os << n << ": " << leafLayer->node_parent(n) << ' ' << leafLayer->node_properties(n);
+		std::vector<WeightedEdge<int> > edges = leafLayer->adjacent_edges(n);
+		for(size_t j=0, size=edges.size(); j<size; ++j) os << " {" << edges[j].u << ',' << edges[j].v << ':' << edges[j].weight << '}';
+		os << '\n';
+	}
+
+	for(int layer=1; layer<=volumeIPF->highest_layer(); ++layer)
+	{
+		shared_ptr<const DICOMImageBranchLayer> branchLayer = volumeIPF->branch_layer(layer);
+		std::vector<int> nodeIndices = branchLayer->node_indices();
+		for(size_t i=0, size=nodeIndices.size(); i<size; ++i)
+		{
+			int n = nodeIndices[i];
+			const std::set<int>& children = branchLayer->node_children(n);
+			os << '(' << layer << ',' << n << "): " << branchLayer->node_parent(n) << " [";
+			std::copy(children.begin(), children.end(), std::ostream_iterator<int>(os, " "));
+			os << "] " << branchLayer->node_properties(n) << '\n';
+		}
+
+		std::vector<WeightedEdge<int> > edges = branchLayer->edges();
+		for(size_t j=0, size=edges.size(); j<size; ++j) os << '{' << edges[j].u << ',' << edges[j].v << ':' << edges[j].weight << "}\n";
+	}
+
+	return os.str();
+}
+
 itk::Image<unsigned char,2>::Pointer make_mosaic_image(const boost::shared_ptr<const PartitionForest<DICOMImageLeafLayer,DICOMImageBranchLayer> >& ipf,
 													   int layerIndex, int width, int height)
 {
@@ -145,6 +558,11 @@ void output_mosaic_image(const IPF_Ptr& ipf, int layerIndex, int width, int heig
 	writer->Update();
 }
 
+bool same_weighted_edge(const WeightedEdge<int>& lhs, const WeightedEdge<int>& rhs)
+{
+	return lhs.u == rhs.u && lhs.v == rhs.v && lhs.weight == rhs.weight;
+}
+
 //#################### WATERFALL PASS LISTENERS ####################
 struct BasicListener : WaterfallPass<int>::Listener
 {
@@ -172,6 +590,16 @@ struct IPFConstructionListener : WaterfallPass<int>::Listener
 	}
 };
 
+struct MergeRecordingListener : WaterfallPass<int>::Listener
+{
+	std::vector<std::pair<int,int> > m_merges;
+
+	void merge_nodes(int u, int v)
+	{
+		m_merges.push_back(std::make_pair(u, v));
+	}
+};
+
 //#################### TEST FUNCTIONS ####################
 void basic_test()
 {
@@ -238,6 +666,53 @@ void comparison_test()
 	std::cout << '\n';
 }
 
+void golodetz_equivalence_test()
+{
+	// Check that the (iterative) Golodetz waterfall pass makes exactly the same merges, in exactly the same order,
+	// as the recursive reference implementation when used to build a complete forest from random graphs. Small
+	// edge weights are used so as to produce plenty of plateaus.
+	srand(23);
+	int failures = 0;
+	const int TRIALS = 200;
+	for(int trial=0; trial<TRIALS; ++trial)
+	{
+		// Create a random connected graph.
+		int nodeCount = 2 + rand() % 300;
+		AdjacencyGraph<int, int> graph;
+		for(int i=0; i<nodeCount; ++i) graph.set_node_properties(i, i);
+		for(int i=1; i<nodeCount; ++i) graph.set_edge_weight(rand() % i, i, 1 + rand() % 4);
+		for(int i=0; i<nodeCount; ++i)
+		{
+			int u = rand() % nodeCount, v = rand() % nodeCount;
+			if(u != v) graph.set_edge_weight(u, v, 1 + rand() % 4);
+		}
+
+		// Repeatedly run both passes on their own copies of the MST until no more merges happen.
+		RootedMST<int> mst(graph), referenceMST(graph);
+		GolodetzWaterfallPass<int> pass;
+		RecursiveGolodetzWaterfallPass<int> referencePass;
+		boost::shared_ptr<MergeRecordingListener> listener(new MergeRecordingListener), referenceListener(new MergeRecordingListener);
+		pass.add_shared_listener(listener);
+		referencePass.add_shared_listener(referenceListener);
+
+		int lastNodeCount;
+		do
+		{
+			lastNodeCount = mst.node_count();
+			pass.run(mst);
+			referencePass.run(referenceMST);
+		} while(mst.node_count() != 1 && mst.node_count() != lastNodeCount);
+
+		if(listener->m_merges != referenceListener->m_merges ||
+		   !std::equal(mst.edges_cbegin(), mst.edges_cend(), referenceMST.edges_cbegin(), same_weighted_edge))
+		{
+			std::cout << "Trial " << trial << " (" << nodeCount << " nodes): merges differ from the reference implementation\n";
+			++failures;
+		}
+	}
+	std::cout << "Golodetz waterfall equivalence test: " << TRIALS - failures << '/' << TRIALS << " trials matched\n";
+}
+
 void golodetz_test_A()
 {
 	// Create the graph.
@@ -647,9 +1122,118 @@ void real_image_test(const std::string& filename, const std::string& outputSpeci
 	}
 }
 
+void subvolume_waterfall_benchmark()
+{
+	// Check that running the waterfall passes for the subvolumes of a volume concurrently builds exactly the same forest
+	// as running them one after the other, and see how the time spent running the passes scales with the number of threads.
+	const itk::Size<3> volumeSize = {{128,64,32}}, subvolumeSize = {{32,32,16}};
+	const int LAYER_LIMIT = 6;
+
+	srand(23);
+	std::vector<DICOMPixelProperties> volumeProperties(volumeSize[0] * volumeSize[1] * volumeSize[2]);
+	for(size_t i=0, size=volumeProperties.size(); i<size; ++i)
+	{
+		int value = rand() % 256;
+		volumeProperties[i] = DICOMPixelProperties(value, static_cast<short>(rand() % 64), static_cast<unsigned char>(value));
+	}
+
+	std::string reference;
+	const int threadCounts[] = {1, 2, 4, 8};
+	for(size_t i=0; i<sizeof(threadCounts) / sizeof(threadCounts[0]); ++i)
+	{
+		std::ostringstream os;
+		double ms = build_subvolume_forest(volumeProperties, volumeSize, subvolumeSize, LAYER_LIMIT, threadCounts[i], os);
+		if(i == 0) reference = os.str();
+		std::cout << "Subvolume waterfall, " << threadCounts[i] << " thread(s): " << ms << " ms"
+				  << (os.str() == reference ? "" : " (forest differs from the single-threaded one!)") << '\n';
+	}
+}
+
+void volume_ipf_file_test()
+{
+	// Check that saving a forest in the binary and text formats and loading it back gives exactly the same forest both ways.
+	typedef VolumeIPFFile::VolumeIPFT VIPF;
+	typedef SubvolumeWaterfallRunner<VIPF> Runner;
+
+	const itk::Size<3> volumeSize = {{16,12,8}};
+	const int sx = volumeSize[0], sy = volumeSize[1], sz = volumeSize[2];
+
+	srand(23);
+	std::vector<DICOMPixelProperties> properties(sx * sy * sz);
+	for(size_t i=0, size=properties.size(); i<size; ++i)
+	{
+		int value = rand() % 256;
+		properties[i] = DICOMPixelProperties(value - 128, static_cast<short>(rand() % 64), static_cast<unsigned char>(value));
+	}
+
+	// Build a forest with a few layers, grouping the voxels into 2x2x2 blocks in place of the watershed.
+	std::vector<std::set<int> > groups;
+	for(int z=0; z<sz; z+=2)
+		for(int y=0; y<sy; y+=2)
+			for(int x=0; x<sx; x+=2)
+			{
+				std::set<int> group;
+				for(int dz=0; dz<2; ++dz)
+					for(int dy=0; dy<2; ++dy)
+						for(int dx=0; dx<2; ++dx)
+						{
+							group.insert(((z + dz) * sy + (y + dy)) * sx + (x + dx));
+						}
+				groups.push_back(group);
+			}
+
+	shared_ptr<DICOMImageLeafLayer> leafLayer(new DICOMImageLeafLayer(properties, sx, sy, sz));
+	shared_ptr<DICOMImageBranchLayer> lowestBranchLayer = VIPF::make_lowest_branch_layer(leafLayer, groups);
+	shared_ptr<VIPF> volumeIPF(new VIPF(volumeSize, leafLayer, lowestBranchLayer));
+
+	std::vector<Runner::WaterfallPass_Ptr> passes(1, Runner::WaterfallPass_Ptr(new GolodetzWaterfallPass<int>));
+	std::vector<Runner::RootedMST_Ptr> msts(1, Runner::RootedMST_Ptr(new RootedMST<int>(*lowestBranchLayer)));
+	std::vector<SubvolumeToVolumeIndexMapper> indexMappers(1, SubvolumeToVolumeIndexMapper(0, volumeSize, volumeSize));
+	Runner runner(passes, msts, indexMappers, 1);
+	while(volumeIPF->highest_layer() < 4 && !runner.finished())
+	{
+		std::vector<std::set<int> > layerGroups;
+		runner.run(layerGroups);
+		volumeIPF->insert_layer_above(volumeIPF->highest_layer(), layerGroups, VIPF::DONT_CHECK_PRECONDITIONS);
+	}
+
+	// Round-trip the forest through both formats and compare everything.
+	std::string expected = describe_volume_ipf(volumeIPF);
+	VolumeIPFFile::save("volume-ipf-file-test-binary.ipf", volumeIPF, VolumeIPFFile::FORMAT_BINARY);
+	VolumeIPFFile::save("volume-ipf-file-test-text.ipf", volumeIPF, VolumeIPFFile::FORMAT_TEXT);
+	std::string binary = describe_volume_ipf(VolumeIPFFile::load("volume-ipf-file-test-binary.ipf"));
+	std::string text = describe_volume_ipf(VolumeIPFFile::load("volume-ipf-file-test-text.ipf"));
+
+	// Check that a binary file whose node indices do not refer to nodes of the adjacent layer is rejected, rather than loaded as an inconsistent forest.
+	std::string bytes;
+	{
+		std::ifstream is("volume-ipf-file-test-binary.ipf", std::ios_base::binary);
+		bytes.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+	}
+	boost::uint64_t leafOffset;
+	std::memcpy(&leafOffset, &bytes[32], sizeof(leafOffset));		// the leaf layer offset follows the 32-byte header
+	const int voxelCount = sx * sy * sz, badParent = voxelCount;
+	std::memcpy(&bytes[static_cast<size_t>(leafOffset) + voxelCount * (sizeof(int) + sizeof(short) + sizeof(unsigned char))], &badParent, sizeof(int));
+	{
+		std::ofstream os("volume-ipf-file-test-corrupt.ipf", std::ios_base::binary);
+		os.write(bytes.data(), bytes.size());
+	}
+	bool rejected = false;
+	try { VolumeIPFFile::load("volume-ipf-file-test-corrupt.ipf"); }
+	catch(Exception&) { rejected = true; }
+
+	std::cout << "Volume IPF file test (" << volumeIPF->highest_layer() << " branch layers): binary format "
+			  << (binary == expected ? "matches" : "DIFFERS") << ", text format " << (text == expected ? "matches" : "DIFFERS")
+			  << ", corrupt file " << (rejected ? "rejected" : "ACCEPTED") << '\n';
+}
+
 int main()
 try
 {
+	golodetz_equivalence_test();
+	subvolume_waterfall_benchmark();
+	volume_ipf_file_test();
+
 	//basic_test();
 	//comparison_test();
 	//golodetz_test_A();
@@ -1,11 +1,16 @@
 /***
  * test-watershed: main.cpp
  * Copyright Stuart Golodetz, 2009. All rights reserved.
+ * Modified by Varduhi Yeghiazaryan, 2013.
  ***/
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/shared_ptr.hpp>
 using boost::shared_ptr;
 
@@ -16,9 +21,11 @@ using boost::shared_ptr;
 #include <itkImageFileWriter.h>
 #include <itkScalarToRGBPixelFunctor.h>
 
+#include <common/jobs/ParallelJob.h>
 #include <common/partitionforests/base/PartitionForest.h>
 #include <common/partitionforests/images/DICOMImageBranchLayer.h>
 #include <common/partitionforests/images/DICOMImageLeafLayer.h>
+#include <common/segmentation/DiffusionGradientPreprocessor.h>
 #include <common/segmentation/watershed/MeijsterRoerdinkWatershed.h>
 #include <common/util/ITKImageUtil.h>
 using namespace mp;
@@ -166,6 +173,109 @@ void forest_test()
 	IPF_Ptr ipf(new IPF(leafLayer, lowestBranchLayer));
 }
 
+void preprocessing_test(const itk::Image<int,3>::Pointer& baseImage, bool useImageSpacing)
+{
+	typedef itk::Image<int,3> BaseImage;
+	typedef itk::Image<short,3> GradientMagnitudeImage;
+	typedef itk::Image<float,3> RealImage;
+
+	const int ITERATIONS = 5;
+	const double CONDUCTANCE = 1.0;
+	const int voxelCount = static_cast<int>(baseImage->GetLargestPossibleRegion().GetNumberOfPixels());
+
+	// Preprocess the volume using ITK filters (as DICOMLowestLayersBuilder used to do).
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+	typedef itk::CastImageFilter<BaseImage,RealImage> CastFilter;
+	CastFilter::Pointer castFilter = CastFilter::New();
+	castFilter->SetInput(baseImage);
+	castFilter->Update();
+	RealImage::Pointer itkSmoothedImage = castFilter->GetOutput();
+
+	typedef itk::GradientAnisotropicDiffusionImageFilter<RealImage,RealImage> ADFilter;
+	for(int i=0; i<ITERATIONS; ++i)
+	{
+		ADFilter::Pointer adFilter = ADFilter::New();
+		adFilter->SetInput(itkSmoothedImage);
+		adFilter->SetConductanceParameter(CONDUCTANCE);
+		adFilter->SetNumberOfIterations(1);
+		adFilter->SetTimeStep(0.0625);
+		adFilter->SetUseImageSpacing(useImageSpacing);
+		adFilter->Update();
+		itkSmoothedImage = adFilter->GetOutput();
+	}
+
+	typedef itk::GradientMagnitudeImageFilter<RealImage,GradientMagnitudeImage> GMFilter;
+	GMFilter::Pointer gmFilter = GMFilter::New();
+	gmFilter->SetInput(itkSmoothedImage);
+	gmFilter->SetUseImageSpacingOff();
+	gmFilter->Update();
+	GradientMagnitudeImage::Pointer itkGradientMagnitudeImage = gmFilter->GetOutput();
+
+	double itkMs = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000.0;
+
+	// Preprocess the volume using the preprocessor, both single-threaded with separate passes and multi-threaded with fused passes.
+	start = boost::posix_time::microsec_clock::universal_time();
+	DiffusionGradientPreprocessor serialPreprocessor(baseImage, CONDUCTANCE, ITERATIONS, useImageSpacing, 0.0625, 1, false);
+	GradientMagnitudeImage::Pointer serialGradientMagnitudeImage = serialPreprocessor.gradient_magnitude_image();
+	double serialMs = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000.0;
+
+	start = boost::posix_time::microsec_clock::universal_time();
+	DiffusionGradientPreprocessor fusedPreprocessor(baseImage, CONDUCTANCE, ITERATIONS, useImageSpacing, 0.0625, std::max(2, ParallelJob::default_thread_count()), true);
+	GradientMagnitudeImage::Pointer fusedGradientMagnitudeImage = fusedPreprocessor.gradient_magnitude_image();
+	double fusedMs = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000.0;
+
+	// The preprocessor's results should not depend on how it was run.
+	RealImage::Pointer serialSmoothedImage = serialPreprocessor.smoothed_image();
+	RealImage::Pointer fusedSmoothedImage = fusedPreprocessor.smoothed_image();
+	assert(std::equal(serialSmoothedImage->GetBufferPointer(), serialSmoothedImage->GetBufferPointer() + voxelCount, fusedSmoothedImage->GetBufferPointer()));
+	assert(std::equal(serialGradientMagnitudeImage->GetBufferPointer(), serialGradientMagnitudeImage->GetBufferPointer() + voxelCount, fusedGradientMagnitudeImage->GetBufferPointer()));
+
+	// They should also match the ITK results, up to floating-point rounding (which can occasionally tip a truncated gradient magnitude over an integer boundary).
+	double maxSmoothedDifference = 0.0;
+	int maxGradientMagnitudeDifference = 0;
+	for(int i=0; i<voxelCount; ++i)
+	{
+		maxSmoothedDifference = std::max(maxSmoothedDifference, static_cast<double>(std::fabs(itkSmoothedImage->GetBufferPointer()[i] - fusedSmoothedImage->GetBufferPointer()[i])));
+		maxGradientMagnitudeDifference = std::max(maxGradientMagnitudeDifference, std::abs(itkGradientMagnitudeImage->GetBufferPointer()[i] - fusedGradientMagnitudeImage->GetBufferPointer()[i]));
+	}
+
+	std::cout << (useImageSpacing ? "With" : "Without") << " image spacing:\n";
+	std::cout << "ITK filters: " << itkMs << " ms\n";
+	std::cout << "Preprocessor (1 thread, separate passes): " << serialMs << " ms\n";
+	std::cout << "Preprocessor (" << std::max(2, ParallelJob::default_thread_count()) << " threads, fused passes): " << fusedMs << " ms\n";
+	std::cout << "Max smoothed image difference: " << maxSmoothedDifference << '\n';
+	std::cout << "Max gradient magnitude difference: " << maxGradientMagnitudeDifference << '\n';
+	assert(maxSmoothedDifference < 1e-2);
+	assert(maxGradientMagnitudeDifference <= 1);
+}
+
+void preprocessing_test()
+{
+	// Make a noisy synthetic volume made up of blocks with different (Hounsfield-like) values. Its voxels are anisotropic
+	// (as in a typical CT volume), so that using the image spacing in the diffusion makes a difference.
+	const int SIZE_X = 96, SIZE_Y = 96, SIZE_Z = 48;
+	itk::Image<int,3>::Pointer baseImage = ITKImageUtil::make_image<int>(SIZE_X, SIZE_Y, SIZE_Z);
+	itk::Image<int,3>::SpacingType spacing;
+	spacing[0] = 0.7;
+	spacing[1] = 0.7;
+	spacing[2] = 2.5;
+	baseImage->SetSpacing(spacing);
+	int *pixels = baseImage->GetBufferPointer();
+	unsigned int seed = 12345;
+	for(int z=0; z<SIZE_Z; ++z)
+		for(int y=0; y<SIZE_Y; ++y)
+			for(int x=0; x<SIZE_X; ++x)
+			{
+				seed = seed * 1103515245 + 12345;
+				int block = (x / 11 + y / 7 + z / 5) % 3;
+				pixels[(z * SIZE_Y + y) * SIZE_X + x] = block * 400 - 1000 + static_cast<int>((seed >> 16) % 200);
+			}
+
+	preprocessing_test(baseImage, false);
+	preprocessing_test(baseImage, true);
+}
+
 void real_image_test()
 {
 	typedef itk::Image<unsigned char,2> UCImage;
@@ -243,6 +353,7 @@ try
 	//basic_test();
 	//gradient_test();
 	//forest_test();
+	preprocessing_test();
 	real_image_test();
 	return 0;
 }